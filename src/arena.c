@@ -2,12 +2,17 @@
 /* arena.h: a simple bump allocator for managing memory */
 /* Credit to skeeto and his blogs for inspiration */
 
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE // for MAP_ANONYMOUS
+#endif /* ifndef _DEFAULT_SOURCE */
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/cdefs.h>
+#include <sys/mman.h>
 
 #include "arena.h"
 
@@ -19,9 +24,115 @@ void arena_abort__()
 
 static void (*arena_abort_fn__)() = arena_abort__;
 
-void arena_abort_set(void (*abort_func)())
+void arena_abort_fn_set(void (*abort_func)())
+{
+    arena_abort_fn__ = abort_func ? abort_func : arena_abort__;
+}
+
+/* Arena_Block
+ * Footer at the end of each block chained to an arena, arena->end points to it while the block is in use.
+ */
+typedef struct Arena_Block {
+    struct Arena_Block* next;
+    uintptr_t size; // size of the mapping, including the footer
+} Arena_Block;
+
+struct Arena_Chain {
+    char* base_end; // end of the arena's first block, which isn't part of the chain
+    Arena_Block* head;
+    Arena_Block* tail;
+    uintptr_t next_size;
+    uintptr_t total;
+    uintptr_t cap;
+};
+
+#define ARENA_BLOCK_MIN_SIZE (1 << 16)
+
+void arena_chain(Arena* restrict arena, uintptr_t cap)
+{
+    assert(arena); assert(!arena->chain);
+
+    uintptr_t size = (uintptr_t)(arena->end - arena->start);
+    Arena_Chain* chain = arena_malloc(arena, 1, Arena_Chain);
+    chain->base_end = arena->end;
+    chain->cap = cap;
+    chain->next_size = ARENA_BLOCK_MIN_SIZE;
+    while (chain->next_size < size) {
+        chain->next_size <<= 1;
+    }
+    arena->chain = chain;
+}
+
+void arena_chain_free(Arena* restrict arena)
 {
-    arena_abort_fn__= abort_func;
+    assert(arena);
+    if (!arena->chain) {
+        return;
+    }
+
+    Arena_Chain* chain = arena->chain;
+    Arena_Block* block = chain->head;
+    while (block) {
+        Arena_Block* next = block->next;
+        munmap((char*)(block + 1) - block->size, block->size);
+        block = next;
+    }
+    chain->head = chain->tail = NULL;
+    chain->total = 0;
+}
+
+/* arena_chain_next__
+ * Slow path of arena_malloc__ and arena_realloc__ for chained arenas, moves the arena to a block with room for
+ * count * size bytes. Blocks after the current one are reused before mapping a new one, since copies of the arena
+ * (like scratch arenas passed by value) leave their blocks behind when they go out of scope.
+ * Returns: false if the cap was reached or the block couldn't be mapped
+ */
+[[nodiscard]]
+static bool arena_chain_next__(Arena* restrict arena, uintptr_t count, uintptr_t size, uintptr_t alignment)
+{
+    Arena_Chain* chain = arena->chain;
+    if (count > (UINTPTR_MAX - alignment - sizeof(Arena_Block)) / size) {
+        return false;
+    }
+    uintptr_t needed = count * size + alignment + sizeof(Arena_Block);
+
+    Arena_Block* block = arena->end == chain->base_end ? chain->head : ((Arena_Block*)arena->end)->next;
+    for (; block; block = block->next) {
+        if (block->size >= needed) {
+            arena->start = (char*)(block + 1) - block->size;
+            arena->end = (char*)block;
+            return true;
+        }
+    }
+
+    uintptr_t block_size = chain->next_size;
+    while (block_size < needed) {
+        block_size <<= 1;
+    }
+    if (chain->cap && block_size > chain->cap - chain->total) {
+        return false;
+    }
+
+    char* memory = mmap(NULL, block_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    block = (Arena_Block*)(memory + block_size) - 1;
+    *block = (Arena_Block){.size = block_size};
+    if (chain->tail) {
+        chain->tail->next = block;
+    }
+    else {
+        chain->head = block;
+    }
+    chain->tail = block;
+    chain->next_size = block_size << 1;
+    chain->total += block_size;
+
+    arena->start = memory;
+    arena->end = (char*)block;
+    return true;
 }
 
 [[nodiscard]]
@@ -34,9 +145,13 @@ void* arena_malloc__(Arena* restrict arena, uintptr_t count, uintptr_t size,
 
     uintptr_t padding = -(uintptr_t)arena->start & (alignment - 1);
     uintptr_t available = (uintptr_t)arena->end - (uintptr_t)arena->start - padding;
-    assert(count < available / size);
     if (available == 0 || count > available / size) {
-        arena_abort_fn__();
+        // the abort function shouldn't return, if it does there's nothing to allocate in
+        if (!arena->chain || !arena_chain_next__(arena, count, size, alignment)) {
+            arena_abort_fn__();
+            return NULL;
+        }
+        padding = -(uintptr_t)arena->start & (alignment - 1);
     }
     void* val = arena->start + padding;
     arena->start += padding + count * size;
@@ -53,9 +168,13 @@ void* arena_realloc__(Arena* restrict arena, uintptr_t count, uintptr_t size,
 
     uintptr_t padding = -(uintptr_t)arena->start & (alignment - 1);
     uintptr_t available = (uintptr_t)arena->end - (uintptr_t)arena->start - padding;
-    assert(count < available / size);
     if (available == 0 || count > available / size) {
-        arena_abort_fn__();
+        // the abort function shouldn't return, if it does there's nothing to allocate in
+        if (!arena->chain || !arena_chain_next__(arena, count, size, alignment)) {
+            arena_abort_fn__();
+            return NULL;
+        }
+        padding = -(uintptr_t)arena->start & (alignment - 1);
     }
     void* val = arena->start + padding;
     arena->start += padding + count * size;
@@ -23,17 +23,35 @@
 #   define ATTR_ALLOC_ALIGN(pos)
 #endif
 
+typedef struct Arena_Chain Arena_Chain;
+
 typedef struct {
     char* start;
     char* end;
+    Arena_Chain* chain; // NULL unless arena_chain was called, then full arenas grow instead of aborting
 } Arena;
 
 /* arena_abort_fn_set
  * Set the function to be called if the arena is full and the requested memory can't be allocated in the arena.
- * abort_func should call exit, abort, or longjmp.
+ * abort_func should call exit, abort, or longjmp, if it returns the allocation returns NULL.
+ * Pass NULL to go back to printing an error and aborting.
  */
 void arena_abort_fn_set(void (*abort_func)());
 
+/* arena_chain
+ * Let the arena grow when full instead of aborting.
+ * When an allocation doesn't fit, a new block is mmap'd and chained after the current one,
+ * each new block twice the size of the last, until cap bytes have been chained (no limit if cap is 0).
+ * Copies of the arena, like scratch arenas passed by value, share the chain and reuse its blocks.
+ * The chain is allocated in the arena itself.
+ */
+void arena_chain(Arena* restrict arena, uintptr_t cap);
+
+/* arena_chain_free
+ * Unmap the blocks chained to the arena. Memory from the arena's first block isn't freed.
+ */
+void arena_chain_free(Arena* restrict arena);
+
 /* arena_malloc
  * Call to allocate in the arena.
  * Convience wrapper for arena_malloc__
@@ -10,6 +10,8 @@
 #endif /* ifndef _POXIC_C_SOURCE */
 
 #include <assert.h>
+#include <errno.h>
+#include <limits.h>
 #include <linux/limits.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,6 +24,7 @@
 #include "debug.h"
 #include "defines.h" // used for macro NCSH_MAX_INPUT
 #include "env.h"
+#include "path_cache.h"
 #include "types.h"
 #include "eskilib/efile.h"
 #include "eskilib/eresult.h"
@@ -102,6 +105,22 @@ enum eresult conf_history_file_set(Shell* restrict shell)
 #endif /* ifdef NCSH_HISTORY_TEST */
 }
 
+/* conf_ac_file_set
+ * The snapshot of the autocompletions trie is saved next to the history file it is built from.
+ */
+enum eresult conf_ac_file_set(Shell* restrict shell)
+{
+    Str* ac_file = estrcat(&shell->config.history_file, &Str_Lit(NCSH_AC_FILE_SUFFIX), &shell->arena);
+    if (!ac_file) {
+        shell->config.ac_file = Str_Empty;
+        return E_FAILURE;
+    }
+
+    shell->config.ac_file = *ac_file;
+    debugf("ac->file: %s\n", shell->config.ac_file.value);
+    return E_SUCCESS;
+}
+
 /* conf_path_add
  * The function which handles config items which add values to PATH.
  */
@@ -127,11 +146,120 @@ void conf_path_add(Str* path, char* restrict val, int len, Arena* restrict arena
     debugf("Got new path to set %s\n", new_path.value);
 }
 
+/* conf_number
+ * Returns: true if val is a number, which is put in number.
+ */
+[[nodiscard]]
+static bool conf_number(char* restrict val, double* restrict number)
+{
+    char* end;
+    errno = 0;
+    double result = strtod(val, &end);
+    if (errno || end == val || *end) {
+        return false;
+    }
+    *number = result;
+    return true;
+}
+
+/* conf_ac_frecency_set
+ * The config items which set how autocompletions are ranked, like 'AC_HALF_LIFE_HOURS=72'.
+ * Values which aren't numbers or are out of range are ignored.
+ */
+#define AC_HALF_LIFE_HOURS "AC_HALF_LIFE_HOURS="
+#define AC_AGE_EVERY "AC_AGE_EVERY="
+#define AC_PRUNE_BELOW "AC_PRUNE_BELOW="
+void conf_ac_frecency_set(char* restrict item, Autocompletion_Frecency* restrict frecency)
+{
+    assert(item); assert(frecency);
+
+    double number;
+    if (!strncmp(item, AC_HALF_LIFE_HOURS, sizeof(AC_HALF_LIFE_HOURS) - 1)) {
+        if (conf_number(item + sizeof(AC_HALF_LIFE_HOURS) - 1, &number) && number > 0) {
+            frecency->half_life = number * 60 * 60;
+        }
+    }
+    else if (!strncmp(item, AC_AGE_EVERY, sizeof(AC_AGE_EVERY) - 1)) {
+        if (conf_number(item + sizeof(AC_AGE_EVERY) - 1, &number) && number >= 0 && number <= AC_AGE_EVERY_MAX) {
+            frecency->age_every = (uint16_t)number;
+        }
+    }
+    else if (!strncmp(item, AC_PRUNE_BELOW, sizeof(AC_PRUNE_BELOW) - 1)) {
+        if (conf_number(item + sizeof(AC_PRUNE_BELOW) - 1, &number) && number >= 0) {
+            frecency->prune_below = number;
+        }
+    }
+
+    debugf("ac frecency: half life %f, age every %d, prune below %f\n", frecency->half_life, frecency->age_every,
+           frecency->prune_below);
+}
+
+/* conf_history_max_set
+ * The config item which sets how many history entries are held in memory, like 'HISTORY_MAX=100000'.
+ * Values which aren't numbers or are out of range are ignored.
+ */
+#define HISTORY_MAX "HISTORY_MAX="
+void conf_history_max_set(char* restrict item, unsigned* restrict history_max)
+{
+    assert(item); assert(history_max);
+
+    double number;
+    if (!strncmp(item, HISTORY_MAX, sizeof(HISTORY_MAX) - 1)) {
+        if (conf_number(item + sizeof(HISTORY_MAX) - 1, &number) && number >= 0 && number <= INT_MAX &&
+            number == (unsigned)number) {
+            *history_max = (unsigned)number;
+        }
+    }
+
+    debugf("history max: %u\n", *history_max);
+}
+
+/* conf_history_erase_dups_set
+ * The config item which turns erase dups on or off, 'HISTORY_ERASE_DUPS=1' or 'HISTORY_ERASE_DUPS=0'.
+ * Other values are ignored.
+ */
+#define HISTORY_ERASE_DUPS "HISTORY_ERASE_DUPS="
+void conf_history_erase_dups_set(char* restrict item, bool* restrict erase_dups)
+{
+    assert(item); assert(erase_dups);
+
+    double number;
+    if (!strncmp(item, HISTORY_ERASE_DUPS, sizeof(HISTORY_ERASE_DUPS) - 1)) {
+        if (conf_number(item + sizeof(HISTORY_ERASE_DUPS) - 1, &number) && (number == 0 || number == 1)) {
+            *erase_dups = number == 1;
+        }
+    }
+
+    debugf("history erase dups: %d\n", *erase_dups);
+}
+
+/* conf_z_parallel_min_set
+ * The config item which sets how many directories z scores on more than one thread from, like 'Z_PARALLEL_MIN=50000'.
+ * 0 scores them on the shell's thread whatever their number. Values which aren't numbers or are out of range are
+ * ignored.
+ */
+#define Z_PARALLEL_MIN "Z_PARALLEL_MIN="
+void conf_z_parallel_min_set(char* restrict item, unsigned* restrict z_parallel_min)
+{
+    assert(item); assert(z_parallel_min);
+
+    double number;
+    if (!strncmp(item, Z_PARALLEL_MIN, sizeof(Z_PARALLEL_MIN) - 1)) {
+        if (conf_number(item + sizeof(Z_PARALLEL_MIN) - 1, &number) && number >= 0 && number <= INT_MAX &&
+            number == (unsigned)number) {
+            *z_parallel_min = (unsigned)number;
+        }
+    }
+
+    debugf("z parallel min: %u\n", *z_parallel_min);
+}
+
 /* conf_process
  * Iterate through the .ncshrc config file and perform any actions needed.
  */
 #define PATH_ADD "PATH+="
 #define ALIAS_ADD "ALIAS "
+#define AC_ITEM "AC_"
 void conf_process(FILE* restrict file, Shell* shell)
 {
     int buffer_length;
@@ -150,12 +278,31 @@ void conf_process(FILE* restrict file, Shell* shell)
         else if (buffer_length > 6 && !memcmp(buffer, ALIAS_ADD, sizeof(ALIAS_ADD) - 1)) {
             alias_add(Str(buffer + 6, (size_t)(buffer_length - 6)), &shell->arena);
         }
+        // Autocompletion ranking, like 'AC_HALF_LIFE_HOURS=72'
+        else if (buffer_length > 3 && !memcmp(buffer, AC_ITEM, sizeof(AC_ITEM) - 1)) {
+            conf_ac_frecency_set(buffer, &shell->config.ac_frecency);
+        }
+        // History size, like 'HISTORY_MAX=100000'
+        else if (buffer_length > 12 && !memcmp(buffer, HISTORY_MAX, sizeof(HISTORY_MAX) - 1)) {
+            conf_history_max_set(buffer, &shell->config.history_max);
+        }
+        // Moving commands ran again to the newest in the history instead of adding them again, like 'HISTORY_ERASE_DUPS=1'
+        else if (buffer_length > 19 && !memcmp(buffer, HISTORY_ERASE_DUPS, sizeof(HISTORY_ERASE_DUPS) - 1)) {
+            conf_history_erase_dups_set(buffer, &shell->config.history_erase_dups);
+        }
+        // Directories z scores on more than one thread from, like 'Z_PARALLEL_MIN=50000'
+        else if (buffer_length > 15 && !memcmp(buffer, Z_PARALLEL_MIN, sizeof(Z_PARALLEL_MIN) - 1)) {
+            conf_z_parallel_min_set(buffer, &shell->config.z_parallel_min);
+        }
 
         memset(buffer, '\0', (size_t)buffer_length);
     }
 
     if (path->length && update_path) {
         setenv(PATH, path->value, true);
+        if (shell->path_cache) {
+            path_cache_clear(shell->path_cache);
+        }
     }
 }
 
@@ -229,6 +376,24 @@ enum eresult conf_init(Shell* restrict shell)
         return result;
     }
 
+    if ((result = conf_ac_file_set(shell)) != E_SUCCESS) {
+        debug("failed setting autocompletions file");
+        return result;
+    }
+
+    shell->config.ac_frecency = (Autocompletion_Frecency){
+        .half_life = NCSH_AC_HALF_LIFE_HOURS * 60.0 * 60.0,
+        .age_every = NCSH_AC_AGE_EVERY,
+        .prune_below = NCSH_AC_PRUNE_BELOW,
+    };
+    shell->config.history_max = NCSH_MAX_HISTORY_IN_MEMORY;
+#ifdef NCSH_HISTORY_ERASE_DUPS
+    shell->config.history_erase_dups = true;
+#else
+    shell->config.history_erase_dups = false;
+#endif /* NCSH_HISTORY_ERASE_DUPS */
+    shell->config.z_parallel_min = NCSH_Z_PARALLEL_MIN;
+
     if ((result = conf_file_load(shell)) != E_SUCCESS) {
         debug("failed loading config file");
         return result;
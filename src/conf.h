@@ -16,4 +16,27 @@
 #define NCSH_HISTORY_FILE "/ncsh_history"
 #endif
 
+#define NCSH_AC_FILE_SUFFIX "_ac"
+
 enum eresult conf_init(Shell* shell);
+
+/* conf_ac_frecency_set
+ * Handle a config item which sets how autocompletions are ranked, like 'AC_HALF_LIFE_HOURS=72'.
+ */
+void conf_ac_frecency_set(char* restrict item, Autocompletion_Frecency* restrict frecency);
+
+/* conf_history_max_set
+ * Handle a config item which sets how many history entries are held in memory, like 'HISTORY_MAX=100000'.
+ */
+void conf_history_max_set(char* restrict item, unsigned* restrict history_max);
+
+/* conf_history_erase_dups_set
+ * Handle a config item which turns erase dups on or off, like 'HISTORY_ERASE_DUPS=1'.
+ */
+void conf_history_erase_dups_set(char* restrict item, bool* restrict erase_dups);
+
+/* conf_z_parallel_min_set
+ * Handle a config item which sets how many directories z scores on more than one thread from, like
+ * 'Z_PARALLEL_MIN=50000'.
+ */
+void conf_z_parallel_min_set(char* restrict item, unsigned* restrict z_parallel_min);
@@ -67,21 +67,104 @@
 #define    NCSH_START_TIME
 #endif // !NCSH_START_TIME
 
+/* NCSH_BACKGROUND_STARTUP: draw the first prompt right after the config file is loaded, and load history,
+ * autocompletions, and the z database on a background thread (defined by default).
+ * Hints are empty until they are loaded, and the first command waits for them.
+ * Useful when the home directory is on a slow filesystem like NFS. */
+#ifndef NCSH_BACKGROUND_STARTUP
+#define    NCSH_BACKGROUND_STARTUP
+#endif // !NCSH_BACKGROUND_STARTUP
+
+
+
+/********* Execution Settings *********/
+/* NCSH_SPAWN: launch external commands with posix_spawn instead of fork + exec (defined by default).
+ * posix_spawn doesn't copy the shell's page tables (glibc implements it with clone(CLONE_VM | CLONE_VFORK)),
+ * which makes a difference for scripts running many short commands since the shell maps a 17 MiB arena.
+ * Define NCSH_FORK to use fork + exec instead. */
+#if !defined(NCSH_SPAWN) && !defined(NCSH_FORK)
+#    define     NCSH_SPAWN
+#endif // !NCSH_SPAWN && !NCSH_FORK
+
+/* NCSH_PIPEFAIL: when defined, pipefail starts enabled.
+ * The status of a pipeline is then the status of the rightmost stage which failed, instead of the last stage.
+ * Can be toggled at runtime with 'set -o pipefail' and 'set +o pipefail'. */
+#ifndef NCSH_PIPEFAIL
+// #    define     NCSH_PIPEFAIL
+#endif // !NCSH_PIPEFAIL
+
+
+
+/********* Memory Settings *********/
+/* NCSH_ARENA_CHAIN_CAP: the max number of bytes the shell's arenas can each grow by once their first block is full.
+ * Full arenas chain new mmap'd blocks, each twice the size of the last, instead of aborting the shell.
+ * Define as 0 to let the arenas grow without limit. */
+#ifndef NCSH_ARENA_CHAIN_CAP
+#    define NCSH_ARENA_CHAIN_CAP (1UL << 30)
+#endif // !NCSH_ARENA_CHAIN_CAP
+
 
 
 /********* History Settings *********/
-// TODO: these not used after bestline, incorporate
+// TODO: NCSH_MAX_HISTORY_FILE not used after bestline, incorporate
 /* NCSH_MAX_HISTORY_FILE: the maximum number of history entries to save to the history file */
 #ifndef NCSH_MAX_HISTORY_FILE
 #    define NCSH_MAX_HISTORY_FILE 2000
 #endif // !NCSH_MAX_HISTORY_FILE
 
-/* NCSH_MAX_HISTORY_FILE: the maximum number of history entries to be able to hold in memory while the program is
- * running. */
+/* NCSH_MAX_HISTORY_IN_MEMORY: the maximum number of history entries to be able to hold in memory while the program is
+ * running. The oldest entries are dropped when there are more, and only the newest are loaded from the history file.
+ * Can be set in .ncshrc with HISTORY_MAX=
+ */
 #ifndef NCSH_MAX_HISTORY_IN_MEMORY
 #    define NCSH_MAX_HISTORY_IN_MEMORY 2400
 #endif // !NCSH_MAX_HISTORY_IN_MEMORY
 
+/* NCSH_HISTORY_ERASE_DUPS: when defined, a command ran again moves to the newest in the history instead of being
+ * added again, so the history holds each command once. Can be set in .ncshrc with HISTORY_ERASE_DUPS=1 or =0.
+ */
+#ifndef NCSH_HISTORY_ERASE_DUPS
+// #    define NCSH_HISTORY_ERASE_DUPS
+#endif // !NCSH_HISTORY_ERASE_DUPS
+
+/* NCSH_HISTORY_APPEND: append each command to the history file as it's ran instead of rewriting the whole file on
+ * exit (defined by default). Lets shells running at the same time share their history instead of the last one to
+ * exit overwriting it, commands from the other shells are merged in before each prompt. When the file holds more than
+ * twice NCSH_MAX_HISTORY_IN_MEMORY (or HISTORY_MAX=) entries, it's compacted to the newest ones on exit. */
+#ifndef NCSH_HISTORY_APPEND
+#define    NCSH_HISTORY_APPEND
+#endif // !NCSH_HISTORY_APPEND
+
+/* NCSH_HISTORY_APPEND_BATCH: with NCSH_HISTORY_APPEND, the number of commands appended to the history file together.
+ * Commands waiting to be appended are lost if the shell is killed. */
+#ifndef NCSH_HISTORY_APPEND_BATCH
+#    define NCSH_HISTORY_APPEND_BATCH 1
+#endif // !NCSH_HISTORY_APPEND_BATCH
+
+/* NCSH_HISTORY_FSYNC: with NCSH_HISTORY_APPEND, sync the history file to disk after every append (not defined by
+ * default). */
+#ifndef NCSH_HISTORY_FSYNC
+// #define NCSH_HISTORY_FSYNC
+#endif // !NCSH_HISTORY_FSYNC
+
+
+
+/********* z Settings *********/
+/* NCSH_Z_PARALLEL_MIN: the number of directories z has to score from which they're split between NCSH_Z_THREADS
+ * threads. The threads are started the first time the database is that large, and wait for the next z after.
+ * Smaller databases are scored on the shell's thread. Define as 0 to always score on the shell's thread.
+ * Can be set in .ncshrc with Z_PARALLEL_MIN=
+ */
+#ifndef NCSH_Z_PARALLEL_MIN
+#    define NCSH_Z_PARALLEL_MIN 20000
+#endif // !NCSH_Z_PARALLEL_MIN
+
+/* NCSH_Z_THREADS: the most threads z scores directories on, including the shell's, fewer if there are fewer CPUs.
+ */
+#ifndef NCSH_Z_THREADS
+#    define NCSH_Z_THREADS 4
+#endif // !NCSH_Z_THREADS
+
 
 
 /********* Autocompletion Settings *********/
@@ -96,6 +179,28 @@
 // #define NCSH_AC_CHARACTER_WEIGHTING
 #endif /* !NCSH_AC_CHARACTER_WEIGHTING */
 
+/* NCSH_AC_HALF_LIFE_HOURS Macro constant
+ * Autocompletions are ranked by how many times they were used, halved every NCSH_AC_HALF_LIFE_HOURS hours since they
+ * were last used, so commands used a lot a long time ago don't outrank the ones used now.
+ * Can be set in .ncshrc with AC_HALF_LIFE_HOURS=
+ */
+#ifndef NCSH_AC_HALF_LIFE_HOURS
+#define    NCSH_AC_HALF_LIFE_HOURS 168
+#endif // !NCSH_AC_HALF_LIFE_HOURS
+
+/* NCSH_AC_AGE_EVERY Macro constant
+ * Every NCSH_AC_AGE_EVERY commands, the use counts of every autocompletion are halved, and autocompletions scoring
+ * below NCSH_AC_PRUNE_BELOW are removed. Keeps the counts from overflowing and the autocompletions trie compact.
+ * Can be set in .ncshrc with AC_AGE_EVERY= and AC_PRUNE_BELOW=
+ */
+#ifndef NCSH_AC_AGE_EVERY
+#define    NCSH_AC_AGE_EVERY 1000
+#endif // !NCSH_AC_AGE_EVERY
+
+#ifndef NCSH_AC_PRUNE_BELOW
+#define    NCSH_AC_PRUNE_BELOW 0.25
+#endif // !NCSH_AC_PRUNE_BELOW
+
 /* NCSH_MAX_AUTOCOMPLETION_MATCHES Macro constant
  * Max number of matches a single autocompletion request can return. Used in get all autocompletions use case.
  */
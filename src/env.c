@@ -9,10 +9,9 @@
 #include "debug.h"
 #include "arena.h"
 #include "env.h"
+#include "eskilib/emap.h"
 #include "eskilib/str.h"
 
-Str* env_add_or_get(Env* env, Str key);
-
 static void env_flat_to_hmap(Env* env, char** envp, Arena* restrict arena)
 {
     assert(env);
@@ -36,41 +35,29 @@ void env_new(Shell* restrict shell, char** envp, Arena* restrict arena)
     assert(arena);
 
     shell->env = arena_malloc(arena, 1, Env);
+    emap_new(shell->env, 0, Str, arena);
     env_flat_to_hmap(shell->env, envp, arena);
 }
 
-#define ENV_FNV_OFFSET 2166136261
-
-[[nodiscard]]
-static uint64_t env_hash(Str str, uint64_t seed)
+Str* env_get(Env* env, Str key)
 {
-    register uint64_t i = seed;
-
-    for (i = ENV_FNV_OFFSET; i < str.length; i++) {
-        i += (i << 1) + (i << 4) + (i << 7) + (i << 8) + (i << 24);
-        i ^= (uint64_t)str.value[i];
-    }
+    assert(env);
 
-    return i;
+    return emap_get(env, key);
 }
 
 Str* env_add_or_get(Env* env, Str key)
 {
     assert(env);
 
-    uint64_t hash = env_hash(key, (uintptr_t)env);
-    constexpr uint32_t mask = env_size - 1;
-    uint32_t step = (hash >> (64 - env_exp)) | 1;
-    for (uint32_t i = hash;;) {
-        i = (i + step) & mask;
-        if (!env->keys[i].value) {
-            env->keys[i] = key;
-            return env->vals + i;
-        }
-        else if (estrcmp(env->keys[i], key)) {
-            return env->vals + i;
-        }
-    }
+    return emap_add_or_get(env, key);
+}
+
+bool env_remove(Env* env, Str key)
+{
+    assert(env);
+
+    return emap_remove(env, key);
 }
 
 Str* env_home_get(Env* env)
@@ -78,8 +65,8 @@ Str* env_home_get(Env* env)
     assert(env);
 
     Str xdg_config_home_key = Str_Lit(NCSH_XDG_CONFIG_HOME_VAL);
-    Str* home = env_add_or_get(env, xdg_config_home_key);
-    debugf("%s? %s\n", NCSH_XDG_CONFIG_HOME_VAL, home->value);
+    Str* home = env_get(env, xdg_config_home_key);
+    debugf("%s? %s\n", NCSH_XDG_CONFIG_HOME_VAL, home ? home->value : NULL);
 
     if (!home || !home->value) {
         Str home_key = Str_Lit(NCSH_HOME_VAL);
@@ -19,6 +19,20 @@
 
 void env_new(Shell* restrict shell, char** envp, Arena* restrict arena);
 
+/* env_get
+ * Returns: the value of key, or NULL if key is not set.
+ */
+Str* env_get(Env* env, Str key);
+
+/* env_add_or_get
+ * Returns: the value of key, adding key with an empty value if key is not set.
+ * key is not copied, it needs to live as long as the shell's arena.
+ */
 Str* env_add_or_get(Env* env, Str key);
 
+/* env_remove
+ * Returns: true if key was set and has been removed.
+ */
+bool env_remove(Env* env, Str key);
+
 Str* env_home_get(Env* env);
@@ -0,0 +1,162 @@
+/* Copyright eskilib (C) by Alex Eski 2025 */
+/* emap.c: open addressing hash map with Str keys, grows in its arena based on load factor */
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "emap.h"
+
+/* Removed keys are replaced with a tombstone so probe sequences passing through them aren't cut short */
+static char emap_tombstone__;
+#define EMAP_TOMBSTONE (&emap_tombstone__)
+
+#define EMAP_FNV_OFFSET 14695981039346656037UL
+#define EMAP_FNV_PRIME 1099511628211UL
+
+// 64-bit FNV-1a hash
+[[nodiscard]]
+static uint64_t emap_hash(Str key)
+{
+    uint64_t hash = EMAP_FNV_OFFSET;
+    for (size_t i = 0; i < key.length; ++i) {
+        hash ^= (unsigned char)key.value[i];
+        hash *= EMAP_FNV_PRIME;
+    }
+    return hash;
+}
+
+void emap_new__(Emap* restrict map, size_t capacity, size_t val_size, size_t val_align, Arena* restrict arena)
+{
+    assert(map); assert(val_size); assert(val_align); assert(arena);
+
+    size_t cap = EMAP_DEFAULT_CAPACITY;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+
+    *map = (Emap){
+        .capacity = cap,
+        .val_size = val_size,
+        .val_align = val_align,
+        .keys = arena_malloc(arena, cap, Str),
+        .vals = arena_malloc__(arena, cap, val_size, val_align),
+        .arena = arena
+    };
+}
+
+/* emap_find
+ * Returns: the slot of key if found is set to true,
+ * otherwise the slot key should be added at (the first tombstone or empty slot in its probe sequence).
+ */
+[[nodiscard]]
+static size_t emap_find(Emap* restrict map, Str key, bool* restrict found)
+{
+    size_t mask = map->capacity - 1;
+    size_t tombstone = SIZE_MAX;
+    for (size_t i = (size_t)emap_hash(key) & mask;; i = (i + 1) & mask) {
+        Str* k = map->keys + i;
+        if (!k->value) {
+            *found = false;
+            return tombstone != SIZE_MAX ? tombstone : i;
+        }
+        if (k->value == EMAP_TOMBSTONE) {
+            if (tombstone == SIZE_MAX) {
+                tombstone = i;
+            }
+            continue;
+        }
+        if (estrcmp(*k, key)) {
+            *found = true;
+            return i;
+        }
+    }
+}
+
+/* emap_grow
+ * Rehash into a new table, doubling the capacity unless most of the used slots were tombstones.
+ */
+static void emap_grow(Emap* restrict map)
+{
+    size_t new_cap = (map->count + 1) * 2 > map->capacity ? map->capacity * 2 : map->capacity;
+    Emap new_map = *map;
+    new_map.capacity = new_cap;
+    new_map.count = 0;
+    new_map.used = 0;
+    new_map.keys = arena_malloc(map->arena, new_cap, Str);
+    new_map.vals = arena_malloc__(map->arena, new_cap, map->val_size, map->val_align);
+
+    for (size_t i = 0; i < map->capacity; ++i) {
+        if (!map->keys[i].value || map->keys[i].value == EMAP_TOMBSTONE) {
+            continue;
+        }
+        bool found;
+        size_t slot = emap_find(&new_map, map->keys[i], &found);
+        new_map.keys[slot] = map->keys[i];
+        memcpy(new_map.vals + slot * map->val_size, map->vals + i * map->val_size, map->val_size);
+        ++new_map.count;
+        ++new_map.used;
+    }
+
+    *map = new_map;
+}
+
+[[nodiscard]]
+void* emap_get(Emap* restrict map, Str key)
+{
+    assert(map); assert(map->keys);
+    if (!key.value || !key.length) {
+        return NULL;
+    }
+
+    bool found;
+    size_t slot = emap_find(map, key, &found);
+    return found ? map->vals + slot * map->val_size : NULL;
+}
+
+[[nodiscard]]
+void* emap_add_or_get(Emap* restrict map, Str key)
+{
+    assert(map); assert(map->keys); assert(key.value); assert(key.length);
+    if (!key.value || !key.length) {
+        return NULL;
+    }
+
+    bool found;
+    size_t slot = emap_find(map, key, &found);
+    if (found) {
+        return map->vals + slot * map->val_size;
+    }
+
+    // keep load factor (including tombstones) under 3/4 so probe sequences stay short and always end
+    if ((map->used + 1) * 4 > map->capacity * 3) {
+        emap_grow(map);
+        slot = emap_find(map, key, &found);
+    }
+
+    if (!map->keys[slot].value) {
+        ++map->used;
+    }
+    ++map->count;
+    map->keys[slot] = key;
+    return memset(map->vals + slot * map->val_size, 0, map->val_size);
+}
+
+bool emap_remove(Emap* restrict map, Str key)
+{
+    assert(map); assert(map->keys);
+    if (!key.value || !key.length) {
+        return false;
+    }
+
+    bool found;
+    size_t slot = emap_find(map, key, &found);
+    if (!found) {
+        return false;
+    }
+
+    map->keys[slot] = (Str){.value = EMAP_TOMBSTONE, .length = 0};
+    memset(map->vals + slot * map->val_size, 0, map->val_size);
+    --map->count;
+    return true;
+}
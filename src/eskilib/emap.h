@@ -0,0 +1,51 @@
+/* Copyright eskilib (C) by Alex Eski 2025 */
+/* emap.h: open addressing hash map with Str keys, grows in its arena based on load factor */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../arena.h"
+#include "str.h"
+
+#define EMAP_DEFAULT_CAPACITY 64
+
+/* Emap
+ * Keys are not copied, they need to live as long as the map (allocate them in the same arena).
+ * Values are stored inline, val_size bytes each, and are zeroed when a key is added.
+ * Pointers to values are invalidated when the map grows, don't hold on to them across emap_add_or_get calls.
+ */
+typedef struct {
+    size_t count; // keys in the map
+    size_t used; // keys in the map + removed keys (tombstones), used for the load factor
+    size_t capacity; // always a power of 2
+    size_t val_size;
+    size_t val_align;
+    Str* keys;
+    char* vals;
+    Arena* arena;
+} Emap;
+
+/* emap_new
+ * Allocate the map with capacity slots (rounded up to a power of 2), the map grows into arena when needed.
+ * Convenience wrapper for emap_new__
+ */
+#define emap_new(map, capacity, type, arena) emap_new__(map, capacity, sizeof(type), _Alignof(type), arena)
+
+void emap_new__(Emap* restrict map, size_t capacity, size_t val_size, size_t val_align, Arena* restrict arena);
+
+/* emap_get
+ * Returns: a pointer to the value of key, or NULL if key is not in the map.
+ */
+void* emap_get(Emap* restrict map, Str key);
+
+/* emap_add_or_get
+ * Returns: a pointer to the value of key, adding key with a zeroed value if it is not in the map.
+ */
+void* emap_add_or_get(Emap* restrict map, Str key);
+
+/* emap_remove
+ * Returns: true if key was in the map and was removed.
+ */
+bool emap_remove(Emap* restrict map, Str key);
@@ -30,11 +30,14 @@
 #include "../arena.h"
 #include "../defines.h"
 #include "../env.h"
+#include "../path_cache.h"
 #include "../ttyio/ttyio.h"
 #include "../types.h"
+#include "../vars.h"
 #include "../z/z.h"
 #include "../io/prompt.h"
 #include "../io/bestline.h"
+#include "../io/history.h"
 
 /* External values */
 extern jmp_buf env_jmp_buf;      // from main.c, used on unrecoverable failures
@@ -82,7 +85,7 @@ static int builtins_z(z_Database* restrict z_db, Str* restrict strs, Arena* aren
 #define NCSH_HISTORY_ADD "add"
 #define NCSH_HISTORY_RM "rm" // alias for rm
 #define NCSH_HISTORY_REMOVE "remove"
-static int builtins_history(Str* restrict strs);
+static int builtins_history(Str* restrict strs, History_Log* restrict history_log);
 
 #define NCSH_ALIAS "alias"
 #define NCSH_ALIAS_PRINT "-p"
@@ -145,11 +148,18 @@ static int builtins_prompt(Str* restrict strs);
 // #define NCSH_EXPORT "export"
 // int builtins_export(Statements* restrict toks, size_t* restrict buf_lens);
 
-// #define NCSH_SET "set"
-// static int builtins_set(Str* restrict strs, Env* restrict env);
+#define NCSH_SET "set"
+#define NCSH_SET_ENABLE "-o"
+#define NCSH_SET_DISABLE "+o"
+#define NCSH_SET_PIPEFAIL "pipefail"
+static int builtins_set(Str* restrict strs, Options* restrict opts);
 
 #define NCSH_UNSET "unset"
-static int builtins_unset(Str* restrict strs, Env* restrict env);
+static int builtins_unset(Str* restrict strs, Shell* restrict shell);
+
+#define NCSH_HASH "hash"
+#define NCSH_HASH_CLEAR "-r"
+static int builtins_hash(Str* restrict strs, Path_Cache* restrict path_cache);
 
 /* Types */
 // clang-format off
@@ -170,9 +180,10 @@ enum Builtins_Disabled : long unsigned int {
     BF_DISABLE =     1 << 12,
     BF_Z =           1 << 13,
     BF_HISTORY =     1 << 14,
+    BF_SET =         1 << 15,
     BF_UNSET =       1 << 16,
     BF_PROMPT =      1 << 17,
-    // BF_SET =         1 << 13,
+    BF_HASH =        1 << 18,
     // BF_EXPORT =      1 << 9,
 };
 // clang-format on
@@ -275,9 +286,9 @@ static int builtins_z(z_Database* restrict z_db, Str* restrict strs, Arena* rest
 
 [[nodiscard]]
 [[maybe_unused]]
-static int builtins_history(Str* restrict strs)
+static int builtins_history(Str* restrict strs, History_Log* restrict history_log)
 {
-    assert(strs);
+    assert(strs); assert(history_log);
 
     if (!strs[1].value) {
         return bestlineHistoryPrint(vm_output_fd);
@@ -309,7 +320,11 @@ static int builtins_history(Str* restrict strs)
     if (args && args[1].value && !args[2].value) {
         // history add
         if (estrcmp(*args, Str_Lit(NCSH_HISTORY_ADD))) {
-            return bestlineHistoryAdd(args[1].value) == EXIT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE_CONTINUE;
+            if (!bestlineHistoryAdd(args[1].value)) {
+                return EXIT_FAILURE_CONTINUE;
+            }
+            history_log_add(history_log, args[1]);
+            return EXIT_SUCCESS;
         }
         // history rm/remove
         else if (estrcmp(*args, Str_Lit(NCSH_HISTORY_RM)) ||
@@ -534,6 +549,13 @@ static int builtins_echo(Str* restrict strs)
     "dededuplicate. Can also call using 'history remove {command}."
 #define HELP_PWD "pwd:         	          Prints the current working directory."
 #define HELP_KILL "kill {processId}:         Terminates the process with associated processId."
+#define HELP_SET                                                                                                       \
+    "set -o/+o {option}:       Enable (-o) or disable (+o) a shell option. Supports pipefail, where a pipeline "       \
+    "fails if any of its commands fail."
+
+#define HELP_HASH                                                                                                      \
+    "hash {command}:           Remember the full path of commands found in PATH, 'hash' prints them and 'hash -r' "  \
+    "forgets them."
 
 #define HELP_WRITE(str)                                                                                                \
     constexpr size_t str##_len = sizeof(str) - 1;                                                                      \
@@ -580,6 +602,8 @@ static int builtins_help([[maybe_unused]] Str* restrict strs)
     HELP_WRITELN(HELP_HISTORY_RM);
     HELP_WRITELN(HELP_PWD);
     HELP_WRITELN(HELP_KILL);
+    HELP_WRITELN(HELP_SET);
+    HELP_WRITELN(HELP_HASH);
 
     // controls
     // HELP_WRITE(HELP_BASIC_CONTROLS);
@@ -967,11 +991,44 @@ static int builtins_prompt(Str* restrict strs)
 //     return EXIT_SUCCESS;
 // }
 
+#define SET_USAGE "ncsh set: usage is set -o {option} to enable or set +o {option} to disable. Options: pipefail."
+
+[[nodiscard]]
+static int builtins_set(Str* restrict strs, Options* restrict opts)
+{
+    assert(strs); assert(strs->value); assert(opts);
+
+    // skip first position since we know it is 'set'
+    Str* args = strs + 1;
+    if (!args || !args->value) {
+        tty_dprintln(vm_output_fd, "%s %s", opts->pipefail ? NCSH_SET_ENABLE : NCSH_SET_DISABLE, NCSH_SET_PIPEFAIL);
+        return EXIT_SUCCESS;
+    }
+
+    bool enable = estrcmp(*args, Str_Lit(NCSH_SET_ENABLE));
+    if ((!enable && !estrcmp(*args, Str_Lit(NCSH_SET_DISABLE))) || !args[1].value) {
+        if (builtins_writeln(vm_output_fd, SET_USAGE, sizeof(SET_USAGE) - 1) == -1) {
+            return EXIT_FAILURE;
+        }
+        return EXIT_FAILURE_CONTINUE;
+    }
+
+    if (estrcmp(args[1], Str_Lit(NCSH_SET_PIPEFAIL))) {
+        opts->pipefail = enable;
+        return EXIT_SUCCESS;
+    }
+
+    if (builtins_writeln(vm_output_fd, SET_USAGE, sizeof(SET_USAGE) - 1) == -1) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_FAILURE_CONTINUE;
+}
+
 #define UNSET_NOTHING_TO_UNSET "ncsh unset: nothing to unset, please pass in a value to unset."
 [[nodiscard]]
-static int builtins_unset(Str* restrict strs, Env* restrict env)
+static int builtins_unset(Str* restrict strs, Shell* restrict shell)
 {
-    assert(strs); assert(strs->value); assert(env);
+    assert(strs); assert(strs->value); assert(shell);
 
     // skip first position since we know it is 'unset'
     Str* args = strs + 1;
@@ -985,25 +1042,63 @@ static int builtins_unset(Str* restrict strs, Env* restrict env)
         return EXIT_SUCCESS;
     }
 
-    Str* val = env_add_or_get(env, *args);
-    if (!val || !val->value) {
-        return EXIT_SUCCESS;
+    if (shell->path_cache && estrcmp(*args, Str_Lit(NCSH_PATH_VAL))) {
+        path_cache_clear(shell->path_cache);
     }
 
-    val->value = NULL;
-    val->length = 0;
+    if (shell->vars) {
+        vars_remove(shell->vars, *args);
+    }
+    if (shell->env) {
+        env_remove(shell->env, *args);
+    }
     return EXIT_SUCCESS;
 }
 
-/* builtins_check_and_run
- * Checks current command against builtins, and if matches runs the builtin.
+#define HASH_NOT_FOUND "ncsh hash: %s: not found"
+[[nodiscard]]
+static int builtins_hash(Str* restrict strs, Path_Cache* restrict path_cache)
+{
+    assert(strs); assert(strs->value);
+
+    if (!path_cache) {
+        return EXIT_FAILURE_CONTINUE;
+    }
+
+    // skip first position since we know it is 'hash'
+    Str* args = strs + 1;
+    if (!args || !args->value) {
+        path_cache_print(path_cache, vm_output_fd);
+        return EXIT_SUCCESS;
+    }
+
+    if (estrcmp(*args, Str_Lit(NCSH_HASH_CLEAR))) {
+        path_cache_clear(path_cache);
+        return EXIT_SUCCESS;
+    }
+
+    int rv = EXIT_SUCCESS;
+    for (; args->value; ++args) {
+        if (!path_cache_get(path_cache, *args).value) {
+            tty_dprintln(vm_output_fd, HASH_NOT_FOUND, args->value);
+            rv = EXIT_FAILURE_CONTINUE;
+        }
+    }
+    return rv;
+}
+
+/* builtins_dispatch
+ * Checks current command against builtins, and if matches runs the builtin when run is set.
+ * Returns: true if the current command is a builtin which isn't disabled.
  */
 [[nodiscard]]
-bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena* restrict scratch)
+static bool builtins_dispatch(Vm_Data* restrict vm, Shell* restrict shell, Arena* restrict scratch, bool run)
 {
     if (shell) {
         if (estrcmp(vm->cmds->strs[0], Str_Lit(Z))) {
-            vm->status = builtins_z(&shell->z_db, vm->cmds->strs, &shell->arena, scratch);
+            if (run) {
+                vm->status = builtins_z(&shell->z_db, vm->cmds->strs, &shell->arena, scratch);
+            }
             return true;
         }
 
@@ -1011,7 +1106,9 @@ bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena*
             if (builtins_disabled_state & BF_HISTORY) {
                 return false;
             }
-            vm->status = builtins_history(vm->cmds->strs);
+            if (run) {
+                vm->status = builtins_history(vm->cmds->strs, &shell->input.history_log);
+            }
             return true;
         }
 
@@ -1019,7 +1116,9 @@ bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena*
             if (builtins_disabled_state & BF_ALIAS) {
                 return false;
             }
-            vm->status = builtins_alias(vm->cmds->strs, &shell->arena);
+            if (run) {
+                vm->status = builtins_alias(vm->cmds->strs, &shell->arena);
+            }
             return true;
         }
 
@@ -1027,7 +1126,29 @@ bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena*
             if (builtins_disabled_state & BF_UNSET) {
                 return false;
             }
-            vm->status = builtins_unset(vm->cmds->strs, shell->env);
+            if (run) {
+                vm->status = builtins_unset(vm->cmds->strs, shell);
+            }
+            return true;
+        }
+
+        if (estrcmp(vm->cmds->strs[0], Str_Lit(NCSH_HASH))) {
+            if (builtins_disabled_state & BF_HASH) {
+                return false;
+            }
+            if (run) {
+                vm->status = builtins_hash(vm->cmds->strs, shell->path_cache);
+            }
+            return true;
+        }
+
+        if (estrcmp(vm->cmds->strs[0], Str_Lit(NCSH_SET))) {
+            if (builtins_disabled_state & BF_SET) {
+                return false;
+            }
+            if (run) {
+                vm->status = builtins_set(vm->cmds->strs, &shell->opts);
+            }
             return true;
         }
     }
@@ -1037,10 +1158,31 @@ bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena*
             if (builtins_disabled_state & builtins[i].flag) {
                 return false;
             }
-            vm->status = (*builtins[i].func)(vm->cmds->strs);
+            if (run) {
+                vm->status = (*builtins[i].func)(vm->cmds->strs);
+            }
             return true;
         }
     }
 
     return false;
 }
+
+/* builtins_check_and_run
+ * Checks current command against builtins, and if matches runs the builtin.
+ */
+[[nodiscard]]
+bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena* restrict scratch)
+{
+    return builtins_dispatch(vm, shell, scratch, true);
+}
+
+/* builtins_check
+ * Checks current command against builtins without running it.
+ * Returns: true if the current command is a builtin which isn't disabled.
+ */
+[[nodiscard]]
+bool builtins_check(Vm_Data* restrict vm, Shell* restrict shell)
+{
+    return builtins_dispatch(vm, shell, NULL, false);
+}
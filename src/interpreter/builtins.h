@@ -8,3 +8,5 @@
 #include "vm_types.h"
 
 bool builtins_check_and_run(Vm_Data* restrict vm, Shell* restrict shell, Arena* restrict scratch_arena);
+
+bool builtins_check(Vm_Data* restrict vm, Shell* restrict shell);
@@ -0,0 +1,230 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* compile.c: lowers parser output into a flat program of instructions with resolved jumps for the VM. */
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "../debug.h"
+#include "compile.h"
+
+#define PROGRAM_DEFAULT_CAP 16
+
+/* Placeholder for forward jumps whose target isn't known until the rest of the block is emitted */
+#define TARGET_UNRESOLVED SIZE_MAX
+
+typedef struct {
+    Program* restrict prog;
+    Arena* restrict s;
+} Compile_Data;
+
+static size_t compile_emit(Compile_Data* restrict data, enum Ops op, enum Vm_State state, Commands* cmds, size_t target)
+{
+    Program* prog = data->prog;
+    if (prog->count == prog->cap) {
+        size_t new_cap = prog->cap * 2;
+        prog->insts = arena_realloc(data->s, new_cap, Instruction, prog->insts, prog->cap);
+        prog->cap = new_cap;
+    }
+
+    prog->insts[prog->count] = (Instruction){.op = op, .state = state, .target = target, .cmds = cmds};
+    return prog->count++;
+}
+
+static inline void compile_patch(Compile_Data* restrict data, size_t jump)
+{
+    if (jump != TARGET_UNRESOLVED) {
+        data->prog->insts[jump].target = data->prog->count;
+    }
+}
+
+/* compile_list
+ * Emit commands joined by '|', '&&', and '||'.
+ * Each pipeline after an '&&' or '||' is guarded by a conditional jump which skips it,
+ * the guards jump to the next guard and are chained together by compile_jumps_resolve.
+ */
+static void compile_list(Compile_Data* restrict data, Commands* restrict cmds, enum Vm_State state)
+{
+    size_t guard = TARGET_UNRESOLVED;
+    for (Commands* c = cmds; c && c->strs[0].value; c = c->next) {
+        if (c != cmds && (c->prev_op == OP_AND || c->prev_op == OP_OR)) {
+            compile_patch(data, guard);
+            guard = compile_emit(data, c->prev_op == OP_AND ? OP_JUMP_IF_FALSE : OP_JUMP_IF_TRUE, state, c,
+                                 TARGET_UNRESOLVED);
+        }
+
+        compile_emit(data, OP_CONST, state, c, 0);
+
+        // assignments like count=$(count + 1) evaluate the math expression in the next commands themselves
+        if (c->op == OP_ASSIGNMENT && c->next && c->next->ops[0] == OP_MATH_EXPR_START) {
+            c = c->next;
+        }
+    }
+    compile_patch(data, guard);
+}
+
+// if [ c1 ]; then s1; elif [ c2 ]; then s2; else s3; fi
+static void compile_if(Compile_Data* restrict data, Statement* restrict stmt)
+{
+    size_t start = data->prog->count;
+    enum Vm_State state = VS_IN_IF_STATEMENTS;
+    while (stmt) {
+        Statement* body = stmt->right;
+        compile_list(data, stmt->commands, VS_IN_CONDITIONS);
+        size_t cond_jump = compile_emit(data, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, body ? body->commands : NULL,
+                                        TARGET_UNRESOLVED);
+        if (body) {
+            compile_list(data, body->commands, state);
+        }
+
+        stmt = stmt->left;
+        if (stmt) {
+            compile_emit(data, OP_JUMP, state, NULL, TARGET_UNRESOLVED);
+        }
+        compile_patch(data, cond_jump);
+
+        if (stmt && stmt->type == LT_ELSE) {
+            compile_list(data, stmt->commands, VS_IN_ELSE_STATEMENTS);
+            break;
+        }
+        state = VS_IN_ELIF_STATEMENTS;
+    }
+
+    // the jumps at the end of the if and elif statements go past fi
+    for (size_t i = start; i < data->prog->count; ++i) {
+        if (data->prog->insts[i].op == OP_JUMP && data->prog->insts[i].target == TARGET_UNRESOLVED) {
+            compile_patch(data, i);
+        }
+    }
+}
+
+// while [ c ]; do s1; s2; done
+static void compile_while(Compile_Data* restrict data, Statement* restrict cond)
+{
+    size_t start = data->prog->count;
+    Statement* stmt = cond->right;
+    compile_list(data, cond->commands, VS_IN_CONDITIONS);
+    size_t cond_jump = compile_emit(data, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, stmt ? stmt->commands : NULL,
+                                    TARGET_UNRESOLVED);
+
+    for (; stmt && stmt->type == LT_WHILE; stmt = stmt->right) {
+        compile_list(data, stmt->commands, VS_IN_LOOP_STATEMENTS);
+    }
+
+    compile_emit(data, OP_JUMP, VS_IN_LOOP_STATEMENTS, NULL, start);
+    compile_patch(data, cond_jump);
+}
+
+// for ((i = 1; i <= 5; i++)); do echo $i done
+static void compile_for(Compile_Data* restrict data, Statement* restrict init)
+{
+    compile_list(data, init->commands, VS_IN_LOOP_INIT);
+    Statement* cond = init->right;
+    if (!cond || cond->type != LT_FOR_CONDITIONS) {
+        return;
+    }
+
+    size_t start = data->prog->count;
+    Statement* stmt = cond->right;
+    compile_list(data, cond->commands, VS_IN_CONDITIONS);
+    size_t cond_jump = compile_emit(data, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, stmt ? stmt->commands : NULL,
+                                    TARGET_UNRESOLVED);
+
+    for (; stmt && stmt->type == LT_FOR; stmt = stmt->right) {
+        compile_list(data, stmt->commands, VS_IN_LOOP_STATEMENTS);
+    }
+    if (stmt && stmt->type == LT_FOR_INCREMENT) {
+        compile_list(data, stmt->commands, VS_IN_LOOP_INCREMENT);
+    }
+
+    compile_emit(data, OP_JUMP, VS_IN_LOOP_INCREMENT, NULL, start);
+    compile_patch(data, cond_jump);
+}
+
+// for fruit in apple banana orange; do echo $fruit done
+static void compile_for_each(Compile_Data* restrict data, Statement* restrict init)
+{
+    size_t start = compile_emit(data, OP_FOR, VS_IN_LOOP_EACH_INIT, init->commands, TARGET_UNRESOLVED);
+
+    for (Statement* stmt = init->right; stmt && stmt->type == LT_FOR; stmt = stmt->right) {
+        compile_list(data, stmt->commands, VS_IN_LOOP_STATEMENTS);
+    }
+
+    compile_emit(data, OP_JUMP, VS_IN_LOOP_STATEMENTS, NULL, start);
+    compile_patch(data, start);
+}
+
+/* compile_jump_resolve
+ * Follow the jumps starting at target whose outcome is already known once a jump of type op was taken:
+ * unconditional jumps, jumps on the same condition (taken), and jumps on the opposite condition (not taken).
+ * Returns: the first instruction after target which does work or depends on a new status.
+ */
+[[nodiscard]]
+static size_t compile_jump_resolve(Program* restrict prog, enum Ops op, size_t target)
+{
+    for (size_t hops = 0; target < prog->count && hops < prog->count; ++hops) {
+        Instruction* inst = prog->insts + target;
+        if (inst->op == OP_JUMP || (op != OP_JUMP && inst->op == op)) {
+            target = inst->target;
+        }
+        else if (op != OP_JUMP && (inst->op == OP_JUMP_IF_FALSE || inst->op == OP_JUMP_IF_TRUE)) {
+            ++target;
+        }
+        else {
+            break;
+        }
+    }
+
+    return target;
+}
+
+static void compile_jumps_resolve(Program* restrict prog)
+{
+    for (size_t i = 0; i < prog->count; ++i) {
+        Instruction* inst = prog->insts + i;
+        if (inst->op == OP_JUMP || inst->op == OP_JUMP_IF_FALSE || inst->op == OP_JUMP_IF_TRUE) {
+            inst->target = compile_jump_resolve(prog, inst->op, inst->target);
+        }
+    }
+}
+
+[[nodiscard]]
+Program* compile(Statements* restrict stmts, Arena* restrict scratch)
+{
+    assert(stmts); assert(scratch);
+
+    Compile_Data data = {
+        .prog = arena_malloc(scratch, 1, Program),
+        .s = scratch
+    };
+    data.prog->cap = PROGRAM_DEFAULT_CAP;
+    data.prog->insts = arena_malloc(scratch, PROGRAM_DEFAULT_CAP, Instruction);
+
+    Statement* stmt = stmts->head;
+    for (; stmt && stmt->type == LT_NORMAL; stmt = stmt->right) {
+        compile_list(&data, stmt->commands, VS_NORMAL);
+    }
+
+    // control flow structures are always the last statement, loops link back to their start
+    if (stmt) {
+        switch (stmt->type) {
+        case LT_IF_CONDITIONS:
+            compile_if(&data, stmt);
+            break;
+        case LT_WHILE_CONDITIONS:
+            compile_while(&data, stmt);
+            break;
+        case LT_FOR_INIT:
+            compile_for(&data, stmt);
+            break;
+        case LT_FOR_EACH_INIT:
+            compile_for_each(&data, stmt);
+            break;
+        default:
+            debugf("compile: unexpected statement type %d\n", stmt->type);
+            break;
+        }
+    }
+
+    compile_jumps_resolve(data.prog);
+    return data.prog;
+}
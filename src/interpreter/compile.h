@@ -0,0 +1,17 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* compile.h: lowers parser output into a flat program of instructions with resolved jumps for the VM. */
+
+#pragma once
+
+#include "../arena.h"
+#include "parse.h"
+#include "vm_types.h"
+
+/* compile
+ * Walks the statements produced by parse once and emits the instructions the VM dispatches.
+ * Control flow (if/elif/else, while, for, '&&' and '||') is lowered into jumps with their targets resolved here,
+ * so the VM never searches the statements for where to go next.
+ * Returns: the compiled program, allocated in scratch.
+ */
+[[nodiscard]]
+Program* compile(Statements* restrict stmts, Arena* restrict scratch);
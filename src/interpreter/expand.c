@@ -9,6 +9,7 @@
 #include "../alias.h"
 #include "../debug.h"
 #include "../env.h"
+#include "../path_cache.h"
 #include "../vars.h"
 #include "../types.h"
 #include "parse.h"
@@ -79,6 +80,10 @@ void expand_assignment(Commands* restrict cmds, Shell* restrict shell)
 {
     assert(cmds); assert(shell && shell->env); assert(cmds->op == OP_ASSIGNMENT);
 
+    if (shell->path_cache && estrcmp(cmds->strs[0], Str_Lit(NCSH_PATH_VAL))) {
+        path_cache_clear(shell->path_cache);
+    }
+
     if (cmds->ops[2] == OP_NUM) {
         Num n = estrtonum(cmds->strs[2]);
         *vars_add_or_get(shell->vars, *estrdup(&cmds->strs[0], &shell->arena)) = Var_n(n);
@@ -103,7 +108,7 @@ Str* expand_variable(Commands* cmds, size_t i, Vars* restrict vars, Arena* restr
     else
         key = (Str){.value = in->value, .length = in->length};
 
-    Var* val = vars_add_or_get(vars, key);
+    Var* val = vars_get(vars, key);
     if (!val || val->type == V_EMPTY) {
         return NULL;
     }
@@ -174,10 +179,8 @@ static void expand_alias(Str* restrict s, Arena* restrict scratch)
 
     char* space = strchr(alias.value, ' ');
     if (!space) {
-        if (alias.length > s->length) {
-            s->value = arena_realloc(scratch, alias.length, char, s->value, s->length);
-        }
-
+        // commands can borrow their strings from the parse cache, so the alias goes in a new string
+        s->value = arena_malloc(scratch, alias.length, char);
         memcpy(s->value, alias.value, alias.length);
         s->length = alias.length;
         return;
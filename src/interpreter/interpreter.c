@@ -7,14 +7,22 @@
 #include "interpreter.h"
 #include "lex.h"
 #include "parse.h"
+#include "parse_cache.h"
+#include "script.h"
 #include "vm.h"
 #include "../ttyio/ttyio.h"
 
 [[nodiscard]]
 int interpreter_run(Shell* restrict shell, Arena scratch)
 {
+    Str line = Str(shell->input.buffer, shell->input.pos);
+    Statements* stmts = shell->parse_cache ? parse_cache_get(shell->parse_cache, line, &scratch) : NULL;
+    if (stmts) {
+        return vm_execute(stmts, shell, &scratch);
+    }
+
     Lexemes lexemes = {0};
-    lex(Str(shell->input.buffer, shell->input.pos), &lexemes, &scratch);
+    lex(line, &lexemes, &scratch);
 
     Parser_Output parse_rv = parse(&lexemes, &scratch);
     if (parse_rv.parser_errno) {
@@ -24,6 +32,10 @@ int interpreter_run(Shell* restrict shell, Arena scratch)
         return EXIT_FAILURE_CONTINUE;
     }
 
+    if (shell->parse_cache) {
+        parse_cache_add(shell->parse_cache, line, parse_rv.output.stmts, scratch);
+    }
+
     return vm_execute(parse_rv.output.stmts, shell, &scratch);
 }
 
@@ -41,3 +53,34 @@ int interpreter_run_noninteractive(char** restrict argv, size_t argc, Shell* res
 
     return vm_execute_noninteractive(parse_rv.output.stmts, shell);
 }
+
+[[nodiscard]]
+int interpreter_run_script(Shell* restrict shell, int fd)
+{
+    Script script;
+    if (script_open(&script, fd, &shell->arena) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    char* buffer = arena_malloc(&shell->arena, NCSH_MAX_INPUT, char);
+    int rv = EXIT_SUCCESS;
+    int status;
+    Str command;
+    while ((status = script_command_next(&script, buffer, &command)) == EXIT_SUCCESS) {
+        shell->input.buffer = command.value;
+        shell->input.pos = command.length;
+
+        rv = interpreter_run(shell, shell->scratch);
+        if (rv == EXIT_FAILURE || rv == EXIT_SUCCESS_END) {
+            break;
+        }
+    }
+
+    script_close(&script);
+    shell->input.buffer = NULL;
+    shell->input.pos = 0;
+    if (status == EXIT_FAILURE) {
+        return EXIT_FAILURE;
+    }
+    return rv == EXIT_SUCCESS_END ? EXIT_SUCCESS : rv;
+}
@@ -18,3 +18,11 @@ int interpreter_run(Shell* restrict shell, Arena scratch);
  * Does not need the scratch arena, since noninteractive shell has a very straghtforward liftime.
  */
 int interpreter_run_noninteractive(char** restrict argv, size_t argc, Shell* restrict shell);
+
+/* interpreter_run_script
+ * Run the script in fd one complete command at a time, like 'ncsh script.sh' or 'ncsh < script.sh'.
+ * Each command is ran by interpreter_run with a fresh copy of shell->scratch, so scratch memory is reset
+ * after every top-level command and memory use doesn't grow with the length of the script.
+ * Returns: exit status of the last command, or EXIT_FAILURE if the script couldn't be read.
+ */
+int interpreter_run_script(Shell* restrict shell, int fd);
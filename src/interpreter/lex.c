@@ -2,212 +2,287 @@
 
 #include <assert.h>
 #include <glob.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "../debug.h"
 #include "../defines.h" // used for macros like NCSH_MAX_INPUT
 #include "lex.h"
 #include "symbols.h"
 
-/* Lexer Internal Variables */
-static char* restrict lex_buf;
-static size_t lex_state;
-static size_t lex_buf_pos;
-static enum Token cur_tok;
-
 [[nodiscard]]
 static inline enum Token get_const_type(Str s)
 {
     return estrisnum(s) ? T_NUM : T_CONST;
 }
 
-// clang-format off
-enum Lexer_State: size_t {
-    IN_NONE =                    0,
-    IN_COMMENT =                 1 << 0,
-};
-// clang-format on
-
-/* ops_2char_str
- * A constant array that contains all shell operations that are 2 characters long, like ">>", "||", "&&".
- * Size of the array is stored as constant expression in ops_2char_len
- * Bytecodes (opcodes) equivalents are stored in the array of enum Ops, ops_2char
+/* LEX_KEYWORD_HASH
+ * Perfect hash of every keyword lexeme, from its second character, last character, and length.
+ * Distinct for all keywords in lex_keywords, a keyword added which collides fails to build (-Woverride-init).
  */
-static constexpr char ops_2char_str[4][2] = {IF, FI, DO, IN};
+#define LEX_KEYWORD_HASH(second, last, len) (((unsigned)(second) + ((unsigned)(last) << 3) + (unsigned)(len) * 6) & 31)
 
-static constexpr size_t ops_2char_len = sizeof(ops_2char_str) / sizeof(ops_2char_str[0]);
+// second and last are passed in since characters of a string literal aren't constant expressions
+#define LEX_KEYWORD(str, second, last, tok) [LEX_KEYWORD_HASH(second, last, sizeof(str) - 1)] = {str, sizeof(str) - 1, tok}
 
-static constexpr enum Token ops_2char[] = {T_IF, T_FI, T_DO, T_IN};
+typedef struct {
+    char str[6];
+    uint8_t len;
+    enum Token tok;
+} Lex_Keyword;
 
-/* ops_3char_str
- * A constant array that contain all shell operations that are 3 characters long, like "&>>".
- * Size of the array is stored as constant expression in ops_3char_len
- * Bytecodes (opcodes) equivalents are stored in the array of enum Ops, ops_3char
+/* lex_keywords
+ * Keywords like "if", "done", and "-eq", indexed by LEX_KEYWORD_HASH.
  */
-static constexpr char ops_3char_str[6][3] = {EQUALS,
-                                             LESS_THAN,
-                                             LESS_THAN_OR_EQUALS,
-                                             GREATER_THAN,
-                                             GREATER_THAN_OR_EQUALS,
-                                             FOR};
-
-static constexpr size_t ops_3char_len = sizeof(ops_3char_str) / sizeof(ops_3char_str[0]);
-
-static constexpr enum Token ops_3char[] = {T_EQ_A,
-                                           T_LT_A,
-                                           T_LE_A,
-                                           T_GT_A,
-                                           T_GE_A,
-                                           T_FOR};
+static const Lex_Keyword lex_keywords[32] = {
+    LEX_KEYWORD(IF, 'f', 'f', T_IF),
+    LEX_KEYWORD(FI, 'i', 'i', T_FI),
+    LEX_KEYWORD(DO, 'o', 'o', T_DO),
+    LEX_KEYWORD(IN, 'n', 'n', T_IN),
+    LEX_KEYWORD(EQUALS, 'e', 'q', T_EQ_A),
+    LEX_KEYWORD(LESS_THAN, 'l', 't', T_LT_A),
+    LEX_KEYWORD(LESS_THAN_OR_EQUALS, 'l', 'e', T_LE_A),
+    LEX_KEYWORD(GREATER_THAN, 'g', 't', T_GT_A),
+    LEX_KEYWORD(GREATER_THAN_OR_EQUALS, 'g', 'e', T_GE_A),
+    LEX_KEYWORD(FOR, 'o', 'r', T_FOR),
+    LEX_KEYWORD(BOOL_TRUE, 'r', 'e', T_TRUE),
+    LEX_KEYWORD(THEN, 'h', 'n', T_THEN),
+    LEX_KEYWORD(ELSE, 'l', 'e', T_ELSE),
+    LEX_KEYWORD(ELIF, 'l', 'f', T_ELIF),
+    LEX_KEYWORD(DONE, 'o', 'e', T_DONE),
+    LEX_KEYWORD(BOOL_FALSE, 'a', 'e', T_FALSE),
+    LEX_KEYWORD(WHILE, 'h', 'e', T_WHILE),
+};
 
+/* tok_get
+ * Internal function used to map the inputted line to a bytecode.
+ * Returns: a value from enum Ops, the bytecode relevant to the input
+ */
 [[nodiscard]]
-static inline enum Token tok_check_len_one(Str s)
+enum Token tok_get(Str s)
 {
-    if (s.value[0] == FSLASH)
-        return T_FSLASH;
+    assert(s.value);
 
-    return get_const_type(s);
+    size_t len = s.length - 1;
+    switch (len) {
+    case 0: {
+        return T_NONE;
+    }
+    case 1: {
+        return s.value[0] == FSLASH ? T_FSLASH : get_const_type(s);
+    }
+    case 2:
+    case 3:
+    case 4:
+    case 5: {
+        const Lex_Keyword* keyword = lex_keywords + LEX_KEYWORD_HASH(s.value[1], s.value[len - 1], len);
+        if (keyword->len == len && !memcmp(keyword->str, s.value, len)) {
+            return keyword->tok;
+        }
+        return get_const_type(s);
+    }
+    default: {
+        return get_const_type(s);
+    }
+    }
 }
 
+/* enum Lex_Class
+ * What a character means to the lexer on its own, looked up in lex_classes.
+ */
+enum Lex_Class : uint8_t {
+    LC_WORD = 0, // part of a word
+    LC_DELIM,    // ends the current word
+    LC_SYMBOL,   // always a lexeme of its own, the token is in lex_symbol_toks
+    LC_SPECIAL,  // depends on the characters around it
+};
+
+static constexpr enum Lex_Class lex_classes[UCHAR_MAX + 1] = {
+    ['\0'] = LC_DELIM,                ['\n'] = LC_DELIM,               ['\r'] = LC_DELIM,
+    [' '] = LC_DELIM,
+    [DOUBLE_QUOTE] = LC_SYMBOL,       [SINGLE_QUOTE] = LC_SYMBOL,      [BACKTICK_QUOTE] = LC_SYMBOL,
+    [O_PARAN] = LC_SYMBOL,            [C_PARAN] = LC_SYMBOL,           [O_BRACKET] = LC_SYMBOL,
+    [C_BRACKET] = LC_SYMBOL,          [EQ] = LC_SYMBOL,                [DOLLAR] = LC_SYMBOL,
+    [PIPE] = LC_SYMBOL,               [AMP] = LC_SYMBOL,               [GT] = LC_SYMBOL,
+    [LT] = LC_SYMBOL,                 [SEMICOLON] = LC_SYMBOL,         [PLUS] = LC_SYMBOL,
+    [MOD] = LC_SYMBOL,
+    [STAR] = LC_SPECIAL,              [QUESTION] = LC_SPECIAL,         [TILDE] = LC_SPECIAL,
+    [MINUS] = LC_SPECIAL,             [COMMENT] = LC_SPECIAL,
+};
+
+static constexpr enum Token lex_symbol_toks[UCHAR_MAX + 1] = {
+    [DOUBLE_QUOTE] = T_D_QUOTE,       [SINGLE_QUOTE] = T_QUOTE,        [BACKTICK_QUOTE] = T_BACKTICK,
+    [O_PARAN] = T_O_PARAN,            [C_PARAN] = T_C_PARAN,           [O_BRACKET] = T_O_BRACK,
+    [C_BRACKET] = T_C_BRACK,          [EQ] = T_EQ,                     [DOLLAR] = T_DOLLAR,
+    [PIPE] = T_PIPE,                  [AMP] = T_AMP,                   [GT] = T_GT,
+    [LT] = T_LT,                      [SEMICOLON] = T_SEMIC,           [PLUS] = T_PLUS,
+    [MOD] = T_MOD,
+};
+
+/* lex_word_scan
+ * Skip over the characters most words are made of: letters, digits, '/', '.', and '_', 16 or 32 at a time.
+ * Reads up to LEX_SCAN_PADDING characters past end, the lexer's copy of the line has room for it.
+ * Returns: the position of the first other character from pos, or a position >= end.
+ */
+#define LEX_SCAN_PADDING 32
+
+#if defined(__AVX2__)
 [[nodiscard]]
-static inline enum Token tok_check_len_two(Str s)
+static inline size_t lex_word_scan(const char* restrict buf, size_t pos, size_t end)
 {
-    for (size_t i = 0; i < ops_2char_len; ++i) {
-        if (CMP_2(s.value, ops_2char_str[i])) {
-            return ops_2char[i];
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i alpha_offset = _mm256_set1_epi8((char)(0x80 - 'a'));
+    const __m256i alpha_limit = _mm256_set1_epi8((char)(0x80 + 26));
+    const __m256i digit_offset = _mm256_set1_epi8((char)(0x80 - '.'));
+    const __m256i digit_limit = _mm256_set1_epi8((char)(0x80 + '9' - '.' + 1));
+    const __m256i underscore = _mm256_set1_epi8('_');
+
+    for (; pos < end; pos += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(buf + pos));
+        // ranges are checked by moving them to the bottom of the signed range: c - low + 0x80 < len + 0x80
+        __m256i alpha = _mm256_cmpgt_epi8(alpha_limit, _mm256_add_epi8(_mm256_or_si256(c, case_bit), alpha_offset));
+        __m256i digit = _mm256_cmpgt_epi8(digit_limit, _mm256_add_epi8(c, digit_offset));
+        __m256i word = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(c, underscore));
+        uint32_t others = ~(uint32_t)_mm256_movemask_epi8(word);
+        if (others) {
+            return pos + (size_t)__builtin_ctz(others);
         }
     }
-
-    return get_const_type(s);
+    return pos;
 }
-
+#elif defined(__SSE2__)
 [[nodiscard]]
-static inline enum Token tok_check_len_three(Str s)
+static inline size_t lex_word_scan(const char* restrict buf, size_t pos, size_t end)
 {
-    for (size_t i = 0; i < ops_3char_len; ++i) {
-        if (CMP_3(s.value, ops_3char_str[i])) {
-            return ops_3char[i];
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i alpha_offset = _mm_set1_epi8((char)(0x80 - 'a'));
+    const __m128i alpha_limit = _mm_set1_epi8((char)(0x80 + 26));
+    const __m128i digit_offset = _mm_set1_epi8((char)(0x80 - '.'));
+    const __m128i digit_limit = _mm_set1_epi8((char)(0x80 + '9' - '.' + 1));
+    const __m128i underscore = _mm_set1_epi8('_');
+
+    for (; pos < end; pos += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(buf + pos));
+        // ranges are checked by moving them to the bottom of the signed range: c - low + 0x80 < len + 0x80
+        __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(_mm_or_si128(c, case_bit), alpha_offset), alpha_limit);
+        __m128i digit = _mm_cmplt_epi8(_mm_add_epi8(c, digit_offset), digit_limit);
+        __m128i word = _mm_or_si128(_mm_or_si128(alpha, digit), _mm_cmpeq_epi8(c, underscore));
+        uint32_t others = ~(uint32_t)_mm_movemask_epi8(word) & 0xFFFF;
+        if (others) {
+            return pos + (size_t)__builtin_ctz(others);
         }
     }
-
-    return get_const_type(s);
+    return pos;
 }
-
+#else
 [[nodiscard]]
-static inline enum Token tok_check_len_four(Str s)
+static inline size_t lex_word_scan(const char* restrict buf, size_t pos, size_t end)
 {
-    switch (s.value[0]) {
-    case 't': {
-        if (!memcmp(s.value, BOOL_TRUE, sizeof(BOOL_TRUE) - 1))
-            return T_TRUE;
-        else if (!memcmp(s.value, THEN, sizeof(THEN) - 1))
-            return T_THEN;
-        break;
-    }
-    case 'e': {
-        if (!memcmp(s.value, ELSE, sizeof(ELSE) - 1))
-            return T_ELSE;
-        else if (!memcmp(s.value, ELIF, sizeof(ELIF) - 1))
-            return T_ELIF;
-        break;
-    }
-    case 'd': {
-        if (!memcmp(s.value, DONE, sizeof(DONE) - 1))
-            return T_DONE;
-        break;
+    while (pos < end && lex_classes[(unsigned char)buf[pos]] == LC_WORD) {
+        ++pos;
     }
-    }
-    return get_const_type(s);
+    return pos;
 }
+#endif
 
+/* lex_word_end
+ * Returns: the position of the first character from pos which isn't part of a word, or end.
+ */
 [[nodiscard]]
-static inline enum Token tok_check_len_five(Str s)
+static inline size_t lex_word_end(const char* restrict buf, size_t pos, size_t end)
 {
-    switch (s.value[0]) {
-    case 'f': {
-        if (!memcmp(s.value, BOOL_FALSE, sizeof(BOOL_FALSE) - 1))
-            return T_FALSE;
-        break;
-    }
-    case 'w': {
-        if (!memcmp(s.value, WHILE, sizeof(WHILE) - 1))
-            return T_WHILE;
-        break;
-    }
+    for (;;) {
+        pos = lex_word_scan(buf, pos, end);
+        // word characters lex_word_scan doesn't skip, like ',' or '@'
+        if (pos >= end || lex_classes[(unsigned char)buf[pos]] != LC_WORD) {
+            break;
+        }
+        ++pos;
     }
-    return get_const_type(s);
+    return pos < end ? pos : end;
 }
 
-/* tok_get
- * Internal function used to map the inputted line to a bytecode.
- * Returns: a value from enum Ops, the bytecode relevant to the input
- */
-[[nodiscard]]
-enum Token tok_get(Str s)
+void lexemes_init(Lexemes* restrict lexemes, Arena* restrict scratch)
 {
-    assert(s.value);
+    assert(lexemes);
 
-    switch (s.length - 1) {
-    case 0: {
-        return T_NONE;
+    // lexemes already holding output are appended to, like when lexing each of the noninteractive args
+    if (lexemes->strs) {
+        return;
     }
 
-    case 1: {
-        return tok_check_len_one(s);
-    }
+    lexemes->cap = LEXER_TOKENS_DEFAULT_CAP;
+    lexemes->ops = arena_malloc(scratch, LEXER_TOKENS_DEFAULT_CAP, uint8_t);
+    lexemes->strs = arena_malloc(scratch, LEXER_TOKENS_DEFAULT_CAP, Str);
+}
 
-    case 2: {
-        return tok_check_len_two(s);
+/* lexemes_grow
+ * Always leave an empty lexeme after the last one, the parser peeks one past the end.
+ */
+static inline void lexemes_grow(Lexemes* restrict lexemes, Arena* restrict scratch)
+{
+    if (lexemes->count + 2 <= lexemes->cap) {
+        return;
     }
 
-    case 3: {
-        return tok_check_len_three(s);
-    }
+    size_t new_cap = lexemes->cap * 2;
+    lexemes->ops = arena_realloc(scratch, new_cap, uint8_t, lexemes->ops, lexemes->cap);
+    lexemes->strs = arena_realloc(scratch, new_cap, Str, lexemes->strs, lexemes->cap);
+    lexemes->cap = new_cap;
+}
 
-    case 4: {
-        return tok_check_len_four(s);
+/* Lexer_Word
+ * The word currently being lexed, a view of len characters starting at start in the lexer's copy of the line.
+ */
+typedef struct {
+    size_t start;
+    size_t len;
+    enum Token tok;
+} Lexer_Word;
+
+static void lexeme_word_add(Lexemes* restrict lexemes, char* restrict buf, Lexer_Word* restrict word,
+                            Arena* restrict scratch)
+{
+    if (!word->len) {
+        return;
     }
 
-    case 5: {
-        return tok_check_len_five(s);
-    }
+    lexemes_grow(lexemes, scratch);
+    buf[word->start + word->len] = '\0';
+    Str s = Str(buf + word->start, word->len + 1);
+    lexemes->strs[lexemes->count] = s;
+    lexemes->ops[lexemes->count] = word->tok == T_NONE ? tok_get(s) : word->tok;
+    ++lexemes->count;
 
-    default: {
-        return get_const_type(s);
-    }
-    }
+    *word = (Lexer_Word){0};
 }
 
-void lexemes_init(Lexemes* restrict lexemes, Arena* restrict scratch)
+/* lexeme_add
+ * Add the symbol c as a lexeme of its own, after the word before it.
+ * Words are null terminated in place by overwriting the character after them, which may be the symbol, so symbols are
+ * copied to their own two characters of the lexer's buffer, at symbol.
+ */
+static void lexeme_add(Lexemes* restrict lexemes, char* restrict buf, Lexer_Word* restrict word,
+                       char* restrict symbol, char c, enum Token tok, Arena* restrict scratch)
 {
-    assert(lexemes);
-
-    lexemes->ops = arena_malloc(scratch, LEXER_TOKENS_LIMIT, uint8_t);
-    lexemes->strs = arena_malloc(scratch, LEXER_TOKENS_LIMIT, Str);
-}
-
-void lexeme_add(Lexemes* restrict lexemes, size_t* n, char c, enum Token tok, Arena* restrict scratch) {
-    if (lex_buf_pos > 0 && *lex_buf) {
-        lexemes->strs[*n].length = lex_buf_pos + 1;
-        lexemes->strs[*n].value = arena_malloc(scratch, lexemes->strs[*n].length, char);
-        memcpy(lexemes->strs[*n].value, lex_buf, lex_buf_pos);
-        lexemes->ops[*n] = cur_tok == T_NONE ? tok_get(lexemes->strs[*n]) : cur_tok;
-        lex_buf_pos = 0;
-        lex_buf[0] = 0;
-        cur_tok = T_NONE;
-        *n += 1;
-    }
-
-    lexemes->ops[*n] = tok;
-    lexemes->strs[*n].length = 2;
-    lexemes->strs[*n].value = arena_malloc(scratch, 2, char);
-    lexemes->strs[*n].value[0] = c;
-    lexemes->strs[*n].value[1] = 0;
-    *n += 1;
+    lexeme_word_add(lexemes, buf, word, scratch);
+
+    lexemes_grow(lexemes, scratch);
+    symbol[0] = c;
+    symbol[1] = '\0';
+    lexemes->strs[lexemes->count] = Str(symbol, 2);
+    lexemes->ops[lexemes->count] = tok;
+    ++lexemes->count;
 }
 
 static inline bool is_whitespace(char c)
@@ -215,8 +290,19 @@ static inline bool is_whitespace(char c)
     return c == ' ' || c == '\t' || c == '\n' || c == '\r';
 }
 
+static inline void lex_word_extend(Lexer_Word* restrict word, size_t pos)
+{
+    if (!word->len) {
+        word->start = pos;
+    }
+    ++word->len;
+}
+
 /* lex
  * Turns the inputted line into values, lengths, and bytecodes that the VM can work with.
+ * The line is copied once, lexemes are views into the copy rather than each being copied on their own.
+ * After the copy, each position has two characters for the symbol there, if it's a symbol.
+ * Characters are classified with lex_classes, runs of word characters are skipped over by lex_word_end.
  */
 void lex(Str line, Lexemes* lexemes, Arena* restrict scratch)
 {
@@ -227,190 +313,108 @@ void lex(Str line, Lexemes* lexemes, Arena* restrict scratch)
     lexemes_init(lexemes, scratch);
     assert(line.value); assert(scratch);
     if (!line.value || !*line.value || !line.length) {
-        lexemes->count = 0;
         return;
     }
     if (line.length < 2 || line.length > NCSH_MAX_INPUT) {
-        lexemes->count = 0;
         return;
     }
 
+    char* buf = arena_malloc(scratch, line.length + LEX_SCAN_PADDING + line.length * 2, char);
+    char* symbols = buf + line.length + LEX_SCAN_PADDING;
+    memcpy(buf, line.value, line.length);
+    line.value = buf;
     estrtrim(&line);
 
     debug_lexer_input(line);
 
-    lex_buf = arena_malloc(scratch, NCSH_MAX_INPUT, char);
-    lex_buf_pos = 0;
-    lex_state = 0;
-    size_t n = lexemes->count;
-    cur_tok = T_NONE;
+    Lexer_Word word = {0};
 
     for (size_t pos = 0; pos < line.length; ++pos) {
-        if (lexemes->count == LEXER_TOKENS_LIMIT - 1 && pos < line.length) { // can't lex all of the tokens
-            lexemes->count = 0;
-            break;
+        char c = line.value[pos];
+        switch (lex_classes[(unsigned char)c]) {
+        case LC_WORD: {
+            if (!word.len) {
+                word.start = pos;
+            }
+            size_t end = lex_word_end(line.value, pos + 1, line.length);
+            word.len += end - pos;
+            pos = end - 1;
+            continue;
         }
-        else if (pos >= NCSH_MAX_INPUT - 1 || lex_buf_pos >= NCSH_MAX_INPUT - 1 ||
-                 lexemes->count == LEXER_TOKENS_LIMIT - 1) {
+        case LC_DELIM: {
+            lexeme_word_add(lexemes, buf, &word, scratch);
+            continue;
+        }
+        case LC_SYMBOL: {
+            lexeme_add(lexemes, buf, &word, symbols + pos * 2, c, lex_symbol_toks[(unsigned char)c], scratch);
+            continue;
+        }
+        case LC_SPECIAL: {
             break;
         }
+        }
 
-        switch (line.value[pos]) {
+        switch (c) {
         case QUESTION: {
-            cur_tok = T_GLOB;
-            lex_buf[lex_buf_pos++] = line.value[pos];
+            word.tok = T_GLOB;
+            lex_word_extend(&word, pos);
             continue;
         }
         case STAR: {
-            if (lex_buf_pos == 0 && pos + 1 < line.length) {
+            if (!word.len && pos + 1 < line.length) {
                 if (is_whitespace(line.value[pos + 1]) || line.value[pos + 1] == STAR) {
-                    lexeme_add(lexemes, &n, line.value[pos], T_STAR, scratch);
+                    lexeme_add(lexemes, buf, &word, symbols + pos * 2, c, T_STAR, scratch);
                     continue;
                 }
             }
-            cur_tok = T_GLOB;
-            lex_buf[lex_buf_pos++] = line.value[pos];
+            word.tok = T_GLOB;
+            lex_word_extend(&word, pos);
             continue;
         }
         case TILDE: {
-            if (lex_buf_pos == 0) {
-                cur_tok = T_HOME;
+            if (!word.len) {
+                word.tok = T_HOME;
             }
-            goto lex_default;
-        }
-        case DOUBLE_QUOTE: {
-            lexeme_add(lexemes, &n, line.value[pos], T_D_QUOTE, scratch);
-            continue;
-        }
-        case SINGLE_QUOTE: {
-            lexeme_add(lexemes, &n, line.value[pos], T_QUOTE, scratch);
-            continue;
-        }
-        case BACKTICK_QUOTE: {
-            lexeme_add(lexemes, &n, line.value[pos], T_BACKTICK, scratch);
-            continue;
-        }
-        case O_PARAN: {
-            lexeme_add(lexemes, &n, line.value[pos], T_O_PARAN, scratch);
-            continue;
-        }
-        case C_PARAN: {
-            lexeme_add(lexemes, &n, line.value[pos], T_C_PARAN, scratch);
-            continue;
-        }
-        case EQ: {
-            lexeme_add(lexemes, &n, line.value[pos], T_EQ, scratch);
-            continue;
-        }
-        case DOLLAR: {
-            lexeme_add(lexemes, &n, line.value[pos], T_DOLLAR, scratch);
-            continue;
-        }
-        case PIPE: {
-            lexeme_add(lexemes, &n, line.value[pos], T_PIPE, scratch);
-            continue;
-        }
-        case AMP: {
-            lexeme_add(lexemes, &n, line.value[pos], T_AMP, scratch);
-            continue;
-        }
-        case GT: {
-            lexeme_add(lexemes, &n, line.value[pos], T_GT, scratch);
-            continue;
-        }
-        case LT: {
-            lexeme_add(lexemes, &n, line.value[pos], T_LT, scratch);
-            continue;
-        }
-        case O_BRACKET: {
-            lexeme_add(lexemes, &n, line.value[pos], T_O_BRACK, scratch);
-            continue;
-        }
-        case C_BRACKET: {
-            lexeme_add(lexemes, &n, line.value[pos], T_C_BRACK, scratch);
-            continue;
-        }
-        case SEMICOLON: {
-            lexeme_add(lexemes, &n, line.value[pos], T_SEMIC, scratch);
-            continue;
-        }
-        case PLUS: {
-            lexeme_add(lexemes, &n, line.value[pos], T_PLUS, scratch);
+            lex_word_extend(&word, pos);
             continue;
         }
         case MINUS: {
             if (pos + 1 < line.length) {
                 if (is_whitespace(line.value[pos + 1]) || line.value[pos + 1] == C_PARAN) {
-                    lexeme_add(lexemes, &n, line.value[pos], T_MINUS, scratch);
+                    lexeme_add(lexemes, buf, &word, symbols + pos * 2, c, T_MINUS, scratch);
                     continue;
                 }
                 if (line.value[pos + 1] == MINUS) {
-                    if (pos + 2 < line.length && !is_whitespace(line.value[pos + 2]) && line.value[pos + 2] != C_PARAN)
-                        goto lex_default;
+                    if (pos + 2 < line.length && !is_whitespace(line.value[pos + 2]) && line.value[pos + 2] != C_PARAN) {
+                        lex_word_extend(&word, pos);
+                        continue;
+                    }
 
-                    lexeme_add(lexemes, &n, line.value[pos], T_MINUS, scratch);
+                    lexeme_add(lexemes, buf, &word, symbols + pos * 2, c, T_MINUS, scratch);
                     continue;
                 }
-
             }
 
-            goto lex_default;
-        }
-        case MOD: {
-            lexeme_add(lexemes, &n, line.value[pos], T_MOD, scratch);
+            lex_word_extend(&word, pos);
             continue;
         }
         case COMMENT: {
-            if (!(lex_state & IN_COMMENT))
-                lex_state |= IN_COMMENT;
-
-            continue;
-        }
-        // whitespace/delimiter case // NOTE: should \t, \a, or EOF be included?
-        case ' ':
-        case '\r':
-        case '\n':
-        case '\0': {
-            if (lex_state & IN_COMMENT) {
-                if (line.value[pos] != '\n') {
-                    continue;
-                }
-                else {
-                    lex_buf[0] = '\0';
-                    lex_buf_pos = 0;
-                    continue;
-                }
-            }
-
-            if (lex_buf_pos == 0) {
+            // everything up to the end of the line is skipped, including symbols
+            lexeme_word_add(lexemes, buf, &word, scratch);
+            char* newline = memchr(line.value + pos, '\n', line.length - pos);
+            if (!newline) {
+                pos = line.length;
                 continue;
             }
-
-            break;
-        }
-        default: {
-        lex_default:
-            lex_buf[lex_buf_pos++] = line.value[pos];
+            pos = (size_t)(newline - line.value);
             continue;
         }
         }
-
-        lex_buf[lex_buf_pos] = '\0';
-
-        debugf("Current lexer state: %d\n", lex_state);
-
-        lexemes->strs[n].length = lex_buf_pos + 1;
-        lexemes->strs[n].value = arena_malloc(scratch, lexemes->strs[n].length, char);
-        memcpy(lexemes->strs[n].value, lex_buf, lex_buf_pos);
-        lexemes->ops[n] = cur_tok == T_NONE ? tok_get(lexemes->strs[n]) : cur_tok;
-        ++n;
-
-        lex_buf[0] = '\0';
-        lex_buf_pos = 0;
-        cur_tok = T_NONE;
     }
 
-    lexemes->count = n;
+    // buf has room for the null terminator even when the line didn't end with one
+    lexeme_word_add(lexemes, buf, &word, scratch);
+
     debug_lexemes(lexemes);
 }
 
@@ -7,7 +7,7 @@
 #include "../arena.h"
 #include "../eskilib/str.h"
 
-#define LEXER_TOKENS_LIMIT 128
+#define LEXER_TOKENS_DEFAULT_CAP 64
 
 enum Token {
     T_NONE,
@@ -59,8 +59,9 @@ enum Token {
 
 typedef struct {
     size_t count;
+    size_t cap;
     uint8_t* ops;
-    Str* strs;
+    Str* strs; // views into the lexer's copy of the line, each null terminated
 } Lexemes;
 
 /* lex
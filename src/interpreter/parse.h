@@ -47,8 +47,10 @@ enum Ops : uint8_t {
     OP_HOME_EXPANSION,                        // ~
     OP_GLOB_EXPANSION,                        // * or ?
 
+    // Control flow, emitted by the compiler (compile.h) for the VM
     OP_JUMP,
     OP_JUMP_IF_FALSE,
+    OP_JUMP_IF_TRUE,
 
     // these could be condensed/removed into fewer ops.
     // they are not needed by vm, only by parser to characterize tokens.
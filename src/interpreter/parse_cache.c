@@ -0,0 +1,305 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* parse_cache.c: caches parser output by input line so repeated lines skip the lexer and parser */
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "parse_cache.h"
+
+void parse_cache_new(Shell* restrict shell)
+{
+    assert(shell);
+
+    Parse_Cache* cache = arena_malloc(&shell->arena, 1, Parse_Cache);
+    cache->memory = arena_malloc(&shell->arena, parse_cache_arena_size, char);
+    cache->arena = (Arena){.start = cache->memory, .end = cache->memory + parse_cache_arena_size};
+    shell->parse_cache = cache;
+}
+
+#define PARSE_CACHE_FNV_OFFSET 14695981039346656037UL
+#define PARSE_CACHE_FNV_PRIME 1099511628211UL
+
+[[nodiscard]]
+static uint64_t parse_cache_hash(Str line)
+{
+    uint64_t hash = PARSE_CACHE_FNV_OFFSET;
+    for (size_t i = 0; i < line.length; ++i) {
+        hash ^= (unsigned char)line.value[i];
+        hash *= PARSE_CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Parse_Cache_Copy
+ * Statements link to each other through right, left, and prev, and loops link back to their start,
+ * so statements already copied are tracked to keep the copy's links the same as the original's.
+ * The cache owns the strings of the statements it stores, copies handed out by parse_cache_get borrow them.
+ */
+typedef struct {
+    size_t count;
+    size_t cap;
+    Statement** from;
+    Statement** to;
+    bool copy_strs;
+    Arena* dest;
+    Arena* s;
+} Parse_Cache_Copy;
+
+/* parse_cache_find
+ * Returns: the copy of stmt if it was already copied, otherwise NULL
+ */
+[[nodiscard]]
+static Statement* parse_cache_find(Statement* restrict stmt, Parse_Cache_Copy* restrict data)
+{
+    for (size_t i = 0; i < data->count; ++i) {
+        if (data->from[i] == stmt) {
+            return data->to[i];
+        }
+    }
+    return NULL;
+}
+
+static void parse_cache_track(Statement* stmt, Statement* copy, Parse_Cache_Copy* restrict data)
+{
+    if (data->count == data->cap) {
+        size_t new_cap = data->cap * 2;
+        data->from = arena_realloc(data->s, new_cap, Statement*, data->from, data->cap);
+        data->to = arena_realloc(data->s, new_cap, Statement*, data->to, data->cap);
+        data->cap = new_cap;
+    }
+
+    data->from[data->count] = stmt;
+    data->to[data->count] = copy;
+    ++data->count;
+}
+
+/* parse_cache_cap
+ * The parser leaves room for more commands than it parsed, only the commands and the null Str after the last
+ * command, which the VM relies on, are copied. Expansion makes room for itself when it adds commands.
+ * Returns: the number of commands, ops, and keys to copy
+ */
+[[nodiscard]]
+static size_t parse_cache_cap(Commands* restrict cmds)
+{
+    return cmds->count < cmds->cap ? cmds->count + 1 : cmds->cap;
+}
+
+[[nodiscard]]
+static Str parse_cache_str_copy(Str str, Arena* restrict dest)
+{
+    if (!str.value) {
+        return str;
+    }
+
+    char* value = arena_malloc(dest, str.length ? str.length : 1, char);
+    memcpy(value, str.value, str.length);
+    return Str(value, str.length);
+}
+
+[[nodiscard]]
+static Commands* parse_cache_cmds_copy(Commands* restrict cmds, Parse_Cache_Copy* restrict data)
+{
+    Commands* head = NULL;
+    Commands** tail = &head;
+    for (Commands* c = cmds; c; c = c->next) {
+        Commands* copy = arena_malloc(data->dest, 1, Commands);
+        *copy = *c;
+        copy->next = NULL;
+
+        size_t cap = parse_cache_cap(c);
+        if (cap) {
+            copy->cap = cap;
+            copy->ops = arena_malloc(data->dest, cap, enum Ops);
+            memcpy(copy->ops, c->ops, cap * sizeof(enum Ops));
+            copy->strs = arena_malloc(data->dest, cap, Str);
+            copy->keys = arena_malloc(data->dest, cap, Str);
+            if (data->copy_strs) {
+                for (size_t i = 0; i < cap; ++i) {
+                    copy->strs[i] = parse_cache_str_copy(c->strs[i], data->dest);
+                    copy->keys[i] = parse_cache_str_copy(c->keys[i], data->dest);
+                }
+            }
+            else {
+                memcpy(copy->strs, c->strs, cap * sizeof(Str));
+                memcpy(copy->keys, c->keys, cap * sizeof(Str));
+            }
+        }
+
+        *tail = copy;
+        tail = &copy->next;
+    }
+
+    return head;
+}
+
+[[nodiscard]]
+static Statement* parse_cache_stmt_copy(Statement* restrict stmt, Parse_Cache_Copy* restrict data)
+{
+    if (!stmt) {
+        return NULL;
+    }
+
+    Statement* copy = parse_cache_find(stmt, data);
+    if (copy) {
+        return copy;
+    }
+
+    copy = arena_malloc(data->dest, 1, Statement);
+    parse_cache_track(stmt, copy, data);
+    copy->type = stmt->type;
+    copy->commands = parse_cache_cmds_copy(stmt->commands, data);
+    copy->right = parse_cache_stmt_copy(stmt->right, data);
+    copy->left = parse_cache_stmt_copy(stmt->left, data);
+    copy->prev = parse_cache_stmt_copy(stmt->prev, data);
+    return copy;
+}
+
+/* parse_cache_stmts_copy
+ * Copy stmts into dest, scratch is used while copying. dest and scratch may be the same arena.
+ * When copy_strs is set the strings of every command and the redirect filename are copied too, otherwise the copy
+ * borrows them from stmts.
+ */
+[[nodiscard]]
+static Statements* parse_cache_stmts_copy(Statements* restrict stmts, bool copy_strs, Arena* dest, Arena* scratch)
+{
+    constexpr size_t default_cap = 8;
+    Parse_Cache_Copy data = {
+        .cap = default_cap,
+        .from = arena_malloc(scratch, default_cap, Statement*),
+        .to = arena_malloc(scratch, default_cap, Statement*),
+        .copy_strs = copy_strs,
+        .dest = dest,
+        .s = scratch
+    };
+
+    Statements* copy = arena_malloc(dest, 1, Statements);
+    *copy = *stmts;
+    if (copy_strs && stmts->redirect_filename) {
+        size_t len = strlen(stmts->redirect_filename) + 1;
+        copy->redirect_filename = arena_malloc(dest, len, char);
+        memcpy(copy->redirect_filename, stmts->redirect_filename, len);
+    }
+    copy->head = parse_cache_stmt_copy(stmts->head, &data);
+    return copy;
+}
+
+// the most an allocation of count types takes from an arena, including the padding to align it
+#define PARSE_CACHE_ALLOC_SIZE(count, type) ((count) * sizeof(type) + _Alignof(type) - 1)
+
+[[nodiscard]]
+static size_t parse_cache_str_size(Str str)
+{
+    return !str.value ? 0 : str.length ? str.length : 1;
+}
+
+/* parse_cache_stmt_size
+ * Walks the statements like parse_cache_stmt_copy does when copying strings, without copying anything.
+ * Returns: an upper bound of the bytes copying stmt and the statements it links to takes
+ */
+[[nodiscard]]
+static size_t parse_cache_stmt_size(Statement* restrict stmt, Parse_Cache_Copy* restrict data)
+{
+    if (!stmt || parse_cache_find(stmt, data)) {
+        return 0;
+    }
+
+    parse_cache_track(stmt, stmt, data);
+    size_t size = PARSE_CACHE_ALLOC_SIZE(1, Statement);
+    for (Commands* c = stmt->commands; c; c = c->next) {
+        size += PARSE_CACHE_ALLOC_SIZE(1, Commands);
+        size_t cap = parse_cache_cap(c);
+        if (cap) {
+            size += PARSE_CACHE_ALLOC_SIZE(cap, enum Ops) + 2 * PARSE_CACHE_ALLOC_SIZE(cap, Str);
+            for (size_t i = 0; i < cap; ++i) {
+                size += parse_cache_str_size(c->strs[i]) + parse_cache_str_size(c->keys[i]);
+            }
+        }
+    }
+
+    return size + parse_cache_stmt_size(stmt->right, data) + parse_cache_stmt_size(stmt->left, data) +
+           parse_cache_stmt_size(stmt->prev, data);
+}
+
+/* parse_cache_stmts_size
+ * Returns: an upper bound of the bytes parse_cache_stmts_copy takes to copy stmts with their strings
+ */
+[[nodiscard]]
+static size_t parse_cache_stmts_size(Statements* restrict stmts, Arena scratch)
+{
+    constexpr size_t default_cap = 8;
+    Parse_Cache_Copy data = {
+        .cap = default_cap,
+        .from = arena_malloc(&scratch, default_cap, Statement*),
+        .to = arena_malloc(&scratch, default_cap, Statement*),
+        .s = &scratch
+    };
+
+    size_t size = PARSE_CACHE_ALLOC_SIZE(1, Statements);
+    if (stmts->redirect_filename) {
+        size += strlen(stmts->redirect_filename) + 1;
+    }
+    return size + parse_cache_stmt_size(stmts->head, &data);
+}
+
+[[nodiscard]]
+Statements* parse_cache_get(Parse_Cache* restrict cache, Str line, Arena* restrict scratch)
+{
+    assert(cache); assert(scratch);
+    if (!line.value || !line.length) {
+        return NULL;
+    }
+
+    uint64_t hash = parse_cache_hash(line);
+    for (size_t i = 0; i < parse_cache_size; ++i) {
+        Parse_Cache_Entry* entry = cache->entries + i;
+        if (entry->stmts && entry->hash == hash && estrcmp(entry->line, line)) {
+            entry->last_used = ++cache->tick;
+            return parse_cache_stmts_copy(entry->stmts, false, scratch, scratch);
+        }
+    }
+
+    return NULL;
+}
+
+void parse_cache_add(Parse_Cache* restrict cache, Str line, Statements* restrict stmts, Arena scratch)
+{
+    assert(cache); assert(stmts);
+    if (!line.value || !line.length) {
+        return;
+    }
+
+    // an arena allocation that doesn't fit aborts the shell, so the copy's size is bounded before copying
+    size_t size = parse_cache_stmts_size(stmts, scratch) + line.length;
+    if (size > parse_cache_arena_size) {
+        return;
+    }
+    if (size > (size_t)(cache->arena.end - cache->arena.start)) {
+        parse_cache_clear(cache);
+    }
+
+    Parse_Cache_Entry* entry = cache->entries;
+    for (size_t i = 0; i < parse_cache_size && entry->stmts; ++i) {
+        if (!cache->entries[i].stmts || cache->entries[i].last_used < entry->last_used) {
+            entry = cache->entries + i;
+        }
+    }
+
+    char* value = arena_malloc(&cache->arena, line.length, char);
+    memcpy(value, line.value, line.length);
+    *entry = (Parse_Cache_Entry){
+        .hash = parse_cache_hash(line),
+        .line = Str(value, line.length),
+        .stmts = parse_cache_stmts_copy(stmts, true, &cache->arena, &scratch),
+        .last_used = ++cache->tick
+    };
+}
+
+void parse_cache_clear(Parse_Cache* restrict cache)
+{
+    assert(cache);
+
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->arena.start = cache->memory;
+}
@@ -0,0 +1,31 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* parse_cache.h: caches parser output by input line so repeated lines skip the lexer and parser */
+
+#pragma once
+
+#include "../arena.h"
+#include "../eskilib/str.h"
+#include "../types.h"
+#include "parse.h"
+
+void parse_cache_new(Shell* restrict shell);
+
+/* parse_cache_get
+ * Look up the parser output for line.
+ * Expansion changes commands in place when they are executed, so the cached statements are never handed out directly.
+ * Expansion puts the strings it makes in new allocations, so the copy borrows the cached strings instead of copying them.
+ * Returns: a copy of the cached statements allocated in scratch, or NULL if line isn't cached.
+ */
+[[nodiscard]]
+Statements* parse_cache_get(Parse_Cache* restrict cache, Str line, Arena* restrict scratch);
+
+/* parse_cache_add
+ * Copy line and the parser output for it into the cache, replacing the least recently used entry if the cache is full.
+ * Must be called before stmts are executed. Lines too large for the cache's arena are not cached.
+ */
+void parse_cache_add(Parse_Cache* restrict cache, Str line, Statements* restrict stmts, Arena scratch);
+
+/* parse_cache_clear
+ * Forget all cached lines and reset the cache's arena.
+ */
+void parse_cache_clear(Parse_Cache* restrict cache);
@@ -2,95 +2,132 @@
 /* pipe.c: Pipes functions */
 
 #include <assert.h>
+#include <spawn.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "pipe.h"
 #include "vm_types.h"
 #include "../ttyio/ttyio.h"
 
 extern int vm_output_fd;
 
 [[nodiscard]]
-int pipe_start(size_t command_position, Pipe_IO* restrict pipes)
+bool pipe_is_stage(Commands* restrict cmds)
 {
-    assert(pipes);
+    assert(cmds);
 
-    if (command_position % 2 != 0) {
-        if (pipe(pipes->fd_one) != 0) {
-            tty_perror("ncsh: Error when piping process");
-            return EXIT_FAILURE;
-        }
-        vm_output_fd = pipes->fd_one[1];
+    return cmds->prev_op == OP_PIPE || (cmds->next && cmds->next->prev_op == OP_PIPE);
+}
+
+void pipe_start(Commands* restrict cmds, Pipe_IO* restrict pipes, Arena* restrict scratch)
+{
+    assert(cmds); assert(pipes); assert(scratch);
+
+    size_t count = 1;
+    while (cmds->next && cmds->next->prev_op == OP_PIPE) {
+        cmds = cmds->next;
+        ++count;
     }
-    else {
-        if (pipe(pipes->fd_two) != 0) {
-            tty_perror("ncsh: Error when piping process");
-            return EXIT_FAILURE;
-        }
-        vm_output_fd = pipes->fd_two[1];
+
+    *pipes = (Pipe_IO){
+        .count = count,
+        .fds = arena_malloc(scratch, count, Pipe_Fds),
+        .pids = arena_malloc(scratch, count, pid_t),
+        .statuses = arena_malloc(scratch, count, int)
+    };
+}
+
+[[nodiscard]]
+int pipe_stage_start(Pipe_IO* restrict pipes)
+{
+    assert(pipes); assert(pipes->count);
+
+    if (pipes->stage == pipes->count - 1) { // last stage writes to stdout (or the redirected stdout)
+        vm_output_fd = STDOUT_FILENO;
+        return EXIT_SUCCESS;
+    }
+
+    if (pipe(pipes->fds[pipes->stage]) != 0) {
+        pipes->fds[pipes->stage][0] = -1;
+        pipes->fds[pipes->stage][1] = -1;
+        tty_perror("ncsh: Error when piping process");
+        return EXIT_FAILURE;
     }
+    vm_output_fd = pipes->fds[pipes->stage][1];
 
     return EXIT_SUCCESS;
 }
 
-void pipe_connect(size_t command_position, size_t number_of_commands, Pipe_IO* restrict pipes)
+void pipe_connect(Pipe_IO* restrict pipes)
 {
-    assert(pipes);
+    assert(pipes); assert(pipes->count);
 
-    if (!command_position) { // first command
-        dup2(pipes->fd_two[1], STDOUT_FILENO);
+    size_t stage = pipes->stage;
+    if (stage) { // every stage but the first reads from the previous stage
+        dup2(pipes->fds[stage - 1][0], STDIN_FILENO);
+        close(pipes->fds[stage - 1][0]);
     }
-    else if (command_position == number_of_commands - 1) { // last command
-        if (number_of_commands % 2 != 0) {
-            dup2(pipes->fd_one[0], STDIN_FILENO);
-        }
-        else {
-            dup2(pipes->fd_two[0], STDIN_FILENO);
-        }
+    if (stage != pipes->count - 1) { // every stage but the last writes into the next stage
+        dup2(pipes->fds[stage][1], STDOUT_FILENO);
+        close(pipes->fds[stage][0]);
+        close(pipes->fds[stage][1]);
     }
-    else { // middle command
-        if (command_position % 2 != 0) {
-            dup2(pipes->fd_two[0], STDIN_FILENO);
-            dup2(pipes->fd_one[1], STDOUT_FILENO);
-            vm_output_fd = pipes->fd_one[1];
+}
+
+[[nodiscard]]
+int pipe_connect_actions(Pipe_IO* restrict pipes, posix_spawn_file_actions_t* restrict actions)
+{
+    assert(pipes); assert(pipes->count); assert(actions);
+
+    size_t stage = pipes->stage;
+    if (stage) {
+        if (posix_spawn_file_actions_adddup2(actions, pipes->fds[stage - 1][0], STDIN_FILENO) ||
+            posix_spawn_file_actions_addclose(actions, pipes->fds[stage - 1][0])) {
+            return EXIT_FAILURE;
         }
-        else {
-            dup2(pipes->fd_one[0], STDIN_FILENO);
-            dup2(pipes->fd_two[1], STDOUT_FILENO);
-            vm_output_fd = pipes->fd_two[1];
+    }
+    if (stage != pipes->count - 1) {
+        if (posix_spawn_file_actions_adddup2(actions, pipes->fds[stage][1], STDOUT_FILENO) ||
+            posix_spawn_file_actions_addclose(actions, pipes->fds[stage][0]) ||
+            posix_spawn_file_actions_addclose(actions, pipes->fds[stage][1])) {
+            return EXIT_FAILURE;
         }
     }
+
+    return EXIT_SUCCESS;
 }
 
-void pipe_stop(size_t command_position, size_t number_of_commands, Pipe_IO* restrict pipes)
+void pipe_stop(Pipe_IO* restrict pipes)
 {
-    assert(pipes);
+    assert(pipes); assert(pipes->count);
 
-    if (!command_position) {
-        close(pipes->fd_two[1]);
+    size_t stage = pipes->stage;
+    if (stage) {
+        close(pipes->fds[stage - 1][0]);
     }
-    else if (command_position == number_of_commands - 1) {
-        if (number_of_commands % 2 != 0) {
-            close(pipes->fd_one[0]);
-            vm_output_fd = STDOUT_FILENO;
-        }
-        else {
-            close(pipes->fd_two[0]);
-            vm_output_fd = STDOUT_FILENO;
-        }
+    if (stage != pipes->count - 1) {
+        close(pipes->fds[stage][1]);
     }
-    else {
-        if (command_position % 2 != 0) {
-            close(pipes->fd_two[0]);
-            close(pipes->fd_one[1]);
-            vm_output_fd = STDOUT_FILENO;
-        }
-        else {
-            close(pipes->fd_one[0]);
-            close(pipes->fd_two[1]);
-            vm_output_fd = STDOUT_FILENO;
-        }
+
+    vm_output_fd = STDOUT_FILENO;
+    ++pipes->stage;
+}
+
+void pipe_abort(Pipe_IO* restrict pipes)
+{
+    assert(pipes); assert(pipes->count);
+
+    size_t stage = pipes->stage;
+    if (stage) {
+        close(pipes->fds[stage - 1][0]);
     }
+    if (stage != pipes->count - 1) {
+        close(pipes->fds[stage][0]);
+        close(pipes->fds[stage][1]);
+    }
+
+    vm_output_fd = STDOUT_FILENO;
 }
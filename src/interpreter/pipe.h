@@ -3,12 +3,46 @@
 
 #pragma once
 
+#include <spawn.h>
 #include <stddef.h>
 
 #include "vm_types.h"
 
-int pipe_start(size_t command_position, Pipe_IO* restrict pipes);
+/* pipe_is_stage
+ * Returns true if cmds is one of the stages of a pipeline (connected to its neighbours with '|').
+ */
+bool pipe_is_stage(Commands* restrict cmds);
 
-void pipe_connect(size_t command_position, size_t number_of_commands, Pipe_IO* restrict pipes);
+/* pipe_start
+ * Called on the first stage of a pipeline.
+ * Counts the stages and allocates the per stage fd, pid, and status arrays in the scratch arena.
+ */
+void pipe_start(Commands* restrict cmds, Pipe_IO* restrict pipes, Arena* restrict scratch);
 
-void pipe_stop(size_t command_position, size_t number_of_commands, Pipe_IO* restrict pipes);
+/* pipe_stage_start
+ * Creates the pipe the current stage writes into (if it is not the last stage).
+ * Sets vm_output_fd so builtins running as a stage write into the pipeline.
+ */
+int pipe_stage_start(Pipe_IO* restrict pipes);
+
+/* pipe_connect
+ * *** Only use in context of child process. ***
+ * Connects stdin/stdout of the current stage to its neighbours and closes the pipe fds it doesn't need.
+ */
+void pipe_connect(Pipe_IO* restrict pipes);
+
+/* pipe_connect_actions
+ * The posix_spawn version of pipe_connect, adds the same dup2s and closes to actions so they run in the child.
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE if the actions could not be added.
+ */
+int pipe_connect_actions(Pipe_IO* restrict pipes, posix_spawn_file_actions_t* restrict actions);
+
+/* pipe_stop
+ * Closes the shell's copies of the current stage's pipe ends and moves on to the next stage.
+ */
+void pipe_stop(Pipe_IO* restrict pipes);
+
+/* pipe_abort
+ * Closes any pipe fds still open in the shell, used when a stage of the pipeline fails to launch.
+ */
+void pipe_abort(Pipe_IO* restrict pipes);
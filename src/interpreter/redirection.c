@@ -3,6 +3,7 @@
 
 #include <assert.h>
 #include <fcntl.h>
+#include <stdio.h>
 #include <unistd.h>
 
 #include "../debug.h"
@@ -31,6 +32,8 @@ void stdout_redirection_start(char* restrict file, bool append, Output_Redirect_
         return;
     }
 
+    // output the shell buffered before the redirection goes where it was meant to, not into the file
+    fflush(stdout);
     io->original_stdout = dup(STDOUT_FILENO);
     dup2(io->fd_stdout, STDOUT_FILENO);
     // vm_output_fd = io->fd_stdout;
@@ -111,6 +114,7 @@ void stdout_and_stderr_redirection_start(char* restrict file, bool append, Outpu
     io->fd_stdout = file_descriptor;
     io->fd_stderr = file_descriptor;
 
+    fflush(stdout);
     io->original_stdout = dup(STDOUT_FILENO);
     io->original_stderr = dup(STDERR_FILENO);
     dup2(file_descriptor, STDOUT_FILENO);
@@ -0,0 +1,296 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* script.c: reads scripts one complete command at a time, for 'ncsh script.sh' and 'ncsh < script.sh' */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../defines.h" // used for macros like NCSH_MAX_INPUT
+#include "../ttyio/ttyio.h"
+#include "script.h"
+#include "symbols.h"
+
+/* Streams are read in chunks of up to SCRIPT_BUFFER_SIZE, the longest line which can be read from a stream */
+#define SCRIPT_BUFFER_SIZE (1 << 16)
+
+[[nodiscard]]
+bool script_is(char* restrict path)
+{
+    assert(path);
+
+    struct stat st;
+    if (stat(path, &st) || !S_ISREG(st.st_mode) || access(path, R_OK)) {
+        return false;
+    }
+    if (access(path, X_OK)) {
+        return true;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    char shebang[2];
+    bool rv = read(fd, shebang, sizeof(shebang)) == sizeof(shebang) && shebang[0] == '#' && shebang[1] == '!';
+    close(fd);
+    return rv;
+}
+
+[[nodiscard]]
+int script_open(Script* restrict script, int fd, Arena* restrict arena)
+{
+    assert(script); assert(arena);
+
+    *script = (Script){.fd = fd};
+    struct stat st;
+    if (fstat(fd, &st)) {
+        tty_perror("ncsh: could not read script");
+        return EXIT_FAILURE;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        if (!st.st_size) {
+            script->eof = true;
+            return EXIT_SUCCESS;
+        }
+
+        void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            (void)posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+            script->map = map;
+            script->map_len = (size_t)st.st_size;
+            return EXIT_SUCCESS;
+        }
+    }
+
+    // pipes, terminals, and files which can't be mapped are read as a stream
+    script->buf = arena_malloc(arena, SCRIPT_BUFFER_SIZE, char);
+    return EXIT_SUCCESS;
+}
+
+void script_close(Script* restrict script)
+{
+    assert(script);
+
+    if (script->map) {
+        munmap(script->map, script->map_len);
+        script->map = NULL;
+    }
+}
+
+[[nodiscard]]
+static int script_map_line_next(Script* restrict script, char** restrict line, size_t* restrict len)
+{
+    if (script->map_pos >= script->map_len) {
+        return EXIT_SUCCESS_END;
+    }
+
+    char* start = script->map + script->map_pos;
+    size_t avail = script->map_len - script->map_pos;
+    char* newline = memchr(start, '\n', avail);
+    *line = start;
+    *len = newline ? (size_t)(newline - start) : avail;
+    script->map_pos += *len + 1;
+    return EXIT_SUCCESS;
+}
+
+[[nodiscard]]
+static int script_stream_line_next(Script* restrict script, char** restrict line, size_t* restrict len)
+{
+    for (;;) {
+        char* start = script->buf + script->buf_pos;
+        size_t avail = script->buf_len - script->buf_pos;
+        char* newline = avail ? memchr(start, '\n', avail) : NULL;
+        if (newline || (script->eof && avail)) {
+            *line = start;
+            *len = newline ? (size_t)(newline - start) : avail;
+            script->buf_pos += newline ? *len + 1 : *len;
+            return EXIT_SUCCESS;
+        }
+        if (script->eof) {
+            return EXIT_SUCCESS_END;
+        }
+
+        // move the partial line to the front of the buffer and read the rest of it
+        memmove(script->buf, start, avail);
+        script->buf_len = avail;
+        script->buf_pos = 0;
+        if (script->buf_len == SCRIPT_BUFFER_SIZE) {
+            return EXIT_FAILURE;
+        }
+
+        ssize_t bytes = read(script->fd, script->buf + script->buf_len, SCRIPT_BUFFER_SIZE - script->buf_len);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            script->eof = true;
+            continue;
+        }
+        script->buf_len += (size_t)bytes;
+    }
+}
+
+[[nodiscard]]
+static int script_line_next(Script* restrict script, char** restrict line, size_t* restrict len)
+{
+    int rv = script->map ? script_map_line_next(script, line, len) : script_stream_line_next(script, line, len);
+    if (rv == EXIT_SUCCESS) {
+        ++script->line_number;
+        // trailing whitespace, including the '\r' of CRLF line endings
+        while (*len && ((*line)[*len - 1] == ' ' || (*line)[*len - 1] == '\t' || (*line)[*len - 1] == '\r')) {
+            --*len;
+        }
+    }
+    return rv;
+}
+
+static inline bool script_is_separator(char c)
+{
+    return c == ' ' || c == '\t' || c == SEMICOLON || c == PIPE || c == AMP || c == O_PARAN || c == C_PARAN;
+}
+
+static inline bool script_word_is(char* restrict word, size_t len, char* restrict keyword, size_t keyword_len)
+{
+    return len == keyword_len && !memcmp(word, keyword, len);
+}
+
+#define SCRIPT_WORD_IS(word, len, keyword) script_word_is(word, len, keyword, sizeof(keyword) - 1)
+
+/* script_depth_change
+ * Counts the keywords opening and closing control structures which are in command position,
+ * so 'echo done' doesn't close a loop. Keywords in quotes or comments are not counted.
+ * Returns: the number of control structures opened by the line minus the number closed.
+ */
+[[nodiscard]]
+static int script_depth_change(char* restrict line, size_t len)
+{
+    int depth = 0;
+    bool command_start = true;
+    char quote = 0;
+    for (size_t i = 0; i < len;) {
+        char c = line[i];
+        if (quote) {
+            if (c == quote) {
+                quote = 0;
+            }
+            ++i;
+            continue;
+        }
+        if (c == SINGLE_QUOTE || c == DOUBLE_QUOTE || c == BACKTICK_QUOTE) {
+            quote = c;
+            command_start = false;
+            ++i;
+            continue;
+        }
+        if (script_is_separator(c)) {
+            if (c != ' ' && c != '\t') {
+                command_start = true;
+            }
+            ++i;
+            continue;
+        }
+        if (c == COMMENT) {
+            break;
+        }
+
+        size_t start = i;
+        while (i < len && !script_is_separator(line[i]) && line[i] != SINGLE_QUOTE && line[i] != DOUBLE_QUOTE &&
+               line[i] != BACKTICK_QUOTE) {
+            ++i;
+        }
+        if (!command_start) {
+            continue;
+        }
+
+        char* word = line + start;
+        size_t word_len = i - start;
+        if (SCRIPT_WORD_IS(word, word_len, IF) || SCRIPT_WORD_IS(word, word_len, WHILE) ||
+            SCRIPT_WORD_IS(word, word_len, FOR)) {
+            ++depth;
+        }
+        else if (SCRIPT_WORD_IS(word, word_len, FI) || SCRIPT_WORD_IS(word, word_len, DONE)) {
+            --depth;
+        }
+        // the words after these keywords are commands too, like 'then echo hi'
+        command_start = SCRIPT_WORD_IS(word, word_len, THEN) || SCRIPT_WORD_IS(word, word_len, DO) ||
+                        SCRIPT_WORD_IS(word, word_len, ELSE);
+    }
+
+    return depth;
+}
+
+[[nodiscard]]
+int script_command_next(Script* restrict script, char* restrict buffer, Str* restrict command)
+{
+    assert(script); assert(buffer); assert(command);
+
+    size_t pos = 0;
+    int depth = 0;
+    bool continued = false;
+    char* line;
+    size_t len;
+    int rv;
+    while ((rv = script_line_next(script, &line, &len)) == EXIT_SUCCESS) {
+        // a line continued with '\' is joined as is, like other shells do
+        if (!continued) {
+            size_t start = 0;
+            while (start < len && (line[start] == ' ' || line[start] == '\t')) {
+                ++start;
+            }
+            line += start;
+            len -= start;
+            if (!len || line[0] == COMMENT) {
+                continue;
+            }
+        }
+
+        bool continues = len && line[len - 1] == '\\';
+        if (continues) {
+            --len;
+        }
+
+        // the lines of a control structure are joined with "; ", or ' ' if the previous line ended with ';'
+        char* separator = !pos || continued ? "" : buffer[pos - 1] == SEMICOLON ? " " : "; ";
+        size_t separator_len = strlen(separator);
+        if (pos + separator_len + len + 1 > NCSH_MAX_INPUT) {
+            tty_fprintln(stderr, "ncsh: line %zu: command is longer than the max input of %d characters.",
+                         script->line_number, NCSH_MAX_INPUT);
+            return EXIT_FAILURE;
+        }
+        memcpy(buffer + pos, separator, separator_len);
+        pos += separator_len;
+        memcpy(buffer + pos, line, len);
+        pos += len;
+
+        continued = continues;
+        depth += script_depth_change(line, len);
+        if (!continued && depth <= 0) {
+            break;
+        }
+    }
+
+    if (rv == EXIT_FAILURE) {
+        tty_fprintln(stderr, "ncsh: line %zu: line is longer than %d characters.", script->line_number + 1,
+                     SCRIPT_BUFFER_SIZE);
+        return EXIT_FAILURE;
+    }
+    if (!pos) {
+        return EXIT_SUCCESS_END;
+    }
+    if (rv == EXIT_SUCCESS_END && depth > 0) {
+        tty_fprintln(stderr, "ncsh: line %zu: unexpected end of script, missing 'fi' or 'done'.", script->line_number);
+        return EXIT_FAILURE;
+    }
+
+    buffer[pos] = '\0';
+    *command = Str(buffer, pos + 1);
+    return EXIT_SUCCESS;
+}
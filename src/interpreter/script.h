@@ -0,0 +1,55 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* script.h: reads scripts one complete command at a time, for 'ncsh script.sh' and 'ncsh < script.sh' */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "../arena.h"
+#include "../eskilib/str.h"
+
+/* Script
+ * A script being read. Regular files are mmap'd, anything else (like a pipe) is read in chunks into buf.
+ * Either way the memory used doesn't depend on the length of the script.
+ */
+typedef struct {
+    int fd;
+    bool eof;
+    size_t line_number;
+
+    // mmap'd regular files
+    char* map;
+    size_t map_len;
+    size_t map_pos;
+
+    // streams
+    char* buf;
+    size_t buf_len;
+    size_t buf_pos;
+} Script;
+
+/* script_is
+ * Returns: true if path should be ran as a script, like 'ncsh script.sh', instead of as a command, like 'ncsh ls'.
+ * Executable files are only scripts if they start with "#!", so 'ncsh ./bin/program' still runs the program.
+ */
+[[nodiscard]]
+bool script_is(char* restrict path);
+
+/* script_open
+ * Start reading the script in fd, memory for reading streams is allocated in arena.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+[[nodiscard]]
+int script_open(Script* restrict script, int fd, Arena* restrict arena);
+
+void script_close(Script* restrict script);
+
+/* script_command_next
+ * Read the next complete command into buffer, which has room for NCSH_MAX_INPUT characters.
+ * Blank lines and comments are skipped, lines ending in '\' are joined with the next line,
+ * and the lines of control structures like if/fi or while/done are joined with "; " until the structure is closed.
+ * Returns: EXIT_SUCCESS with the command (null terminated, length includes the null terminator) in command,
+ * EXIT_SUCCESS_END at the end of the script, or EXIT_FAILURE if a command is too long or a structure isn't closed.
+ */
+[[nodiscard]]
+int script_command_next(Script* restrict script, char* restrict buffer, Str* restrict command);
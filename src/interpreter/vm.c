@@ -8,6 +8,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <sys/wait.h>
@@ -15,11 +16,13 @@
 
 #include "../debug.h"
 #include "../defines.h"
+#include "../path_cache.h"
 #include "../signals.h"
 #include "../ttyio/ttyio.h"
 #include "../types.h"
 #include "parse.h"
 #include "builtins.h"
+#include "compile.h"
 #include "expand.h"
 #include "pipe.h"
 #include "redirection.h"
@@ -34,24 +37,18 @@
 /* vm_child_pid: Used in signal handling, signals.h & main.c */
 extern sig_atomic_t vm_child_pid;
 
+/* environ: passed to posix_spawnp, execvp uses it implicitly in the fork + exec path */
+extern char** environ;
+
 /* vm_output_fd: set in pipe.c or redirection.c, read from builtins */
-int vm_output_fd;
+int vm_output_fd = STDOUT_FILENO;
 /* vm_error_fd: set in redirection.c, read from builtins */
 // int vm_error_fd;
 
 /* Failure Handling */
 [[nodiscard]]
-int vm_fork_failure(Vm_Data* restrict vm)
+int vm_fork_failure()
 {
-    if (vm->command_position != vm->stmts->pipes_count - 1) {
-        if (vm->command_position % 2 != 0) {
-            close(vm->pipes_io.fd_one[1]);
-        }
-        else {
-            close(vm->pipes_io.fd_two[1]);
-        }
-    }
-
     tty_perror("ncsh: Error when forking process");
     return EXIT_FAILURE;
 }
@@ -106,758 +103,442 @@ int vm_status_aggregate(Vm_Data* restrict vm)
     return vm->status;
 }
 
+/* vm_peek
+ * Skip over unconditional jumps to the next instruction the VM will dispatch.
+ * Returns: the commands of that instruction, or NULL and sets vm->end if the program is done.
+ */
 [[nodiscard]]
-Commands* vm_command_next(Commands* restrict cmds, Vm_Data* restrict vm)
+Commands* vm_peek(Vm_Data* restrict vm)
 {
-    if (!cmds->next || !cmds->next->strs[0].value) {
-        vm->cur_stmt = vm->cur_stmt->right;
-        if (!vm->cur_stmt) {
-            debug("No next stmt, end\n");
-            vm->end = true;
-            return NULL;
-        }
-        else if (vm->state == VS_IN_IF_STATEMENTS && vm->cur_stmt->type != LT_IF) {
-            debug("at end of if statements, marking vm end\n");
-            vm->end = true;
-            return NULL;
-        }
-        else {
-            if (!vm->cur_stmt->commands) {
-                vm->end = true;
-                return NULL;
-            }
-            if (vm->cur_stmt->commands->ops[0] == OP_JUMP) {
-                vm->cur_stmt = vm->cur_stmt->right;
-                if (!vm->cur_stmt || !vm->cur_stmt->commands) {
-                    debug("no stmt or cmds after OP_JUMP, marking vm end\n");
-                    vm->end = true;
-                    return NULL;
-                }
-            }
-            debug("setting cmds to next statment's command\n");
-            cmds = vm->cur_stmt->commands;
-            cmds->pos = 0;
-            return cmds;
-        }
+    Program* prog = vm->prog;
+    while (vm->pc < prog->count && prog->insts[vm->pc].op == OP_JUMP) {
+        vm->pc = prog->insts[vm->pc].target;
     }
 
-    cmds = cmds->next;
-    cmds->pos = 0;
-    return cmds;
-}
-
-[[nodiscard]]
-Commands* vm_command_set(Commands* restrict cmds, Vm_Data* restrict vm, enum Vm_State state)
-{
-    vm->cmds = cmds;
-    vm->state = state;
-    vm->op_current = cmds->prev_op;
-    return vm_command_next(cmds, vm);
-}
-
-[[nodiscard]]
-Commands* vm_next_if_statement(Vm_Data* restrict vm)
-{
-    vm->cur_stmt = vm->cur_stmt->right;
-    if (vm->cur_stmt->type != LT_IF || !vm->cur_stmt->commands) {
+    if (vm->pc >= prog->count) {
         vm->end = true;
         return NULL;
     }
 
-    return vm->cur_stmt->commands;
+    return prog->insts[vm->pc].cmds;
 }
 
+/* vm_next
+ * Dispatch instructions of the compiled program until one which runs commands.
+ * Sets vm->cmds to those commands, or to NULL if the program finished without running any more.
+ * Returns: the commands of the instruction after them, NULL if there are none (vm->end is set).
+ */
 [[nodiscard]]
-Statement* vm_find_else(Vm_Data* restrict vm)
+Commands* vm_next(Vm_Data* restrict vm)
 {
-    Statement* stmt = vm->stmts->head;
-    while (stmt && stmt->type != LT_ELSE) {
-        stmt = stmt->left;
-    }
-    return stmt;
-}
+    assert(vm);
+    assert(vm->prog);
+
+    Program* prog = vm->prog;
+    vm->cmds = NULL;
+    while (vm->pc < prog->count) {
+        Instruction* inst = prog->insts + vm->pc++;
+        switch (inst->op) {
+        case OP_JUMP:
+            vm->pc = inst->target;
+            continue;
+        case OP_JUMP_IF_FALSE:
+            if (vm->status != EXIT_SUCCESS) {
+                vm->status = EXIT_FAILURE_CONTINUE; // make sure condition failure doesn't cause shell to exit
+                vm->pc = inst->target;
+            }
+            continue;
+        case OP_JUMP_IF_TRUE:
+            if (vm->status == EXIT_SUCCESS) {
+                vm->pc = inst->target;
+            }
+            continue;
+        case OP_FOR:
+            // vm->pos is the value assigned to the loop variable, the variable itself is at 0
+            if (++vm->pos >= inst->cmds->count) {
+                vm->pos = 0;
+                vm->pc = inst->target;
+                continue;
+            }
+            break;
+        default:
+            break;
+        }
 
-[[nodiscard]]
-Commands* vm_next_else_statement(Vm_Data* restrict vm)
-{
-    switch (vm->cur_stmt->type) {
-    case LT_IF_CONDITIONS:
-    case LT_ELIF_CONDITIONS:
-        vm->cur_stmt = vm->cur_stmt->left;
+        vm->cmds = inst->cmds;
+        vm->cmds->pos = 0;
+        vm->state = inst->state;
+        vm->op_current = inst->cmds->prev_op;
         break;
-    case LT_NORMAL:
-    case LT_IF:
-    case LT_ELIF:
-        vm->cur_stmt = vm_find_else(vm);
-        break;
-    case LT_ELSE:
-        vm->cur_stmt = vm->cur_stmt->prev->left;
-        break;
-    default:
-        goto next_else_failure;
     }
 
-    if (!vm->cur_stmt || vm->cur_stmt->type != LT_ELSE || !vm->cur_stmt->commands) {
-    next_else_failure:
-        vm->end = true;
-        return NULL;
+    return vm_peek(vm);
+}
+
+/* vm_signals_block
+ * Block SIGINT and SIGQUIT BEFORE fork to avoid race conditions.
+ * This prevents the shell from being interrupted by signals meant for the foreground job.
+ * Only blocks once per foreground job, all stages of a pipeline are launched with the signals blocked.
+ */
+void vm_signals_block(Vm_Data* restrict vm)
+{
+    if (vm->signals_blocked) {
+        return;
     }
 
-    return vm->cur_stmt->commands;
+    sigset_t block_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGINT);
+    sigaddset(&block_mask, SIGQUIT);
+    sigprocmask(SIG_BLOCK, &block_mask, &vm->signals_old_mask);
+    vm->signals_blocked = true;
 }
 
-[[nodiscard]]
-Commands* vm_next_elif_condition(Vm_Data* restrict vm)
+/* vm_signals_restore
+ * Clear any pending SIGINT/SIGQUIT, these signals were meant for the foreground job, not the shell.
+ * Then restore the signal mask (unblock SIGINT/SIGQUIT).
+ */
+void vm_signals_restore(Vm_Data* restrict vm)
 {
-    if (!vm->cur_stmt->prev || (vm->cur_stmt->type != LT_IF && vm->cur_stmt->prev->type == LT_IF_CONDITIONS) ||
-        (vm->cur_stmt->type == LT_ELIF_CONDITIONS && vm->cur_stmt->prev->type == LT_ELIF_CONDITIONS)) {
-        if (vm->cur_stmt->left && vm->cur_stmt->left->type == LT_ELIF_CONDITIONS) {
-            vm->cur_stmt = vm->cur_stmt->left;
-            return vm->cur_stmt->commands;
-        }
-
-        return NULL;
+    if (!vm->signals_blocked) {
+        return;
     }
 
-    vm->cur_stmt = vm->cur_stmt->prev->left;
-    if (!vm->cur_stmt || vm->cur_stmt->type != LT_ELIF_CONDITIONS || !vm->cur_stmt->commands) {
-        vm->end = true;
-        return NULL;
+    sigset_t block_mask;
+    sigemptyset(&block_mask);
+    sigaddset(&block_mask, SIGINT);
+    sigaddset(&block_mask, SIGQUIT);
+
+    sigset_t pending;
+    sigpending(&pending);
+    if (sigismember(&pending, SIGINT) || sigismember(&pending, SIGQUIT)) {
+        struct timespec timeout = {0, 0};
+        siginfo_t info;
+        // Consume the pending signal(s) without processing them
+        while (sigtimedwait(&block_mask, &info, &timeout) > 0) {
+            // Just discard the signal
+        }
     }
 
-    return vm->cur_stmt->commands;
+    sigprocmask(SIG_SETMASK, &vm->signals_old_mask, NULL);
+    vm->signals_blocked = false;
 }
 
+/* vm_command_path
+ * Gets the full path of the current command from the PATH cache, so PATH is only searched the first time it runs.
+ * Returns: the full path, or the command name if there is no cache or it isn't in PATH (exec then reports the error).
+ */
 [[nodiscard]]
-Commands* vm_next_elif_statement(Vm_Data* restrict vm)
+char* vm_command_path(Vm_Data* restrict vm)
 {
-    vm->cur_stmt = vm->cur_stmt->right;
-    if (vm->cur_stmt->type != LT_ELIF || !vm->cur_stmt->commands) {
-        vm->end = true;
-        return NULL;
+    if (!vm->sh || !vm->sh->path_cache) {
+        return vm->cmds->strs[0].value;
     }
 
-    return vm->cur_stmt->commands;
+    Str path = path_cache_get(vm->sh->path_cache, vm->cmds->strs[0]);
+    return path.value ? path.value : vm->cmds->strs[0].value;
 }
 
+/* vm_fork
+ * Forks and execs the current command into process group pgid, or a new process group if pgid is 0.
+ * A builtin pipeline stage is run in the child instead of exec'd.
+ * Returns: the pid of the child, or -1 on failure.
+ */
 [[nodiscard]]
-Commands* vm_next_if(Vm_Data* restrict vm)
+pid_t vm_fork(Vm_Data* restrict vm, pid_t pgid)
 {
-    Commands* cmds = vm->next_cmds;
-    if (vm->cur_stmt->type == LT_IF_CONDITIONS) {
-        if (vm->state != VS_IN_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_AND) {
-            if (vm->stmts->type == ST_IF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-            else if (vm->stmts->type == ST_IF_ELIF || vm->stmts->type == ST_IF_ELIF_ELSE) {
-                debug("going to next elif condition");
-                cmds = vm_next_elif_condition(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-            else {
-                vm->end = true;
-                return NULL;
-            }
+    char* file = NULL;
+    if (vm->builtin_stage) {
+        // the child flushes stdout before exiting, it must not write the shell's pending output a second time
+        fflush(stdout);
+    }
+    else {
+        // resolve in the shell process so the PATH cache is updated
+        file = vm_command_path(vm);
+        // exec fails in the child where the cache can't be fixed, so check a cached path still exists first
+        if (file != vm->cmds->strs[0].value && access(file, F_OK) && errno == ENOENT) {
+            path_cache_invalidate(vm->sh->path_cache, vm->cmds->strs[0]);
+            file = vm_command_path(vm);
         }
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
 
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            if (cmds->ops[cmds->pos] == OP_TRUE || cmds->ops[cmds->pos] == OP_CONST) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else if (vm->cur_stmt->type == LT_IF_CONDITIONS) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else if (vm->stmts->type == ST_IF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-
-            else if (vm->stmts->type == ST_IF_ELIF || vm->stmts->type == ST_IF_ELIF_ELSE) {
-                /*if (vm->cur_stmt->prev->type == LT_ELIF_CONDITIONS) {
-                    cmds = vm_next_elif_condition(vm);
-                    if (cmds) {
-                        return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-                    }
-                }*/
-
-                debug("going to next elif condition");
-                cmds = vm_next_elif_condition(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else {
-                vm->end = true;
-                return NULL;
-            }
+    if (pid == 0) { // runs in the child process
+        // Restore signal mask in child (unblock SIGINT/SIGQUIT)
+        if (vm->signals_blocked) {
+            sigprocmask(SIG_SETMASK, &vm->signals_old_mask, NULL);
         }
 
-        else if (vm->status != EXIT_SUCCESS) {
-            if (vm->stmts->type == ST_IF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-
-            else if (vm->stmts->type == ST_IF_ELIF || vm->stmts->type == ST_IF_ELIF_ELSE) {
-                debug("going to next elif condition");
-                cmds = vm_next_elif_condition(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
+        setpgid(0, pgid);
+        signal_reset();
 
-            else {
-                vm->end = true;
-                return NULL;
-            }
+        if (vm->pipes_io.count) {
+            pipe_connect(&vm->pipes_io);
         }
 
-        else if (vm->status == EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            cmds = vm_next_if_statement(vm);
-            if (!cmds) {
-                return NULL;
-            }
-
-            return vm_command_set(cmds, vm, VS_IN_IF_STATEMENTS);
+        if (vm->builtin_stage) {
+            // pipe_connect moved the write end of the pipe to stdout
+            vm_output_fd = STDOUT_FILENO;
+            (void)builtins_check_and_run(vm, vm->sh, vm->s);
+            fflush(stdout);
+            _exit(vm->status == EXIT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE);
         }
 
-        else {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
+        char** buffers = estrtoarr(vm->cmds->strs, vm->cmds->count, vm->s);
+        if (!buffers || !*buffers) {
+            exit(-5);
         }
+        execvp(file, buffers);
+        tty_perror("ncsh: Could not run command");
+        exit(-1);
     }
 
-    if (vm->cur_stmt->type == LT_IF) {
-        debug("in LT_IF");
-        debugf("vm->status %d\n", vm->status);
-        if (vm->state == VS_IN_CONDITIONS && vm->status != EXIT_SUCCESS && vm->stmts->type == ST_IF_ELSE) {
-            if (vm->cur_stmt->type != LT_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-            }
-
-            cmds = vm->cur_stmt->commands;
-            return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-        }
-
-        if (vm->state == VS_IN_CONDITIONS && vm->status != EXIT_SUCCESS &&
-            (vm->stmts->type == ST_IF_ELIF || vm->stmts->type == ST_IF_ELIF_ELSE)) {
-            debug("in LT_IF ST_IF_ELIF or ST_IF_ELIF_ELSE");
-            if (vm->cur_stmt->type != LT_ELIF_CONDITIONS) {
-                cmds = vm_next_elif_condition(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            cmds = vm->cur_stmt->commands;
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
+    // Put child in its process group (both parent and child do this to avoid race)
+    setpgid(pid, pgid ? pgid : pid);
+    return pid;
+}
 
-        if (vm->status != EXIT_SUCCESS && (vm->state == VS_IN_IF_STATEMENTS || vm->state == VS_IN_CONDITIONS) &&
-            cmds->prev_op != OP_AND) {
+#ifdef NCSH_SPAWN
+/* vm_exec_failure_status: status of a command which could not be run, same as the forked child's exit(-1) */
+constexpr int vm_exec_failure_status = 255;
 
-            vm->end = true;
-            return NULL;
-        }
-
-        return vm_command_set(cmds, vm, VS_IN_IF_STATEMENTS);
+/* vm_spawn
+ * Launches the current command with posix_spawnp into process group pgid, or a new process group if pgid is 0.
+ * The child setup done in vm_fork is expressed through spawn attributes and file actions instead,
+ * so no shell code runs in the child and the shell's page tables are not copied.
+ * Falls back to vm_fork if the attributes or file actions can't be set up.
+ * Returns: the pid of the child, 0 if the command could not be run (vm->status is set), or -1 on failure.
+ */
+[[nodiscard]]
+pid_t vm_spawn(Vm_Data* restrict vm, pid_t pgid)
+{
+    char** buffers = estrtoarr(vm->cmds->strs, vm->cmds->count, vm->s);
+    if (!buffers || !*buffers) {
+        vm->status = vm_exec_failure_status;
+        return 0;
     }
 
-    if (vm->cur_stmt->type == LT_ELSE) {
-        debug("in LT_ELSE");
-        debugf("vm->status %d\n", vm->status);
-        if (vm->state == VS_IN_IF_STATEMENTS) {
-            vm->end = true;
-            return NULL;
-        }
-
-        if (vm->state == VS_IN_ELIF_STATEMENTS) {
-            vm->cmds = NULL;
-            vm->end = true;
-            return NULL;
-        }
-
-        if (vm->status == EXIT_SUCCESS && vm->state == VS_IN_ELSE_STATEMENTS) {
-            return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-        }
-
-        if (vm->state == VS_IN_CONDITIONS && vm->status != EXIT_SUCCESS) {
-            return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-        }
-
-        vm->end = true;
-        return NULL;
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr)) {
+        return vm_fork(vm, pgid);
     }
-
-    if (vm->cur_stmt->type == LT_ELIF_CONDITIONS) {
-        debug("in LT_ELIF_CONDITIONS");
-        if (vm->state != VS_IN_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_AND) {
-            if (vm->cur_stmt->prev->type == LT_IF_CONDITIONS || vm->cur_stmt->prev->type == LT_ELIF_CONDITIONS) {
-                cmds = vm_next_elif_condition(vm);
-                if (cmds) {
-                    return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-                }
-            }
-
-            if (vm->stmts->type == ST_IF_ELIF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-            else {
-                vm->end = true;
-                return NULL;
-            }
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            if (vm->cur_stmt->type == LT_ELIF_CONDITIONS) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-            else if (vm->stmts->type == ST_IF_ELIF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-            else {
-                vm->end = true;
-                return NULL;
-            }
-        }
-
-        else if (vm->status != EXIT_SUCCESS) {
-            if (vm->stmts->type == ST_IF_ELIF_ELSE) {
-                cmds = vm_next_else_statement(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-                return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-            }
-            else if (vm->stmts->type == ST_IF_ELIF) {
-                debug("going to next elif condition");
-                cmds = vm_next_elif_condition(vm);
-                if (!cmds) {
-                    return NULL;
-                }
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-            else {
-                vm->end = true;
-                return NULL;
-            }
-        }
-
-        else if (vm->status == EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            cmds = vm_next_elif_statement(vm);
-            if (!cmds) {
-                return NULL;
-            }
-            return vm_command_set(cmds, vm, VS_IN_ELIF_STATEMENTS);
-        }
-
-        else {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
+    posix_spawn_file_actions_t actions;
+    if (posix_spawn_file_actions_init(&actions)) {
+        posix_spawnattr_destroy(&attr);
+        return vm_fork(vm, pgid);
     }
 
-    if (vm->cur_stmt->type == LT_ELIF) {
-        debug("in LT_ELIF");
-        debugf("vm->status %d\n", vm->status);
-
-        if (vm->status == EXIT_SUCCESS && vm->state == VS_IN_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_ELIF_STATEMENTS);
-        }
+    // same dispositions as signal_reset, SIGTSTP/SIGTTIN/SIGTTOU stay ignored since ignored signals survive exec
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGQUIT);
+    sigaddset(&defaults, SIGTERM);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGWINCH);
+    sigaddset(&defaults, SIGPIPE);
 
-        else if (vm->status != EXIT_SUCCESS && vm->stmts->type == ST_IF_ELIF_ELSE) {
-            if (vm->cur_stmt->prev->type == LT_ELIF_CONDITIONS) {
-                cmds = vm_next_elif_condition(vm);
-                if (cmds) {
-                    return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-                }
-            }
-
-            cmds = vm_next_else_statement(vm);
-            if (!cmds) {
-                return NULL;
-            }
-            return vm_command_set(cmds, vm, VS_IN_ELSE_STATEMENTS);
-        }
+    short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF;
+    if (vm->signals_blocked) {
+        flags |= POSIX_SPAWN_SETSIGMASK;
+    }
+    if (posix_spawnattr_setflags(&attr, flags) || posix_spawnattr_setpgroup(&attr, pgid) ||
+        posix_spawnattr_setsigdefault(&attr, &defaults) ||
+        (vm->signals_blocked && posix_spawnattr_setsigmask(&attr, &vm->signals_old_mask)) ||
+        (vm->pipes_io.count && pipe_connect_actions(&vm->pipes_io, &actions) != EXIT_SUCCESS)) {
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        return vm_fork(vm, pgid);
+    }
 
-        else if (vm->status != EXIT_SUCCESS) {
-            if (vm->cur_stmt->prev->type == LT_ELIF_CONDITIONS) {
-                cmds = vm_next_elif_condition(vm);
-                if (cmds) {
-                    return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-                }
-            }
-        }
+    pid_t pid;
+    char* file = vm_command_path(vm);
+    int rv = posix_spawnp(&pid, file, &actions, &attr, buffers, environ);
+    if (rv == ENOENT && file != vm->cmds->strs[0].value) { // cached path no longer exists, search PATH again
+        path_cache_invalidate(vm->sh->path_cache, vm->cmds->strs[0]);
+        file = vm_command_path(vm);
+        rv = posix_spawnp(&pid, file, &actions, &attr, buffers, environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    if (rv == EAGAIN || rv == ENOMEM) { // couldn't create the process
+        errno = rv;
+        return -1;
+    }
+    if (rv) { // the process was created but exec failed, posix_spawnp has already reaped it
+        errno = rv;
+        tty_perror("ncsh: Could not run command");
+        vm->status = vm_exec_failure_status;
+        return 0;
     }
 
-    debug("vm_next_if: no conditions met, marking vm->end");
-    debugf("vm->status %d\n", vm->status);
-    vm->end = true;
-    return NULL;
+    return pid;
 }
+#endif /* NCSH_SPAWN */
 
+/* vm_launch
+ * Launches the current command with posix_spawn, or with fork + exec when NCSH_FORK is defined.
+ * Builtin pipeline stages are always forked, there is nothing to spawn.
+ * Returns: the pid of the child, 0 if the command could not be run (vm->status is set), or -1 on failure.
+ */
 [[nodiscard]]
-Commands* vm_next_while_statement(Vm_Data* restrict vm)
+pid_t vm_launch(Vm_Data* restrict vm, pid_t pgid)
 {
-    vm->cur_stmt = vm->cur_stmt->right;
-    if (vm->cur_stmt->type != LT_WHILE || !vm->cur_stmt->commands) {
-        vm->end = true;
-        return NULL;
+    if (vm->builtin_stage) {
+        return vm_fork(vm, pgid);
     }
 
-    return vm->cur_stmt->commands;
+#ifdef NCSH_SPAWN
+    return vm_spawn(vm, pgid);
+#else
+    return vm_fork(vm, pgid);
+#endif /* NCSH_SPAWN */
 }
 
-[[nodiscard]]
-Commands* vm_next_while(Vm_Data* restrict vm)
+/* vm_foreground_start
+ * Gives terminal control to the foreground job's process group.
+ * This ensures SIGINT goes to the job, not the shell.
+ * Negative vm_child_pid makes the signal handler forward signals to the entire process group.
+ */
+void vm_foreground_start(pid_t pgid)
 {
-    Commands* cmds = vm->next_cmds;
-    if (vm->cur_stmt->type == LT_WHILE_CONDITIONS) {
-        if (vm->state != VS_IN_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_AND) {
-            vm->end = true;
-            return NULL;
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            if (cmds->ops[cmds->pos] == OP_TRUE || cmds->ops[cmds->pos] == OP_CONST) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else if (vm->cur_stmt->type == LT_WHILE_CONDITIONS) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else {
-                vm->end = true;
-                return NULL;
-            }
-        }
-
-        else if (vm->status != EXIT_SUCCESS) {
-            vm->end = true;
-            return NULL;
-        }
-
-        else if (vm->status == EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            cmds = vm_next_while_statement(vm);
-            if (!cmds) {
-                return NULL;
-            }
-
-            return vm_command_set(cmds, vm, VS_IN_LOOP_STATEMENTS);
-        }
+    vm_child_pid = -pgid;
 
-        else {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-    }
-
-    if (vm->cur_stmt->type == LT_WHILE) {
-        if (vm->status != EXIT_SUCCESS && (vm->state == VS_IN_LOOP_STATEMENTS || vm->state == VS_IN_CONDITIONS) &&
-            cmds->prev_op != OP_AND) {
-            vm->end = true;
-            return NULL;
-        }
-
-        if (vm->status != EXIT_SUCCESS) {
-            vm->end = true;
-            return NULL;
-        }
-
-        if (!cmds->next && vm->cur_stmt->right && vm->cur_stmt->right->type == LT_WHILE_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        return vm_command_set(cmds, vm, VS_IN_LOOP_STATEMENTS);
+    if (tcsetpgrp(STDIN_FILENO, pgid) < 0) {
+        // If we can't set foreground process group, continue anyway
+        // but this might cause issues with signal delivery
+        // tty_perror("ncsh: tcsetpgrp failed for child");
     }
-
-    vm->end = true;
-    return NULL;
 }
 
-
-[[nodiscard]]
-Commands* vm_next_for_statement(Vm_Data* restrict vm)
+/* vm_foreground_stop
+ * Gives terminal control back to the shell once the foreground job has exited.
+ */
+void vm_foreground_stop(Vm_Data* restrict vm, pid_t shell_pgid)
 {
-    vm->cur_stmt = vm->cur_stmt->right;
-    if (vm->cur_stmt->type != LT_FOR || !vm->cur_stmt->commands) {
-        vm->end = true;
-        return NULL;
+    vm_child_pid = 0;
+
+    if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
+        // tty_perror("ncsh: tcsetpgrp failed to restore shell");
     }
 
-    return vm->cur_stmt->commands;
+    vm_signals_restore(vm);
 }
 
-[[nodiscard]]
-Commands* vm_next_for(Vm_Data* restrict vm)
+/* vm_pipeline_wait
+ * Reaps every stage of the pipeline once all stages have been launched.
+ * vm->status is set to the last stage's status, or the rightmost failing stage's status when pipefail is enabled.
+ */
+void vm_pipeline_wait(Vm_Data* restrict vm)
 {
-    Commands* cmds = vm->next_cmds;
-    if (vm->cur_stmt->type == LT_FOR_INIT) { // init C style for loop
-        return vm_command_set(cmds, vm, VS_IN_LOOP_INIT);
-    }
-
-    if (vm->cur_stmt->type == LT_FOR_EACH_INIT) { // init for val in v1 v2 ... style for loop
-        if (vm->state == VS_NORMAL)
-            vm->pos = 1;
-        else
-            ++vm->pos;
-
-        if (vm->pos >= cmds->count) {
-            vm->cmds = NULL;
-            vm->end = true;
-            return NULL;
+    Pipe_IO* pipes = &vm->pipes_io;
+    for (size_t i = 0; i < pipes->count; ++i) {
+        if (!pipes->pids[i]) { // stage was a builtin, status already recorded
+            continue;
         }
-        return vm_command_set(cmds, vm, VS_IN_LOOP_EACH_INIT);
+        vm_waitpid(pipes->pids[i], vm);
+        pipes->statuses[i] = vm->status;
     }
 
-    if (vm->cur_stmt->type == LT_FOR_CONDITIONS) {
-        if (vm->state != VS_IN_CONDITIONS) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_AND) {
-            vm->end = true;
-            return NULL;
-        }
-
-        else if (vm->status != EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            if (cmds->ops[cmds->pos] == OP_TRUE || cmds->ops[cmds->pos] == OP_CONST) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else if (vm->cur_stmt->type == LT_FOR_CONDITIONS) {
-                return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-            }
-
-            else {
-                vm->end = true;
-                return NULL;
-            }
-        }
-
-        else if (vm->status != EXIT_SUCCESS) {
-            vm->end = true;
-            return NULL;
-        }
-
-        else if (vm->status == EXIT_SUCCESS && cmds->prev_op == OP_OR) {
-            cmds = vm_next_for_statement(vm);
-            if (!cmds) {
-                return NULL;
+    vm->status = pipes->statuses[pipes->count - 1];
+    if (vm->sh && vm->sh->opts.pipefail) {
+        for (size_t i = pipes->count; i > 0; --i) {
+            if (pipes->statuses[i - 1] != EXIT_SUCCESS) {
+                vm->status = pipes->statuses[i - 1];
+                break;
             }
-
-            return vm_command_set(cmds, vm, VS_IN_LOOP_STATEMENTS);
-        }
-
-        else {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
         }
     }
-
-    if (vm->cur_stmt->type == LT_FOR_INCREMENT) {
-        return vm_command_set(cmds, vm, VS_IN_LOOP_INCREMENT);
-    }
-
-    if (vm->cur_stmt->type == LT_FOR) {
-        if (vm->status != EXIT_SUCCESS && (vm->state == VS_IN_LOOP_STATEMENTS || vm->state == VS_IN_CONDITIONS) && cmds->prev_op != OP_AND) {
-            vm->end = true;
-            return NULL;
-        }
-
-        if (vm->status != EXIT_SUCCESS) {
-            vm->end = true;
-            return NULL;
-        }
-
-        if (!cmds->next && vm->cur_stmt->right && vm->cur_stmt->right->type == LT_FOR_INCREMENT) {
-            return vm_command_set(cmds, vm, VS_IN_CONDITIONS);
-        }
-
-        return vm_command_set(cmds, vm, VS_IN_LOOP_STATEMENTS);
-    }
-
-    vm->end = true;
-    return NULL;
 }
 
-[[nodiscard]]
-Commands* vm_next_normal(Vm_Data* restrict vm)
+/* vm_pipeline_failure
+ * Reaps the stages that were already launched when a later stage of the pipeline could not be launched.
+ * The launched stages see EOF or SIGPIPE since the shell has closed its pipe fds.
+ */
+void vm_pipeline_failure(Vm_Data* restrict vm)
 {
-    if (vm->next_cmds && vm->next_cmds->prev_op == OP_AND && vm->status != EXIT_SUCCESS) {
-        debug("breaking out of VM loop, short circuiting on AND.");
-        vm->status = EXIT_FAILURE_CONTINUE; // make sure condition failure doesn't cause shell to exit
-        vm->end = true;
-        return NULL;
-    }
-    else if (vm->next_cmds && vm->next_cmds->prev_op == OP_OR && vm->status == EXIT_SUCCESS) {
-        debug("breaking out of VM loop, short circuiting on OR.");
-        vm->end = true;
-        return NULL;
-    }
-
-    vm->cmds = vm->next_cmds;
-    vm->next_cmds = vm_command_next(vm->next_cmds, vm);
-
-    if (!vm->end) {
-        vm->op_current = vm->next_cmds->prev_op;
+    Pipe_IO* pipes = &vm->pipes_io;
+    pipe_abort(pipes);
+    for (size_t i = 0; i < pipes->stage; ++i) {
+        if (pipes->pids[i]) {
+            vm_waitpid(pipes->pids[i], vm);
+        }
     }
-
-    return vm->next_cmds;
+    vm->status = EXIT_FAILURE;
+    *pipes = (Pipe_IO){0};
 }
 
-[[nodiscard]]
-Commands* vm_next(Vm_Data* restrict vm)
+/* vm_pipeline_shell_stage_stop
+ * Finishes a stage of the pipeline which ran in the shell process, like a builtin.
+ * Waits for the pipeline if it was the last stage.
+ */
+void vm_pipeline_shell_stage_stop(Vm_Data* restrict vm, pid_t shell_pgid)
 {
-    assert(vm);
-    assert(vm->stmts);
+    Pipe_IO* pipes = &vm->pipes_io;
+    pipes->pids[pipes->stage] = 0;
+    pipes->statuses[pipes->stage] = vm->status;
+    pipe_stop(pipes);
 
-    if (!vm->stmts || !vm->next_cmds) {
-        vm->end = true;
-        return NULL;
+    if (pipes->stage != pipes->count) {
+        return;
     }
 
-    switch (vm->stmts->type) {
-    case ST_IF:
-    case ST_IF_ELSE:
-    case ST_IF_ELIF:
-    case ST_IF_ELIF_ELSE:
-        return vm_next_if(vm);
-    case ST_WHILE:
-        return vm_next_while(vm);
-    case ST_FOR:
-    case ST_FOR_EACH:
-        return vm_next_for(vm);
-    default:
-        return vm_next_normal(vm);
+    if (!vm->stmts->is_bg_job) {
+        vm_pipeline_wait(vm);
+        if (pipes->pgid || vm->signals_blocked) {
+            vm_foreground_stop(vm, shell_pgid);
+        }
     }
+    *pipes = (Pipe_IO){0};
 }
 
 [[nodiscard]]
 int vm_run_foreground(Vm_Data* restrict vm, pid_t shell_pgid)
 {
-    // Block SIGINT and SIGQUIT BEFORE fork to avoid race conditions
-    // This prevents the shell from being interrupted by signals meant for the foreground job
-    sigset_t block_mask, old_mask;
-    sigemptyset(&block_mask);
-    sigaddset(&block_mask, SIGINT);
-    sigaddset(&block_mask, SIGQUIT);
-    sigprocmask(SIG_BLOCK, &block_mask, &old_mask);
+    vm_signals_block(vm);
 
-    int pid = fork();
+    Pipe_IO* pipes = &vm->pipes_io;
+    pid_t pid = vm_launch(vm, pipes->count ? pipes->pgid : 0);
     if (pid < 0) {
-        sigprocmask(SIG_SETMASK, &old_mask, NULL);
-        return vm_fork_failure(vm);
-    }
-
-    if (pid == 0) { // runs in the child process
-        // Restore signal mask in child (unblock SIGINT/SIGQUIT)
-        sigprocmask(SIG_SETMASK, &old_mask, NULL);
-
-        setpgid(0, 0);
-        signal_reset();
-
-        if (vm->op_current == OP_PIPE)
-            pipe_connect(vm->command_position, vm->stmts->pipes_count, &vm->pipes_io);
-
-        char** buffers = estrtoarr(vm->cmds->strs, vm->cmds->count, vm->s);
-        if (!buffers || !*buffers) {
-            exit(-5);
+        if (pipes->count) {
+            vm_pipeline_failure(vm);
         }
-        execvp(*buffers, buffers);
-        tty_perror("ncsh: Could not run command");
-        exit(-1);
+        vm_foreground_stop(vm, shell_pgid);
+        return vm_fork_failure();
     }
 
-    // Set global vm_child_pid so signal handler can forward signals to child
-    vm_child_pid = pid;
-
-    // Put child in its own process group (both parent and child do this to avoid race)
-    setpgid(pid, pid);
-
-    // Give terminal control to the child's process group
-    // This ensures SIGINT goes to the child, not the shell
-    if (tcsetpgrp(STDIN_FILENO, pid) < 0) {
-        // If we can't set foreground process group, continue anyway
-        // but this might cause issues with signal delivery
-        // tty_perror("ncsh: tcsetpgrp failed for child");
+    if (!pid) { // command could not be run, a pipeline stage is finished like a builtin in vm_run
+        if (!pipes->count) {
+            vm_foreground_stop(vm, shell_pgid);
+        }
+        return EXIT_SUCCESS;
     }
 
-    if (vm->op_current == OP_PIPE) {
-        pipe_stop(vm->command_position, vm->stmts->pipes_count, &vm->pipes_io);
+    if (!pipes->count) {
+        vm_foreground_start(pid);
+        vm_waitpid(pid, vm);
+        vm_foreground_stop(vm, shell_pgid);
+        return EXIT_SUCCESS;
     }
 
-    vm_waitpid(pid, vm);
-
-    // Reset vm_child_pid now that child has exited
-    vm_child_pid = 0;
-
-    // Give terminal control back to the shell
-    if (tcsetpgrp(STDIN_FILENO, shell_pgid) < 0) {
-        // tty_perror("ncsh: tcsetpgrp failed to restore shell");
+    // pipeline stage: don't wait, the next stage needs to be running to drain this stage's output
+    if (!pipes->pgid) {
+        pipes->pgid = pid;
+        vm_foreground_start(pid);
     }
+    pipes->pids[pipes->stage] = pid;
+    pipe_stop(pipes);
 
-    // Clear any pending SIGINT/SIGQUIT before unblocking
-    // These signals were meant for the child, not the shell
-    sigset_t pending;
-    sigpending(&pending);
-    if (sigismember(&pending, SIGINT) || sigismember(&pending, SIGQUIT)) {
-        struct timespec timeout = {0, 0};
-        siginfo_t info;
-        // Consume the pending signal(s) without processing them
-        while (sigtimedwait(&block_mask, &info, &timeout) > 0) {
-            // Just discard the signal
-        }
+    if (pipes->stage == pipes->count) {
+        vm_pipeline_wait(vm);
+        vm_foreground_stop(vm, shell_pgid);
+        *pipes = (Pipe_IO){0};
     }
 
-    // Restore signal mask (unblock SIGINT/SIGQUIT)
-    sigprocmask(SIG_SETMASK, &old_mask, NULL);
-
     return EXIT_SUCCESS;
 }
 
@@ -885,32 +566,34 @@ void vm_check_background(Processes* restrict pcs)
 [[nodiscard]]
 int vm_run_background(Vm_Data* restrict vm, Processes* restrict pcs)
 {
-    int pid = fork();
+    Pipe_IO* pipes = &vm->pipes_io;
+    pid_t pid = vm_launch(vm, pipes->count ? pipes->pgid : 0);
     if (pid < 0) {
-        return vm_fork_failure(vm);
-    }
-
-    if (pid == 0) { // runs in the child process
-        setpgid(0, 0);
-        signal_reset();
-
-        char** buffers = estrtoarr(vm->cmds->strs, vm->cmds->count, vm->s);
-        if (!buffers || !*buffers) {
-            return EXIT_FAILURE_CONTINUE;
+        if (pipes->count) {
+            vm_pipeline_failure(vm);
         }
+        return vm_fork_failure();
+    }
 
-        execvp(*buffers, buffers);
-        if (!buffers || !*buffers) {
-            exit(-5);
-        }
-        tty_perror("ncsh: Could not run command");
-        exit(-1);
+    if (!pid) {
+        return EXIT_SUCCESS;
     }
 
-    setpgid(pid, pid);
     size_t job_number = ++pcs->job_number;
     tty_println("job [%zu] pid [%d]", job_number, pid);
     pcs->pids[job_number - 1] = pid;
+
+    if (pipes->count) {
+        if (!pipes->pgid) {
+            pipes->pgid = pid;
+        }
+        pipes->pids[pipes->stage] = pid;
+        pipe_stop(pipes);
+        if (pipes->stage == pipes->count) {
+            *pipes = (Pipe_IO){0};
+        }
+    }
+
     return EXIT_SUCCESS;
 }
 
@@ -918,18 +601,21 @@ int vm_run_background(Vm_Data* restrict vm, Processes* restrict pcs)
 int vm_run(Statements* restrict stmts, Shell* restrict shell, Arena* restrict scratch)
 {
     int rv;
-    Vm_Data vm = {.stmts = stmts, .cur_stmt = stmts->head, .sh = shell, .s = scratch};
-    vm.next_cmds = vm.cur_stmt->commands;
-    vm.next_cmds->pos = 0;
+    Vm_Data vm = {.stmts = stmts, .prog = compile(stmts, scratch), .sh = shell, .s = scratch};
 
     if (redirection_start_if_needed(&vm) != EXIT_SUCCESS) {
         return EXIT_FAILURE_CONTINUE;
     }
 
-    while (!vm.end && vm.next_cmds) {
+    while (!vm.end) {
         vm.next_cmds = vm_next(&vm);
 
-        if (!vm.cmds || !vm.cmds->strs) {
+        // jumped past the last instruction, like a false if condition without an else
+        if (!vm.cmds) {
+            break;
+        }
+
+        if (!vm.cmds->strs) {
             rv = EXIT_FAILURE_CONTINUE;
             goto failure;
         }
@@ -943,12 +629,20 @@ int vm_run(Statements* restrict stmts, Shell* restrict shell, Arena* restrict sc
             goto next;
         }
 
-        if (vm.op_current == OP_PIPE && !vm.end) {
-            if (pipe_start(vm.command_position, &vm.pipes_io) != EXIT_SUCCESS) {
+        if (pipe_is_stage(vm.cmds)) {
+            if (!vm.pipes_io.count) {
+                pipe_start(vm.cmds, &vm.pipes_io, scratch);
+            }
+            if (pipe_stage_start(&vm.pipes_io) != EXIT_SUCCESS) {
+                vm_pipeline_failure(&vm);
+                vm_foreground_stop(&vm, shell->pgid);
                 rv = EXIT_FAILURE;
                 goto failure;
             }
         }
+        size_t stage = vm.pipes_io.stage;
+        // a builtin run in the shell would block once the pipe is full, the next stage isn't running yet to drain it
+        vm.builtin_stage = vm.pipes_io.count && stage != vm.pipes_io.count - 1 && builtins_check(&vm, shell);
 
         if (vm.cmds->op == OP_ASSIGNMENT) {
             if (vm.cmds->next && vm.cmds->next->ops[0] == OP_MATH_EXPR_START) {
@@ -959,7 +653,6 @@ int vm_run(Statements* restrict stmts, Shell* restrict shell, Arena* restrict sc
                 vm.cmds->count = 3;
                 expand_assignment(vm.cmds, vm.sh);
                 vm.status = EXIT_SUCCESS;
-                vm.next_cmds = vm_next(&vm);
             }
             else {
                 expand_assignment(vm.cmds, vm.sh);
@@ -981,11 +674,15 @@ int vm_run(Statements* restrict stmts, Shell* restrict shell, Arena* restrict sc
                 vm.status = EXIT_FAILURE_CONTINUE;
         }
 
+        else if (vm.builtin_stage) {
+            rv = stmts->is_bg_job ? vm_run_background(&vm, &shell->pcs) : vm_run_foreground(&vm, shell->pgid);
+            if (rv != EXIT_SUCCESS) {
+                goto failure;
+            }
+        }
+
         else if (builtins_check_and_run(&vm, shell, scratch)) {
             debugf("builtin ran %s\n", vm.cmds->strs[0].value);
-            if (vm.op_current == OP_PIPE) {
-                pipe_stop(vm.command_position, stmts->pipes_count, &vm.pipes_io);
-            }
         }
 
         else if (vm.state == VS_IN_CONDITIONS && (vm_is_math_cond(vm.op_current) || vm_is_math_cond(vm.cmds->op))) {
@@ -1005,6 +702,11 @@ int vm_run(Statements* restrict stmts, Shell* restrict shell, Arena* restrict sc
                 goto failure;
             }
         }
+
+        // stages that ran in the shell process (builtins) didn't move the pipeline forward
+        if (vm.pipes_io.count && vm.pipes_io.stage == stage) {
+            vm_pipeline_shell_stage_stop(&vm, shell->pgid);
+        }
 next:
         ++vm.command_position;
     }
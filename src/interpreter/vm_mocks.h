@@ -1,5 +1,5 @@
 /* Copyright ncsh (C) by Alex Eski 2025 */
-/* vm_mocks.h: a way to overide functions like execvp to be able to unit test vm.c */
+/* vm_mocks.h: a way to overide functions like execvp and posix_spawnp to be able to unit test vm.c */
 
 #pragma once
 
@@ -11,6 +11,11 @@
         return res;
     }
 
+    int posix_spawnp_mock(pid_t* pid, int res) {
+        *pid = 1;
+        return res;
+    }
+
     int waitpid_mock(pid_t pid, int* status, int w) {
         (void)status;
         (void)w;
@@ -20,8 +25,10 @@
 #   define fork() (pid_t)1
 #   ifdef NCSH_VM_TEST_EXEC_FAILURE
 #       define execvp(arg, args) execvp_mock(arg, args, -1)
+#       define posix_spawnp(pid, file, actions, attr, argv, envp) posix_spawnp_mock(pid, ENOENT)
 #   else
 #       define execvp(arg, args) execvp_mock(arg, args, 0)
+#       define posix_spawnp(pid, file, actions, attr, argv, envp) posix_spawnp_mock(pid, 0)
 #   endif /* NCSH_VM_TEST_EXEC_FAILURE */
 #   define waitpid(pid, status, w) waitpid_mock(pid, status, w)
 #endif /* NCSH_VM_TEST */
@@ -3,8 +3,10 @@
 
 #pragma once
 
+#include <signal.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 
 #include "parse.h"
 #include "../types.h"
@@ -31,6 +33,26 @@ enum Vm_State {
     VS_IN_LOOP_INCREMENT,   // increment/decrement for C style for loops
 };
 
+/* Instruction
+ * One instruction of a compiled program, see compile.h.
+ * op is OP_CONST to run cmds, OP_FOR to run the next iteration of a for each loop,
+ * or one of the jumps (OP_JUMP, OP_JUMP_IF_FALSE, OP_JUMP_IF_TRUE) which only move the program counter.
+ * For conditional jumps cmds are the commands ran when the jump isn't taken. */
+typedef struct {
+    enum Ops op;
+    enum Vm_State state;
+    size_t target; // instruction jumped to, OP_FOR jumps here when out of values
+    Commands* cmds;
+} Instruction;
+
+/* Program
+ * Flat array of instructions the VM dispatches, produced from Statements by compile. */
+typedef struct {
+    size_t count;
+    size_t cap;
+    Instruction* insts;
+} Program;
+
 /* Output_Redirect_IO
  * Stores file descriptors (fds) for redirected output and original fds
  * for stdout and/or stderr */
@@ -49,11 +71,21 @@ typedef struct {
     int original_stdin;
 } Input_Redirect_IO;
 
+/* Pipe_Fds
+ * The read (0) and write (1) ends of one pipe */
+typedef int Pipe_Fds[2];
+
 /* Pipe_IO
- * Stores file descriptors (fds) and state for piping io between processes */
+ * Stores file descriptors (fds) and state for piping io between processes.
+ * Every stage of a pipeline is launched before any are waited on, all stages share one process group.
+ * count is 0 when the VM is not currently running a pipeline. */
 typedef struct {
-    int fd_one[2];
-    int fd_two[2];
+    size_t stage;   // the stage currently being launched
+    size_t count;   // the number of stages (commands) in the pipeline
+    Pipe_Fds* fds;  // fds[i] connects stage i to stage i + 1
+    pid_t pgid;     // process group of the pipeline, the pid of the first forked stage
+    pid_t* pids;    // 0 for stages that ran as builtins
+    int* statuses;
 } Pipe_IO;
 
 /* Vm_Data
@@ -67,10 +99,11 @@ typedef struct {
     uint8_t command_position;
     bool end;
     Statements* stmts;
-    Statement* cur_stmt;
+    Program* prog;
+    size_t pc;              // index of the next instruction in prog
     Commands* cmds;
-    Commands* next_cmds;
-    size_t pos;
+    Commands* next_cmds;    // commands of the next instruction, NULL at the end of the program
+    size_t pos;             // position of the current value in for each loops
 
     Shell* sh;
     Arena* s;
@@ -78,4 +111,8 @@ typedef struct {
     Output_Redirect_IO output_redirect_io;
     Input_Redirect_IO input_redirect_io;
     Pipe_IO pipes_io;
+    bool builtin_stage;     // the current command is a builtin writing into a pipe, forked like any other stage
+
+    bool signals_blocked;
+    sigset_t signals_old_mask;
 } Vm_Data;
@@ -1,11 +1,19 @@
 /* Copyright ncsh (C) by Alex Eski 2025 */
-/* ac.h: manage autocompletions via a prefix trie for ncsh */
+/* ac.h: manage autocompletions via a radix trie for ncsh */
+
+#define _POSIX_C_SOURCE 200809L // for st_mtim
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../defines.h" // used for NCSH_MAX_INPUT
 #include "../eskilib/str.h"
@@ -14,6 +22,66 @@
 static inline int char_to_index(char character);
 static inline char index_to_char(int index);
 
+static Autocompletion_Frecency ac_frecency = {
+    .half_life = NCSH_AC_HALF_LIFE_HOURS * 60.0 * 60.0,
+    .age_every = NCSH_AC_AGE_EVERY,
+    .prune_below = NCSH_AC_PRUNE_BELOW,
+};
+
+void ac_frecency_set(Autocompletion_Frecency frecency)
+{
+    assert(frecency.half_life > 0);
+    if (frecency.half_life <= 0) {
+        return;
+    }
+    if (frecency.age_every > AC_AGE_EVERY_MAX) {
+        frecency.age_every = AC_AGE_EVERY_MAX;
+    }
+    ac_frecency = frecency;
+}
+
+#define AC_LN2 0.69314718055994530942
+
+/* ac_log2
+ * log2 without libm, which ncsh doesn't link. The exponent is counted, then log2 of what's left in [1, 2) comes from
+ * the series for atanh, which is accurate to about 1e-8 there.
+ * Returns: -DBL_MAX for 0, so a word without a weight ranks below every other, and DBL_MAX for infinity.
+ */
+static double ac_log2(double x)
+{
+    if (!(x > 0)) {
+        return -DBL_MAX;
+    }
+    if (x > DBL_MAX) {
+        return DBL_MAX;
+    }
+    double exponent = 0;
+    while (x >= 2) {
+        x /= 2;
+        ++exponent;
+    }
+    while (x < 1) {
+        x *= 2;
+        --exponent;
+    }
+
+    // ln(x) = 2 * atanh(s), where s = (x - 1) / (x + 1) is at most 1/3
+    double s = (x - 1) / (x + 1);
+    double s2 = s * s;
+    double atanh = s * (1 + s2 * (1.0 / 3 + s2 * (1.0 / 5 + s2 * (1.0 / 7 + s2 * (1.0 / 9 + s2 * (1.0 / 11 + s2 / 13))))));
+    return exponent + 2 * atanh / AC_LN2;
+}
+
+/* ac_key
+ * Words are ranked by weight * 2^(-(now - last_used) / half_life). Which of two words scores higher doesn't depend on
+ * now, so comparing log2 of the score at the epoch instead lets best be precomputed and stay right as time passes.
+ * Returns: log2 of the word's score at the epoch.
+ */
+static inline double ac_key(Autocompletion_Node* restrict node)
+{
+    return ac_log2(node->weight) + node->last_used / ac_frecency.half_life;
+}
+
 Autocompletion_Node* ac_alloc(Arena* restrict arena)
 {
     Autocompletion_Node* tree = arena_malloc(arena, 1, Autocompletion_Node);
@@ -21,35 +89,205 @@ Autocompletion_Node* ac_alloc(Arena* restrict arena)
     return tree;
 }
 
-void ac_add(char* restrict string, size_t length, Autocompletion_Node* restrict tree, Arena* restrict arena)
+Autocompletion_Node* ac_child(Autocompletion_Node* restrict node, char character)
 {
-    assert(string && length && tree && arena);
+    char* key = node->children_count ? memchr(node->keys, character, node->children_count) : NULL;
+    return key ? node->children[key - node->keys] : NULL;
+}
+
+/* ac_child_add
+ * Add child to node, keeping children sorted by the first character of their edge.
+ */
+static void ac_child_add(Autocompletion_Node* restrict node, Autocompletion_Node* restrict child, Arena* restrict arena)
+{
+    if (node->children_count == node->children_cap) {
+        uint8_t new_cap = node->children_cap ? (uint8_t)(node->children_cap * 2) : 1;
+        if (!node->children_cap) {
+            node->keys = arena_malloc(arena, new_cap, char);
+            node->children = arena_malloc(arena, new_cap, Autocompletion_Node*);
+        }
+        else {
+            node->keys = arena_realloc(arena, new_cap, char, node->keys, node->children_cap);
+            node->children =
+                arena_realloc(arena, new_cap, Autocompletion_Node*, node->children, node->children_cap);
+        }
+        node->children_cap = new_cap;
+    }
+
+    uint8_t pos = node->children_count;
+    while (pos && node->keys[pos - 1] > child->edge[0]) {
+        node->keys[pos] = node->keys[pos - 1];
+        node->children[pos] = node->children[pos - 1];
+        --pos;
+    }
+    node->keys[pos] = child->edge[0];
+    node->children[pos] = child;
+    ++node->children_count;
+}
+
+/* ac_outranks
+ * Returns: true if word a scores higher than word b. The logs are only needed when both the counts and times differ.
+ */
+static inline bool ac_outranks(Autocompletion_Node* restrict a, Autocompletion_Node* restrict b)
+{
+    if (a->last_used == b->last_used) {
+        return a->weight > b->weight;
+    }
+    if (a->weight == b->weight) {
+        return a->last_used > b->last_used;
+    }
+    return ac_key(a) > ac_key(b);
+}
+
+/* ac_best
+ * Returns: the higher scoring of the two words, a when they are tied, or whichever isn't NULL.
+ */
+static inline Autocompletion_Node* ac_best(Autocompletion_Node* a, Autocompletion_Node* b)
+{
+    if (!a || (b && ac_outranks(b, a))) {
+        return b;
+    }
+    return a;
+}
+
+/* ac_split
+ * Split the edge into child after len characters: child is replaced by a new node with the first len characters of
+ * the edge, which has child with the rest of the edge as its only child.
+ * Returns: the new node.
+ */
+static Autocompletion_Node* ac_split(Autocompletion_Node* restrict node, Autocompletion_Node* restrict child,
+                                     uint16_t len, Arena* restrict arena)
+{
+    Autocompletion_Node* mid = arena_malloc(arena, 1, Autocompletion_Node);
+    mid->edge = child->edge;
+    mid->edge_len = len;
+#ifdef  NCSH_AC_CHARACTER_WEIGHTING
+    mid->weight = child->weight;
+#else
+    mid->weight = 1;
+#endif  /* NCSH_AC_CHARACTER_WEIGHTING */
+
+    child->edge += len;
+    child->edge_len = (uint16_t)(child->edge_len - len);
+    ac_child_add(mid, child, arena);
+    mid->parent = node;
+    child->parent = mid;
+    mid->best = ac_best(child->is_end_of_a_word ? child : NULL, child->best);
+
+    char* key = memchr(node->keys, mid->edge[0], node->children_count);
+    assert(key);
+    node->children[key - node->keys] = mid;
+    return mid;
+}
+
+static inline void ac_weight_increment(Autocompletion_Node* restrict node)
+{
+    if (node->weight < UINT16_MAX) {
+        ++node->weight;
+    }
+}
+
+/* ac_printable
+ * Copies the printable characters of string, which is length long including the null terminator, into value.
+ * Returns: the number of characters copied, 0 if there's nothing to add.
+ */
+static size_t ac_printable(char* restrict string, size_t length, char* restrict value)
+{
+    assert(string && length);
     if (!string || !length || length > NCSH_MAX_INPUT) {
-        return;
+        return 0;
     }
 
+    size_t len = 0;
     for (size_t i = 0; i < length - 1; ++i) { // string.length - 1 because it includes null terminator
         int index = char_to_index(string[i]);
         if (index < 0 || index > 96) {
             continue;
         }
+        value[len++] = string[i];
+    }
+    return len;
+}
 
-        if (!tree->nodes[index]) {
-            tree->nodes[index] = arena_malloc(arena, 1, Autocompletion_Node);
-            tree->nodes[index]->is_end_of_a_word = false;
-            tree->nodes[index]->weight = 1;
-            tree = tree->nodes[index];
-            continue;
+/* ac_insert
+ * Walks the trie for value, adding and splitting nodes as needed, and marks its last node as a word.
+ * Returns: the node of the word. Its count and when it was last used are left to the caller.
+ */
+static Autocompletion_Node* ac_insert(char* restrict value, size_t len, Autocompletion_Node* restrict tree,
+                                      Arena* restrict arena)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        Autocompletion_Node* child = ac_child(tree, value[pos]);
+        if (!child) {
+            child = arena_malloc(arena, 1, Autocompletion_Node);
+            child->edge = arena_malloc(arena, len - pos, char);
+            memcpy(child->edge, value + pos, len - pos);
+            child->edge_len = (uint16_t)(len - pos);
+            child->weight = 1;
+            child->parent = tree;
+            ac_child_add(tree, child, arena);
+            tree = child;
+            break;
+        }
+
+        uint16_t common = 1;
+        while (common < child->edge_len && pos + common < len && child->edge[common] == value[pos + common]) {
+            ++common;
+        }
+        if (common < child->edge_len) {
+            child = ac_split(tree, child, common, arena);
         }
 
 #ifdef  NCSH_AC_CHARACTER_WEIGHTING
-        ++tree->nodes[index]->weight;
-#endif  /* AC_CHARACTER_WEIGHTING */
-        tree = tree->nodes[index];
+        ac_weight_increment(child);
+#endif  /* NCSH_AC_CHARACTER_WEIGHTING */
+        tree = child;
+        pos += common;
     }
 
-    ++tree->weight;
     tree->is_end_of_a_word = true;
+    return tree;
+}
+
+/* ac_best_update
+ * The score of word changed, so the best words of its ancestors might have too.
+ */
+static void ac_best_update(Autocompletion_Node* restrict word)
+{
+    for (Autocompletion_Node* node = word; node->parent; node = node->parent) {
+        Autocompletion_Node* best = ac_best(node->is_end_of_a_word ? node : NULL, node->best);
+        node->parent->best = ac_best(node->parent->best, best);
+    }
+}
+
+void ac_add_at(char* restrict string, size_t length, time_t now, Autocompletion_Node* restrict tree,
+               Arena* restrict arena)
+{
+    assert(string && length && tree && arena);
+
+    // only printable characters are stored
+    char value[NCSH_MAX_INPUT];
+    size_t len = ac_printable(string, length, value);
+    if (!len) {
+        return;
+    }
+
+    Autocompletion_Node* word = ac_insert(value, len, tree, arena);
+    ac_weight_increment(word);
+    word->last_used = (uint32_t)now;
+
+    if (ac_frecency.age_every && ++tree->added >= ac_frecency.age_every) {
+        ac_age(tree, now, arena);
+        return;
+    }
+
+    ac_best_update(word);
+}
+
+void ac_add(char* restrict string, size_t length, Autocompletion_Node* restrict tree, Arena* restrict arena)
+{
+    ac_add_at(string, length, time(NULL), tree, arena);
 }
 
 void ac_add_multiple(Str* restrict strings, int count, Autocompletion_Node* restrict tree, Arena* restrict arena)
@@ -64,25 +302,124 @@ void ac_add_multiple(Str* restrict strings, int count, Autocompletion_Node* rest
     }
 }
 
-/* ac_find
+/* ac_age_node
+ * Ages the words under node, see ac_age, and recomputes best for it and every node under it.
+ * Returns: true if node has no words left under it, so it should be removed from its parent.
+ */
+static bool ac_age_node(Autocompletion_Node* restrict node, double prune_key, Arena* restrict arena)
+{
+    if (node->is_end_of_a_word) {
+        node->weight = (uint16_t)(node->weight - node->weight / 2); // rounded up, so words are only pruned by score
+        node->is_end_of_a_word = ac_key(node) >= prune_key;
+    }
+
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < node->children_count; ++i) {
+        if (!ac_age_node(node->children[i], prune_key, arena)) {
+            ++kept;
+        }
+        else {
+            node->children[i] = NULL;
+        }
+    }
+
+    // keys can be in a snapshot's read only mapping, so the children left are copied rather than moved
+    if (kept < node->children_count) {
+        char* keys = kept ? arena_malloc(arena, kept, char) : NULL;
+        Autocompletion_Node** children = kept ? arena_malloc(arena, kept, Autocompletion_Node*) : NULL;
+        uint8_t pos = 0;
+        for (uint8_t i = 0; i < node->children_count; ++i) {
+            if (node->children[i]) {
+                keys[pos] = node->keys[i];
+                children[pos++] = node->children[i];
+            }
+        }
+        node->keys = keys;
+        node->children = children;
+        node->children_count = node->children_cap = kept;
+    }
+
+    // the root's edge is empty, so it is never removed or merged
+    if (node->edge_len && !node->is_end_of_a_word) {
+        if (!node->children_count) {
+            return true;
+        }
+
+        // a node with one way forward and no word of its own is merged with its child
+        if (node->children_count == 1) {
+            Autocompletion_Node* child = node->children[0];
+            uint16_t edge_len = (uint16_t)(node->edge_len + child->edge_len);
+            char* edge = arena_malloc(arena, edge_len, char);
+            memcpy(edge, node->edge, node->edge_len);
+            memcpy(edge + node->edge_len, child->edge, child->edge_len);
+
+            Autocompletion_Node* parent = node->parent;
+            *node = *child;
+            node->edge = edge;
+            node->edge_len = edge_len;
+            node->parent = parent;
+            for (uint8_t i = 0; i < node->children_count; ++i) {
+                node->children[i]->parent = node;
+            }
+            return false;
+        }
+    }
+
+    node->best = NULL;
+    for (uint8_t i = 0; i < node->children_count; ++i) {
+        Autocompletion_Node* child = node->children[i];
+        node->best = ac_best(node->best, ac_best(child->is_end_of_a_word ? child : NULL, child->best));
+    }
+    return false;
+}
+
+void ac_age(Autocompletion_Node* restrict tree, time_t now, Arena* restrict arena)
+{
+    assert(tree && arena);
+
+    double prune_key = ac_frecency.prune_below > 0 ? ac_log2(ac_frecency.prune_below) + now / ac_frecency.half_life
+                                                   : -DBL_MAX;
+    tree->added = 0;
+    (void)ac_age_node(tree, prune_key, arena);
+}
+
+/* ac_find_pos
  * char* p: the prefix, Autocompletion_Node* restrict t: the trie
- * Walk the trie to find the prefix. Return null if prefix not found.
+ * Walk the trie to find the prefix, edge_pos is set to how far into the found node's edge the prefix ends.
+ * Returns: the node whose edge the prefix ends in, or NULL if prefix not found.
  */
-Autocompletion_Node* ac_find(char* restrict p, Autocompletion_Node* restrict t)
+static Autocompletion_Node* ac_find_pos(char* restrict p, Autocompletion_Node* restrict t, uint16_t* restrict edge_pos)
 {
+    *edge_pos = t ? t->edge_len : 0;
     while (p && *p) {
         if (!t)
             return NULL;
 
-        t = t->nodes[char_to_index(*p)];
+        t = ac_child(t, *p);
+        if (!t)
+            return NULL;
+
+        uint16_t i = 1;
         ++p;
+        while (i < t->edge_len && *p) {
+            if (t->edge[i] != *p)
+                return NULL;
+            ++i;
+            ++p;
+        }
+        *edge_pos = i;
     }
 
     return t;
 }
 
+Autocompletion_Node* ac_find(char* restrict p, Autocompletion_Node* restrict t)
+{
+    uint16_t edge_pos;
+    return ac_find_pos(p, t, &edge_pos);
+}
+
 // static slightly improved performance in benchmarks
-static size_t ac_str_pos;
 static uint8_t ac_match_pos;
 
 // not using static slightly improved performance in benchmarks
@@ -95,42 +432,52 @@ void ac_match(Autocompletion* restrict matches, Autocompletion_Node* restrict tr
         return;
     }
 
-    if (tree->is_end_of_a_word && *ac_buffer) {
+    if (tree->is_end_of_a_word && ac_buffer_len) {
         matches[ac_match_pos].value = arena_malloc(scratch, ac_buffer_len + 1, char);
         memcpy(matches[ac_match_pos].value, ac_buffer, ac_buffer_len);
         matches[ac_match_pos].value[ac_buffer_len] = '\0';
         matches[ac_match_pos].weight = tree->weight;
+        matches[ac_match_pos].last_used = tree->last_used;
         ++ac_match_pos;
     }
 
-    for (size_t i = 0; i < NCSH_LETTERS; ++i) {
-        if (!tree->nodes[i]) {
-            continue;
-        }
+    for (uint8_t i = 0; i < tree->children_count; ++i) {
+        Autocompletion_Node* child = tree->children[i];
+        memcpy(ac_buffer + ac_buffer_len, child->edge, child->edge_len);
+        ac_buffer_len += child->edge_len;
 
-        ac_buffer[ac_buffer_len] = index_to_char(i);
-        ++ac_buffer_len;
-
-        ac_match(matches, tree->nodes[i], scratch);
+        ac_match(matches, child, scratch);
 
         if (ac_match_pos + 1 >= NCSH_MAX_AUTOCOMPLETION_MATCHES) {
             return;
         }
 
-        if (matches[ac_match_pos].value) {
-            ++ac_match_pos;
-        }
+        ac_buffer_len -= child->edge_len;
+    }
+}
 
-        --ac_buffer_len;
+/* ac_edge_rest
+ * Copy what's left of node's edge after edge_pos into dest. The root has no edge, so nothing is copied for it.
+ * Returns: the number of characters copied
+ */
+static size_t ac_edge_rest(Autocompletion_Node* restrict node, uint16_t edge_pos, char* restrict dest)
+{
+    size_t len = (size_t)(node->edge_len - edge_pos);
+    if (len) {
+        memcpy(dest, node->edge + edge_pos, len);
     }
+    return len;
 }
 
-uint8_t ac_matches(Autocompletion* restrict matches, Autocompletion_Node* restrict prefix, Arena* restrict scratch)
+/* ac_matches
+ * Gets the matches under prefix, edge_pos is how far into the prefix node's edge the search ended,
+ * the rest of the edge is the start of every match.
+ */
+uint8_t ac_matches(Autocompletion* restrict matches, Autocompletion_Node* restrict prefix, uint16_t edge_pos,
+                   Arena* restrict scratch)
 {
-    ac_str_pos = 0;
     ac_match_pos = 0;
-    ac_buffer[0] = '\0';
-    ac_buffer_len = 0;
+    ac_buffer_len = ac_edge_rest(prefix, edge_pos, ac_buffer);
 
     ac_match(matches, prefix, scratch);
 
@@ -141,58 +488,532 @@ uint8_t ac_get(char* restrict search, Autocompletion* restrict matches, Autocomp
 {
     assert(search);
 
-    Autocompletion_Node* prefix = ac_find(search, tree);
+    uint16_t edge_pos;
+    Autocompletion_Node* prefix = ac_find_pos(search, tree, &edge_pos);
     if (!prefix)
         return 0;
 
-    uint8_t match_count = ac_matches(matches, prefix, &scratch);
+    uint8_t match_count = ac_matches(matches, prefix, edge_pos, &scratch);
     if (!match_count)
         return 0;
 
     return match_count;
 }
 
-uint8_t ac_first(char* restrict search, char* restrict match, Autocompletion_Node* restrict tree, Arena scratch)
+/* ac_first_at
+ * Rebuilds the best match for a search which ends in prefix's edge after edge_pos characters into match.
+ * Returns: 0 if no matches, 1 if any matches
+ */
+static uint8_t ac_first_at(Autocompletion_Node* restrict prefix, uint16_t edge_pos, char* restrict match)
+{
+    // the prefix's own node is only a match when search ends before the end of its edge
+    Autocompletion_Node* best = prefix->best;
+    if (edge_pos < prefix->edge_len && prefix->is_end_of_a_word && (!best || !ac_outranks(best, prefix)))
+        best = prefix;
+    if (!best)
+        return 0;
+
+    size_t len = (size_t)(prefix->edge_len - edge_pos);
+    for (Autocompletion_Node* node = best; node != prefix; node = node->parent) {
+        len += node->edge_len;
+    }
+    assert(len < NCSH_MAX_INPUT);
+
+    // the word is rebuilt from its last node back to the prefix
+    match[len] = '\0';
+    for (Autocompletion_Node* node = best; node != prefix; node = node->parent) {
+        len -= node->edge_len;
+        memcpy(match + len, node->edge, node->edge_len);
+    }
+    (void)ac_edge_rest(prefix, edge_pos, match);
+
+    return 1;
+}
+
+uint8_t ac_first(char* restrict search, char* restrict match, Autocompletion_Node* restrict tree)
 {
     assert(search);
 
-    Autocompletion_Node* prefix = ac_find(search, tree);
+    uint16_t edge_pos;
+    Autocompletion_Node* prefix = ac_find_pos(search, tree, &edge_pos);
     if (!prefix)
         return 0;
 
-    Autocompletion matches[NCSH_MAX_AUTOCOMPLETION_MATCHES] = {0};
-    uint8_t match_count = ac_matches(matches, prefix, &scratch);
-    if (!match_count)
-        return 0;
+    return ac_first_at(prefix, edge_pos, match);
+}
+
+void ac_cursor_init(Autocompletion_Cursor* restrict cursor, Autocompletion_Node* restrict tree, char* restrict match,
+                    Arena* restrict arena)
+{
+    assert(cursor && tree && match && arena);
+
+    *cursor = (Autocompletion_Cursor){
+        .match = match,
+        .search = arena_malloc(arena, NCSH_MAX_INPUT, char),
+        .positions = arena_malloc(arena, NCSH_MAX_INPUT + 1, Autocompletion_Position),
+        .tree = tree,
+    };
+    cursor->positions[0] = (Autocompletion_Position){.node = tree, .edge_pos = tree->edge_len};
+}
+
+void ac_cursor_reset(Autocompletion_Cursor* restrict cursor)
+{
+    assert(cursor);
 
-    Autocompletion potential_match = matches[0];
-    for (uint8_t i = 1; i < match_count; ++i) {
-        if (matches[i].weight > potential_match.weight) {
-            potential_match = matches[i];
+    cursor->len = 0;
+    cursor->cached = false;
+    cursor->positions[0] = (Autocompletion_Position){.node = cursor->tree, .edge_pos = cursor->tree->edge_len};
+}
+
+/* ac_cursor_step
+ * Returns: the position after walking character from position, node is NULL if there's no match.
+ */
+static inline Autocompletion_Position ac_cursor_step(Autocompletion_Position position, char character)
+{
+    Autocompletion_Node* node = position.node;
+    if (!node)
+        return position;
+
+    if (position.edge_pos < node->edge_len) {
+        if (node->edge[position.edge_pos] != character)
+            return (Autocompletion_Position){0};
+        return (Autocompletion_Position){.node = node, .edge_pos = (uint16_t)(position.edge_pos + 1)};
+    }
+
+    Autocompletion_Node* child = ac_child(node, character);
+    return (Autocompletion_Position){.node = child, .edge_pos = child ? 1 : 0};
+}
+
+uint8_t ac_cursor_first(Autocompletion_Cursor* restrict cursor, char* restrict search)
+{
+    assert(cursor && search);
+
+    // pop the positions for characters which changed, like when backspace is pressed
+    size_t same = 0;
+    while (same < cursor->len && search[same] == cursor->search[same]) {
+        ++same;
+    }
+    if (same == cursor->len && !search[same] && cursor->cached) {
+        return cursor->match_count;
+    }
+    cursor->len = same;
+
+    // then push positions for the characters typed since the last call
+    while (search[cursor->len]) {
+        if (cursor->len + 1 >= NCSH_MAX_INPUT) {
+            break;
         }
+        cursor->positions[cursor->len + 1] = ac_cursor_step(cursor->positions[cursor->len], search[cursor->len]);
+        cursor->search[cursor->len] = search[cursor->len];
+        ++cursor->len;
     }
 
-    memcpy(match, potential_match.value, NCSH_MAX_INPUT);
+    Autocompletion_Position position = cursor->positions[cursor->len];
+    cursor->match_count = position.node ? ac_first_at(position.node, position.edge_pos, cursor->match) : 0;
+    if (!cursor->match_count) {
+        cursor->match[0] = '\0';
+    }
+    cursor->cached = true;
+    return cursor->match_count;
+}
 
-    return 1;
+/* Snapshots
+ * A snapshot is the trie flattened into a file which can be mapped back in without walking any strings:
+ * a header, the nodes in breadth first order so the children of each node are next to each other,
+ * the first character of each node's edge (the keys of its parent), then every edge.
+ * Nodes refer to each other and to edges by index and offset, so the file doesn't depend on where it's mapped.
+ */
+#define AC_SNAPSHOT_MAGIC "NCSHAC4"
+
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t hash;
+} Autocompletion_History_Stamp;
+
+typedef struct {
+    char magic[8];
+    Autocompletion_History_Stamp history;
+    uint32_t nodes_count;
+    uint32_t edges_len;
+    uint16_t added; // the root's, so counts are halved on schedule across sessions
+    uint8_t reserved[6];
+    uint64_t checksum; // of everything after the header
+} Autocompletion_Snapshot_Header;
+
+typedef struct {
+    uint32_t edge; // offset into the edges
+    uint32_t first_child; // index of the first child, the rest follow it
+    uint32_t last_used;
+    uint16_t edge_len;
+    uint16_t weight;
+    uint8_t children_count;
+    uint8_t is_end_of_a_word;
+} Autocompletion_Snapshot_Node;
+
+#define AC_FNV_OFFSET 14695981039346656037UL
+#define AC_FNV_PRIME 1099511628211UL
+
+static uint64_t ac_checksum(unsigned char* restrict bytes, size_t len)
+{
+    uint64_t hash = AC_FNV_OFFSET;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= AC_FNV_PRIME;
+    }
+    return hash;
 }
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wsign-conversion"
-static Autocompletion_Node* dumpdot_node_root;
-void ac_dump_dot(FILE *sink, Autocompletion_Node *root)
+/* ac_history_stamp
+ * Gets the size and modification time of the history file, and its hash when hash is true.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+[[nodiscard]]
+static int ac_history_stamp(char* restrict history_path, Autocompletion_History_Stamp* restrict stamp, bool hash)
+{
+    int fd = open(history_path, O_RDONLY);
+    if (fd == -1) {
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    *stamp = (Autocompletion_History_Stamp){
+        .size = (uint64_t)st.st_size,
+        .mtime_sec = (int64_t)st.st_mtim.tv_sec,
+        .mtime_nsec = (int64_t)st.st_mtim.tv_nsec,
+        .hash = AC_FNV_OFFSET,
+    };
+    if (!hash || !st.st_size) {
+        close(fd);
+        return EXIT_SUCCESS;
+    }
+
+    unsigned char* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return EXIT_FAILURE;
+    }
+    stamp->hash = ac_checksum(map, (size_t)st.st_size);
+    munmap(map, (size_t)st.st_size);
+    return EXIT_SUCCESS;
+}
+
+[[nodiscard]]
+static int ac_snapshot_write(int fd, char* restrict buffer, size_t len)
+{
+    while (len) {
+        ssize_t bytes = write(fd, buffer, len);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return EXIT_FAILURE;
+        }
+        buffer += bytes;
+        len -= (size_t)bytes;
+    }
+    return EXIT_SUCCESS;
+}
+
+int ac_snapshot_save(Autocompletion_Node* restrict tree, char* restrict path, char* restrict history_path, Arena scratch)
+{
+    assert(tree && path && history_path);
+
+    Autocompletion_Snapshot_Header header = {.magic = AC_SNAPSHOT_MAGIC};
+    if (ac_history_stamp(history_path, &header.history, true) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    // breadth first, so each node's children are next to each other in the queue
+    size_t cap = 64;
+    size_t count = 1;
+    size_t edges_len = 0;
+    Autocompletion_Node** queue = arena_malloc(&scratch, cap, Autocompletion_Node*);
+    queue[0] = tree;
+    for (size_t i = 0; i < count; ++i) {
+        Autocompletion_Node* node = queue[i];
+        edges_len += node->edge_len;
+        if (count + node->children_count > cap) {
+            size_t new_cap = cap * 2 + node->children_count;
+            queue = arena_realloc(&scratch, new_cap, Autocompletion_Node*, queue, cap);
+            cap = new_cap;
+        }
+        if (node->children_count) {
+            memcpy(queue + count, node->children, node->children_count * sizeof(Autocompletion_Node*));
+            count += node->children_count;
+        }
+    }
+    if (count > UINT32_MAX || edges_len > UINT32_MAX) {
+        return EXIT_FAILURE;
+    }
+    header.nodes_count = (uint32_t)count;
+    header.edges_len = (uint32_t)edges_len;
+    header.added = tree->added;
+
+    size_t len = sizeof(header) + count * sizeof(Autocompletion_Snapshot_Node) + count + edges_len;
+    char* buffer = arena_malloc(&scratch, len, char);
+    Autocompletion_Snapshot_Node* nodes = (Autocompletion_Snapshot_Node*)(void*)(buffer + sizeof(header));
+    char* keys = (char*)(nodes + count);
+    char* edges = keys + count;
+
+    uint32_t edge = 0;
+    uint32_t first_child = 1;
+    for (size_t i = 0; i < count; ++i) {
+        Autocompletion_Node* node = queue[i];
+        nodes[i] = (Autocompletion_Snapshot_Node){
+            .edge = edge,
+            .first_child = first_child,
+            .last_used = node->last_used,
+            .edge_len = node->edge_len,
+            .weight = node->weight,
+            .children_count = node->children_count,
+            .is_end_of_a_word = node->is_end_of_a_word,
+        };
+        if (node->edge_len) {
+            keys[i] = node->edge[0];
+            memcpy(edges + edge, node->edge, node->edge_len);
+            edge += node->edge_len;
+        }
+        first_child += node->children_count;
+    }
+    header.checksum = ac_checksum((unsigned char*)nodes, len - sizeof(header));
+    memcpy(buffer, &header, sizeof(header));
+
+    // written to a temporary file then renamed, so a running shell which mapped the old snapshot keeps it intact
+    size_t path_len = strlen(path);
+    char* tmp_path = arena_malloc(&scratch, path_len + sizeof(".tmp"), char);
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        return EXIT_FAILURE;
+    }
+    int rv = ac_snapshot_write(fd, buffer, len);
+    if (close(fd) || rv != EXIT_SUCCESS || rename(tmp_path, path)) {
+        unlink(tmp_path);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* ac_snapshot_fresh
+ * Returns: true if the history file is the same as when the snapshot was saved.
+ * The hash is only checked when the modification time changed, like when the history was saved again unchanged.
+ */
+[[nodiscard]]
+static bool ac_snapshot_fresh(Autocompletion_History_Stamp* restrict saved, char* restrict history_path)
+{
+    Autocompletion_History_Stamp stamp;
+    if (ac_history_stamp(history_path, &stamp, false) != EXIT_SUCCESS || stamp.size != saved->size) {
+        return false;
+    }
+    if (stamp.mtime_sec == saved->mtime_sec && stamp.mtime_nsec == saved->mtime_nsec) {
+        return true;
+    }
+    return ac_history_stamp(history_path, &stamp, true) == EXIT_SUCCESS && stamp.hash == saved->hash;
+}
+
+/* ac_snapshot_map
+ * Maps the snapshot at path and checks its header, size, and checksum, but not whether the history changed since.
+ * Returns: the header at the start of the mapping, which is len long, or NULL if there's no valid snapshot.
+ */
+[[nodiscard]]
+static Autocompletion_Snapshot_Header* ac_snapshot_map(char* restrict path, size_t* restrict len)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(Autocompletion_Snapshot_Header)) {
+        close(fd);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    char* map = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    Autocompletion_Snapshot_Header* header = (Autocompletion_Snapshot_Header*)(void*)map;
+    size_t count = header->nodes_count;
+    if (memcmp(header->magic, AC_SNAPSHOT_MAGIC, sizeof(AC_SNAPSHOT_MAGIC)) || !count ||
+        *len != sizeof(*header) + count * sizeof(Autocompletion_Snapshot_Node) + count + header->edges_len ||
+        header->checksum != ac_checksum((unsigned char*)(header + 1), *len - sizeof(*header))) {
+        munmap(map, *len);
+        return NULL;
+    }
+    return header;
+}
+
+Autocompletion_Node* ac_snapshot_load(char* restrict path, char* restrict history_path, Arena* restrict arena)
+{
+    assert(path && history_path && arena);
+
+    size_t len;
+    Autocompletion_Snapshot_Header* header = ac_snapshot_map(path, &len);
+    if (!header) {
+        return NULL;
+    }
+    char* map = (char*)header;
+    if (!ac_snapshot_fresh(&header->history, history_path)) {
+        munmap(map, len);
+        return NULL;
+    }
+    size_t count = header->nodes_count;
+
+    Autocompletion_Snapshot_Node* snapshot_nodes = (Autocompletion_Snapshot_Node*)(void*)(header + 1);
+    char* keys = (char*)(snapshot_nodes + count);
+    char* edges = keys + count;
+
+    // edges and keys are used from the mapping, which is never written to: splitting an edge only moves pointers,
+    // and children_cap is children_count, so the first child added copies the keys into the arena
+    Arena arena_save = *arena;
+    Autocompletion_Node* nodes = arena_malloc(arena, count, Autocompletion_Node);
+    Autocompletion_Node** children = arena_malloc(arena, count, Autocompletion_Node*);
+    size_t next_child = 1;
+    for (size_t i = 0; i < count; ++i) {
+        Autocompletion_Snapshot_Node* snapshot_node = snapshot_nodes + i;
+        // children must follow their parents in order and each node must have one parent, so the nodes are a tree.
+        // only the root has no edge, and words have a weight, which ac_key takes the log of
+        if ((size_t)snapshot_node->edge + snapshot_node->edge_len > header->edges_len ||
+            (!i && snapshot_node->edge_len) ||
+            (i && (!snapshot_node->edge_len || keys[i] != edges[snapshot_node->edge])) ||
+            snapshot_node->is_end_of_a_word > 1 || (snapshot_node->is_end_of_a_word && !snapshot_node->weight) ||
+            (snapshot_node->children_count && snapshot_node->first_child != next_child) ||
+            next_child + snapshot_node->children_count > count) {
+            *arena = arena_save;
+            munmap(map, len);
+            return NULL;
+        }
+
+        Autocompletion_Node* node = nodes + i;
+        node->is_end_of_a_word = snapshot_node->is_end_of_a_word;
+        node->weight = snapshot_node->weight;
+        node->last_used = snapshot_node->last_used;
+        node->edge = edges + snapshot_node->edge;
+        node->edge_len = snapshot_node->edge_len;
+        node->children_count = node->children_cap = snapshot_node->children_count;
+        node->keys = keys + next_child;
+        node->children = children + next_child;
+        for (size_t j = next_child; j < next_child + snapshot_node->children_count; ++j) {
+            children[j] = nodes + j;
+            nodes[j].parent = node;
+        }
+        next_child += snapshot_node->children_count;
+    }
+    if (next_child != count) {
+        *arena = arena_save;
+        munmap(map, len);
+        return NULL;
+    }
+    nodes->added = header->added;
+
+    // every node comes after its parent, so going backwards each node's best is done before it's passed up.
+    // ties go to the word first in lexical order.
+    for (size_t i = count - 1; i > 0; --i) {
+        Autocompletion_Node* node = nodes + i;
+        Autocompletion_Node* best = ac_best(node->is_end_of_a_word ? node : NULL, node->best);
+        node->parent->best = ac_best(best, node->parent->best);
+    }
+
+    return nodes;
+}
+
+/* ac_snapshot_find
+ * Walks the nodes of a mapped snapshot for the word value, which is len characters long.
+ * The nodes aren't trusted to form a tree, only to be inside the mapping.
+ * Returns: the snapshot node of the word, or NULL if it isn't a word in the snapshot.
+ */
+[[nodiscard]]
+static Autocompletion_Snapshot_Node* ac_snapshot_find(Autocompletion_Snapshot_Header* restrict header,
+                                                      char* restrict value, size_t len)
+{
+    size_t count = header->nodes_count;
+    Autocompletion_Snapshot_Node* nodes = (Autocompletion_Snapshot_Node*)(void*)(header + 1);
+    char* keys = (char*)(nodes + count);
+    char* edges = keys + count;
+
+    Autocompletion_Snapshot_Node* node = nodes;
+    size_t pos = 0;
+    while (pos < len) {
+        if ((size_t)node->first_child + node->children_count > count) {
+            return NULL;
+        }
+        Autocompletion_Snapshot_Node* child = NULL;
+        for (size_t i = node->first_child; i < (size_t)node->first_child + node->children_count; ++i) {
+            if (keys[i] == value[pos]) {
+                child = nodes + i;
+                break;
+            }
+        }
+        if (!child || !child->edge_len || child->edge_len > len - pos ||
+            (size_t)child->edge + child->edge_len > header->edges_len ||
+            memcmp(edges + child->edge, value + pos, child->edge_len)) {
+            return NULL;
+        }
+        pos += child->edge_len;
+        node = child;
+    }
+    return node->is_end_of_a_word ? node : NULL;
+}
+
+Autocompletion_Node* ac_rebuild(Str* restrict lines, size_t count, char* restrict snapshot_path, time_t now,
+                                Arena* restrict arena)
 {
-    size_t index = root - dumpdot_node_root;
-    for (size_t i = 0; i < NCSH_LETTERS; ++i) {
-        if (root->nodes[i] != NULL) {
-            size_t child_index = root->nodes[i] - dumpdot_node_root;
-            fprintf(sink, "    Node_%zu [label=\"%c\"]\n", child_index, index_to_char(i));
-            fprintf(sink, "    Node_%zu -> Node_%zu [label=\"%c\"]\n", index, child_index, index_to_char(i));
-            ac_dump_dot(sink, root->nodes[i]);
+    assert(arena);
+
+    Autocompletion_Node* tree = ac_alloc(arena);
+    size_t len = 0;
+    Autocompletion_Snapshot_Header* header = snapshot_path ? ac_snapshot_map(snapshot_path, &len) : NULL;
+    if (header) {
+        tree->added = header->added;
+    }
+
+    char value[NCSH_MAX_INPUT];
+    for (size_t i = 0; i < count; ++i) {
+        size_t value_len = ac_printable(lines[i].value, lines[i].length, value);
+        if (!value_len) {
+            continue;
+        }
+
+        Autocompletion_Node* word = ac_insert(value, value_len, tree, arena);
+        Autocompletion_Snapshot_Node* saved = header ? ac_snapshot_find(header, value, value_len) : NULL;
+        if (saved && saved->weight) {
+            // the history doesn't record when or how often it was used, the snapshot does
+            word->weight = saved->weight;
+            word->last_used = saved->last_used;
+        }
+        else {
+            // oldest line first, so a second apart keeps the order they were used in
+            ac_weight_increment(word);
+            word->last_used = (uint32_t)(now - (time_t)(count - 1 - i));
         }
+        ac_best_update(word);
+    }
+
+    if (header) {
+        munmap(header, len);
+    }
+    return tree;
+}
+
+void ac_dump_dot(FILE *sink, Autocompletion_Node *root)
+{
+    for (uint8_t i = 0; i < root->children_count; ++i) {
+        Autocompletion_Node* child = root->children[i];
+        fprintf(sink, "    Node_%p [label=\"%.*s\"]\n", (void*)child, (int)child->edge_len, child->edge);
+        fprintf(sink, "    Node_%p -> Node_%p [label=\"%c\"]\n", (void*)root, (void*)child, child->edge[0]);
+        ac_dump_dot(sink, child);
     }
 }
-#pragma GCC diagnostic pop
 
 void ac_export_dot(Autocompletion_Node* restrict tree, char* restrict file_path)
 {
@@ -202,7 +1023,6 @@ void ac_export_dot(Autocompletion_Node* restrict tree, char* restrict file_path)
         return;
     }
 
-    dumpdot_node_root = tree;
     printf("[INFO] Starting export of dot file to %s\n", file_path);
 
     fprintf(file, "digraph Trie {\n");
@@ -5,19 +5,36 @@
 
 #pragma once
 
+#include <time.h>
+
 #include "../arena.h"
 #include "../eskilib/str.h"
 
 #define NCSH_LETTERS 96 // ascii printable characters 32-127
 
-/*  struct Autocompletion_Nodes
- *  Prefix tree (trie) for storing autocomplete possibilities
- *  Use stack for nodes, slightly faster than allocating on heap in benchmarks.
+/*  struct Autocompletion_Node
+ *  Radix trie (path compressed prefix trie) for storing autocomplete possibilities.
+ *  Each node holds the label of the edge leading into it, so a run of characters with only one way forward
+ *  is a single node instead of one node per character.
+ *  Children are sparse: keys holds the first character of each child's edge, sorted, so matches come out in
+ *  lexical order and a child is found by scanning a few bytes.
+ *  best is the highest scoring word strictly below the node, kept up to date by ac_add, so the best completion of a
+ *  prefix is found without visiting the rest of the subtree. parent is used to rebuild words from their last node.
+ *  Words are scored by frecency, see Autocompletion_Frecency.
  */
 typedef struct Autocompletion_Node_ {
     bool is_end_of_a_word;
-    uint16_t weight;
-    struct Autocompletion_Node_* nodes[NCSH_LETTERS];
+    uint8_t children_count;
+    uint8_t children_cap;
+    uint16_t weight; // times the word was used
+    uint16_t edge_len;
+    uint32_t last_used; // seconds since the epoch
+    uint16_t added; // only used in the root, the number of words added since counts were last halved
+    char* edge; // not null terminated
+    char* keys;
+    struct Autocompletion_Node_** children;
+    struct Autocompletion_Node_* parent;
+    struct Autocompletion_Node_* best;
 } Autocompletion_Node;
 
 /* struct Autocompletion
@@ -25,9 +42,49 @@ typedef struct Autocompletion_Node_ {
  */
 typedef struct {
     uint16_t weight;
+    uint32_t last_used;
     char* value;
 } Autocompletion;
 
+/* struct Autocompletion_Frecency
+ * How words are ranked. A word's score is the number of times it was used, halved for every half_life seconds since
+ * it was last used, like z's z_score but decaying smoothly instead of in steps.
+ * Every age_every words added, every count is halved and words scoring below prune_below are removed,
+ * so counts can't overflow and words which stopped being used don't stay in the trie forever.
+ */
+typedef struct {
+    double half_life;
+    uint16_t age_every; // 0 to never halve counts
+    double prune_below;
+} Autocompletion_Frecency;
+
+// counts are at most twice age_every between halvings
+#define AC_AGE_EVERY_MAX (UINT16_MAX / 2)
+
+/* struct Autocompletion_Position
+ * Where a search ends in the trie: in node's edge, after edge_pos characters of it. node is NULL if there's no match.
+ */
+typedef struct {
+    Autocompletion_Node* node;
+    uint16_t edge_pos;
+} Autocompletion_Position;
+
+/* struct Autocompletion_Cursor
+ * Incremental ac_first for a line being typed. positions is a stack of where each prefix of search ends in the trie,
+ * so typing a character walks one step from the top of the stack and deleting one pops it.
+ * The result is cached in match until search changes.
+ * The positions point into the trie, so the cursor must be reset with ac_cursor_reset when words are added.
+ */
+typedef struct {
+    size_t len; // characters of search the positions are for
+    bool cached; // match and match_count are the result for search
+    uint8_t match_count;
+    char* match;
+    char* search;
+    Autocompletion_Position* positions;
+    Autocompletion_Node* tree;
+} Autocompletion_Cursor;
+
 static inline int char_to_index(char character)
 {
     return (int)character - ' ';
@@ -43,10 +100,50 @@ static inline char index_to_char(int index)
  */
 Autocompletion_Node* ac_alloc(Arena* restrict arena);
 
+/* ac_frecency_set
+ * Set how words are ranked, for every trie. Words already in a trie are reranked when it is aged or loaded.
+ */
+void ac_frecency_set(Autocompletion_Frecency frecency);
+
+/* ac_add_at
+ * Add the string to the trie as used at now, seconds since the epoch. Ages the trie every age_every words.
+ */
+void ac_add_at(char* restrict string, size_t length, time_t now, Autocompletion_Node* restrict tree,
+               Arena* restrict arena);
+
+/* ac_add
+ * Add the string to the trie as used now.
+ */
 void ac_add(char* restrict string, size_t length, Autocompletion_Node* restrict tree, Arena* restrict arena);
 
 void ac_add_multiple(Str* restrict strings, int count, Autocompletion_Node* restrict tree, Arena* restrict arena);
 
+/* ac_rebuild
+ * Builds the trie from the lines of the history, oldest first, without aging it part way through.
+ * Words in the snapshot at snapshot_path keep their count and the time they were last used, even though the snapshot
+ * itself can't be loaded once the history changed. The rest are stamped a second apart ending at now, so they keep
+ * the order they were used in. snapshot_path can be NULL.
+ * Returns: the root of the trie
+ */
+Autocompletion_Node* ac_rebuild(Str* restrict lines, size_t count, char* restrict snapshot_path, time_t now,
+                                Arena* restrict arena);
+
+/* ac_age
+ * Halve every count in the trie and remove the words which score below the frecency's prune_below at now.
+ * Nodes left without words are removed and edges are merged back together, so the trie stays compressed.
+ * Called by ac_add every age_every words.
+ */
+void ac_age(Autocompletion_Node* restrict tree, time_t now, Arena* restrict arena);
+
+/* ac_child
+ * Returns: the child of node whose edge starts with character, or NULL if there isn't one.
+ */
+Autocompletion_Node* ac_child(Autocompletion_Node* restrict node, char character);
+
+/* ac_find
+ * Walk the trie to find the prefix.
+ * Returns: the node whose edge the prefix ends in, or NULL if prefix not found.
+ */
 Autocompletion_Node* ac_find(char* restrict str, Autocompletion_Node* restrict tree);
 
 /* ac_get
@@ -57,8 +154,42 @@ Autocompletion_Node* ac_find(char* restrict str, Autocompletion_Node* restrict t
 uint8_t ac_get(char* restrict search, Autocompletion* restrict matches, Autocompletion_Node* restrict tree, Arena scratch);
 
 /* ac_first
- * Gets highest weighted match based on traversing the tree.
- * Populates match into variable match
+ * Gets the highest scoring match out of every word starting with search, by walking the prefix and rebuilding the
+ * precomputed best word of its subtree. When scores are tied, the word which reached the score first is used.
+ * Populates match into variable match, which has room for NCSH_MAX_INPUT characters.
+ * Returns: 0 if no matches, 1 if any matches
+ */
+uint8_t ac_first(char* restrict search, char* restrict match, Autocompletion_Node* restrict tree);
+
+/* ac_cursor_init
+ * Allocates the cursor's stacks using the passed in arena. Results are written to match, which has room for
+ * NCSH_MAX_INPUT characters.
+ */
+void ac_cursor_init(Autocompletion_Cursor* restrict cursor, Autocompletion_Node* restrict tree, char* restrict match,
+                    Arena* restrict arena);
+
+/* ac_cursor_reset
+ * Forget the positions and cached result, needed after words are added to the trie or the cursor's tree is replaced.
+ */
+void ac_cursor_reset(Autocompletion_Cursor* restrict cursor);
+
+/* ac_cursor_first
+ * Same as ac_first, but only walks the characters of search which changed since the last call.
+ * Populates match into the cursor's match.
  * Returns: 0 if no matches, 1 if any matches
  */
-uint8_t ac_first(char* restrict search, char* restrict match, Autocompletion_Node* restrict tree, Arena scratch);
+uint8_t ac_cursor_first(Autocompletion_Cursor* restrict cursor, char* restrict search);
+
+/* ac_snapshot_save
+ * Saves the trie to path as a snapshot that ac_snapshot_load can map back in, stamped with the size,
+ * modification time, and hash of the history file so it isn't loaded once the history changes.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int ac_snapshot_save(Autocompletion_Node* restrict tree, char* restrict path, char* restrict history_path, Arena scratch);
+
+/* ac_snapshot_load
+ * Maps the snapshot at path and builds the trie from it without walking any strings.
+ * The edges stay in the mapping, which is never unmapped.
+ * Returns: the root of the trie, or NULL if there's no snapshot, it is invalid, or the history file changed since.
+ */
+Autocompletion_Node* ac_snapshot_load(char* restrict path, char* restrict history_path, Arena* restrict arena);
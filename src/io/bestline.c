@@ -257,7 +257,7 @@ static struct bestlineRing ring;
 static struct sigaction orig_cont;
 static struct sigaction orig_winch;
 static struct termios orig_termios;
-static char *bl_history[BESTLINE_MAX_HISTORY];
+static char **bl_history;
 static bestlineXlatCallback *xlatCallback;
 static bestlineHintsCallback *hintsCallback;
 static bestlineFreeHintsCallback *freeHintsCallback;
@@ -2324,6 +2324,549 @@ static ssize_t bestlineCompleteLine(struct bestlineState *ls, char *seq, int siz
     return nread;
 }
 
+/*
+ * History is a ring of lines, oldest first starting at bl_history_head,
+ * so adding a line to a full history evicts the oldest one in O(1)
+ * instead of moving every line down. The ring is allocated on the first
+ * add, with room for bl_history_max lines, which can be changed at
+ * runtime with bestlineHistorySetMaxLen(), plus the line being edited.
+ *
+ * Lines are kept in slabs carved into blocks of power of two sizes, with
+ * a free list per size, so adding and evicting lines doesn't go through
+ * malloc and free. Each block starts with the index of its size class.
+ * Lines too long for the largest class are malloc'd on their own.
+ *
+ * Every line pushed gets the next id, kept in a second ring alongside
+ * the lines, so ids only ever go up from the oldest line to the newest.
+ * CTRL-R searches go through an index of the trigrams of each line to
+ * the ids of the lines with it, built on the first search and kept up
+ * to date as lines are added and evicted after that. A line has every
+ * trigram of the query if it contains it, so only the lines on all of
+ * the query's lists are searched, instead of every line of the history.
+ *
+ * In erase dups mode, adding a line that's already in the history moves
+ * it to the newest instead of adding it again, found through a hash of
+ * the line to its id instead of comparing it to every line.
+ */
+#define BESTLINE_HISTORY_SLAB 65536
+#define BESTLINE_HISTORY_CLASS_MIN 4 /* 16 byte blocks */
+#define BESTLINE_HISTORY_CLASSES 9 /* up to 4096 byte blocks */
+#define BESTLINE_HISTORY_MALLOCED 255
+#define BESTLINE_TRIGRAMS_MIN 1024
+#define BESTLINE_TRIGRAMS_PER_QUERY 16
+#define BESTLINE_DUPS_MIN 1024
+
+struct bestlineHistorySlab {
+    struct bestlineHistorySlab *next;
+};
+
+/* Ids of the lines with a trigram, ascending. Ids before start were
+ * evicted. Lines which changed since they were added can still be on
+ * the list, so whatever is found through it has to be checked. */
+struct bestlineTrigram {
+    unsigned key; /* the three bytes, 0 when the bucket is empty */
+    unsigned start;
+    unsigned len;
+    unsigned cap;
+    unsigned *ids;
+};
+
+/* With erase dups, each line's hash to its id, so the line a command
+ * was ran as before is found without going through the history. */
+struct bestlineHistoryDup {
+    unsigned hash;
+    unsigned id; /* plus one, 0 when the bucket is empty */
+};
+
+static unsigned bl_history_max = BESTLINE_MAX_HISTORY;
+static unsigned bl_history_cap;
+static unsigned bl_history_head;
+static unsigned *bl_history_ids;
+static unsigned bl_history_serial;
+static char *bl_history_free[BESTLINE_HISTORY_CLASSES];
+static struct bestlineHistorySlab *bl_history_slabs;
+static char *bl_history_bump;
+static char *bl_history_bump_end;
+static struct bestlineTrigram *bl_trigrams;
+static unsigned bl_trigrams_cap;
+static unsigned bl_trigrams_count;
+static struct bestlineHistoryDup *bl_dups;
+static unsigned bl_dups_cap;
+static unsigned bl_dups_count;
+
+static char **bestlineHistorySlot(unsigned i) {
+    unsigned j = bl_history_head + i; /* both are less than INT_MAX */
+    return bl_history + (j >= bl_history_cap ? j - bl_history_cap : j);
+}
+
+static unsigned *bestlineHistoryId(unsigned i) {
+    unsigned j = bl_history_head + i;
+    return bl_history_ids + (j >= bl_history_cap ? j - bl_history_cap : j);
+}
+
+static void bestlineHistoryBlockFree(char *b, unsigned c) {
+    memcpy(b, &bl_history_free[c], sizeof(char *));
+    bl_history_free[c] = b;
+}
+
+static char *bestlineHistoryBlock(unsigned c) {
+    char *b;
+    size_t size, rest;
+    unsigned k;
+    struct bestlineHistorySlab *s;
+    if ((b = bl_history_free[c])) {
+        memcpy(&bl_history_free[c], b, sizeof(char *));
+        return b;
+    }
+    size = (size_t)1 << (c + BESTLINE_HISTORY_CLASS_MIN);
+    if ((size_t)(bl_history_bump_end - bl_history_bump) < size) {
+        /* hand what's left of the slab to the smaller classes */
+        for (k = c; k--;) {
+            rest = (size_t)1 << (k + BESTLINE_HISTORY_CLASS_MIN);
+            if ((size_t)(bl_history_bump_end - bl_history_bump) >= rest) {
+                bestlineHistoryBlockFree(bl_history_bump, k);
+                bl_history_bump += rest;
+            }
+        }
+        if (!(s = (struct bestlineHistorySlab *)malloc(BESTLINE_HISTORY_SLAB)))
+            return 0;
+        s->next = bl_history_slabs;
+        bl_history_slabs = s;
+        bl_history_bump = (char *)s + (1 << BESTLINE_HISTORY_CLASS_MIN);
+        bl_history_bump_end = (char *)s + BESTLINE_HISTORY_SLAB;
+    }
+    b = bl_history_bump;
+    bl_history_bump += size;
+    return b;
+}
+
+static char *bestlineHistoryCopy(const char *p, size_t n) {
+    char *b;
+    unsigned c;
+    for (c = 0; c < BESTLINE_HISTORY_CLASSES; ++c) {
+        if (n + 2 <= (size_t)1 << (c + BESTLINE_HISTORY_CLASS_MIN))
+            break;
+    }
+    if (c < BESTLINE_HISTORY_CLASSES) {
+        if (!(b = bestlineHistoryBlock(c)))
+            return 0;
+        b[0] = (char)c;
+    } else {
+        if (!(b = (char *)malloc(n + 2)))
+            return 0;
+        b[0] = (char)BESTLINE_HISTORY_MALLOCED;
+    }
+    memcpy(b + 1, p, n);
+    b[n + 1] = 0;
+    return b + 1;
+}
+
+static void bestlineHistoryRelease(char *line) {
+    unsigned c;
+    if (!line)
+        return;
+    c = (unsigned char)line[-1];
+    if (c == BESTLINE_HISTORY_MALLOCED) {
+        free(line - 1);
+    } else {
+        bestlineHistoryBlockFree(line - 1, c);
+    }
+}
+
+static unsigned bestlineTrigramKey(const char *p) {
+    return (unsigned)(p[0] & 255) | (unsigned)(p[1] & 255) << 8 | (unsigned)(p[2] & 255) << 16;
+}
+
+static struct bestlineTrigram *bestlineTrigramBucket(struct bestlineTrigram *t, unsigned cap, unsigned key) {
+    unsigned h = key * 0x9e3779b1u;
+    for (h ^= h >> 15;; ++h) {
+        if (!t[h & (cap - 1)].key || t[h & (cap - 1)].key == key)
+            return t + (h & (cap - 1));
+    }
+}
+
+static struct bestlineTrigram *bestlineTrigramFind(unsigned key) {
+    struct bestlineTrigram *t;
+    if (!bl_trigrams)
+        return 0;
+    t = bestlineTrigramBucket(bl_trigrams, bl_trigrams_cap, key);
+    return t->key && t->start < t->len ? t : 0;
+}
+
+static void bestlineTrigramsFree(void) {
+    unsigned i;
+    for (i = 0; i < bl_trigrams_cap; ++i)
+        free(bl_trigrams[i].ids);
+    free(bl_trigrams);
+    bl_trigrams = 0;
+    bl_trigrams_cap = bl_trigrams_count = 0;
+}
+
+/* Adds id to the list of the trigram at p, keeping it ascending. */
+static int bestlineTrigramAdd(const char *p, unsigned id) {
+    unsigned i, lo, hi, cap, key;
+    unsigned *ids;
+    struct bestlineTrigram *t, *u;
+    key = bestlineTrigramKey(p);
+    t = bestlineTrigramBucket(bl_trigrams, bl_trigrams_cap, key);
+    if (!t->key) {
+        if ((bl_trigrams_count + 1) * 2 > bl_trigrams_cap) {
+            cap = bl_trigrams_cap * 2;
+            if (!(u = (struct bestlineTrigram *)calloc(cap, sizeof(*u))))
+                return 0;
+            for (i = 0; i < bl_trigrams_cap; ++i) {
+                if (bl_trigrams[i].key)
+                    *bestlineTrigramBucket(u, cap, bl_trigrams[i].key) = bl_trigrams[i];
+            }
+            free(bl_trigrams);
+            bl_trigrams = u;
+            bl_trigrams_cap = cap;
+            t = bestlineTrigramBucket(bl_trigrams, bl_trigrams_cap, key);
+        }
+        t->key = key;
+        ++bl_trigrams_count;
+    }
+    /* lines are nearly always added newest, so this is nearly always an append */
+    lo = t->start;
+    hi = t->len;
+    if (lo < hi && t->ids[hi - 1] >= id) {
+        while (lo < hi) {
+            i = lo + (hi - lo) / 2;
+            if (t->ids[i] < id)
+                lo = i + 1;
+            else
+                hi = i;
+        }
+        if (t->ids[lo] == id)
+            return 1;
+    } else {
+        lo = hi;
+    }
+    if (t->start && t->start >= t->len / 2) {
+        memmove(t->ids, t->ids + t->start, (t->len - t->start) * sizeof(unsigned));
+        t->len -= t->start;
+        lo -= t->start;
+        t->start = 0;
+    }
+    if (t->len == t->cap) {
+        cap = t->cap ? t->cap * 2 : 4;
+        if (!(ids = (unsigned *)realloc(t->ids, cap * sizeof(unsigned))))
+            return 0;
+        t->ids = ids;
+        t->cap = cap;
+    }
+    memmove(t->ids + lo + 1, t->ids + lo, (t->len - lo) * sizeof(unsigned));
+    t->ids[lo] = id;
+    ++t->len;
+    return 1;
+}
+
+/* Adds the n characters at p to the index as the line with id. When
+ * there isn't the memory for it, the index is thrown away, and built
+ * again by the next search. */
+static void bestlineHistoryIndex(const char *p, size_t n, unsigned id) {
+    size_t i;
+    if (!bl_trigrams)
+        return;
+    for (i = 0; i + 2 < n; ++i) {
+        if (!bestlineTrigramAdd(p + i, id)) {
+            bestlineTrigramsFree();
+            return;
+        }
+    }
+}
+
+/* Takes the oldest line, with id, out of the index, before it's evicted. */
+static void bestlineHistoryUnindex(const char *p, unsigned id) {
+    size_t i, n;
+    struct bestlineTrigram *t;
+    if (!bl_trigrams)
+        return;
+    for (n = strlen(p), i = 0; i + 2 < n; ++i) {
+        if ((t = bestlineTrigramFind(bestlineTrigramKey(p + i)))) {
+            while (t->start < t->len && t->ids[t->start] <= id)
+                ++t->start;
+            if (t->start == t->len)
+                t->start = t->len = 0;
+        }
+    }
+}
+
+static int bestlineHistoryIndexBuild(void) {
+    unsigned i;
+    char *line;
+    if (bl_trigrams)
+        return 1;
+    if (!(bl_trigrams = (struct bestlineTrigram *)calloc(BESTLINE_TRIGRAMS_MIN, sizeof(*bl_trigrams))))
+        return 0;
+    bl_trigrams_cap = BESTLINE_TRIGRAMS_MIN;
+    for (i = 0; i < historylen && bl_trigrams; ++i) {
+        line = *bestlineHistorySlot(i);
+        bestlineHistoryIndex(line, strlen(line), *bestlineHistoryId(i));
+    }
+    return bl_trigrams != 0;
+}
+
+/* Moves id down to the biggest id on the list that's no bigger than it.
+ * Returns 0 if there isn't one. */
+static int bestlineTrigramFloor(const struct bestlineTrigram *t, unsigned *id) {
+    unsigned i, lo, hi;
+    lo = t->start;
+    hi = t->len;
+    while (lo < hi) {
+        i = lo + (hi - lo) / 2;
+        if (t->ids[i] <= *id)
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    if (lo == t->start)
+        return 0;
+    *id = t->ids[lo - 1];
+    return 1;
+}
+
+/* Finds the first of the lines i, i + 1, ... counting back from the
+ * newest that could contain the n characters at q, going by the index,
+ * so CTRL-R skips the lines that can't. Queries too short to have a
+ * trigram have to look at every line, so get i back.
+ *
+ * @return the line to look at next, or historylen if none can match */
+static unsigned bestlineHistoryNext(unsigned i, const char *q, size_t n) {
+    struct bestlineTrigram *t[BESTLINE_TRIGRAMS_PER_QUERY];
+    unsigned k, m, agree, id, e, lo, hi, mid;
+    if (i >= historylen || n < 3 || !bestlineHistoryIndexBuild())
+        return i;
+    for (m = 0; m < BESTLINE_TRIGRAMS_PER_QUERY && m + 2 < n; ++m) {
+        if (!(t[m] = bestlineTrigramFind(bestlineTrigramKey(q + m))))
+            return historylen;
+    }
+    /* step down the lists in turn until they all agree on an id */
+    id = *bestlineHistoryId(historylen - 1 - i);
+    for (agree = k = 0; agree < m; k = (k + 1) % m) {
+        e = id;
+        if (!bestlineTrigramFloor(t[k], &e))
+            return historylen;
+        if (e == id) {
+            ++agree;
+        } else {
+            id = e;
+            agree = 1;
+        }
+    }
+    /* the newest line with an id no bigger, if that line was deleted */
+    lo = 0;
+    hi = historylen - i;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (*bestlineHistoryId(mid) <= id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return historylen - lo;
+}
+
+/* Finds the line with id by its place in the ring of ids.
+ *
+ * @return the line, oldest first, or historylen if it's not there */
+static unsigned bestlineHistoryLine(unsigned id) {
+    unsigned lo, hi, mid;
+    lo = 0;
+    hi = historylen;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (*bestlineHistoryId(mid) < id)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo < historylen && *bestlineHistoryId(lo) == id ? lo : historylen;
+}
+
+static unsigned bestlineHistoryHash(const char *p, size_t n) {
+    size_t i;
+    unsigned h = 2166136261u; /* FNV-1a */
+    for (i = 0; i < n; ++i)
+        h = (h ^ (unsigned char)p[i]) * 16777619u;
+    return h;
+}
+
+static void bestlineHistoryDupsFree(void) {
+    free(bl_dups);
+    bl_dups = 0;
+    bl_dups_cap = bl_dups_count = 0;
+}
+
+/* Adds the line with id to the dups table, whose memory can run out
+ * when it grows, in which case erase dups stops erasing them. */
+static void bestlineHistoryDupAdd(const char *p, size_t n, unsigned id) {
+    unsigned i, cap, h;
+    struct bestlineHistoryDup *d;
+    if (!bl_dups)
+        return;
+    if ((bl_dups_count + 1) * 2 > bl_dups_cap) {
+        cap = bl_dups_cap * 2;
+        if (!(d = (struct bestlineHistoryDup *)calloc(cap, sizeof(*d)))) {
+            bestlineHistoryDupsFree();
+            return;
+        }
+        for (i = 0; i < bl_dups_cap; ++i) {
+            if (bl_dups[i].id) {
+                for (h = bl_dups[i].hash; d[h & (cap - 1)].id; ++h) {
+                }
+                d[h & (cap - 1)] = bl_dups[i];
+            }
+        }
+        free(bl_dups);
+        bl_dups = d;
+        bl_dups_cap = cap;
+    }
+    for (h = i = bestlineHistoryHash(p, n); bl_dups[i & (bl_dups_cap - 1)].id; ++i) {
+    }
+    bl_dups[i & (bl_dups_cap - 1)].hash = h;
+    bl_dups[i & (bl_dups_cap - 1)].id = id + 1;
+    ++bl_dups_count;
+}
+
+/* Takes the line with id out of the dups table, moving the entries
+ * after it back so lookups don't need tombstones. */
+static void bestlineHistoryDupRemove(const char *p, unsigned id) {
+    unsigned i, j, k, mask;
+    if (!bl_dups)
+        return;
+    mask = bl_dups_cap - 1;
+    for (i = bestlineHistoryHash(p, strlen(p)) & mask; bl_dups[i].id != id + 1; i = (i + 1) & mask) {
+        if (!bl_dups[i].id)
+            return;
+    }
+    for (j = i;;) {
+        j = (j + 1) & mask;
+        if (!bl_dups[j].id)
+            break;
+        k = bl_dups[j].hash & mask;
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+            bl_dups[i] = bl_dups[j];
+            i = j;
+        }
+    }
+    bl_dups[i].id = 0;
+    --bl_dups_count;
+}
+
+/* Finds the n characters at p in the history through the dups table.
+ *
+ * @return the line, oldest first, or historylen if it's not there */
+static unsigned bestlineHistoryDupFind(const char *p, size_t n) {
+    char *line;
+    unsigned i, h, k;
+    if (!bl_dups)
+        return historylen;
+    h = bestlineHistoryHash(p, n);
+    for (i = h;; ++i) {
+        if (!bl_dups[i & (bl_dups_cap - 1)].id)
+            return historylen;
+        if (bl_dups[i & (bl_dups_cap - 1)].hash == h &&
+            (k = bestlineHistoryLine(bl_dups[i & (bl_dups_cap - 1)].id - 1)) < historylen) {
+            line = *bestlineHistorySlot(k);
+            if (!memcmp(line, p, n) && !line[n])
+                return k;
+        }
+    }
+}
+
+static int bestlineHistoryDupsAlloc(void) {
+    bestlineHistoryDupsFree();
+    if (!(bl_dups = (struct bestlineHistoryDup *)calloc(BESTLINE_DUPS_MIN, sizeof(*bl_dups))))
+        return -1;
+    bl_dups_cap = BESTLINE_DUPS_MIN;
+    return 0;
+}
+
+static void bestlineHistoryDupsBuild(void) {
+    unsigned i;
+    char *line;
+    if (bestlineHistoryDupsAlloc())
+        return;
+    for (i = 0; i < historylen && bl_dups; ++i) {
+        line = *bestlineHistorySlot(i);
+        bestlineHistoryDupAdd(line, strlen(line), *bestlineHistoryId(i));
+    }
+}
+
+/* Gives the lines new ids from zero, before the ids run out. */
+static void bestlineHistoryRenumber(void) {
+    unsigned i;
+    bestlineTrigramsFree();
+    for (i = 0; i < historylen; ++i)
+        *bestlineHistoryId(i) = i;
+    bl_history_serial = historylen;
+    if (bl_dups)
+        bestlineHistoryDupsBuild();
+}
+
+/* Adds a copy of the n characters at p as the newest line, evicting the
+ * oldest line when the history already has max lines. */
+static char *bestlineHistoryPush(const char *p, size_t n, unsigned max) {
+    char *line;
+    if (!max)
+        return 0;
+    if (!bl_history) {
+        if (!(bl_history = (char **)calloc(bl_history_max + 1, sizeof(char *))))
+            return 0;
+        if (!(bl_history_ids = (unsigned *)calloc(bl_history_max + 1, sizeof(unsigned)))) {
+            free(bl_history);
+            bl_history = 0;
+            return 0;
+        }
+        bl_history_cap = bl_history_max + 1;
+        bl_history_head = 0;
+    }
+    if (!(line = bestlineHistoryCopy(p, n)))
+        return 0;
+    if (historylen >= max) {
+        bestlineHistoryUnindex(bl_history[bl_history_head], bl_history_ids[bl_history_head]);
+        bestlineHistoryDupRemove(bl_history[bl_history_head], bl_history_ids[bl_history_head]);
+        bestlineHistoryRelease(bl_history[bl_history_head]);
+        bl_history[bl_history_head] = 0;
+        if (++bl_history_head == bl_history_cap)
+            bl_history_head = 0;
+        --historylen;
+    }
+    if (bl_history_serial == UINT_MAX)
+        bestlineHistoryRenumber();
+    *bestlineHistoryId(historylen) = bl_history_serial;
+    bestlineHistoryDupAdd(line, n, bl_history_serial);
+    bestlineHistoryIndex(line, n, bl_history_serial++);
+    *bestlineHistorySlot(historylen++) = line;
+    return line;
+}
+
+static void bestlineHistoryPop(void) {
+    char **slot;
+    if (!historylen)
+        return;
+    slot = bestlineHistorySlot(--historylen);
+    bestlineHistoryDupRemove(*slot, *bestlineHistoryId(historylen));
+    bestlineHistoryRelease(*slot);
+    *slot = 0;
+}
+
+static void bestlineHistoryReplace(unsigned i, const char *p) {
+    char *line;
+    size_t n = strlen(p);
+    char **slot = bestlineHistorySlot(i);
+    if (!strcmp(*slot, p))
+        return;
+    if ((line = bestlineHistoryCopy(p, n))) {
+        bestlineHistoryDupRemove(*slot, *bestlineHistoryId(i));
+        bestlineHistoryRelease(*slot);
+        *slot = line;
+        bestlineHistoryDupAdd(line, n, *bestlineHistoryId(i));
+        bestlineHistoryIndex(line, n, *bestlineHistoryId(i));
+    }
+}
+
 static void bestlineEditHistoryGoto(struct bestlineState *l, unsigned i) {
     size_t n;
     if (historylen <= 1)
@@ -2331,13 +2874,12 @@ static void bestlineEditHistoryGoto(struct bestlineState *l, unsigned i) {
     if (i > historylen - 1)
         return;
     i = Max(Min(i, historylen - 1), 0);
-    free(bl_history[historylen - 1 - l->hindex]);
-    bl_history[historylen - 1 - l->hindex] = strdup(l->buf);
+    bestlineHistoryReplace(historylen - 1 - l->hindex, l->buf);
     l->hindex = i;
-    n = strlen(bl_history[historylen - 1 - l->hindex]);
+    n = strlen(*bestlineHistorySlot(historylen - 1 - l->hindex));
     bestlineGrow(l, n + 1);
     n = Min(n, l->buflen - 1);
-    memcpy(l->buf, bl_history[historylen - 1 - l->hindex], n);
+    memcpy(l->buf, *bestlineHistorySlot(historylen - 1 - l->hindex), n);
     l->buf[n] = 0;
     l->len = l->pos = n;
     bestlineRefreshLine(l);
@@ -2394,7 +2936,7 @@ static int bestlineSearch(struct bestlineState *l, char *seq, int size) {
                     --j;
                 } else if (i + 1 < historylen) {
                     ++i;
-                    j = strlen(bl_history[historylen - 1 - i]);
+                    j = strlen(*bestlineHistorySlot(historylen - 1 - i));
                 }
             } else if (seq[0] == Ctrl('G')) {
                 bestlineEditHistoryGoto(l, oldindex);
@@ -2412,7 +2954,7 @@ static int bestlineSearch(struct bestlineState *l, char *seq, int size) {
         }
         isstale = 0;
         while (i < historylen) {
-            p = bl_history[historylen - 1 - i];
+            p = *bestlineHistorySlot(historylen - 1 - i);
             k = strlen(p);
             if (!isstale) {
                 j = Min(k, j + ab.len);
@@ -2431,7 +2973,7 @@ static int bestlineSearch(struct bestlineState *l, char *seq, int size) {
                 break;
             } else {
                 isstale = 1;
-                ++i;
+                i = bestlineHistoryNext(i + 1, ab.b, ab.len);
             }
         }
     }
@@ -3386,7 +3928,7 @@ static ssize_t bestlineEdit(int stdin_fd, int stdout_fd, const char *prompt, con
     l.prompt = promptlastnl ? promptlastnl + 1 : promptnotnull;
     l.ws = GetTerminalSize(l.ws, l.ifd, l.ofd);
     abInit(&l.full);
-    bestlineHistoryAdd("");
+    bestlineHistoryPush("", 0, bl_history_max + 1); /* the line being edited */
     bestlineWriteChars(l.ofd, promptnotnull);
     init = init ? init : "";
     bestlineEditInsert(&l, init, strlen(init));
@@ -3412,10 +3954,7 @@ static ssize_t bestlineEdit(int stdin_fd, int stdout_fd, const char *prompt, con
             seq[0] = '\r';
             seq[1] = 0;
         } else {
-            if (historylen) {
-                free(bl_history[--historylen]);
-                bl_history[historylen] = 0;
-            }
+            bestlineHistoryPop();
             free(l.buf);
             abFree(&l.full);
             return -1;
@@ -3465,10 +4004,7 @@ static ssize_t bestlineEdit(int stdin_fd, int stdout_fd, const char *prompt, con
             if (l.len) {
                 bestlineEditDelete(&l);
             } else {
-                if (historylen) {
-                    free(bl_history[--historylen]);
-                    bl_history[historylen] = 0;
-                }
+                bestlineHistoryPop();
                 free(l.buf);
                 abFree(&l.full);
                 return -1;
@@ -3491,10 +4027,7 @@ static ssize_t bestlineEdit(int stdin_fd, int stdout_fd, const char *prompt, con
         case '\r': {
             char is_finished = 1;
             char needs_strip = 0;
-            if (historylen) {
-                free(bl_history[--historylen]);
-                bl_history[historylen] = 0;
-            }
+            bestlineHistoryPop();
             l.final = 1;
             bestlineEditEnd(&l);
             bestlineRefreshLineForce(&l);
@@ -3656,14 +4189,31 @@ void bestlineFree(void *ptr) {
 }
 
 void bestlineHistoryFree(void) {
-    size_t i;
-    for (i = 0; i < BESTLINE_MAX_HISTORY; i++) {
-        if (bl_history[i]) {
-            free(bl_history[i]);
-            bl_history[i] = 0;
-        }
+    unsigned i;
+    char *line;
+    struct bestlineHistorySlab *s;
+    for (i = 0; i < historylen; i++) {
+        line = *bestlineHistorySlot(i);
+        if (line && (unsigned char)line[-1] == BESTLINE_HISTORY_MALLOCED)
+            free(line - 1);
+    }
+    while ((s = bl_history_slabs)) {
+        bl_history_slabs = s->next;
+        free(s);
     }
+    memset(bl_history_free, 0, sizeof(bl_history_free));
+    bl_history_bump = bl_history_bump_end = 0;
+    free(bl_history);
+    free(bl_history_ids);
+    bl_history = 0;
+    bl_history_ids = 0;
+    bl_history_cap = bl_history_head = 0;
     historylen = 0;
+    bestlineTrigramsFree();
+    if (bl_dups) {
+        memset(bl_dups, 0, bl_dups_cap * sizeof(*bl_dups));
+        bl_dups_count = 0;
+    }
 }
 
 static void bestlineAtExit(void) {
@@ -3672,21 +4222,89 @@ static void bestlineAtExit(void) {
     bestlineRingFree();
 }
 
+/**
+ * Adds line to the history as the newest line, unless it's the newest
+ * line already. With erase dups, the line it was ran as before is moved
+ * to the newest instead.
+ *
+ * @return 1 if it was added or moved, otherwise 0
+ */
 int bestlineHistoryAdd(const char *line) {
-    char *linecopy;
-    if (!BESTLINE_MAX_HISTORY)
-        return 0;
-    if (historylen && !strcmp(bl_history[historylen - 1], line))
+    size_t n;
+    if (historylen && !strcmp(*bestlineHistorySlot(historylen - 1), line))
         return 0;
-    if (!(linecopy = strdup(line)))
+    n = strlen(line);
+    bestlineHistoryDelete(bestlineHistoryDupFind(line, n));
+    return bestlineHistoryPush(line, n, bl_history_max) ? 1 : 0;
+}
+
+/**
+ * Turns erase dups on or off. While it's on, lines added that are
+ * already in the history move to the newest instead of being added
+ * again, and turning it on erases the duplicates already there,
+ * keeping the newest of each.
+ *
+ * @return 0 on success, or -1 if there isn't the memory for it
+ */
+int bestlineHistorySetEraseDups(int on) {
+    unsigned i;
+    char *line;
+    if (!on) {
+        bestlineHistoryDupsFree();
         return 0;
-    if (historylen == BESTLINE_MAX_HISTORY) {
-        free(bl_history[0]);
-        memmove(bl_history, bl_history + 1, sizeof(char *) * (BESTLINE_MAX_HISTORY - 1));
-        historylen--;
     }
-    bl_history[historylen++] = linecopy;
-    return 1;
+    if (bestlineHistoryDupsAlloc())
+        return -1;
+    /* newest first, deleting a line only moves the lines newer than it, which are done */
+    for (i = historylen; i-- && bl_dups;) {
+        line = *bestlineHistorySlot(i);
+        if (bestlineHistoryDupFind(line, strlen(line)) < historylen)
+            bestlineHistoryDelete(i);
+        else
+            bestlineHistoryDupAdd(line, strlen(line), *bestlineHistoryId(i));
+    }
+    return bl_dups ? 0 : -1;
+}
+
+/**
+ * Sets how many lines the history holds, evicting the oldest lines when
+ * it already holds more than that.
+ *
+ * @return 0 on success, or -1 w/ errno
+ */
+int bestlineHistorySetMaxLen(unsigned n) {
+    char **h;
+    unsigned i;
+    unsigned *ids;
+    n = Min(n, INT_MAX - 1);
+    if (bl_history) {
+        if (!(h = (char **)calloc(n + 1, sizeof(char *))))
+            return -1;
+        if (!(ids = (unsigned *)calloc(n + 1, sizeof(unsigned)))) {
+            free(h);
+            return -1;
+        }
+        while (historylen > n) {
+            bestlineHistoryUnindex(bl_history[bl_history_head], bl_history_ids[bl_history_head]);
+            bestlineHistoryDupRemove(bl_history[bl_history_head], bl_history_ids[bl_history_head]);
+            bestlineHistoryRelease(bl_history[bl_history_head]);
+            if (++bl_history_head == bl_history_cap)
+                bl_history_head = 0;
+            --historylen;
+        }
+        for (i = 0; i < historylen; ++i) {
+            h[i] = *bestlineHistorySlot(i);
+            ids[i] = *bestlineHistoryId(i);
+        }
+        free(bl_history);
+        free(bl_history_ids);
+        bl_history = h;
+        bl_history_ids = ids;
+        bl_history_cap = n + 1;
+        bl_history_head = 0;
+    }
+    bl_history_max = n;
+    return 0;
 }
 
 /**
@@ -3705,7 +4323,7 @@ int bestlineHistorySave(const char *filename) {
         return -1;
     chmod(filename, S_IRUSR | S_IWUSR);
     for (j = 0; j < historylen; j++) {
-        fputs(bl_history[j], fp);
+        fputs(*bestlineHistorySlot(j), fp);
         fputc('\n', fp);
     }
     fclose(fp);
@@ -3724,12 +4342,12 @@ int bestlineHistorySave(const char *filename) {
 int bestlineHistoryLoad(const char *filename) {
     char **h;
     int rc, fd, err;
-    size_t i, j, k, n, t;
+    size_t i, j, k, n, t, max;
     char *m, *e, *p, *q, *f, *s;
     err = errno, rc = 0;
-    if (!BESTLINE_MAX_HISTORY)
+    if (!(max = bl_history_max))
         return 0;
-    if (!(h = (char **)calloc(2 * BESTLINE_MAX_HISTORY, sizeof(char *))))
+    if (!(h = (char **)calloc(2 * max, sizeof(char *))))
         return -1;
     assert(filename);
     if ((fd = open(filename, O_RDONLY)) != -1) {
@@ -3745,18 +4363,16 @@ int bestlineHistoryLoad(const char *filename) {
                     if (q > p) {
                         h[i * 2 + 0] = p;
                         h[i * 2 + 1] = q;
-                        i = (i + 1) % BESTLINE_MAX_HISTORY;
+                        i = (i + 1) % max;
                     }
                 }
                 bestlineHistoryFree();
-                for (j = 0; j < BESTLINE_MAX_HISTORY; ++j) {
-                    if (h[(k = (i + j) % BESTLINE_MAX_HISTORY) * 2]) {
-                        if ((s = (char *)malloc((t = h[k * 2 + 1] - h[k * 2]) + 1))) {
-                            memcpy(s, h[k * 2], t), s[t] = 0;
-                            if (onHistoryLoadedCallback)
-                                onHistoryLoadedCallback(s, t + 1);
-                            bl_history[historylen++] = s;
-                        }
+                for (j = 0; j < max; ++j) {
+                    if (h[(k = (i + j) % max) * 2]) {
+                        t = h[k * 2 + 1] - h[k * 2];
+                        bestlineHistoryDelete(bestlineHistoryDupFind(h[k * 2], t));
+                        if ((s = bestlineHistoryPush(h[k * 2], t, bl_history_max)) && onHistoryLoadedCallback)
+                            onHistoryLoadedCallback(s, t + 1);
                     }
                 }
                 munmap(m, n);
@@ -3777,7 +4393,7 @@ int bestlineHistoryLoad(const char *filename) {
 int bestlineHistoryPrint(int fd)
 {
     for (unsigned i = 0; i < historylen; ++i) {
-        bestlineWriteChars(fd, bl_history[i]);
+        bestlineWriteChars(fd, *bestlineHistorySlot(i));
         bestlineWrite(fd, "\n", 1);
     }
     return 0;
@@ -3788,27 +4404,84 @@ unsigned bestlineHistoryCount()
     return historylen;
 }
 
-void bestlineHistoryCountDecrement()
+/**
+ * Gets a line of the history, oldest first.
+ *
+ * @return the line, or null if i is past the newest line
+ */
+const char *bestlineHistoryGet(unsigned i)
+{
+    return i < historylen ? *bestlineHistorySlot(i) : 0;
+}
+
+/**
+ * Finds the newest line of the history older than line i (oldest first)
+ * that contains query, the same way CTRL-R does, so with bestlineHistoryCount()
+ * for i it finds the newest line that does.
+ *
+ * @return the line, or -1 if none of them contain it
+ */
+int bestlineHistoryFind(const char *query, unsigned i)
 {
-    --historylen;
+    char *p;
+    unsigned k;
+    size_t n = strlen(query);
+    k = bestlineHistoryNext(historylen - Min(i, historylen), query, n);
+    for (; k < historylen; k = bestlineHistoryNext(k + 1, query, n)) {
+        p = *bestlineHistorySlot(historylen - 1 - k);
+        if (FindSubstringReverse(p, strlen(p), query, n))
+            return (int)(historylen - 1 - k);
+    }
+    return -1;
 }
 
-char **bestlineHistory()
+/**
+ * Deletes a line of the history, oldest first. The lines on the shorter
+ * side of the ring move over to fill the gap.
+ *
+ * @return 0 on success, or -1 if i is past the newest line
+ */
+int bestlineHistoryDelete(unsigned i)
 {
-    return bl_history;
+    unsigned j;
+    if (i >= historylen)
+        return -1;
+    /* lines deleted from the middle stay on the index until evicted,
+       searches only go through it to lines still in the history */
+    if (!i)
+        bestlineHistoryUnindex(*bestlineHistorySlot(i), *bestlineHistoryId(i));
+    bestlineHistoryDupRemove(*bestlineHistorySlot(i), *bestlineHistoryId(i));
+    bestlineHistoryRelease(*bestlineHistorySlot(i));
+    if (i < historylen / 2) {
+        for (j = i; j > 0; --j) {
+            *bestlineHistorySlot(j) = *bestlineHistorySlot(j - 1);
+            *bestlineHistoryId(j) = *bestlineHistoryId(j - 1);
+        }
+        bl_history[bl_history_head] = 0;
+        if (++bl_history_head == bl_history_cap)
+            bl_history_head = 0;
+    } else {
+        for (j = i; j + 1 < historylen; ++j) {
+            *bestlineHistorySlot(j) = *bestlineHistorySlot(j + 1);
+            *bestlineHistoryId(j) = *bestlineHistoryId(j + 1);
+        }
+        *bestlineHistorySlot(historylen - 1) = 0;
+    }
+    --historylen;
+    return 0;
 }
 
 int bestlineHistoryClean()
 {
     if (historyCleanCallback)
-        historyCleanCallback(bl_history, historylen);
+        historyCleanCallback();
     return 0;
 }
 
 int bestlineHistoryRemove(const char * rm, int n)
 {
     if (historyRemoveCallback)
-        historyRemoveCallback(rm, n, bl_history, historylen);
+        historyRemoveCallback(rm, n);
     return 0;
 }
 
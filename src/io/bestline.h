@@ -3,6 +3,10 @@
 extern "C" {
 #endif
 
+#ifndef BESTLINE_MAX_HISTORY
+#define BESTLINE_MAX_HISTORY 1024
+#endif
+
 typedef struct bestlineCompletions {
     unsigned long len;
     char **cvec;
@@ -14,8 +18,8 @@ typedef char *(bestlineHintsCallback)(const char *, const char **, const char **
 typedef void(bestlineFreeHintsCallback)(void *);
 typedef unsigned(bestlineXlatCallback)(unsigned);
 typedef void(bestlineOnHistoryLoadedCallback(const char *, int));
-typedef void(bestlineHistoryCleanCallback(char **, unsigned));
-typedef void(bestlineHistoryRemoveCallback(const char *, int, char **, unsigned));
+typedef void(bestlineHistoryCleanCallback(void));
+typedef void(bestlineHistoryRemoveCallback(const char *, int));
 
 void bestlineSetCompletionCallback(bestlineCompletionCallback *);
 void bestlineSetHintsCallback(bestlineHintsCallback *);
@@ -36,8 +40,11 @@ int bestlineHistoryLoad(const char *);
 int bestlineHistorySave(const char *);
 int bestlineHistoryPrint(int fd);
 unsigned bestlineHistoryCount();
-void bestlineHistoryCountDecrement();
-char **bestlineHistory();
+const char *bestlineHistoryGet(unsigned);
+int bestlineHistoryFind(const char *, unsigned);
+int bestlineHistoryDelete(unsigned);
+int bestlineHistorySetMaxLen(unsigned);
+int bestlineHistorySetEraseDups(int);
 int bestlineHistoryClean();
 int bestlineHistoryRemove(const char *, int);
 void bestlineBalanceMode(char);
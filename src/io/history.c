@@ -0,0 +1,478 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* history.c: the history file as an append-only log shared by every running shell */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../defines.h" // used for macros like NCSH_HISTORY_APPEND_BATCH
+#include "../ttyio/ttyio.h"
+#include "bestline.h"
+#include "history.h"
+
+[[nodiscard]]
+int history_log_open(History_Log* restrict log, char* restrict path, History_Log_Callback* on_merged,
+                     Arena* restrict arena)
+{
+    assert(log); assert(path); assert(arena);
+
+    *log = (History_Log){0};
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        tty_perror("ncsh: could not open the history file");
+        return EXIT_FAILURE;
+    }
+
+    size_t path_len = strlen(path);
+    *log = (History_Log){
+        .fd = fd,
+        .path = path,
+        .tmp_path = arena_malloc(arena, path_len + sizeof(".tmp"), char),
+        .tail = arena_malloc(arena, HISTORY_LOG_TAIL_SIZE, char),
+        .pending = arena_malloc(arena, HISTORY_LOG_BUFFER_SIZE, char),
+        .buffer = arena_malloc(arena, HISTORY_LOG_BUFFER_SIZE, char),
+        .on_merged = on_merged,
+    };
+    memcpy(log->tmp_path, path, path_len);
+    memcpy(log->tmp_path + path_len, ".tmp", sizeof(".tmp"));
+    return EXIT_SUCCESS;
+}
+
+void history_log_unlock(History_Log* restrict log)
+{
+    assert(log); assert(log->path);
+
+    (void)flock(log->fd, LOCK_UN);
+}
+
+void history_log_seek(History_Log* restrict log, off_t offset)
+{
+    assert(log); assert(offset >= 0);
+    if (!log->path) {
+        return;
+    }
+
+    log->offset = offset;
+    log->seeked = true;
+    size_t len = offset < HISTORY_LOG_TAIL_SIZE ? (size_t)offset : HISTORY_LOG_TAIL_SIZE;
+    log->tail_len = pread(log->fd, log->tail, len, offset - (off_t)len) == (ssize_t)len ? len : 0;
+}
+
+int history_log_reload(History_Log* restrict log)
+{
+    assert(log); assert(log->path);
+
+    struct stat st;
+    if (fstat(log->fd, &st) || bestlineHistoryLoad(log->path)) {
+        return EXIT_FAILURE;
+    }
+    history_log_seek(log, st.st_size);
+    return EXIT_SUCCESS;
+}
+
+int history_log_load(History_Log* restrict log)
+{
+    assert(log);
+    if (!log->path || history_log_lock(log, LOCK_SH) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    int rv = history_log_reload(log);
+    history_log_unlock(log);
+    return rv;
+}
+
+/* history_log_compacted
+ * Returns: true if the history file was rewritten since the last merge, like when another shell compacted it.
+ */
+[[nodiscard]]
+static bool history_log_compacted(History_Log* restrict log, off_t size)
+{
+    if (size < log->offset) {
+        return true;
+    }
+    if (!log->tail_len) {
+        return false;
+    }
+
+    char tail[HISTORY_LOG_TAIL_SIZE];
+    return pread(log->fd, tail, log->tail_len, log->offset - (off_t)log->tail_len) != (ssize_t)log->tail_len ||
+           memcmp(tail, log->tail, log->tail_len);
+}
+
+/* history_log_merge_lines
+ * Add the complete lines in the first len bytes of the buffer to the history.
+ * Returns: the number of bytes used, lines which aren't complete are left for the next read.
+ */
+[[nodiscard]]
+static size_t history_log_merge_lines(History_Log* restrict log, size_t len, size_t* restrict count)
+{
+    char* start = log->buffer;
+    char* end = log->buffer + len;
+    char* newline;
+    while ((newline = memchr(start, '\n', (size_t)(end - start)))) {
+        char* line_end = newline;
+        while (line_end > start && line_end[-1] == '\r') {
+            --line_end;
+        }
+        *line_end = '\0';
+        if (line_end > start && bestlineHistoryAdd(start)) {
+            ++*count;
+            if (log->on_merged) {
+                log->on_merged(start, (int)(line_end - start) + 1);
+            }
+        }
+        start = newline + 1;
+    }
+    return (size_t)(start - log->buffer);
+}
+
+/* history_log_merge_to
+ * Merge the lines appended before size, for callers holding the lock.
+ * Returns: the number of lines merged
+ */
+static size_t history_log_merge_to(History_Log* restrict log, off_t size)
+{
+    if (!log->seeked || size <= log->offset) {
+        return 0;
+    }
+    if (history_log_compacted(log, size)) {
+        // rewritten in place by something other than a shell, what's left is older than what's already loaded
+        history_log_seek(log, size);
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t len = 0;
+    bool skipping = false; // lines too long for the buffer are skipped
+    while (log->offset + (off_t)len < size) {
+        size_t want = HISTORY_LOG_BUFFER_SIZE - len;
+        if ((off_t)want > size - log->offset - (off_t)len) {
+            want = (size_t)(size - log->offset - (off_t)len);
+        }
+        ssize_t bytes = pread(log->fd, log->buffer + len, want, log->offset + (off_t)len);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            break;
+        }
+        len += (size_t)bytes;
+
+        size_t skipped = 0;
+        if (skipping) {
+            char* newline = memchr(log->buffer, '\n', len);
+            skipped = newline ? (size_t)(newline - log->buffer) + 1 : len;
+            skipping = !newline;
+            memmove(log->buffer, log->buffer + skipped, len - skipped);
+            len -= skipped;
+        }
+
+        size_t used = history_log_merge_lines(log, len, &count);
+        memmove(log->buffer, log->buffer + used, len - used);
+        len -= used;
+        if (len == HISTORY_LOG_BUFFER_SIZE) {
+            skipping = true;
+            used += len;
+            len = 0;
+        }
+        log->offset += (off_t)(skipped + used);
+    }
+
+    history_log_seek(log, log->offset);
+    return count;
+}
+
+size_t history_log_merge_locked(History_Log* restrict log)
+{
+    assert(log);
+
+    struct stat st;
+    if (!log->path || fstat(log->fd, &st)) {
+        return 0;
+    }
+    return history_log_merge_to(log, st.st_size);
+}
+
+/* History_Log_Replaced
+ * Appended to a history file after it's replaced by history_log_replace, for the shells which still have it open.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t size; // the size of the history file when it was replaced, before this was appended
+    uint64_t ino; // the history file which replaced it
+    uint64_t offset; // where size is in the history file which replaced it
+} History_Log_Replaced;
+
+#define HISTORY_LOG_REPLACED_MAGIC "NCSHREPL"
+
+/* history_log_follow
+ * Switch to the history file which replaced the one this shell has open, for callers holding the lock on the old one.
+ * What was appended to the old one is merged, then tracking continues from where it ends in the new one.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+[[nodiscard]]
+static int history_log_follow(History_Log* restrict log)
+{
+    int fd = open(log->path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st)) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return EXIT_FAILURE;
+    }
+
+    History_Log_Replaced replaced = {0};
+    bool found = false;
+    struct stat old;
+    if (!fstat(log->fd, &old)) {
+        found = old.st_size >= (off_t)sizeof(replaced) &&
+                pread(log->fd, &replaced, sizeof(replaced), old.st_size - (off_t)sizeof(replaced)) ==
+                    (ssize_t)sizeof(replaced) &&
+                !memcmp(replaced.magic, HISTORY_LOG_REPLACED_MAGIC, sizeof(replaced.magic)) &&
+                replaced.size == (uint64_t)old.st_size - sizeof(replaced);
+        (void)history_log_merge_to(log, found ? (off_t)replaced.size : old.st_size);
+    }
+
+    // closing the old file releases its lock
+    close(log->fd);
+    log->fd = fd;
+    if (log->seeked) {
+        // replaced more than once since, where the old file ends in this one isn't known
+        bool followed = found && replaced.ino == (uint64_t)st.st_ino && replaced.offset <= (uint64_t)st.st_size;
+        history_log_seek(log, followed ? (off_t)replaced.offset : st.st_size);
+    }
+    return EXIT_SUCCESS;
+}
+
+int history_log_lock(History_Log* restrict log, int operation)
+{
+    assert(log); assert(log->path);
+
+    while (true) {
+        while (flock(log->fd, operation) == -1) {
+            if (errno != EINTR) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        // other shells replace the history file when they compact or clean it, locking it then follows it
+        struct stat st;
+        struct stat path_st;
+        if (stat(log->path, &path_st) || fstat(log->fd, &st) ||
+            (st.st_ino == path_st.st_ino && st.st_dev == path_st.st_dev)) {
+            return EXIT_SUCCESS;
+        }
+        if (history_log_follow(log) != EXIT_SUCCESS) {
+            history_log_unlock(log);
+            return EXIT_FAILURE;
+        }
+    }
+}
+
+size_t history_log_merge(History_Log* restrict log)
+{
+    assert(log);
+
+    struct stat st;
+    if (!log->path || !log->seeked || fstat(log->fd, &st) || st.st_size == log->offset) {
+        return 0;
+    }
+    if (history_log_lock(log, LOCK_SH) != EXIT_SUCCESS) {
+        return 0;
+    }
+    size_t count = history_log_merge_locked(log);
+    history_log_unlock(log);
+    return count;
+}
+
+/* history_log_write
+ * Write all len bytes of buffer to fd.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+[[nodiscard]]
+static int history_log_write(int fd, const char* restrict buffer, size_t len)
+{
+    size_t written = 0;
+    while (written < len) {
+        ssize_t bytes = write(fd, buffer + written, len - written);
+        if (bytes == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return EXIT_FAILURE;
+        }
+        written += (size_t)bytes;
+    }
+    return EXIT_SUCCESS;
+}
+
+int history_log_flush(History_Log* restrict log)
+{
+    assert(log);
+    if (!log->path || !log->pending_len) {
+        return EXIT_SUCCESS;
+    }
+    if (history_log_lock(log, LOCK_EX) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    // what other shells appended goes before this shell's lines, so it's merged first
+    history_log_merge_locked(log);
+
+    int rv = history_log_write(log->fd, log->pending, log->pending_len);
+    if (rv == EXIT_FAILURE) {
+        tty_perror("ncsh: could not append to the history file");
+    }
+#ifdef NCSH_HISTORY_FSYNC
+    if (rv == EXIT_SUCCESS && fdatasync(log->fd)) {
+        tty_perror("ncsh: could not sync the history file");
+        rv = EXIT_FAILURE;
+    }
+#endif /* NCSH_HISTORY_FSYNC */
+
+    // the lines just written are already in the history
+    struct stat st;
+    if (log->seeked && !fstat(log->fd, &st)) {
+        history_log_seek(log, st.st_size);
+    }
+    log->pending_len = 0;
+    log->pending_count = 0;
+
+    history_log_unlock(log);
+    return rv;
+}
+
+void history_log_add(History_Log* restrict log, Str line)
+{
+    assert(log);
+    if (!log->path || line.length <= 1 || line.length > HISTORY_LOG_BUFFER_SIZE) {
+        return;
+    }
+
+    if (log->pending_len + line.length > HISTORY_LOG_BUFFER_SIZE) {
+        (void)history_log_flush(log);
+    }
+    memcpy(log->pending + log->pending_len, line.value, line.length - 1);
+    log->pending_len += line.length;
+    log->pending[log->pending_len - 1] = '\n';
+    ++log->pending_count;
+
+    if (log->pending_count >= NCSH_HISTORY_APPEND_BATCH) {
+        (void)history_log_flush(log);
+    }
+}
+
+int history_log_replace(History_Log* restrict log)
+{
+    assert(log); assert(log->path);
+
+    // synced before it's renamed, so a crash leaves the old history file or the whole new one
+    int fd = open(log->tmp_path, O_RDWR | O_APPEND | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fchmod(fd, S_IRUSR | S_IWUSR) || fdatasync(fd) || fstat(fd, &st) || flock(fd, LOCK_EX) ||
+        rename(log->tmp_path, log->path)) {
+        if (fd != -1) {
+            close(fd);
+        }
+        unlink(log->tmp_path);
+        return EXIT_FAILURE;
+    }
+
+    struct stat old;
+    if (!fstat(log->fd, &old)) {
+        History_Log_Replaced replaced = {
+            .size = (uint64_t)old.st_size,
+            .ino = (uint64_t)st.st_ino,
+            .offset = (uint64_t)st.st_size,
+        };
+        memcpy(replaced.magic, HISTORY_LOG_REPLACED_MAGIC, sizeof(replaced.magic));
+        (void)history_log_write(log->fd, (char*)&replaced, sizeof(replaced));
+    }
+
+    // the lock on the new one is taken before the old one's is released
+    close(log->fd);
+    log->fd = fd;
+    if (log->seeked) {
+        history_log_seek(log, st.st_size);
+    }
+    return EXIT_SUCCESS;
+}
+
+int history_log_compact(History_Log* restrict log, size_t keep)
+{
+    assert(log);
+    if (!log->path || !keep) {
+        return EXIT_SUCCESS;
+    }
+    if (history_log_lock(log, LOCK_EX) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    // everything in the history file is merged first, so this shell continues from the new one's end
+    (void)history_log_merge_locked(log);
+
+    struct stat st;
+    if (fstat(log->fd, &st) || st.st_size < 2) {
+        history_log_unlock(log);
+        return EXIT_SUCCESS;
+    }
+    size_t size = (size_t)st.st_size;
+    char* map = mmap(NULL, size, PROT_READ, MAP_SHARED, log->fd, 0);
+    if (map == MAP_FAILED) {
+        history_log_unlock(log);
+        return EXIT_FAILURE;
+    }
+
+    // count lines back from the end until there are more than twice keep
+    size_t lines = 0;
+    size_t start = 0;
+    for (size_t i = size - 1; i > 0 && lines < 2 * keep; --i) {
+        if (map[i - 1] == '\n' && ++lines == keep) {
+            start = i;
+        }
+    }
+
+    int rv = EXIT_SUCCESS;
+    if (lines >= 2 * keep) {
+        int fd = open(log->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+        rv = fd == -1 ? EXIT_FAILURE : history_log_write(fd, map + start, size - start);
+        if (fd != -1 && close(fd)) {
+            rv = EXIT_FAILURE;
+        }
+        if (rv == EXIT_SUCCESS) {
+            rv = history_log_replace(log);
+        }
+        else {
+            unlink(log->tmp_path);
+        }
+        if (rv == EXIT_FAILURE) {
+            tty_perror("ncsh: could not compact the history file");
+        }
+    }
+    munmap(map, size);
+
+    history_log_unlock(log);
+    return rv;
+}
+
+void history_log_close(History_Log* restrict log)
+{
+    assert(log);
+    if (!log->path) {
+        return;
+    }
+
+    close(log->fd);
+    *log = (History_Log){0};
+}
@@ -0,0 +1,122 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* history.h: the history file as an append-only log shared by every running shell */
+
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "../arena.h"
+#include "../eskilib/str.h"
+
+/* Every command is appended to the history file as it's ran instead of the whole file being rewritten on exit,
+ * so shells running at the same time don't overwrite each other's history. Writes are done under an exclusive
+ * flock on the file, reads and loads under a shared one. When it's compacted or cleaned, the new history file is
+ * renamed over it, and the other shells switch to the new one the next time they lock it. */
+
+#define HISTORY_LOG_BUFFER_SIZE (1 << 16)
+#define HISTORY_LOG_TAIL_SIZE 256
+
+/* History_Log_Callback
+ * Called with each line merged from the history file, length includes the null terminator.
+ */
+typedef void(History_Log_Callback)(const char* line, int length);
+
+/* History_Log
+ * The history file opened for appending. Everything before offset is in the in-memory history, whether this shell
+ * wrote it or read it, so only what other shells appended after it is merged.
+ */
+typedef struct {
+    int fd;
+    char* path;
+    char* tmp_path; // where the history file is written before it's renamed over path
+    bool seeked; // nothing is merged until the history has been loaded and offset set
+    off_t offset;
+
+    // the bytes right before offset, if they change the file was rewritten in place
+    char* tail;
+    size_t tail_len;
+
+    // commands waiting to be appended
+    char* pending;
+    size_t pending_len;
+    size_t pending_count;
+
+    char* buffer; // lines read from other shells
+    History_Log_Callback* on_merged;
+} History_Log;
+
+/* history_log_open
+ * Open the history file at path for appending, creating it if it doesn't exist.
+ * on_merged is called with each line merged from other shells after it's added to the history. Can be NULL.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+[[nodiscard]]
+int history_log_open(History_Log* restrict log, char* restrict path, History_Log_Callback* on_merged,
+                     Arena* restrict arena);
+
+/* history_log_load
+ * Load the history file into bestline's history, then start tracking it from its end.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_load(History_Log* restrict log);
+
+/* history_log_reload
+ * history_log_load, for callers holding the lock, like after rewriting the history file.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_reload(History_Log* restrict log);
+
+/* history_log_seek
+ * Start tracking the history file from offset, when the history was loaded up to offset some other way.
+ */
+void history_log_seek(History_Log* restrict log, off_t offset);
+
+/* history_log_lock
+ * Take the flock of the history file, operation is LOCK_SH or LOCK_EX. Waits for other shells to release it.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_lock(History_Log* restrict log, int operation);
+
+void history_log_unlock(History_Log* restrict log);
+
+/* history_log_add
+ * Queue line (length includes the null terminator) to be appended.
+ * Every NCSH_HISTORY_APPEND_BATCH lines are appended together, with one write.
+ */
+void history_log_add(History_Log* restrict log, Str line);
+
+/* history_log_flush
+ * Append the lines waiting to be appended, merging what other shells appended first.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_flush(History_Log* restrict log);
+
+/* history_log_merge_locked
+ * history_log_merge, for callers holding the lock, like before rewriting the history file.
+ * Returns: the number of lines merged
+ */
+size_t history_log_merge_locked(History_Log* restrict log);
+
+/* history_log_merge
+ * Add the lines other shells appended since the last merge to bestline's history.
+ * Cheap when nothing was appended: a single fstat.
+ * Returns: the number of lines merged
+ */
+size_t history_log_merge(History_Log* restrict log);
+
+/* history_log_replace
+ * Rename the file written to tmp_path over the history file, for callers holding the exclusive lock who've merged
+ * everything in it. Tracking continues from the new one's end, and its lock is held instead.
+ * The other shells with the old one open continue from where it ends in the new one.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_replace(History_Log* restrict log);
+
+/* history_log_compact
+ * When the history file holds more than twice keep lines, replace it with only the last keep lines.
+ * Returns: EXIT_SUCCESS or EXIT_FAILURE
+ */
+int history_log_compact(History_Log* restrict log, size_t keep);
+
+void history_log_close(History_Log* restrict log);
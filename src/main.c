@@ -6,8 +6,10 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <setjmp.h>
 #include <stdlib.h>
+#include <sys/file.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -19,12 +21,17 @@
 #include "io/bestline.h"
 #include "io/bestout.h"
 #include "io/hashset.h"
+#include "io/history.h"
 #include "ttyio/ttyio.h"
 #include "debug.h"
 #include "arena.h"
 #include "conf.h"
+#include "path_cache.h"
+#include "interpreter/parse_cache.h"
+#include "interpreter/script.h"
 #include "defines.h"
 #include "signals.h"
+#include "startup.h"
 #include "vars.h"
 #include "env.h"
 
@@ -42,7 +49,7 @@ Config* conf_;
 
 /* arena_init
  * Initialize arenas used for the lifteim of the shell.
- * A permanent arena and a scratch arena are allocated.
+ * A permanent arena and a scratch arena are allocated, both grow by chaining blocks when full.
  * Returns: pointer to start of the memory block allocated.
  */
 [[nodiscard]]
@@ -61,13 +68,15 @@ static char* arena_init(Shell* restrict shell)
     char* scratch_memory_start = memory + (arena_capacity + 1);
     shell->scratch =
         (Arena){.start = scratch_memory_start, .end = scratch_memory_start + (scratch_capacity)};
+    arena_chain(&shell->arena, NCSH_ARENA_CHAIN_CAP);
+    arena_chain(&shell->scratch, NCSH_ARENA_CHAIN_CAP);
 
     return memory;
 }
 
 /* arena_noninteractive_init
  * Initialize arenas used for the lifteim of the shell.
- * A permanent arena and a scratch arena are allocated.
+ * A permanent arena and a scratch arena are allocated, both grow by chaining blocks when full.
  * Returns: pointer to start of the memory block allocated.
  */
 [[nodiscard]]
@@ -86,18 +95,109 @@ static char* arena_noninteractive_init(Shell* restrict shell)
     char* scratch_memory_start = memory + (arena_capacity + 1);
     shell->scratch =
         (Arena){.start = scratch_memory_start, .end = scratch_memory_start + (scratch_capacity)};
+    arena_chain(&shell->arena, NCSH_ARENA_CHAIN_CAP);
+    arena_chain(&shell->scratch, NCSH_ARENA_CHAIN_CAP);
 
     return memory;
 }
 
+/* autocompletions_load
+ * The trie is loaded on the first keystroke instead of on startup, so startup time doesn't depend on history size.
+ * It is mapped from the snapshot saved on exit when the history hasn't changed since, else rebuilt from the history.
+ * With NCSH_BACKGROUND_STARTUP the startup thread does this, and the trie is used once the thread is done.
+ * Returns: true if the trie is loaded, false if the startup thread is still loading it.
+ */
+static bool autocompletions_load()
+{
+    if (input_->autocompletions_loaded) {
+        return true;
+    }
+
+    Autocompletion_Node* tree = NULL;
+#ifdef NCSH_BACKGROUND_STARTUP
+    if (input_->startup) {
+        if (!startup_load_done(input_->startup)) {
+            return false;
+        }
+        tree = input_->startup->tree;
+    }
+#endif /* NCSH_BACKGROUND_STARTUP */
+
+    if (!tree) {
+        tree = ac_snapshot_load(conf_->ac_file.value, conf_->history_file.value, arena_);
+    }
+    if (!tree) {
+        Arena scratch = *input_->scratch;
+        unsigned count = bestlineHistoryCount();
+        Str* lines = count ? arena_malloc(&scratch, count, Str) : NULL;
+        for (unsigned i = 0; i < count; ++i) {
+            char* line = (char*)bestlineHistoryGet(i);
+            lines[i] = Str(line, strlen(line) + 1);
+        }
+        tree = ac_rebuild(lines, count, conf_->ac_file.value, time(NULL), arena_);
+    }
+
+    input_->autocompletions_loaded = true;
+    input_->autocompletions_tree = tree;
+    input_->autocompletion_cursor.tree = tree;
+    ac_cursor_reset(&input_->autocompletion_cursor);
+    return true;
+}
+
+/* z_adopt
+ * Use the z database z_init read, on the main thread so what reading it reports isn't printed over the prompt.
+ * z works without its database file when it couldn't be read, whether it was read on the startup thread or not.
+ * db can be the shell's own z_db.
+ */
+static void z_adopt(Shell* shell, z_Database* db, enum z_Result result)
+{
+    z_read_report(db);
+    if (result != Z_SUCCESS) {
+        bestlineWriteStr(STDERR_FILENO, Str_Lit("ncsh: could not load the z database.\n"));
+        shell->z_db = (z_Database){0};
+    }
+    else if (db != &shell->z_db) {
+        shell->z_db = *db;
+    }
+    shell->z_db.parallel_min = shell->config.z_parallel_min;
+}
+
+#ifdef NCSH_BACKGROUND_STARTUP
+/* startup_load_adopt
+ * Use what the startup thread loaded once it is done, or wait for it when wait is true.
+ * Not called while bestline is reading a line, since bestline's history is replaced.
+ */
+static void startup_load_adopt(Shell* restrict shell, bool wait)
+{
+    Startup_Load* load = shell->input.startup;
+    if (!load || load->joined || (!wait && !startup_load_done(load))) {
+        return;
+    }
+    startup_load_wait(load);
+    [[maybe_unused]] bool loaded = autocompletions_load();
+    assert(loaded);
+
+    // adopted before the first command runs, so bestline's history only has the line being read when exiting early
+    bestlineHistoryFree();
+    for (size_t i = 0; i < load->history_count; ++i) {
+        bestlineHistoryAdd(load->history[i].value);
+    }
+    history_log_seek(&shell->input.history_log, load->history_size);
+
+    z_adopt(shell, load->z_db, load->z_result);
+}
+#endif /* NCSH_BACKGROUND_STARTUP */
+
 void completion(const char *buf, int pos, bestlineCompletions *lc)
 {
     if (pos <= 0 || !buf) {
         return;
     }
 
-    uint8_t ac_matches_count =
-        ac_first((char*)buf, input_->current_autocompletion, input_->autocompletions_tree, *input_->scratch);
+    if (!autocompletions_load()) {
+        return;
+    }
+    uint8_t ac_matches_count = ac_cursor_first(&input_->autocompletion_cursor, (char*)buf);
 
     if (!ac_matches_count) {
         if (input_->current_autocompletion[0] == '\0') {
@@ -120,8 +220,10 @@ char *hints(const char *buf, const char **ansi1, const char **ansi2)
         return NULL;
     }
 
-    uint8_t ac_matches_count =
-        ac_first((char*)buf, input_->current_autocompletion, input_->autocompletions_tree, *input_->scratch);
+    if (!autocompletions_load()) {
+        return NULL;
+    }
+    uint8_t ac_matches_count = ac_cursor_first(&input_->autocompletion_cursor, (char*)buf);
 
     if (!ac_matches_count) {
         if (input_->current_autocompletion[0] == '\0') {
@@ -141,86 +243,147 @@ char *hints(const char *buf, const char **ansi1, const char **ansi2)
     return NULL;
 }
 
-void history_clean(char** history, unsigned count)
+void history_clean()
 {
-    if (!history || !count)
+    unsigned count = bestlineHistoryCount();
+    if (!count)
         return;
 
     tty_print("ncsh history: starting to clean history with %u entries.\n", count);
 
-    bestlineHistorySave(conf_->history_file.value);
+    // other shells don't append to the history file while it's rewritten
+    History_Log* log = &input_->history_log;
+    if (log->path) {
+        (void)history_log_flush(log);
+        if (history_log_lock(log, LOCK_EX) != EXIT_SUCCESS) {
+            tty_perror("ncsh history: could not lock the history file to clean history");
+            return;
+        }
+        (void)history_log_merge_locked(log);
+        count = bestlineHistoryCount(); // with what other shells appended
+    }
+    else {
+        bestlineHistorySave(conf_->history_file.value);
+    }
 
     Hashset hset = {0};
     hashset_malloc(0, input_->scratch, &hset);
 
-    FILE* file = fopen(conf_->history_file.value, "w");
+    // other shells have the history file open, so it's written to another file which replaces it
+    FILE* file = fopen(log->path ? log->tmp_path : conf_->history_file.value, "w");
     if (!file) {
         tty_perror("ncsh: Could not open .ncsh_history file to clean history");
-        return;
+        goto unlock;
     }
 
     for (size_t i = 0; i < count; ++i) {
-        if (!history[i] || !*history[i]) {
+        char* line = (char*)bestlineHistoryGet(i);
+        if (!*line) {
             continue;
         }
 
-        Str entry = Str_Get(history[i]);
+        Str entry = Str_Get(line);
         if (!hashset_exists(entry.value, &hset)) {
             hashset_set(entry, input_->scratch, &hset);
 
             if (!fputs(entry.value, file)) {
                 tty_perror("ncsh history: Error writing to file");
                 fclose(file);
-                return;
+                goto unlock;
             }
             if (!fputc('\n', file)) {
                 tty_perror("ncsh history: Error writing to file");
                 fclose(file);
-                return;
+                goto unlock;
             }
         }
     }
 
     fclose(file);
 
-    bestlineHistoryLoad(conf_->history_file.value);
+    if (log->path) {
+        if (history_log_replace(log) != EXIT_SUCCESS) {
+            tty_perror("ncsh history: could not replace the history file to clean history");
+            goto unlock;
+        }
+        (void)history_log_reload(log);
+        history_log_unlock(log);
+    }
+    else {
+        bestlineHistoryLoad(conf_->history_file.value);
+    }
     tty_print("ncsh history: finished cleaning history, history now has %u entries.\n", bestlineHistoryCount());
+    return;
+
+unlock:
+    if (log->path) {
+        unlink(log->tmp_path);
+        history_log_unlock(log);
+    }
 }
 
 // clean history first so there is just 1 entry to remove after (if the entry is found).
-void history_remove(const char* rm, int n, char** history, unsigned count)
+void history_remove(const char* rm, int n)
 {
-    assert(rm); assert(n); assert(history); assert(count);
+    assert(rm); assert(n);
 
     Str s = *estrdup(&Str((char*)rm, (size_t)n), arena_);
 
-    history_clean(history, count);
+    history_clean();
 
-    char **h = bestlineHistory(); // get the reloaded history
-    for (size_t i = 0; i < bestlineHistoryCount(); ++i) {
-        if (estrcmp(Str_Get(h[i]), s)) {
-            free(h[i]);
-            h[i] = NULL;
-            if (i + 1 == count || !count) {
-                return;
-            }
-
-            for (size_t j = i; j < count - 1; ++j) {
-                h[i] = h[i + 1];
-            }
-            bestlineHistoryCountDecrement();
-            tty_print("ncsh history: removed entry: %s\n", s.value);
+    // what other shells appended since cleaning is merged before the history file is replaced
+    History_Log* log = &input_->history_log;
+    if (log->path) {
+        if (history_log_lock(log, LOCK_EX) != EXIT_SUCCESS) {
+            tty_perror("ncsh history: could not lock the history file to remove an entry");
             return;
         }
+        (void)history_log_merge_locked(log);
+    }
+
+    unsigned count = bestlineHistoryCount(); // the reloaded history
+    unsigned i = 0;
+    while (i < count && !estrcmp(Str_Get((char*)bestlineHistoryGet(i)), s)) {
+        ++i;
+    }
+    if (i == count) {
+        tty_print("ncsh history: entry to remove '%s' was not found\n", s.value);
+    }
+    else {
+        bestlineHistoryDelete(i);
+        // without NCSH_HISTORY_APPEND, the history file is rewritten on exit
+        if (log->path && (bestlineHistorySave(log->tmp_path) || history_log_replace(log) != EXIT_SUCCESS)) {
+            tty_perror("ncsh history: could not replace the history file to remove an entry");
+        }
+        tty_print("ncsh history: removed entry: %s\n", s.value);
     }
 
-    tty_print("ncsh history: entry to remove '%s' was not found\n", s.value);
+    if (log->path) {
+        history_log_unlock(log);
+    }
 }
 
 /* hooks into bestline history loading to populate trie used for autocompletions */
 void ac_add_when_history_expanded(const char *in, int n) {
     assert(n > 0);
+    // history loaded on startup is added to the trie when it's loaded
+    if (!input_->autocompletions_loaded) {
+        return;
+    }
     ac_add((char *)in, (size_t)n, input_->autocompletions_tree, arena_);
+    ac_cursor_reset(&input_->autocompletion_cursor);
+}
+
+/* opts_init
+ * Set the defaults for options which can be changed at runtime via the set builtin.
+ */
+static void opts_init(Options* restrict opts)
+{
+#ifdef NCSH_PIPEFAIL
+    opts->pipefail = true;
+#else
+    opts->pipefail = false;
+#endif /* NCSH_PIPEFAIL */
 }
 
 /* init
@@ -240,10 +403,20 @@ static char* init(Shell* restrict shell, char** restrict envp)
 
     env_new(shell, envp, &shell->arena);
     vars_new(shell);
+    path_cache_new(shell);
+    parse_cache_new(shell);
+    opts_init(&shell->opts);
 
     if (conf_init(shell) != E_SUCCESS) {
         return NULL;
     }
+    ac_frecency_set(shell->config.ac_frecency);
+    if (bestlineHistorySetMaxLen(shell->config.history_max)) {
+        bestlineWriteStr(STDERR_FILENO, Str_Lit("ncsh: could not set the size of the history.\n"));
+    }
+    if (bestlineHistorySetEraseDups(shell->config.history_erase_dups)) {
+        bestlineWriteStr(STDERR_FILENO, Str_Lit("ncsh: could not turn on erasing duplicates from the history.\n"));
+    }
 
     prompt_init();
     Str user_key = Str_Lit(NCSH_USER_VAL);
@@ -254,10 +427,20 @@ static char* init(Shell* restrict shell, char** restrict envp)
 
     shell->input.current_autocompletion = arena_malloc(&shell->arena, NCSH_MAX_INPUT, char);
     shell->input.autocompletions_tree = ac_alloc(&shell->arena);
+    ac_cursor_init(&shell->input.autocompletion_cursor, shell->input.autocompletions_tree,
+                   shell->input.current_autocompletion, &shell->arena);
+
+    bool background = false;
+#ifdef NCSH_BACKGROUND_STARTUP
+    shell->input.startup = arena_malloc(&shell->arena, 1, Startup_Load);
+    background = startup_load_start(shell->input.startup, &shell->config, shell->config.history_max) == EXIT_SUCCESS;
+    if (!background) {
+        shell->input.startup = NULL;
+    }
+#endif /* NCSH_BACKGROUND_STARTUP */
 
-    enum z_Result z_result = z_init(&shell->config.location, &shell->z_db, &shell->arena);
-    if (z_result != Z_SUCCESS) {
-        return NULL;
+    if (!background) {
+        z_adopt(shell, &shell->z_db, z_init(&shell->config.location, &shell->z_db, &shell->arena));
     }
 
     if ((shell->pgid = signal_init()) < 0) {
@@ -272,7 +455,16 @@ static char* init(Shell* restrict shell, char** restrict envp)
     bestlineSetHintsCallback(hints);
     bestlineSetCompletionCallback(completion);
     bestlineSetOnHistoryLoadedCallback(ac_add_when_history_expanded);
-    bestlineHistoryLoad(shell->config.history_file.value);
+#ifdef NCSH_HISTORY_APPEND
+    if (shell->config.history_file.value) {
+        // falls back to rewriting the history file on exit
+        (void)history_log_open(&shell->input.history_log, shell->config.history_file.value,
+                               ac_add_when_history_expanded, &shell->arena);
+    }
+#endif /* NCSH_HISTORY_APPEND */
+    if (!background && history_log_load(&shell->input.history_log) != EXIT_SUCCESS) {
+        bestlineHistoryLoad(shell->config.history_file.value);
+    }
     bestlineSetOnHistoryCleanCallback(history_clean);
     bestlineSetOnHistoryRemoveCallback(history_remove);
     shell->arena = *arena_;
@@ -286,15 +478,37 @@ static void cleanup(char* restrict shell_memory, Shell* restrict shell)
     if (!shell_memory) {
         return;
     }
-    if (shell->config.history_file.value) {
+#ifdef NCSH_BACKGROUND_STARTUP
+    // history, autocompletions, and z entries which haven't been loaded yet would be lost when saving
+    startup_load_adopt(shell, true);
+#endif /* NCSH_BACKGROUND_STARTUP */
+    if (shell->input.history_log.path) {
+        (void)history_log_flush(&shell->input.history_log);
+        (void)history_log_compact(&shell->input.history_log, shell->config.history_max);
+        history_log_close(&shell->input.history_log);
+    }
+    else if (shell->config.history_file.value) {
         bestlineHistorySave(shell->config.history_file.value);
     }
+    if (shell->config.history_file.value) {
+        if (shell->input.autocompletions_loaded && shell->config.ac_file.value) {
+            (void)ac_snapshot_save(shell->input.autocompletions_tree, shell->config.ac_file.value,
+                                   shell->config.history_file.value, shell->scratch);
+        }
+    }
     if (shell->input.buffer) {
         free(shell->input.buffer);
     }
     if (shell->z_db.database_file) {
         z_exit(&shell->z_db);
     }
+#ifdef NCSH_BACKGROUND_STARTUP
+    if (shell->input.startup) {
+        startup_load_free(shell->input.startup);
+    }
+#endif /* NCSH_BACKGROUND_STARTUP */
+    arena_chain_free(&shell->scratch);
+    arena_chain_free(&shell->arena);
     free(shell_memory);
 }
 
@@ -324,29 +538,38 @@ static void startup_time()
 
 /* noninteractive
  * Main noninteractive loop of the shell.
- * Runs when calling shell via command-line like /bin/ncsh ls or via scripts.
- * Much simpler than interactive loop, parses input from command-line and sends it to the VM.
+ * Runs when calling shell via command-line like /bin/ncsh ls or via scripts, like /bin/ncsh script.sh or /bin/ncsh < script.sh.
+ * Much simpler than interactive loop, parses input from command-line or the script and sends it to the VM.
  * Returns: exit status, see defines.h (EXIT_...)
  */
 [[nodiscard]]
 static int noninteractive(int argc, char** restrict argv, char** restrict envp)
 {
-    assert(argc > 1); // 1 because first arg is ncsh
+    assert(argc >= 1);
     assert(argv);
     assert(strstr(argv[0], "ncsh"));
 
-    // noninteractive does not support no args
-    if (argc <= 1) {
-        return EXIT_FAILURE;
-    }
-
     debug("ncsh running in noninteractive mode.");
     debug_argsv(argc, argv);
 
+    // 'ncsh < script.sh' reads the script from stdin, 'ncsh script.sh' from the file
+    int script_fd = -1;
+    if (argc == 1) {
+        script_fd = STDIN_FILENO;
+    }
+    else if (argc == 2 && script_is(argv[1])) {
+        script_fd = open(argv[1], O_RDONLY);
+        if (script_fd == -1) {
+            tty_perror("ncsh: could not open script");
+            return EXIT_FAILURE;
+        }
+    }
+
     tty_init_caps();
 
     Shell shell = {0};
-    char* memory = arena_noninteractive_init(&shell);
+    // scripts run many commands which each get a fresh scratch arena, so they get the interactive arenas
+    char* memory = script_fd != -1 ? arena_init(&shell) : arena_noninteractive_init(&shell);
     if (!memory) {
         tty_color_set(TTYIO_RED_ERROR);
         bestlineWriteStr(STDERR_FILENO, Str_Lit("ncsh: could not start up, not enough memory available.\n"));
@@ -356,6 +579,9 @@ static int noninteractive(int argc, char** restrict argv, char** restrict envp)
     }
 
     env_new(&shell, envp, &shell.arena);
+    vars_new(&shell);
+    path_cache_new(&shell);
+    opts_init(&shell.opts);
 
     int rv = EXIT_SUCCESS;
     if (conf_init(&shell) != E_SUCCESS) {
@@ -363,10 +589,26 @@ static int noninteractive(int argc, char** restrict argv, char** restrict envp)
         goto exit;
     }
 
-    rv = interpreter_run_noninteractive(argv + 1, (size_t)argc - 1, &shell);
+    if (script_fd != -1) {
+        // take the terminal back from each foreground command, like the interactive shell does
+        struct sigaction sa_ign = {.sa_handler = SIG_IGN};
+        sigemptyset(&sa_ign.sa_mask);
+        sigaction(SIGTTOU, &sa_ign, NULL);
+        shell.pgid = getpgrp();
+
+        rv = interpreter_run_script(&shell, script_fd);
+    }
+    else {
+        rv = interpreter_run_noninteractive(argv + 1, (size_t)argc - 1, &shell);
+    }
 
 exit:
+    if (script_fd > STDIN_FILENO) {
+        close(script_fd);
+    }
     tty_deinit_caps();
+    arena_chain_free(&shell.scratch);
+    arena_chain_free(&shell.arena);
     free(memory);
     return rv;
 }
@@ -406,6 +648,10 @@ int main(int argc, char** argv, char** envp)
 
     Str prompt;
     while ((prompt = prompt_get(&shell.input, &shell.scratch)).value) {
+#ifdef NCSH_BACKGROUND_STARTUP
+        startup_load_adopt(&shell, false);
+#endif /* NCSH_BACKGROUND_STARTUP */
+        history_log_merge(&shell.input.history_log);
         shell.input.buffer = bestline(prompt.value);
         if (!shell.input.buffer) {
             // Check if bestline returned NULL due to interrupt (Ctrl+C)
@@ -418,6 +664,10 @@ int main(int argc, char** argv, char** envp)
 
         shell.input.pos = strlen(shell.input.buffer) + 1;
 
+#ifdef NCSH_BACKGROUND_STARTUP
+        // commands like z and history use what the startup thread loads
+        startup_load_adopt(&shell, true);
+#endif /* NCSH_BACKGROUND_STARTUP */
         int command_result = interpreter_run(&shell, shell.scratch);
         if (command_result == EXIT_FAILURE) {
             rv = EXIT_FAILURE;
@@ -427,8 +677,12 @@ int main(int argc, char** argv, char** envp)
             break;
         }
 
-        bestlineHistoryAdd(shell.input.buffer);
+        if (bestlineHistoryAdd(shell.input.buffer)) {
+            history_log_add(&shell.input.history_log, Str(shell.input.buffer, shell.input.pos));
+        }
+        autocompletions_load();
         ac_add(shell.input.buffer, shell.input.pos, shell.input.autocompletions_tree, &shell.arena);
+        ac_cursor_reset(&shell.input.autocompletion_cursor);
         shell.input.pos = 0;
         free(shell.input.buffer);
     }
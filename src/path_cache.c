@@ -0,0 +1,187 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* path_cache.c: caches the full paths of commands found in PATH, used by the hash builtin */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <linux/limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "env.h"
+#include "path_cache.h"
+#include "eskilib/str.h"
+#include "ttyio/ttyio.h"
+
+void path_cache_new(Shell* restrict shell)
+{
+    assert(shell);
+
+    shell->path_cache = arena_malloc(&shell->arena, 1, Path_Cache);
+}
+
+#define PATH_CACHE_FNV_OFFSET 14695981039346656037UL
+#define PATH_CACHE_FNV_PRIME 1099511628211UL
+
+[[nodiscard]]
+static uint64_t path_cache_hash(Str name)
+{
+    uint64_t hash = PATH_CACHE_FNV_OFFSET;
+    for (size_t i = 0; i < name.length; ++i) {
+        hash ^= (unsigned char)name.value[i];
+        hash *= PATH_CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+/* path_cache_slot
+ * Returns: the entry for name, or the empty entry name should be added at.
+ * Always finds one since the cache is cleared before it can fill up.
+ */
+[[nodiscard]]
+static Path_Cache_Entry* path_cache_slot(Path_Cache* restrict cache, Str name)
+{
+    constexpr uint32_t mask = path_cache_size - 1;
+    for (uint32_t i = (uint32_t)path_cache_hash(name) & mask;; i = (i + 1) & mask) {
+        Path_Cache_Entry* entry = cache->entries + i;
+        if (!entry->name.value || estrcmp(entry->name, name)) {
+            return entry;
+        }
+    }
+}
+
+[[nodiscard]]
+static char* path_cache_pool_add(Path_Cache* restrict cache, char* restrict val, size_t len)
+{
+    char* rv = cache->pool + cache->pool_len;
+    memcpy(rv, val, len);
+    cache->pool_len += len;
+    return rv;
+}
+
+/* path_cache_search
+ * Search the directories in PATH for an executable file called name, like execvp does.
+ * Returns: the length of the full path written to buffer including the null terminator, or 0 if not found.
+ */
+[[nodiscard]]
+static size_t path_cache_search(Str name, char* restrict buffer)
+{
+    char* path = getenv(NCSH_PATH_VAL);
+    if (!path || !*path) {
+        return 0;
+    }
+
+    struct stat st;
+    while (*path) {
+        char* end = strchr(path, ':');
+        size_t dir_len = end ? (size_t)(end - path) : strlen(path);
+        if (dir_len + 1 + name.length <= PATH_MAX) {
+            size_t len = 0;
+            if (!dir_len) { // empty entries in PATH mean the current directory
+                buffer[len++] = '.';
+            }
+            else {
+                memcpy(buffer, path, dir_len);
+                len = dir_len;
+            }
+            buffer[len++] = '/';
+            memcpy(buffer + len, name.value, name.length);
+            len += name.length;
+
+            if (!stat(buffer, &st) && S_ISREG(st.st_mode) && !access(buffer, X_OK)) {
+                return len;
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        path = end + 1;
+    }
+
+    return 0;
+}
+
+[[nodiscard]]
+Str path_cache_get(Path_Cache* restrict cache, Str name)
+{
+    assert(cache); assert(name.value); assert(name.length);
+
+    if (memchr(name.value, '/', name.length)) {
+        return name;
+    }
+
+    Path_Cache_Entry* entry = path_cache_slot(cache, name);
+    if (entry->path.value) {
+        ++entry->hits;
+        return entry->path;
+    }
+
+    char buffer[PATH_MAX];
+    size_t len = path_cache_search(name, buffer);
+    if (!len) {
+        return Str_Empty;
+    }
+
+    // clear the cache when it is getting full to keep probing short, rare since PATH has a limited amount of commands
+    size_t needed = entry->name.value ? len : len + name.length;
+    if (cache->pool_len + needed > path_cache_pool_size || cache->count + 1 > path_cache_size / 4 * 3) {
+        path_cache_clear(cache);
+        entry = path_cache_slot(cache, name);
+    }
+
+    if (!entry->name.value) {
+        entry->name = Str(path_cache_pool_add(cache, name.value, name.length), name.length);
+        ++cache->count;
+    }
+    entry->path = Str(path_cache_pool_add(cache, buffer, len), len);
+    entry->hits = 1;
+    return entry->path;
+}
+
+void path_cache_invalidate(Path_Cache* restrict cache, Str name)
+{
+    assert(cache);
+
+    if (!name.value || !name.length) {
+        return;
+    }
+
+    Path_Cache_Entry* entry = path_cache_slot(cache, name);
+    if (entry->name.value) {
+        // keep the name so the entry stays in the probe sequence, the path is resolved again on next use
+        entry->path = Str_Empty;
+        entry->hits = 0;
+    }
+}
+
+void path_cache_clear(Path_Cache* restrict cache)
+{
+    assert(cache);
+
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->count = 0;
+    cache->pool_len = 0;
+}
+
+#define PATH_CACHE_EMPTY "ncsh hash: hash table empty"
+void path_cache_print(Path_Cache* restrict cache, int fd)
+{
+    assert(cache);
+
+    if (!cache->count) {
+        tty_dprintln(fd, PATH_CACHE_EMPTY);
+        return;
+    }
+
+    tty_dprintln(fd, "hits\tcommand");
+    for (size_t i = 0; i < path_cache_size; ++i) {
+        if (cache->entries[i].path.value) {
+            tty_dprintln(fd, "%4zu\t%s", cache->entries[i].hits, cache->entries[i].path.value);
+        }
+    }
+}
@@ -0,0 +1,32 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* path_cache.h: caches the full paths of commands found in PATH, used by the hash builtin */
+
+#pragma once
+
+#include "arena.h"
+#include "eskilib/str.h"
+#include "types.h"
+
+void path_cache_new(Shell* restrict shell);
+
+/* path_cache_get
+ * Get the full path of the command name, searching PATH and adding it to the cache if it isn't cached yet.
+ * Names containing a '/' are not searched for, name is returned as is.
+ * Returns: the full path, or Str_Empty if the command could not be found in PATH.
+ */
+Str path_cache_get(Path_Cache* restrict cache, Str name);
+
+/* path_cache_invalidate
+ * Forget the cached path of name, used when the cached path no longer exists.
+ */
+void path_cache_invalidate(Path_Cache* restrict cache, Str name);
+
+/* path_cache_clear
+ * Forget all cached paths, used when PATH changes and by 'hash -r'.
+ */
+void path_cache_clear(Path_Cache* restrict cache);
+
+/* path_cache_print
+ * Print the number of hits and the full path of every cached command.
+ */
+void path_cache_print(Path_Cache* restrict cache, int fd);
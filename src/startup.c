@@ -0,0 +1,165 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* startup.c: load history, autocompletions, and the z database on a background thread during startup */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "defines.h" // used for NCSH_ARENA_CHAIN_CAP
+#include "startup.h"
+
+/* startup_history_read
+ * Read the last history_max non-empty lines of the history file, oldest first, like bestlineHistoryLoad does.
+ */
+static void startup_history_read(Startup_Load* restrict load)
+{
+    int fd = open(load->history_file, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    // other shells append to the history file under an exclusive lock, see history.h
+    (void)flock(fd, LOCK_SH);
+    struct stat st;
+    if (fstat(fd, &st) || !st.st_size) {
+        close(fd);
+        return;
+    }
+    size_t len = (size_t)st.st_size;
+    char* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return;
+    }
+    load->history_size = st.st_size;
+
+    // find where the lines to keep start by counting lines back from the end
+    size_t count = 0;
+    size_t start = len;
+    for (size_t end = len; end > 0 && count < load->history_max;) {
+        size_t line_start = end;
+        while (line_start > 0 && map[line_start - 1] != '\n') {
+            --line_start;
+        }
+        size_t line_end = end;
+        while (line_end > line_start && (map[line_end - 1] == '\r' || map[line_end - 1] == '\n')) {
+            --line_end;
+        }
+        if (line_end > line_start) {
+            ++count;
+            start = line_start;
+        }
+        end = line_start ? line_start - 1 : 0;
+    }
+
+    load->history = arena_malloc(&load->arena, count ? count : 1, Str);
+    for (size_t pos = start; pos < len && load->history_count < count;) {
+        char* newline = memchr(map + pos, '\n', len - pos);
+        size_t line_end = newline ? (size_t)(newline - map) : len;
+        size_t next = line_end + 1;
+        while (line_end > pos && map[line_end - 1] == '\r') {
+            --line_end;
+        }
+        if (line_end > pos) {
+            Str* line = load->history + load->history_count++;
+            line->length = line_end - pos + 1;
+            line->value = arena_malloc(&load->arena, line->length, char);
+            memcpy(line->value, map + pos, line->length - 1);
+        }
+        pos = next;
+    }
+
+    munmap(map, len);
+    close(fd);
+}
+
+static int startup_load(void* arg)
+{
+    Startup_Load* load = arg;
+
+    startup_history_read(load);
+
+    load->tree = load->ac_file ? ac_snapshot_load(load->ac_file, load->history_file, &load->arena) : NULL;
+    if (!load->tree) {
+        load->tree = ac_rebuild(load->history, load->history_count, load->ac_file, time(NULL), &load->arena);
+    }
+
+    load->z_db = arena_malloc(&load->arena, 1, z_Database);
+    load->z_result = z_init(&load->config_location, load->z_db, &load->arena);
+
+    atomic_store_explicit(&load->done, true, memory_order_release);
+    return EXIT_SUCCESS;
+}
+
+[[nodiscard]]
+int startup_load_start(Startup_Load* restrict load, Config* restrict config, size_t history_max)
+{
+    assert(load); assert(config);
+
+    constexpr size_t capacity = 1 << 20;
+    *load = (Startup_Load){
+        .config_location = config->location,
+        .history_file = config->history_file.value,
+        .ac_file = config->ac_file.value,
+        .history_max = history_max,
+        .memory = malloc(capacity),
+    };
+    if (!load->memory || !load->history_file) {
+        free(load->memory);
+        return EXIT_FAILURE;
+    }
+    load->arena = (Arena){.start = load->memory, .end = load->memory + capacity};
+    arena_chain(&load->arena, NCSH_ARENA_CHAIN_CAP);
+
+    // the thread blocks every signal so they're handled by the main thread
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int rv = thrd_create(&load->thread, startup_load, load);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (rv != thrd_success) {
+        arena_chain_free(&load->arena);
+        free(load->memory);
+        load->memory = NULL;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+[[nodiscard]]
+bool startup_load_done(Startup_Load* restrict load)
+{
+    assert(load);
+    return atomic_load_explicit(&load->done, memory_order_acquire);
+}
+
+void startup_load_wait(Startup_Load* restrict load)
+{
+    assert(load);
+    if (load->joined) {
+        return;
+    }
+    thrd_join(load->thread, NULL);
+    load->joined = true;
+    assert(startup_load_done(load));
+}
+
+void startup_load_free(Startup_Load* restrict load)
+{
+    assert(load);
+    if (!load->memory) {
+        return;
+    }
+    arena_chain_free(&load->arena);
+    free(load->memory);
+    load->memory = NULL;
+}
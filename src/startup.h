@@ -0,0 +1,63 @@
+/* Copyright ncsh (C) by Alex Eski 2025 */
+/* startup.h: load history, autocompletions, and the z database on a background thread during startup */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <threads.h>
+
+#include "arena.h"
+#include "eskilib/str.h"
+#include "io/ac.h"
+#include "types.h"
+#include "z/z.h"
+
+/* Startup_Load
+ * What the startup thread loads. Everything it loads is allocated in its own arena, which lives until exit.
+ * The main thread must not read the results until done is set.
+ */
+typedef struct Startup_Load {
+    thrd_t thread;
+    atomic_bool done;
+    bool joined;
+
+    // set before the thread starts
+    Str config_location;
+    char* history_file;
+    char* ac_file;
+    size_t history_max;
+
+    // set by the thread
+    char* memory;
+    Arena arena;
+    Str* history;
+    size_t history_count;
+    off_t history_size; // bytes of the history file the history was read from
+    Autocompletion_Node* tree;
+    z_Database* z_db;
+    enum z_Result z_result;
+} Startup_Load;
+
+/* startup_load_start
+ * Start loading the last history_max lines of the history file, the autocompletions trie for them
+ * (from its snapshot when it's up to date), and the z database on a background thread.
+ * Returns: EXIT_SUCCESS, or EXIT_FAILURE if the thread couldn't be started
+ */
+[[nodiscard]]
+int startup_load_start(Startup_Load* restrict load, Config* restrict config, size_t history_max);
+
+/* startup_load_done
+ * Returns: true if the startup thread is done and its results can be used.
+ */
+[[nodiscard]]
+bool startup_load_done(Startup_Load* restrict load);
+
+/* startup_load_wait
+ * Wait for the startup thread to finish.
+ */
+void startup_load_wait(Startup_Load* restrict load);
+
+/* startup_load_free
+ * Free the memory the startup thread loaded into, nothing it loaded can be used after.
+ */
+void startup_load_free(Startup_Load* restrict load);
@@ -3,8 +3,11 @@
 #pragma once
 
 #include "arena.h"
+#include "eskilib/emap.h"
+#include "interpreter/parse.h"
 #include "z/z.h"
 #include "io/ac.h"
+#include "io/history.h"
 
 #define NCSH_MAX_PROCESSES 100
 
@@ -17,15 +20,9 @@ typedef struct {
 } Processes;
 
 /* Env
- * Stores env variables from envp in hashtable with static size.
+ * Stores env variables from envp in a hash map of Str values.
  */
-constexpr size_t env_exp = 7;
-constexpr size_t env_size = 1 << env_exp; // 128
-typedef struct
-{
-    Str keys[env_size];
-    Str vals[env_size];
-} Env;
+typedef Emap Env;
 
 typedef struct {
     enum {
@@ -39,13 +36,59 @@ typedef struct {
     } val;
 } Var;
 
-constexpr size_t var_exp = 7;
-constexpr size_t var_size = 1 << var_exp; // 128
-typedef struct
-{
-    Str keys[var_size];
-    Var vals[var_size];
-} Vars;
+/* Vars
+ * Stores shell variables in a hash map of Var values.
+ */
+typedef Emap Vars;
+
+/* Path_Cache
+ * Caches the full path PATH resolves a command name to, so PATH is only scanned the first time a command runs.
+ * Open addressing hash table with static size, names and paths are stored in the pool.
+ * The whole cache is cleared when full, when PATH changes, or with 'hash -r'.
+ */
+constexpr size_t path_cache_exp = 8;
+constexpr size_t path_cache_size = 1 << path_cache_exp; // 256
+constexpr size_t path_cache_pool_size = 1 << 14; // 16 KiB
+typedef struct {
+    Str name;
+    Str path; // empty when the entry needs to be resolved again (i.e. the cached path no longer exists)
+    size_t hits;
+} Path_Cache_Entry;
+
+typedef struct {
+    size_t count;
+    size_t pool_len;
+    Path_Cache_Entry entries[path_cache_size];
+    char pool[path_cache_pool_size];
+} Path_Cache;
+
+/* Parse_Cache
+ * Caches parser output by input line, so lines which are entered again skip lexing and parsing.
+ * When every entry is taken the least recently used one is replaced.
+ * Lines and statements are copied into the cache's own arena, which is reset (clearing the cache) when full.
+ */
+constexpr size_t parse_cache_size = 32;
+constexpr size_t parse_cache_arena_size = 1 << 17; // 128 KiB
+typedef struct {
+    uint64_t hash;
+    Str line;
+    Statements* stmts;
+    size_t last_used;
+} Parse_Cache_Entry;
+
+typedef struct {
+    size_t tick;
+    char* memory;
+    Arena arena;
+    Parse_Cache_Entry entries[parse_cache_size];
+} Parse_Cache;
+
+/* Options
+ * Shell options which can be toggled at runtime via the set builtin.
+ */
+typedef struct {
+    bool pipefail; // pipeline status is the rightmost non-zero status instead of the last stage's status
+} Options;
 
 /* Config
  * Stores home location, config location, and full path to the config file.
@@ -54,6 +97,11 @@ typedef struct {
     Str location;
     Str file;
     Str history_file;
+    Str ac_file; // snapshot of the autocompletions trie, next to the history file
+    Autocompletion_Frecency ac_frecency; // how autocompletions are ranked, can be set in .ncshrc
+    unsigned history_max; // history entries held in memory, can be set in .ncshrc
+    bool history_erase_dups; // commands ran again move to the newest in the history, can be set in .ncshrc
+    unsigned z_parallel_min; // directories z scores on more than one thread from, can be set in .ncshrc
 } Config;
 
 /* struct Input
@@ -70,7 +118,11 @@ typedef struct {
     // autocompletions
     size_t current_autocompletion_len;
     char* current_autocompletion;
+    bool autocompletions_loaded; // the trie is loaded on the first keystroke
+    struct Startup_Load* startup; // history, autocompletions, and z loaded on a background thread during startup
+    History_Log history_log; // the history file, when commands are appended to it as they're ran
     Autocompletion_Node* autocompletions_tree;
+    Autocompletion_Cursor autocompletion_cursor;
     Arena* scratch;
 } Input;
 
@@ -88,7 +140,10 @@ typedef struct Shell {
 
     Env* env;
     Vars* vars;
+    Path_Cache* path_cache;
+    Parse_Cache* parse_cache;
     Config config;
+    Options opts;
 
     Input input;
     Processes pcs;
@@ -27,6 +27,9 @@
 #include "z/fzf.c"
 #include "z/z.c"
 
+#include "interpreter/compile.c"
+#include "interpreter/parse_cache.c"
+#include "interpreter/script.c"
 #include "interpreter/expand.c"
 #include "interpreter/interpreter.c"
 #include "interpreter/lex.c"
@@ -36,6 +39,7 @@
 #include "io/bestline.c"
 #include "io/ac.c"
 #include "io/hashset.c"
+#include "io/history.c"
 #include "io/prompt.c"
 
 #include "interpreter/builtins.c"
@@ -47,5 +51,8 @@
 #include "arena.c"
 #include "conf.c"
 #include "env.c"
+#include "eskilib/emap.c"
+#include "path_cache.c"
+#include "startup.c"
 
 #include "main.c"
@@ -12,4 +12,18 @@
 
 void vars_new(Shell* restrict shell);
 
+/* vars_get
+ * Returns: the value of key, or NULL if key is not set.
+ */
+Var* vars_get(Vars* vars, Str key);
+
+/* vars_add_or_get
+ * Returns: the value of key, adding key with an empty value if key is not set.
+ * key is not copied, it needs to live as long as the shell's arena.
+ */
 Var* vars_add_or_get(Vars* vars, Str key);
+
+/* vars_remove
+ * Returns: true if key was set and has been removed.
+ */
+bool vars_remove(Vars* vars, Str key);
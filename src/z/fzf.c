@@ -8,6 +8,10 @@
 
 #include "../arena.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 // TODO(conni2461): UNICODE HEADER
 #define UNICODE_MAXASCII 0x7f
 
@@ -81,20 +85,6 @@ enum fzf_char_types {
 };
 typedef enum fzf_char_types char_types;
 
-int32_t index_byte(fzf_string_t* string, char b)
-{
-    if (!string || !string->data) {
-        return -1;
-    }
-
-    for (size_t i = 0; i < string->size; i++) {
-        if (string->data[i] == b) {
-            return (int32_t)i;
-        }
-    }
-    return -1;
-}
-
 size_t leading_whitespaces(fzf_string_t* str)
 {
     size_t whitespaces = 0;
@@ -110,8 +100,8 @@ size_t leading_whitespaces(fzf_string_t* str)
 size_t trailing_whitespaces(fzf_string_t* str)
 {
     size_t whitespaces = 0;
-    for (size_t i = str->size - 1; true; i--) {
-        if (!isspace((uint8_t)str->data[i])) {
+    for (size_t i = str->size; i > 0; i--) {
+        if (!isspace((uint8_t)str->data[i - 1])) {
             break;
         }
         whitespaces++;
@@ -119,13 +109,6 @@ size_t trailing_whitespaces(fzf_string_t* str)
     return whitespaces;
 }
 
-void copy_runes(fzf_string_t* src, fzf_i32_t* destination)
-{
-    for (size_t i = 0; i < src->size; i++) {
-        destination->data[i] = (int32_t)src->data[i];
-    }
-}
-
 void copy_into_i16(i16_slice_t* src, fzf_i16_t* dest)
 {
     for (size_t i = 0; i < src->size; i++) {
@@ -349,28 +332,385 @@ int16_t bonus_at(fzf_string_t* input, size_t idx)
     return bonus_for(char_class_of(input->data[idx - 1]), char_class_of(input->data[idx]));
 }
 
-int32_t try_skip(fzf_string_t* input, bool case_sensitive, byte b, int32_t from)
+/* SIMD kernels
+ * The byte search of try_skip, the bonus of each character in fzf_fuzzy_match_v2, and the max of the last row of its
+ * score matrix, 16 (SSE2) or 32 (AVX2) bytes at a time. Every kernel has a scalar version with the same results,
+ * which is also what finishes the bytes left over at the end, since nothing past the end of the text can be read.
+ * The AVX2 kernels finish with the SSE2 ones first, paths are often not much longer than 32 bytes.
+ * The AVX2 kernels are compiled whatever -march is, and picked at runtime if the CPU has AVX2.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define FZF_X86
+#endif
+
+#if defined(FZF_X86) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define FZF_AVX2 __attribute__((target("avx2")))
+#endif
+
+static enum fzf_simd fzf_simd_level = FZF_SIMD_UNSET;
+
+enum fzf_simd fzf_simd_best(void)
 {
-    assert(input && input->data);
-    str_slice_t slice = slice_str(input->data, (size_t)from, input->size);
-    fzf_string_t byte_array = {.data = slice.data, .size = slice.size};
-    int32_t idx = index_byte(&byte_array, b);
-    if (idx == 0) {
-        return from;
+#ifdef FZF_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return FZF_SIMD_AVX2;
+    }
+#endif /* FZF_AVX2 */
+#ifdef __SSE2__
+    return FZF_SIMD_SSE2;
+#else
+    return FZF_SIMD_SCALAR;
+#endif /* __SSE2__ */
+}
+
+enum fzf_simd fzf_simd_set(enum fzf_simd level)
+{
+    enum fzf_simd best = fzf_simd_best();
+    fzf_simd_level = level == FZF_SIMD_UNSET || level > best ? best : level;
+    return fzf_simd_level;
+}
+
+[[nodiscard]]
+static inline enum fzf_simd fzf_simd(void)
+{
+    return fzf_simd_level == FZF_SIMD_UNSET ? fzf_simd_best() : fzf_simd_level;
+}
+
+/* fzf_index_byte_*
+ * Returns: the index of the first byte of data which is b or upper, or -1
+ */
+static int32_t fzf_index_byte_scalar(const char* data, size_t size, char b, char upper)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == b || data[i] == upper) {
+            return (int32_t)i;
+        }
     }
+    return -1;
+}
 
-    if (!case_sensitive && b >= 'a' && b <= 'z') {
-        if (idx > 0) {
-            assert(byte_array.data);
-            str_slice_t tmp = slice_str_right(byte_array.data, (size_t)idx);
-            byte_array.data = tmp.data;
-            byte_array.size = tmp.size;
+#ifdef __SSE2__
+static int32_t fzf_index_byte_sse2(const char* data, size_t i, size_t size, char b, char upper)
+{
+    const __m128i lower_v = _mm_set1_epi8(b);
+    const __m128i upper_v = _mm_set1_epi8(upper);
+    for (; i + 16 <= size; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(const void*)(data + i));
+        uint32_t found =
+            (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(c, lower_v), _mm_cmpeq_epi8(c, upper_v)));
+        if (found) {
+            return (int32_t)(i + (size_t)__builtin_ctz(found));
         }
-        int32_t uidx = index_byte(&byte_array, b - (byte)32);
-        if (uidx >= 0) {
-            idx = uidx;
+    }
+    int32_t idx = fzf_index_byte_scalar(data + i, size - i, b, upper);
+    return idx < 0 ? -1 : (int32_t)i + idx;
+}
+#endif /* __SSE2__ */
+
+#ifdef FZF_AVX2
+FZF_AVX2
+static int32_t fzf_index_byte_avx2(const char* data, size_t size, char b, char upper)
+{
+    const __m256i lower_v = _mm256_set1_epi8(b);
+    const __m256i upper_v = _mm256_set1_epi8(upper);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(const void*)(data + i));
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, lower_v), _mm256_cmpeq_epi8(c, upper_v)));
+        if (found) {
+            return (int32_t)(i + (size_t)__builtin_ctz(found));
         }
     }
+    return fzf_index_byte_sse2(data, i, size, b, upper);
+}
+#endif /* FZF_AVX2 */
+
+int32_t fzf_index_byte(const char* data, size_t size, char b, char upper, enum fzf_simd level)
+{
+    switch (level) {
+#ifdef FZF_AVX2
+    case FZF_SIMD_AVX2:
+        return fzf_index_byte_avx2(data, size, b, upper);
+#endif /* FZF_AVX2 */
+#ifdef __SSE2__
+    case FZF_SIMD_SSE2:
+        return fzf_index_byte_sse2(data, 0, size, b, upper);
+#endif /* __SSE2__ */
+    default:
+        return fzf_index_byte_scalar(data, size, b, upper);
+    }
+}
+
+/* fzf_bonus_*
+ * Set bonus to the bonus of each byte of data, the first byte's previous class being CharNonWord, and runes to each
+ * byte as an unsigned value, lowercased unless case_sensitive.
+ */
+static void fzf_bonus_scalar(const char* data, size_t size, bool case_sensitive, int16_t* bonus, int32_t* runes,
+                             char_class prev_class)
+{
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        char_class class = char_class_of(c);
+        if (!case_sensitive && class == CharUpper) {
+            c = (char)(c + ('a' - 'A'));
+        }
+        runes[i] = (uint8_t)c;
+        bonus[i] = bonus_for(prev_class, class);
+        prev_class = class;
+    }
+}
+
+#ifdef __SSE2__
+static void fzf_bonus_sse2(const char* data, size_t i, size_t size, bool case_sensitive, int16_t* bonus,
+                           int32_t* runes)
+{
+    // ranges are checked by moving them to the bottom of the signed range: c - low + 0x80 < len + 0x80
+    const __m128i lower_offset = _mm_set1_epi8((char)(0x80 - 'a'));
+    const __m128i upper_offset = _mm_set1_epi8((char)(0x80 - 'A'));
+    const __m128i alpha_limit = _mm_set1_epi8((char)(0x80 + 26));
+    const __m128i digit_offset = _mm_set1_epi8((char)(0x80 - '0'));
+    const __m128i digit_limit = _mm_set1_epi8((char)(0x80 + 10));
+    const __m128i boundary = _mm_set1_epi8(BonusBoundary);
+    const __m128i camel = _mm_set1_epi8(BonusCamel123);
+    const __m128i case_bit = _mm_set1_epi8(case_sensitive ? 0 : 'a' - 'A');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 16 <= size; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(const void*)(data + i));
+        // the byte before the first is 0, a CharNonWord
+        __m128i p = i ? _mm_loadu_si128((const __m128i*)(const void*)(data + i - 1)) : _mm_slli_si128(c, 1);
+
+        __m128i c_lower = _mm_cmplt_epi8(_mm_add_epi8(c, lower_offset), alpha_limit);
+        __m128i c_upper = _mm_cmplt_epi8(_mm_add_epi8(c, upper_offset), alpha_limit);
+        __m128i c_digit = _mm_cmplt_epi8(_mm_add_epi8(c, digit_offset), digit_limit);
+        __m128i c_word = _mm_or_si128(_mm_or_si128(c_lower, c_upper), c_digit);
+        __m128i p_lower = _mm_cmplt_epi8(_mm_add_epi8(p, lower_offset), alpha_limit);
+        __m128i p_upper = _mm_cmplt_epi8(_mm_add_epi8(p, upper_offset), alpha_limit);
+        __m128i p_digit = _mm_cmplt_epi8(_mm_add_epi8(p, digit_offset), digit_limit);
+        __m128i p_word = _mm_or_si128(_mm_or_si128(p_lower, p_upper), p_digit);
+
+        // BonusBoundary after a non word character, or on one (BonusNonWord), else BonusCamel123 for lower to upper
+        // and for a digit after a non digit, else 0
+        __m128i is_boundary =
+            _mm_or_si128(_mm_andnot_si128(p_word, c_word), _mm_andnot_si128(c_word, _mm_set1_epi8(-1)));
+        __m128i is_camel = _mm_or_si128(_mm_and_si128(p_lower, c_upper), _mm_andnot_si128(p_digit, c_digit));
+        __m128i b = _mm_or_si128(_mm_and_si128(is_boundary, boundary),
+                                 _mm_andnot_si128(is_boundary, _mm_and_si128(is_camel, camel)));
+        __m128i r = _mm_add_epi8(c, _mm_and_si128(c_upper, case_bit));
+
+        _mm_storeu_si128((__m128i*)(void*)(bonus + i), _mm_unpacklo_epi8(b, zero));
+        _mm_storeu_si128((__m128i*)(void*)(bonus + i + 8), _mm_unpackhi_epi8(b, zero));
+        __m128i r_lo = _mm_unpacklo_epi8(r, zero);
+        __m128i r_hi = _mm_unpackhi_epi8(r, zero);
+        _mm_storeu_si128((__m128i*)(void*)(runes + i), _mm_unpacklo_epi16(r_lo, zero));
+        _mm_storeu_si128((__m128i*)(void*)(runes + i + 4), _mm_unpackhi_epi16(r_lo, zero));
+        _mm_storeu_si128((__m128i*)(void*)(runes + i + 8), _mm_unpacklo_epi16(r_hi, zero));
+        _mm_storeu_si128((__m128i*)(void*)(runes + i + 12), _mm_unpackhi_epi16(r_hi, zero));
+    }
+    fzf_bonus_scalar(data + i, size - i, case_sensitive, bonus + i, runes + i,
+                     i ? char_class_of(data[i - 1]) : CharNonWord);
+}
+#endif /* __SSE2__ */
+
+#ifdef FZF_AVX2
+FZF_AVX2
+static void fzf_bonus_avx2(const char* data, size_t size, bool case_sensitive, int16_t* bonus, int32_t* runes)
+{
+    const __m256i lower_offset = _mm256_set1_epi8((char)(0x80 - 'a'));
+    const __m256i upper_offset = _mm256_set1_epi8((char)(0x80 - 'A'));
+    const __m256i alpha_limit = _mm256_set1_epi8((char)(0x80 + 26));
+    const __m256i digit_offset = _mm256_set1_epi8((char)(0x80 - '0'));
+    const __m256i digit_limit = _mm256_set1_epi8((char)(0x80 + 10));
+    const __m256i boundary = _mm256_set1_epi8(BonusBoundary);
+    const __m256i camel = _mm256_set1_epi8(BonusCamel123);
+    const __m256i case_bit = _mm256_set1_epi8(case_sensitive ? 0 : 'a' - 'A');
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i*)(const void*)(data + i));
+        // the byte before the first is 0, a CharNonWord
+        __m256i p = i ? _mm256_loadu_si256((const __m256i*)(const void*)(data + i - 1))
+                      : _mm256_alignr_epi8(c, _mm256_permute2x128_si256(c, c, 0x08), 15);
+
+        __m256i c_lower = _mm256_cmpgt_epi8(alpha_limit, _mm256_add_epi8(c, lower_offset));
+        __m256i c_upper = _mm256_cmpgt_epi8(alpha_limit, _mm256_add_epi8(c, upper_offset));
+        __m256i c_digit = _mm256_cmpgt_epi8(digit_limit, _mm256_add_epi8(c, digit_offset));
+        __m256i c_word = _mm256_or_si256(_mm256_or_si256(c_lower, c_upper), c_digit);
+        __m256i p_lower = _mm256_cmpgt_epi8(alpha_limit, _mm256_add_epi8(p, lower_offset));
+        __m256i p_upper = _mm256_cmpgt_epi8(alpha_limit, _mm256_add_epi8(p, upper_offset));
+        __m256i p_digit = _mm256_cmpgt_epi8(digit_limit, _mm256_add_epi8(p, digit_offset));
+        __m256i p_word = _mm256_or_si256(_mm256_or_si256(p_lower, p_upper), p_digit);
+
+        __m256i is_boundary =
+            _mm256_or_si256(_mm256_andnot_si256(p_word, c_word), _mm256_andnot_si256(c_word, _mm256_set1_epi8(-1)));
+        __m256i is_camel = _mm256_or_si256(_mm256_and_si256(p_lower, c_upper), _mm256_andnot_si256(p_digit, c_digit));
+        __m256i b = _mm256_or_si256(_mm256_and_si256(is_boundary, boundary),
+                                    _mm256_andnot_si256(is_boundary, _mm256_and_si256(is_camel, camel)));
+        __m256i r = _mm256_add_epi8(c, _mm256_and_si256(c_upper, case_bit));
+
+        __m128i b_lo = _mm256_castsi256_si128(b);
+        __m128i b_hi = _mm256_extracti128_si256(b, 1);
+        _mm256_storeu_si256((__m256i*)(void*)(bonus + i), _mm256_cvtepu8_epi16(b_lo));
+        _mm256_storeu_si256((__m256i*)(void*)(bonus + i + 16), _mm256_cvtepu8_epi16(b_hi));
+        __m128i r_lo = _mm256_castsi256_si128(r);
+        __m128i r_hi = _mm256_extracti128_si256(r, 1);
+        _mm256_storeu_si256((__m256i*)(void*)(runes + i), _mm256_cvtepu8_epi32(r_lo));
+        _mm256_storeu_si256((__m256i*)(void*)(runes + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(r_lo, 8)));
+        _mm256_storeu_si256((__m256i*)(void*)(runes + i + 16), _mm256_cvtepu8_epi32(r_hi));
+        _mm256_storeu_si256((__m256i*)(void*)(runes + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(r_hi, 8)));
+    }
+    fzf_bonus_sse2(data, i, size, case_sensitive, bonus, runes);
+}
+#endif /* FZF_AVX2 */
+
+void fzf_bonus(const char* data, size_t size, bool case_sensitive, int16_t* bonus, int32_t* runes,
+               enum fzf_simd level)
+{
+    switch (level) {
+#ifdef FZF_AVX2
+    case FZF_SIMD_AVX2:
+        fzf_bonus_avx2(data, size, case_sensitive, bonus, runes);
+        return;
+#endif /* FZF_AVX2 */
+#ifdef __SSE2__
+    case FZF_SIMD_SSE2:
+        fzf_bonus_sse2(data, 0, size, case_sensitive, bonus, runes);
+        return;
+#endif /* __SSE2__ */
+    default:
+        fzf_bonus_scalar(data, size, case_sensitive, bonus, runes, CharNonWord);
+    }
+}
+
+/* fzf_row_max_*
+ * Returns: the max of the row, its first position in at. 0 and at untouched if the row is empty.
+ */
+static int16_t fzf_row_max_scalar(const int16_t* row, size_t size, size_t* at)
+{
+    int16_t max = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (!i || row[i] > max) {
+            max = row[i];
+            *at = i;
+        }
+    }
+    return max;
+}
+
+#ifdef __SSE2__
+static int16_t fzf_row_max_sse2(const int16_t* row, size_t size, size_t* at)
+{
+    if (size < 8) {
+        return fzf_row_max_scalar(row, size, at);
+    }
+
+    __m128i max_v = _mm_loadu_si128((const __m128i*)(const void*)row);
+    size_t i = 8;
+    for (; i + 8 <= size; i += 8) {
+        max_v = _mm_max_epi16(max_v, _mm_loadu_si128((const __m128i*)(const void*)(row + i)));
+    }
+    max_v = _mm_max_epi16(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(1, 0, 3, 2)));
+    max_v = _mm_max_epi16(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(2, 3, 0, 1)));
+    max_v = _mm_max_epi16(max_v, _mm_shufflelo_epi16(_mm_shufflehi_epi16(max_v, _MM_SHUFFLE(2, 3, 0, 1)),
+                                                     _MM_SHUFFLE(2, 3, 0, 1)));
+    int16_t max = (int16_t)_mm_extract_epi16(max_v, 0);
+    for (; i < size; i++) {
+        max = row[i] > max ? row[i] : max;
+    }
+
+    for (i = 0; i + 8 <= size; i += 8) {
+        uint32_t found = (uint32_t)_mm_movemask_epi8(
+            _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(const void*)(row + i)), _mm_set1_epi16(max)));
+        if (found) {
+            *at = i + (size_t)__builtin_ctz(found) / 2;
+            return max;
+        }
+    }
+    while (row[i] != max) {
+        i++;
+    }
+    *at = i;
+    return max;
+}
+#endif /* __SSE2__ */
+
+#ifdef FZF_AVX2
+FZF_AVX2
+static int16_t fzf_row_max_avx2(const int16_t* row, size_t size, size_t* at)
+{
+    if (size < 16) {
+        return fzf_row_max_scalar(row, size, at);
+    }
+
+    __m256i max_v = _mm256_loadu_si256((const __m256i*)(const void*)row);
+    size_t i = 16;
+    for (; i + 16 <= size; i += 16) {
+        max_v = _mm256_max_epi16(max_v, _mm256_loadu_si256((const __m256i*)(const void*)(row + i)));
+    }
+    __m128i half = _mm_max_epi16(_mm256_castsi256_si128(max_v), _mm256_extracti128_si256(max_v, 1));
+    half = _mm_max_epi16(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_max_epi16(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    half = _mm_max_epi16(half, _mm_shufflelo_epi16(_mm_shufflehi_epi16(half, _MM_SHUFFLE(2, 3, 0, 1)),
+                                                   _MM_SHUFFLE(2, 3, 0, 1)));
+    int16_t max = (int16_t)_mm_extract_epi16(half, 0);
+    for (; i < size; i++) {
+        max = row[i] > max ? row[i] : max;
+    }
+
+    for (i = 0; i + 16 <= size; i += 16) {
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(const void*)(row + i)), _mm256_set1_epi16(max)));
+        if (found) {
+            *at = i + (size_t)__builtin_ctz(found) / 2;
+            return max;
+        }
+    }
+    while (row[i] != max) {
+        i++;
+    }
+    *at = i;
+    return max;
+}
+#endif /* FZF_AVX2 */
+
+int16_t fzf_row_max(const int16_t* row, size_t size, size_t* at, enum fzf_simd level)
+{
+    switch (level) {
+#ifdef FZF_AVX2
+    case FZF_SIMD_AVX2:
+        return fzf_row_max_avx2(row, size, at);
+#endif /* FZF_AVX2 */
+#ifdef __SSE2__
+    case FZF_SIMD_SSE2:
+        return fzf_row_max_sse2(row, size, at);
+#endif /* __SSE2__ */
+    default:
+        return fzf_row_max_scalar(row, size, at);
+    }
+}
+
+/* lower_at
+ * Returns: the character of text at idx lowercased, from text's lowercase copy if it has one
+ */
+static inline char lower_at(fzf_string_t* text, size_t idx)
+{
+    return text->lower ? text->lower[idx] : (char)tolower((uint8_t)text->data[idx]);
+}
+
+int32_t try_skip(fzf_string_t* input, bool case_sensitive, byte b, int32_t from)
+{
+    assert(input && input->data);
+    if (!case_sensitive && input->lower) {
+        // the pattern is lowercase too when it isn't case sensitive
+        str_slice_t lower = slice_str(input->lower, (size_t)from, input->size);
+        int32_t idx = fzf_index_byte(lower.data, lower.size, b, b, fzf_simd());
+        return idx < 0 ? -1 : from + idx;
+    }
+    str_slice_t slice = slice_str(input->data, (size_t)from, input->size);
+    // the first of b or its uppercase, which is what searching for b then its uppercase before it found
+    byte upper = !case_sensitive && b >= 'a' && b <= 'z' ? b - (byte)32 : b;
+    int32_t idx = fzf_index_byte(slice.data, slice.size, b, upper, fzf_simd());
     if (idx < 0) {
         return -1;
     }
@@ -417,7 +757,7 @@ int32_t calculate_score(bool case_sensitive, fzf_string_t* text, fzf_string_t* p
         int32_t class = char_class_of(c);
         if (!case_sensitive) {
             /* TODO(conni2461): He does some unicode stuff here, investigate */
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, idx);
         }
 
         if (c == pattern->data[pidx]) {
@@ -480,7 +820,7 @@ fzf_result_t fzf_fuzzy_match_v1(bool case_sensitive, fzf_string_t* text, fzf_str
         /* TODO(conni2461): Common pattern maybe a macro would be good here */
         if (!case_sensitive) {
             /* TODO(conni2461): He does some unicode stuff here, investigate */
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, idx);
         }
 
         if (c == pattern->data[pidx]) {
@@ -503,7 +843,7 @@ fzf_result_t fzf_fuzzy_match_v1(bool case_sensitive, fzf_string_t* text, fzf_str
             char c = text->data[idx];
             if (!case_sensitive) {
                 /* TODO(conni2461): He does some unicode stuff here, investigate */
-                c = (char)tolower((uint8_t)c);
+                c = lower_at(text, idx);
             }
             if (c == pattern->data[pidx]) {
                 pidx--;
@@ -550,9 +890,8 @@ fzf_result_t fzf_fuzzy_match_v2(bool case_sensitive, fzf_string_t* text, fzf_str
     fzf_i16_t bo = alloc16(&offset16, slab, N, scratch_arena);
     // The first occurrence of each character in the pattern
     fzf_i32_t f = alloc32(&offset32, slab, M, scratch_arena);
-    // Rune array
+    // Rune array, only from idx on is used
     fzf_i32_t t = alloc32(&offset32, slab, N, scratch_arena);
-    copy_runes(text, &t); // input.CopyRunes(T)
 
     // Phase 2. Calculate bonus for each point
     int16_t max_score = 0;
@@ -564,7 +903,6 @@ fzf_result_t fzf_fuzzy_match_v2(bool case_sensitive, fzf_string_t* text, fzf_str
     char pchar0 = pattern->data[0];
     char pchar = pattern->data[0];
     int16_t prev_h0 = 0;
-    int32_t prev_class = CharNonWord;
     bool in_gap = false;
 
     i32_slice_t t_sub = slice_i32(t.data, idx, t.size); // T[idx:];
@@ -572,19 +910,10 @@ fzf_result_t fzf_fuzzy_match_v2(bool case_sensitive, fzf_string_t* text, fzf_str
     i16_slice_t c0_sub = slice_i16_right(slice_i16(c0.data, idx, c0.size).data, t_sub.size);
     i16_slice_t b_sub = slice_i16_right(slice_i16(bo.data, idx, bo.size).data, t_sub.size);
 
+    fzf_bonus(text->data + idx, t_sub.size, case_sensitive, b_sub.data, t_sub.data, fzf_simd());
     for (size_t off = 0; off < t_sub.size; off++) {
-        char_class class;
         char c = (char)t_sub.data[off];
-        class = char_class_of(c);
-        if (!case_sensitive && class == CharUpper) {
-            /* TODO(conni2461): unicode support */
-            c = (char)tolower((uint8_t)c);
-        }
-
-        t_sub.data[off] = (uint8_t)c;
-        int16_t bonus = bonus_for(prev_class, class);
-        b_sub.data[off] = bonus;
-        prev_class = class;
+        int16_t bonus = b_sub.data[off];
         if (c == pchar) {
             if (pidx < M) {
                 f.data[pidx] = (int32_t)(idx + off);
@@ -692,12 +1021,15 @@ fzf_result_t fzf_fuzzy_match_v2(bool case_sensitive, fzf_string_t* text, fzf_str
             }
             c_sub.data[j] = consecutive;
             in_gap = s1 < s2;
-            int16_t score = max16(max16(s1, s2), 0);
-            if (pidx == M - 1 && (score > max_score)) {
+            h_sub.data[j] = max16(max16(s1, s2), 0);
+        }
+        if (pidx == M - 1) {
+            size_t at = 0;
+            int16_t score = fzf_row_max(h_sub.data, t_sub.size, &at, fzf_simd());
+            if (score > max_score) {
                 max_score = score;
-                max_score_pos = col;
+                max_score_pos = foff + at;
             }
-            h_sub.data[j] = score;
         }
     }
 
@@ -761,7 +1093,7 @@ fzf_result_t fzf_exact_match_naive(bool case_sensitive, fzf_string_t* text, fzf_
         char c = text->data[idx];
         if (!case_sensitive) {
             /* TODO(conni2461): He does some unicode stuff here, investigate */
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, idx);
         }
 
         if (c == pattern->data[pidx]) {
@@ -818,7 +1150,7 @@ fzf_result_t fzf_prefix_match(bool case_sensitive, fzf_string_t* text, fzf_strin
     for (size_t i = 0; i < M; i++) {
         char c = text->data[trimmed_len + i];
         if (!case_sensitive) {
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, trimmed_len + i);
         }
 
         if (c != pattern->data[i]) {
@@ -858,7 +1190,7 @@ fzf_result_t fzf_suffix_match(bool case_sensitive, fzf_string_t* text, fzf_strin
         assert(idx + diff >= idx);
         char c = text->data[idx + diff];
         if (!case_sensitive) {
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, idx + diff);
         }
 
         if (c != pattern->data[idx]) {
@@ -893,7 +1225,7 @@ fzf_result_t fzf_equal_match(bool case_sensitive, fzf_string_t* text, fzf_string
         char pchar = pattern->data[idx];
         char c = text->data[trimmed_len + idx];
         if (!case_sensitive) {
-            c = (char)tolower((uint8_t)c);
+            c = lower_at(text, trimmed_len + idx);
         }
         if (c != pchar) {
             match = false;
@@ -961,11 +1293,14 @@ fzf_pattern_t* fzf_parse_pattern(char* const pattern, size_t pat_len, Arena* scr
     assert(pattern);
     assert(pattern[pat_len - 1] != '\0'); // not null terminated
 
-    char* pattern_copy = str_replace_slashes(pattern, pat_len, scratch_arena);
+    // trailing spaces are left out of the copy, the pattern itself isn't written to
     while (has_suffix(pattern, pat_len, " ", 1) && !has_suffix(pattern, pat_len, "\\ ", 2)) {
-        pattern[pat_len - 1] = 0;
         pat_len--;
     }
+    if (pat_len == 0) {
+        return pat_obj;
+    }
+    char* pattern_copy = str_replace_slashes(pattern, pat_len, scratch_arena);
 
     const char* delim = " ";
     char* ptr = strtok(pattern_copy, delim);
@@ -1076,7 +1411,11 @@ fzf_pattern_t* fzf_parse_pattern(char* const pattern, size_t pat_len, Arena* scr
     return pat_obj;
 }
 
-int32_t fzf_get_score(const char* text, size_t text_len, fzf_pattern_t* pattern, fzf_slab_t* slab, Arena* scratch_arena)
+/* fzf_score
+ * Each term is matched with its own copy of scratch_arena, the memory it allocates isn't needed for the next term.
+ * Returns: the fzf score of input
+ */
+static int32_t fzf_score(fzf_string_t* input, fzf_pattern_t* pattern, fzf_slab_t* slab, Arena* scratch_arena)
 {
     // If the pattern is an empty string then pattern->ptr will be NULL and we
     // basically don't want to filter. Return 1 for telescope
@@ -1084,14 +1423,14 @@ int32_t fzf_get_score(const char* text, size_t text_len, fzf_pattern_t* pattern,
         return 1;
     }
 
-    fzf_string_t input = {.data = text, .size = text_len};
     if (pattern->only_inv) {
         int final = 0;
         for (size_t i = 0; i < pattern->size; i++) {
             fzf_term_set_t* term_set = pattern->ptr[i];
             fzf_term_t* fzf_term = &term_set->ptr[0];
 
-            final += CALL_ALG(fzf_term, input, NULL, slab, scratch_arena).score;
+            Arena term_scratch = *scratch_arena;
+            final += CALL_ALG(fzf_term, *input, NULL, slab, &term_scratch).score;
         }
         return (final > 0) ? 0 : 1;
     }
@@ -1103,7 +1442,8 @@ int32_t fzf_get_score(const char* text, size_t text_len, fzf_pattern_t* pattern,
         bool matched = false;
         for (size_t j = 0; j < term_set->size; j++) {
             fzf_term_t* fzf_term = &term_set->ptr[j];
-            fzf_result_t res = CALL_ALG(fzf_term, input, NULL, slab, scratch_arena);
+            Arena term_scratch = *scratch_arena;
+            fzf_result_t res = CALL_ALG(fzf_term, *input, NULL, slab, &term_scratch);
             if (res.start >= 0) {
                 if (fzf_term->inv) {
                     continue;
@@ -1130,6 +1470,12 @@ int32_t fzf_get_score(const char* text, size_t text_len, fzf_pattern_t* pattern,
     return total_score;
 }
 
+int32_t fzf_get_score(const char* text, size_t text_len, fzf_pattern_t* pattern, fzf_slab_t* slab, Arena* scratch_arena)
+{
+    fzf_string_t input = {.data = text, .size = text_len};
+    return fzf_score(&input, pattern, slab, scratch_arena);
+}
+
 fzf_position_t* fzf_get_positions(const char* text, fzf_pattern_t* pattern, fzf_slab_t* slab, Arena* scratch_arena)
 {
     // If the pattern is an empty string then pattern->ptr will be NULL and we
@@ -1192,3 +1538,49 @@ fzf_slab_t* fzf_make_default_slab(Arena* scratch_arena)
     constexpr size_t size_16 = 10 * 1024;
     return fzf_make_slab((fzf_slab_config_t){size_16, 2048}, scratch_arena);
 }
+
+/* fzf_context_scratch_size
+ * The fuzzy matcher only uses the slab when the text's length times the term's fits in its int16s, size_16, and falls
+ * back to matching without the matrices when it doesn't. When the slab is full it allocates what's left in the scratch
+ * arena: at most 3 int16s per character and 2 per cell of the matrices, 4 * size_16 int16s, with size_16 + 1 int32s
+ * for the positions of the term's characters and the text.
+ * Each term starts over at the beginning of the block. It's chained anyway, so a term this misjudges grows it instead
+ * of aborting the shell in the middle of a z.
+ * Returns: the bytes a context's scratch block needs so a term never runs out
+ */
+static size_t fzf_context_scratch_size(fzf_slab_config_t config)
+{
+    constexpr size_t padding = 128; // for aligning each allocation and the chain header
+    return 4 * config.size_16 * sizeof(int16_t) + (config.size_16 + 1) * sizeof(int32_t) + padding;
+}
+
+fzf_context_t* fzf_make_context(fzf_slab_config_t config, Arena* arena)
+{
+    fzf_context_t* ctx = arena_malloc(arena, 1, fzf_context_t);
+    ctx->slab = fzf_make_slab(config, arena);
+    size_t scratch_size = fzf_context_scratch_size(config);
+    ctx->scratch.start = arena_malloc(arena, scratch_size, char);
+    ctx->scratch.end = ctx->scratch.start + scratch_size;
+    arena_chain(&ctx->scratch, 0);
+    return ctx;
+}
+
+void fzf_free_context(fzf_context_t* ctx)
+{
+    assert(ctx);
+    arena_chain_free(&ctx->scratch);
+}
+
+void fzf_context_pattern(fzf_context_t* ctx, char* const pattern, size_t pat_len, Arena* scratch_arena)
+{
+    assert(ctx);
+    ctx->pattern = fzf_parse_pattern(pattern, pat_len, scratch_arena);
+}
+
+int32_t fzf_context_score(fzf_context_t* ctx, const char* text, const char* lower, size_t text_len)
+{
+    assert(ctx && ctx->pattern);
+    fzf_string_t input = {.data = text, .size = text_len, .lower = lower};
+    Arena scratch = ctx->scratch;
+    return fzf_score(&input, ctx->pattern, ctx->slab, &scratch);
+}
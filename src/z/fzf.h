@@ -49,6 +49,7 @@ typedef struct {
 typedef struct {
     const char* data;
     size_t size;
+    const char* lower; // data lowercased, used instead of lowercasing each character when it isn't NULL
 } fzf_string_t;
 
 typedef fzf_result_t (*fzf_algo_t)(bool, fzf_string_t*, fzf_string_t*, fzf_position_t*, fzf_slab_t*, Arena*);
@@ -93,6 +94,27 @@ fzf_result_t fzf_suffix_match(bool case_sensitive, fzf_string_t* text, fzf_strin
 fzf_result_t fzf_equal_match(bool case_sensitive, fzf_string_t* text, fzf_string_t* pattern, fzf_position_t* pos,
                              fzf_slab_t* slab, Arena* scratch_arena);
 
+/* fzf_simd
+ * The instruction set the matching kernels use.
+ */
+enum fzf_simd {
+    FZF_SIMD_UNSET = -1,
+    FZF_SIMD_SCALAR,
+    FZF_SIMD_SSE2,
+    FZF_SIMD_AVX2
+};
+
+/* fzf_simd_best
+ * Returns: the widest instruction set the kernels were built with that the CPU supports, the one used by default
+ */
+enum fzf_simd fzf_simd_best(void);
+
+/* fzf_simd_set
+ * Use level instead of the best instruction set, for tests and benchmarks. FZF_SIMD_UNSET goes back to the best.
+ * Returns: the level used, the best one if level isn't supported
+ */
+enum fzf_simd fzf_simd_set(enum fzf_simd level);
+
 /* Public Interface */
 
 /* fzf_parse_pattern
@@ -115,4 +137,40 @@ fzf_slab_t* fzf_make_slab(fzf_slab_config_t config, Arena* scratch_arena);
 
 fzf_slab_t* fzf_make_default_slab(Arena* scratch_arena);
 
+/* fzf_context_t
+ * What scoring many texts against the same pattern reuses: the slab, and a block for the matrices which don't fit in
+ * it, reset for each text. Made once, then a pattern is parsed into it for each search, so scoring allocates nothing.
+ */
+typedef struct {
+    fzf_pattern_t* pattern;
+    fzf_slab_t* slab;
+    Arena scratch;
+} fzf_context_t;
+
+/* fzf_make_context
+ * Allocate a context with a slab of config's size in the arena. Its scratch block is chained, so scoring texts
+ * against patterns with many terms grows it instead of running out.
+ * Returns: a pointer to the context, without a pattern until fzf_context_pattern is called.
+ */
+fzf_context_t* fzf_make_context(fzf_slab_config_t config, Arena* arena);
+
+/* fzf_free_context
+ * Unmap the blocks chained to the context's scratch block. The context itself stays in the arena it was made in.
+ */
+void fzf_free_context(fzf_context_t* ctx);
+
+/* fzf_context_pattern
+ * Parse the fzf pattern into the context, allocating using the scratch arena.
+ * pat_len should be equivalent to strlen, do not include null terminator in length.
+ */
+void fzf_context_pattern(fzf_context_t* ctx, char* const pattern, size_t pat_len, Arena* scratch_arena);
+
+/* fzf_context_score
+ * Get score for specific entry based on the context's pattern, without allocating.
+ * lower is text lowercased, or NULL to lowercase each character as it's compared.
+ * text_len should be equivalent to strlen, do not include null terminator in length.
+ * Returns: the fzf score
+ */
+int32_t fzf_context_score(fzf_context_t* ctx, const char* text, const char* lower, size_t text_len);
+
 #endif // FZF_H
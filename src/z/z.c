@@ -5,14 +5,20 @@
 #endif                  /* ifndef _DEFAULT_SOURCE */
 
 #include <assert.h>
+#include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <linux/limits.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 
-#include "../defines.h" // used for NCSH_MAX_INPUT
+#include "../defines.h" // used for NCSH_MAX_INPUT and NCSH_Z_THREADS
 #include "../ttyio/ttyio.h"
 #include "fzf.h"
 #include "z.h"
@@ -37,6 +43,357 @@ double z_score(z_Directory* restrict directory, int fzf_score, time_t now)
     }
 }
 
+/* The match index
+ * Each directory has a mask of the characters in its path, case folded, and the trigrams of its path's components
+ * are in a table of the ids of the directories containing them. Every character of a term is in the paths it
+ * matches, fuzzy or not, so directories whose mask is missing one are skipped without being scored. Exact, prefix,
+ * suffix, and equal terms are also substrings of the paths they match, so only the directories in the postings of
+ * each of their trigrams are looked at.
+ */
+#define Z_DATABASE_MIN 64
+#define Z_TRIGRAMS_MIN 1024
+#define Z_TRIGRAM_IDS_MIN 4
+#define Z_FZF_SLAB_SIZE 64 // too small for fzf's v2 fuzzy matcher for most paths, so they're scored by v1
+
+[[nodiscard]]
+static inline unsigned char z_fold(char c)
+{
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c - 'A' + 'a') : (unsigned char)c;
+}
+
+/* z_mask
+ * Letters and digits get a bit each, every other byte shares the rest.
+ * Returns: the mask of the characters in the first len bytes of s
+ */
+[[nodiscard]]
+static uint64_t z_mask(const char* restrict s, size_t len)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = z_fold(s[i]);
+        if (c >= 'a' && c <= 'z') {
+            mask |= (uint64_t)1 << (c - 'a');
+        }
+        else if (c >= '0' && c <= '9') {
+            mask |= (uint64_t)1 << (26 + c - '0');
+        }
+        else {
+            mask |= (uint64_t)1 << (36 + c % 28);
+        }
+    }
+    return mask;
+}
+
+[[nodiscard]]
+static inline uint32_t z_trigram_key(const char* restrict p)
+{
+    return (uint32_t)z_fold(p[0]) << 16 | (uint32_t)z_fold(p[1]) << 8 | z_fold(p[2]);
+}
+
+[[nodiscard]]
+static inline bool z_trigram_valid(const char* restrict p)
+{
+    return p[0] != '/' && p[1] != '/' && p[2] != '/';
+}
+
+[[nodiscard]]
+static inline size_t z_trigram_bucket(uint32_t key, size_t capacity)
+{
+    return (size_t)((key * 0x9E3779B97F4A7C15UL) >> 32) & (capacity - 1);
+}
+
+/* z_trigram_find
+ * Returns: the slot of the trigram, or its empty slot if it isn't in the table. NULL if there is no table.
+ */
+[[nodiscard]]
+static z_Trigram* z_trigram_find(z_Database* restrict db, uint32_t key)
+{
+    if (!db->trigrams_cap) {
+        return NULL;
+    }
+    size_t i = z_trigram_bucket(key, db->trigrams_cap);
+    while (db->trigrams[i].key && db->trigrams[i].key != key) {
+        i = (i + 1) & (db->trigrams_cap - 1);
+    }
+    return db->trigrams + i;
+}
+
+static void z_trigrams_grow(z_Database* restrict db, Arena* restrict arena)
+{
+    z_Trigram* old = db->trigrams;
+    size_t old_cap = db->trigrams_cap;
+    db->trigrams_cap = old_cap ? old_cap * 2 : Z_TRIGRAMS_MIN;
+    db->trigrams = arena_malloc(arena, db->trigrams_cap, z_Trigram);
+    for (size_t i = 0; i < old_cap; ++i) {
+        if (old[i].key) {
+            *z_trigram_find(db, old[i].key) = old[i];
+        }
+    }
+}
+
+static void z_trigram_add(z_Database* restrict db, uint32_t key, uint32_t id, Arena* restrict arena)
+{
+    if ((db->trigrams_count + 1) * 2 > db->trigrams_cap) {
+        z_trigrams_grow(db, arena);
+    }
+
+    z_Trigram* trigram = z_trigram_find(db, key);
+    if (!trigram->key) {
+        trigram->key = key;
+        ++db->trigrams_count;
+    }
+    else if (trigram->len && trigram->ids[trigram->len - 1] == id) {
+        return; // the trigram is in the path more than once
+    }
+
+    if (trigram->len == trigram->cap) {
+        if (!trigram->cap) {
+            trigram->ids = arena_malloc(arena, Z_TRIGRAM_IDS_MIN, uint32_t);
+            trigram->cap = Z_TRIGRAM_IDS_MIN;
+        }
+        else {
+            trigram->ids = arena_realloc(arena, trigram->cap * 2, uint32_t, trigram->ids, trigram->cap);
+            trigram->cap *= 2;
+        }
+    }
+    trigram->ids[trigram->len++] = id;
+}
+
+/* z_index_add
+ * Index the directory at id, which is newer than every directory indexed.
+ */
+static void z_index_add(z_Database* restrict db, size_t id, Arena* restrict arena)
+{
+    Str path = db->dirs[id].path;
+    db->dirs[id].mask = z_mask(path.value, path.length - 1);
+    for (size_t i = 0; i + 3 < path.length; ++i) {
+        if (z_trigram_valid(path.value + i)) {
+            z_trigram_add(db, z_trigram_key(path.value + i), (uint32_t)id, arena);
+        }
+    }
+}
+
+/* z_index_remove
+ * Take the directory at id out of the index, the ids after it are shifted down like dirs.
+ */
+static void z_index_remove(z_Database* restrict db, size_t id)
+{
+    for (size_t i = 0; i < db->trigrams_cap; ++i) {
+        z_Trigram* trigram = db->trigrams + i;
+        if (!trigram->len || trigram->ids[trigram->len - 1] < id) {
+            continue;
+        }
+
+        uint32_t lo = 0;
+        uint32_t hi = trigram->len;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (trigram->ids[mid] < id) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        if (trigram->ids[lo] == id) {
+            memmove(trigram->ids + lo, trigram->ids + lo + 1, (trigram->len - lo - 1) * sizeof(uint32_t));
+            --trigram->len;
+        }
+        for (uint32_t j = lo; j < trigram->len; ++j) {
+            --trigram->ids[j];
+        }
+    }
+}
+
+static void z_index_clear(z_Database* restrict db)
+{
+    db->trigrams = NULL;
+    db->trigrams_cap = 0;
+    db->trigrams_count = 0;
+}
+
+/* z_lower
+ * Returns: path lowercased, path itself if it has no uppercase characters
+ */
+[[nodiscard]]
+static char* z_lower(Str path, Arena* restrict arena)
+{
+    size_t i = 0;
+    while (i < path.length && !isupper((unsigned char)path.value[i])) {
+        ++i;
+    }
+    if (i == path.length) {
+        return path.value;
+    }
+
+    char* lower = arena_malloc(arena, path.length, char);
+    memcpy(lower, path.value, i);
+    for (; i < path.length; ++i) {
+        lower[i] = (char)tolower((unsigned char)path.value[i]);
+    }
+    return lower;
+}
+
+/* z_directory_add
+ * Add a directory to the end of the database and index it.
+ */
+static void z_directory_add(z_Database* restrict db, z_Directory dir, Arena* restrict arena)
+{
+    if (!db->fzf) {
+        db->fzf = fzf_make_context((fzf_slab_config_t){Z_FZF_SLAB_SIZE, Z_FZF_SLAB_SIZE}, arena);
+    }
+    if (db->count == db->cap) {
+        if (!db->cap) {
+            db->dirs = arena_malloc(arena, Z_DATABASE_MIN, z_Directory);
+            db->cap = Z_DATABASE_MIN;
+        }
+        else {
+            db->dirs = arena_realloc(arena, db->cap * 2, z_Directory, db->dirs, db->cap);
+            db->cap *= 2;
+        }
+    }
+    dir.lower = z_lower(dir.path, arena);
+    db->dirs[db->count] = dir;
+    z_index_add(db, db->count, arena);
+    ++db->count;
+}
+
+/* z_term_indexed
+ * Returns: true if the term's trigrams are in every path it matches
+ */
+[[nodiscard]]
+static bool z_term_indexed(fzf_term_t* restrict term)
+{
+    return !term->inv && ((fzf_string_t*)term->text)->size >= 3 &&
+           (term->fn == fzf_exact_match_naive || term->fn == fzf_prefix_match || term->fn == fzf_suffix_match ||
+            term->fn == fzf_equal_match);
+}
+
+/* z_prefilter
+ * The masks of the terms of each set in the pattern. Sets with an inverse term can match any path, so have none.
+ */
+typedef struct {
+    size_t count;
+    uint64_t** masks;
+} z_Prefilter;
+
+[[nodiscard]]
+static z_Prefilter z_prefilter(fzf_pattern_t* restrict pattern, Arena* restrict scratch)
+{
+    z_Prefilter prefilter = {.count = pattern->size};
+    if (!pattern->size) {
+        return prefilter;
+    }
+
+    prefilter.masks = arena_malloc(scratch, pattern->size, uint64_t*);
+    for (size_t i = 0; i < pattern->size; ++i) {
+        fzf_term_set_t* set = pattern->ptr[i];
+        bool inv = false;
+        for (size_t j = 0; j < set->size; ++j) {
+            inv |= set->ptr[j].inv;
+        }
+        if (inv || !set->size) {
+            continue;
+        }
+
+        prefilter.masks[i] = arena_malloc(scratch, set->size, uint64_t);
+        for (size_t j = 0; j < set->size; ++j) {
+            fzf_string_t* text = set->ptr[j].text;
+            prefilter.masks[i][j] = z_mask(text->data, text->size);
+        }
+    }
+    return prefilter;
+}
+
+/* z_prefilter_match
+ * Returns: false if a path with this mask can't match the pattern
+ */
+[[nodiscard]]
+static bool z_prefilter_match(z_Prefilter* restrict prefilter, fzf_pattern_t* restrict pattern, uint64_t mask)
+{
+    for (size_t i = 0; i < prefilter->count; ++i) {
+        if (!prefilter->masks[i]) {
+            continue;
+        }
+        bool any = false;
+        for (size_t j = 0; j < pattern->ptr[i]->size && !any; ++j) {
+            any = !(prefilter->masks[i][j] & ~mask);
+        }
+        if (!any) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* z_candidates
+ * Intersect the postings of the trigrams of the pattern's indexed terms which are alone in their set.
+ * Returns: the number of ids in candidates, or SIZE_MAX with candidates untouched if the pattern has no indexed
+ * terms, and every directory is a candidate.
+ */
+[[nodiscard]]
+static size_t z_candidates(z_Database* restrict db, fzf_pattern_t* restrict pattern, uint32_t** restrict candidates,
+                           Arena* restrict scratch)
+{
+    size_t max = 0;
+    for (size_t i = 0; i < pattern->size; ++i) {
+        if (pattern->ptr[i]->size == 1 && z_term_indexed(pattern->ptr[i]->ptr)) {
+            max += ((fzf_string_t*)pattern->ptr[i]->ptr->text)->size - 2;
+        }
+    }
+    if (!max) {
+        return SIZE_MAX;
+    }
+
+    z_Trigram** postings = arena_malloc(scratch, max, z_Trigram*);
+    size_t count = 0;
+    for (size_t i = 0; i < pattern->size; ++i) {
+        if (pattern->ptr[i]->size != 1 || !z_term_indexed(pattern->ptr[i]->ptr)) {
+            continue;
+        }
+        fzf_string_t* text = pattern->ptr[i]->ptr->text;
+        for (size_t j = 0; j + 2 < text->size; ++j) {
+            if (!z_trigram_valid(text->data + j)) {
+                continue;
+            }
+            z_Trigram* trigram = z_trigram_find(db, z_trigram_key(text->data + j));
+            if (!trigram || !trigram->len) {
+                return 0;
+            }
+            postings[count++] = trigram;
+        }
+    }
+    if (!count) {
+        return SIZE_MAX; // every trigram crosses a slash
+    }
+
+    // walk the shortest postings, keeping ids found in all the others
+    size_t shortest = 0;
+    for (size_t i = 1; i < count; ++i) {
+        if (postings[i]->len < postings[shortest]->len) {
+            shortest = i;
+        }
+    }
+    uint32_t* positions = arena_malloc(scratch, count, uint32_t);
+    *candidates = arena_malloc(scratch, postings[shortest]->len, uint32_t);
+    size_t len = 0;
+    for (uint32_t k = 0; k < postings[shortest]->len; ++k) {
+        uint32_t id = postings[shortest]->ids[k];
+        bool all = true;
+        for (size_t i = 0; i < count && all; ++i) {
+            z_Trigram* trigram = postings[i];
+            while (positions[i] < trigram->len && trigram->ids[positions[i]] < id) {
+                ++positions[i];
+            }
+            all = positions[i] < trigram->len && trigram->ids[positions[i]] == id;
+        }
+        if (all) {
+            (*candidates)[len++] = id;
+        }
+    }
+    return len;
+}
+
 bool z_match_exists(Str* restrict target, z_Database* restrict db)
 {
     assert(db); assert(target); assert(target->value); assert(target->length > 0);
@@ -45,6 +402,7 @@ bool z_match_exists(Str* restrict target, z_Database* restrict db)
         if (estrcmp(*target, db->dirs[i].path)) {
             ++(db->dirs + i)->rank;
             (db->dirs + i)->last_accessed = time(NULL);
+            db->dirty = true;
             return true;
         }
     }
@@ -52,30 +410,42 @@ bool z_match_exists(Str* restrict target, z_Database* restrict db)
     return false;
 }
 
-z_Directory* z_match_find(Str* restrict target, char* restrict cwd, size_t cwd_length, z_Database* restrict db,
-                          Arena* restrict scratch)
+/* z_Search
+ * A z_match_find's query, and the directories it scores, the candidates or every directory if all.
+ * Read by every thread scoring it.
+ */
+typedef struct {
+    z_Database* db;
+    char* cwd;
+    size_t cwd_length;
+    fzf_pattern_t* pattern;
+    z_Prefilter prefilter;
+    uint32_t* candidates;
+    bool all;
+    size_t count;
+    time_t now;
+} z_Search;
+
+/* z_search_range
+ * Score the directories from begin to end of the search with the fzf context.
+ * Returns: the match with the best z score, the first of them when they tie, or a match without a dir
+ */
+static z_Match z_search_range(z_Search* restrict search, fzf_context_t* restrict fzf, size_t begin, size_t end)
 {
-    assert(target); assert(target->value); assert(target->length); assert(cwd); assert(cwd_length);
-    if (!db->count || cwd_length < 2) {
-        return NULL;
-    }
-
-    fzf_slab_t* slab = fzf_make_slab((fzf_slab_config_t){(size_t)1 << 6, 1 << 6}, scratch);
-    fzf_pattern_t* pattern = fzf_parse_pattern(target->value, target->length - 1, scratch);
+    z_Database* db = search->db;
     z_Match current_match = {0};
-    time_t now = time(NULL);
-#ifdef Z_DEBUG
-    tty_println("cwd %s, len %zu", cwd, cwd_length);
-#endif
-
-    for (size_t i = 0; i < db->count; ++i) {
-        if (!estrcmp_s(db->dirs[i].path, cwd, cwd_length)) {
-            int fzf_score =
-                fzf_get_score((db->dirs + i)->path.value, (db->dirs + i)->path.length - 1, pattern, slab, scratch);
+    for (size_t k = begin; k < end; ++k) {
+        size_t i = search->all ? k : search->candidates[k];
+        if (!z_prefilter_match(&search->prefilter, search->pattern, db->dirs[i].mask)) {
+            continue;
+        }
+        if (!estrcmp_s(db->dirs[i].path, search->cwd, search->cwd_length)) {
+            int fzf_score = fzf_context_score(fzf, db->dirs[i].path.value, db->dirs[i].lower,
+                                              db->dirs[i].path.length - 1);
             if (!fzf_score)
                 continue;
 
-            double potential_match_z_score = z_score((db->dirs + i), fzf_score, now);
+            double potential_match_z_score = z_score((db->dirs + i), fzf_score, search->now);
 #ifdef Z_DEBUG
             tty_println("%zu %s len: %zu", i, (db->dirs + i)->path.value, (db->dirs + i)->path.length);
             tty_println("%s fzf_score %d", (db->dirs + i)->path.value, fzf_score);
@@ -88,59 +458,317 @@ z_Directory* z_match_find(Str* restrict target, char* restrict cwd, size_t cwd_l
             }
         }
     }
+    return current_match;
+}
 
-#ifdef Z_DEBUG
-    tty_println("match %s", current_match.dir->path.value);
-#endif /* ifdef Z_DEBUG */
+/* The z thread pool
+ * Databases with at least parallel_min directories to score are split in contiguous ranges between the shell's thread
+ * and the pool's, each scoring its range with its own fzf context, so its own slab and scratch. The best match of each
+ * range is kept in order, only replaced by a strictly better one, which is the match scoring them one after the other
+ * finds, the first of those with the best score. The threads are started by the first z of a large enough database and
+ * wait for the next one after.
+ */
+typedef struct {
+    thrd_t thread;
+    z_Pool* pool;
+    size_t range; // the range of each search this thread scores, the shell's thread scores the first
+    fzf_context_t* fzf;
+    z_Match match;
+} z_Worker;
+
+struct z_Pool {
+    mtx_t lock;
+    cnd_t wake; // a search to score, or stop
+    cnd_t done; // every worker scored its range
+    uint64_t generation; // incremented for each search
+    size_t pending;
+    bool stop;
+    z_Search* search;
+    size_t workers_count;
+    z_Worker* workers;
+};
 
-    return current_match.dir;
+[[nodiscard]]
+static inline size_t z_range_begin(size_t count, size_t range, size_t ranges)
+{
+    return count / ranges * range + (range < count % ranges ? range : count % ranges);
 }
 
-enum z_Result z_write_entry(z_Directory* restrict dir, FILE* restrict file)
+static int z_worker(void* arg)
 {
-    assert(dir && file);
-
-    if (!dir->path.value) {
-        tty_puts("ncsh z: an entry couldn't be written to the z database.");
+    z_Worker* worker = arg;
+    z_Pool* pool = worker->pool;
+    uint64_t generation = 0;
+    for (;;) {
+        mtx_lock(&pool->lock);
+        while (!pool->stop && pool->generation == generation) {
+            cnd_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->stop) {
+            mtx_unlock(&pool->lock);
+            return 0;
+        }
+        generation = pool->generation;
+        z_Search* search = pool->search;
+        mtx_unlock(&pool->lock);
+
+        worker->fzf->pattern = search->pattern;
+        size_t ranges = pool->workers_count + 1;
+        worker->match = z_search_range(search, worker->fzf, z_range_begin(search->count, worker->range, ranges),
+                                       z_range_begin(search->count, worker->range + 1, ranges));
+
+        mtx_lock(&pool->lock);
+        if (!--pool->pending) {
+            cnd_signal(&pool->done);
+        }
+        mtx_unlock(&pool->lock);
     }
+}
+
+/* z_parallel_threads
+ * Returns: the number of threads to score large databases on, NCSH_Z_THREADS or the number of CPUs if fewer
+ */
+[[nodiscard]]
+static size_t z_parallel_threads(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 && (size_t)cpus < NCSH_Z_THREADS ? (size_t)cpus : NCSH_Z_THREADS;
+}
 
-    size_t bytes_written;
+/* z_parallel_start
+ * Start the threads z scores large databases with, threads - 1 of them to score with the shell's thread.
+ * When none can be started, parallel_min is set to 0 so every z after scores on the shell's thread without trying again.
+ */
+void z_parallel_start(z_Database* restrict db, size_t threads, Arena* restrict arena)
+{
+    assert(db); assert(!db->pool);
+    if (threads < 2) {
+        db->parallel_min = 0;
+        return;
+    }
 
-    bytes_written = fwrite(&dir->rank, sizeof(double), 1, file);
-    if (!bytes_written || feof(file)) {
-        return Z_ZERO_BYTES_READ;
+    z_Pool* pool = arena_malloc(arena, 1, z_Pool);
+    if (mtx_init(&pool->lock, mtx_plain) != thrd_success) {
+        db->parallel_min = 0;
+        return;
     }
-    else if (ferror(file)) {
-        return Z_FILE_ERROR;
+    if (cnd_init(&pool->wake) != thrd_success) {
+        mtx_destroy(&pool->lock);
+        db->parallel_min = 0;
+        return;
     }
+    if (cnd_init(&pool->done) != thrd_success) {
+        cnd_destroy(&pool->wake);
+        mtx_destroy(&pool->lock);
+        db->parallel_min = 0;
+        return;
+    }
+    pool->workers = arena_malloc(arena, threads - 1, z_Worker);
+
+    // the threads block every signal so they're handled by the main thread
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (size_t i = 0; i < threads - 1; ++i) {
+        z_Worker* worker = pool->workers + pool->workers_count;
+        *worker = (z_Worker){
+            .pool = pool,
+            .range = pool->workers_count + 1,
+            .fzf = fzf_make_context((fzf_slab_config_t){Z_FZF_SLAB_SIZE, Z_FZF_SLAB_SIZE}, arena),
+        };
+        if (thrd_create(&worker->thread, z_worker, worker) != thrd_success) {
+            break;
+        }
+        ++pool->workers_count;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
 
-    bytes_written = fwrite(&dir->last_accessed, sizeof(time_t), 1, file);
-    if (!bytes_written || feof(file)) {
-        return Z_ZERO_BYTES_READ;
+    if (!pool->workers_count) {
+        cnd_destroy(&pool->done);
+        cnd_destroy(&pool->wake);
+        mtx_destroy(&pool->lock);
+        db->parallel_min = 0;
+        return;
     }
-    else if (ferror(file)) {
-        return Z_FILE_ERROR;
+    db->pool = pool;
+}
+
+/* z_parallel_stop
+ * Stop the threads z scores large databases with and wait for them to exit.
+ */
+void z_parallel_stop(z_Database* restrict db)
+{
+    assert(db);
+    z_Pool* pool = db->pool;
+    if (!pool) {
+        return;
     }
 
-    bytes_written = fwrite(&dir->path.length, sizeof(uint32_t), 1, file);
-    if (!bytes_written || feof(file)) {
-        return Z_ZERO_BYTES_READ;
+    mtx_lock(&pool->lock);
+    pool->stop = true;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+    for (size_t i = 0; i < pool->workers_count; ++i) {
+        thrd_join(pool->workers[i].thread, NULL);
+        fzf_free_context(pool->workers[i].fzf);
     }
-    else if (ferror(file)) {
-        return Z_FILE_ERROR;
+    cnd_destroy(&pool->done);
+    cnd_destroy(&pool->wake);
+    mtx_destroy(&pool->lock);
+    db->pool = NULL;
+}
+
+/* z_parallel_search
+ * Score the search's first range on this thread while the pool's threads score the others.
+ * Returns: the best match of the search, the same one as scoring it on one thread
+ */
+static z_Match z_parallel_search(z_Pool* restrict pool, z_Search* restrict search, fzf_context_t* restrict fzf)
+{
+    size_t ranges = pool->workers_count + 1;
+    mtx_lock(&pool->lock);
+    pool->search = search;
+    pool->pending = pool->workers_count;
+    ++pool->generation;
+    cnd_broadcast(&pool->wake);
+    mtx_unlock(&pool->lock);
+
+    z_Match match = z_search_range(search, fzf, 0, z_range_begin(search->count, 1, ranges));
+
+    mtx_lock(&pool->lock);
+    while (pool->pending) {
+        cnd_wait(&pool->done, &pool->lock);
+    }
+    mtx_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->workers_count; ++i) {
+        z_Match* worker_match = &pool->workers[i].match;
+        if (worker_match->dir && (!match.dir || match.z_score < worker_match->z_score)) {
+            match = *worker_match;
+        }
     }
+    return match;
+}
 
-    bytes_written = fwrite(dir->path.value, sizeof(char), dir->path.length, file);
-    if (!bytes_written) {
-        return Z_ZERO_BYTES_READ;
+z_Directory* z_match_find(Str* restrict target, char* restrict cwd, size_t cwd_length, z_Database* restrict db,
+                          Arena* restrict scratch)
+{
+    assert(target); assert(target->value); assert(target->length); assert(cwd); assert(cwd_length);
+    if (!db->count || cwd_length < 2) {
+        return NULL;
     }
-    else if (ferror(file)) {
-        return Z_FILE_ERROR;
+
+    fzf_context_pattern(db->fzf, target->value, target->length - 1, scratch);
+    z_Search search = {.db = db, .cwd = cwd, .cwd_length = cwd_length, .pattern = db->fzf->pattern, .now = time(NULL)};
+    search.prefilter = z_prefilter(search.pattern, scratch);
+    size_t candidates_count = z_candidates(db, search.pattern, &search.candidates, scratch);
+    search.all = candidates_count == SIZE_MAX;
+    search.count = search.all ? db->count : candidates_count;
+#ifdef Z_DEBUG
+    tty_println("cwd %s, len %zu", cwd, cwd_length);
+    tty_println("candidates %zu of %zu", search.count, db->count);
+#endif
+
+    z_Match current_match = db->pool && db->parallel_min && search.count >= db->parallel_min
+                                ? z_parallel_search(db->pool, &search, db->fzf)
+                                : z_search_range(&search, db->fzf, 0, search.count);
+
+#ifdef Z_DEBUG
+    tty_println("match %s", current_match.dir->path.value);
+#endif /* ifdef Z_DEBUG */
+
+    return current_match.dir;
+}
+
+/* The z database file
+ * A header, the entries, then the paths they refer to by offset, each null terminated. The file is mapped read-only
+ * on startup and the paths are used in place, so loading it copies nothing. A checksum of everything after the header
+ * catches a corrupted file. It is written to a temporary file then renamed over the old one, so it's never half
+ * written, and a shell which mapped the old one keeps it intact. Fields are in the machine's byte order.
+ * Files without the magic are the old format, an entry at a time with no header but the count, and are read the
+ * old way, then written in the new format on exit.
+ */
+#define Z_DATABASE_MAGIC "NCSHZDB"
+#define Z_DATABASE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t paths_len;
+    uint64_t checksum;
+} z_Database_Header;
+
+typedef struct {
+    double rank;
+    int64_t last_accessed;
+    uint64_t path; // offset into the paths
+    uint64_t path_length; // includes the null terminator
+} z_Database_Entry;
+
+#define Z_FNV_OFFSET 14695981039346656037UL
+#define Z_FNV_PRIME 1099511628211UL
+
+[[nodiscard]]
+static uint64_t z_checksum(unsigned char* restrict bytes, size_t len)
+{
+    uint64_t hash = Z_FNV_OFFSET;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= Z_FNV_PRIME;
     }
+    return hash;
+}
 
+[[nodiscard]]
+static enum z_Result z_write_all(int fd, char* restrict buffer, size_t len)
+{
+    while (len) {
+        ssize_t bytes = write(fd, buffer, len);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return Z_FILE_ERROR;
+        }
+        buffer += bytes;
+        len -= (size_t)bytes;
+    }
     return Z_SUCCESS;
 }
 
+/* z_sync_dir
+ * Flush the directory holding path, so a file renamed into it stays renamed after a crash.
+ * Returns: Z_SUCCESS, or Z_FILE_ERROR if the directory couldn't be opened or flushed
+ */
+[[nodiscard]]
+static enum z_Result z_sync_dir(char* restrict path, size_t path_len)
+{
+    size_t dir_len = path_len;
+    while (dir_len && path[dir_len - 1] != '/') {
+        --dir_len;
+    }
+
+    char dir[NCSH_MAX_INPUT];
+    if (!dir_len) {
+        memcpy(dir, ".", sizeof("."));
+    }
+    else {
+        // keep the slash when the directory is the root
+        dir_len = dir_len == 1 ? 1 : dir_len - 1;
+        memcpy(dir, path, dir_len);
+        dir[dir_len] = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return Z_FILE_ERROR;
+    }
+    int rv = fsync(fd);
+    close(fd);
+    return rv ? Z_FILE_ERROR : Z_SUCCESS;
+}
+
 #define Z_ERROR_WRITING_TO_DB_MESSAGE "z: Error writing to z database file"
 
 enum z_Result z_write(z_Database* restrict db)
@@ -149,34 +777,71 @@ enum z_Result z_write(z_Database* restrict db)
     if (!db) {
         return Z_NULL_REFERENCE;
     }
-    if (!db->count) {
+    // without a database file, like when it couldn't be read, z still works until the shell exits
+    if (!db->dirty || !db->database_file) {
         return Z_SUCCESS;
     }
 
-    FILE* file = fopen(db->database_file, "wb");
-    if (!file || feof(file) || ferror(file)) {
+    size_t paths_len = 0;
+    for (size_t i = 0; i < db->count; ++i) {
+        paths_len += db->dirs[i].path.length;
+    }
+    size_t len = sizeof(z_Database_Header) + db->count * sizeof(z_Database_Entry) + paths_len;
+    char* buffer = malloc(len);
+    if (!buffer) {
+        return Z_MALLOC_ERROR;
+    }
+
+    z_Database_Entry* entries = (z_Database_Entry*)(void*)(buffer + sizeof(z_Database_Header));
+    char* paths = (char*)(entries + db->count);
+    uint64_t path = 0;
+    for (size_t i = 0; i < db->count; ++i) {
+        entries[i] = (z_Database_Entry){
+            .rank = db->dirs[i].rank,
+            .last_accessed = (int64_t)db->dirs[i].last_accessed,
+            .path = path,
+            .path_length = db->dirs[i].path.length,
+        };
+        memcpy(paths + path, db->dirs[i].path.value, db->dirs[i].path.length);
+        path += db->dirs[i].path.length;
+    }
+    z_Database_Header header = {
+        .magic = Z_DATABASE_MAGIC,
+        .version = Z_DATABASE_VERSION,
+        .count = (uint32_t)db->count,
+        .paths_len = paths_len,
+        .checksum = z_checksum((unsigned char*)entries, len - sizeof(z_Database_Header)),
+    };
+    memcpy(buffer, &header, sizeof(header));
+
+    // database_file is never longer than NCSH_MAX_INPUT, see z_database_file_set
+    size_t path_len = strlen(db->database_file);
+    char tmp_path[NCSH_MAX_INPUT + sizeof(".tmp")];
+    memcpy(tmp_path, db->database_file, path_len);
+    memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
         tty_perror(Z_ERROR_WRITING_TO_DB_MESSAGE);
-        if (file) {
-            fclose(file);
-        }
+        free(buffer);
         return Z_FILE_ERROR;
     }
-
-    if (!fwrite(&db->count, sizeof(uint32_t), 1, file) || feof(file) || ferror(file)) {
-        tty_perror("Error writing number of entries to z database file, could not write to database file");
-        fclose(file);
+    enum z_Result result = z_write_all(fd, buffer, len);
+    free(buffer);
+    // the data has to reach the disk before the rename does, or a crash can leave an empty database behind
+    if (result == Z_SUCCESS && fdatasync(fd)) {
+        result = Z_FILE_ERROR;
+    }
+    if (close(fd) || result != Z_SUCCESS || rename(tmp_path, db->database_file)) {
+        tty_perror(Z_ERROR_WRITING_TO_DB_MESSAGE);
+        unlink(tmp_path);
         return Z_FILE_ERROR;
     }
-
-    enum z_Result result;
-    for (size_t i = 0; i < db->count; ++i) {
-        if ((result = z_write_entry((db->dirs + i), file)) != Z_SUCCESS) {
-            fclose(file);
-            return result;
-        }
+    if (z_sync_dir(db->database_file, path_len) != Z_SUCCESS) {
+        tty_perror(Z_ERROR_WRITING_TO_DB_MESSAGE);
+        return Z_FILE_ERROR;
     }
 
-    fclose(file);
+    db->dirty = false;
     return Z_SUCCESS;
 }
 
@@ -202,6 +867,7 @@ enum z_Result z_read_entry(z_Directory* restrict dir, FILE* restrict file, Arena
     else if (ferror(file)) {
         return Z_FILE_ERROR;
     }
+    dir->path.length = 0;
     bytes_read = fread(&dir->path.length, sizeof(uint32_t), 1, file);
     if (!bytes_read || feof(file)) {
         return Z_ZERO_BYTES_READ;
@@ -209,14 +875,14 @@ enum z_Result z_read_entry(z_Directory* restrict dir, FILE* restrict file, Arena
     else if (ferror(file)) {
         return Z_FILE_ERROR;
     }
-    else if (dir->path.length == 0) {
+    else if (dir->path.length < 2 || dir->path.length > PATH_MAX) {
         return Z_FILE_ERROR;
     }
 
     dir->path.value = arena_malloc(arena, dir->path.length, char);
 
     bytes_read = fread(dir->path.value, sizeof(char), dir->path.length, file);
-    if (!bytes_read) {
+    if (bytes_read != dir->path.length) {
         return Z_ZERO_BYTES_READ;
     }
     else if (ferror(file)) {
@@ -224,77 +890,174 @@ enum z_Result z_read_entry(z_Directory* restrict dir, FILE* restrict file, Arena
     }
 
     dir->path.value[dir->path.length - 1] = '\0'; // Null-terminate the string
-    assert(strlen(dir->path.value) + 1 == dir->path.length);
+    dir->path.length = strlen(dir->path.value) + 1;
     return Z_SUCCESS;
 }
 
+#define Z_DB_CORRUPTED_MESSAGE "ncsh z: database file is corrupted, starting with an empty database."
+
+/* z_read_legacy
+ * Read a database file in the old format: the number of entries, then an entry at a time.
+ * Entries before one that can't be read are kept.
+ */
+static enum z_Result z_read_legacy(z_Database* restrict db, Arena* restrict arena)
+{
+    FILE* file = fopen(db->database_file, "rb");
+    if (!file) {
+        return Z_FILE_ERROR;
+    }
+
+    uint32_t number_of_entries = 0;
+    if (fread(&number_of_entries, sizeof(uint32_t), 1, file) != 1 || !number_of_entries) {
+        db->read_report = Z_READ_REPORT_CORRUPTED;
+        fclose(file);
+        return Z_SUCCESS;
+    }
+
+    for (uint32_t i = 0; i < number_of_entries; ++i) {
+        z_Directory dir = {0};
+        if (z_read_entry(&dir, file, arena) != Z_SUCCESS) {
+            db->read_report = Z_READ_REPORT_PARTLY_CORRUPTED;
+            break;
+        }
+        z_directory_add(db, dir, arena);
+    }
+
+    fclose(file);
+    db->dirty = true; // written in the new format on exit
+    return Z_SUCCESS;
+}
+
+/* z_read_map
+ * Check the mapped database file and use its entries, with their paths in place.
+ * Returns: false if the file is corrupted
+ */
+[[nodiscard]]
+static bool z_read_map(z_Database* restrict db, char* restrict map, size_t len, Arena* restrict arena)
+{
+    z_Database_Header* header = (z_Database_Header*)(void*)map;
+    size_t count = header->count;
+    if (header->version != Z_DATABASE_VERSION || count * sizeof(z_Database_Entry) > len - sizeof(*header) ||
+        header->paths_len != len - sizeof(*header) - count * sizeof(z_Database_Entry) ||
+        header->checksum != z_checksum((unsigned char*)(header + 1), len - sizeof(*header))) {
+        return false;
+    }
+
+    z_Database_Entry* entries = (z_Database_Entry*)(void*)(header + 1);
+    char* paths = (char*)(entries + count);
+    if (count > db->cap) {
+        db->dirs = arena_malloc(arena, count, z_Directory);
+        db->cap = count;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        z_Database_Entry* entry = entries + i;
+        if (entry->path > header->paths_len || entry->path_length < 2 ||
+            entry->path_length > header->paths_len - entry->path ||
+            memchr(paths + entry->path, '\0', entry->path_length) != paths + entry->path + entry->path_length - 1) {
+            return false;
+        }
+        z_directory_add(db,
+                        (z_Directory){
+                            .rank = entry->rank,
+                            .last_accessed = (time_t)entry->last_accessed,
+                            .path = Str(paths + entry->path, (size_t)entry->path_length),
+                        },
+                        arena);
+#ifdef Z_DEBUG
+        tty_println("Rank: %f", (db->dirs + i)->rank);
+        tty_println("Last accessed: %ld", (db->dirs + i)->last_accessed);
+        tty_println("Path: %s", (db->dirs + i)->path.value);
+#endif /* ifdef Z_DEBUG */
+    }
+    return true;
+}
+
 #define Z_CREATING_DB_FILE_MESSAGE "z: trying to create z database file."
 #define Z_CREATED_DB_FILE "z: created z database file."
-#define Z_NO_COUNT_HEADER                                                                                              \
-    "z: couldn't find number of entries header while trying to read z database file. File is empty or "           \
-    "corrupted."
 
-enum z_Result z_read(z_Database* restrict db, Arena* restrict arena)
+void z_read_report(z_Database* restrict db)
 {
-    FILE* file = fopen(db->database_file, "rb");
+    assert(db);
 
-    if (!file || feof(file) || ferror(file)) {
+    switch (db->read_report) {
+    case Z_READ_REPORT_NONE:
+        return;
+    case Z_READ_REPORT_CREATED:
+    case Z_READ_REPORT_NOT_CREATED:
+        errno = db->open_errno;
         tty_perror("z: z database file could not be found or opened");
         tty_writeln(Z_CREATING_DB_FILE_MESSAGE, sizeof(Z_CREATING_DB_FILE_MESSAGE) - 1);
-
-        file = fopen(db->database_file, "wb");
-
-        if (!file || ferror(file)) {
+        if (db->read_report == Z_READ_REPORT_NOT_CREATED) {
+            errno = db->create_errno;
             tty_perror("z: error creating z database file");
-            if (file) {
-                fclose(file);
-            }
         }
         else {
             tty_writeln(Z_CREATED_DB_FILE, sizeof(Z_CREATED_DB_FILE) - 1);
         }
+        break;
+    case Z_READ_REPORT_CORRUPTED:
+        tty_writeln(Z_DB_CORRUPTED_MESSAGE, sizeof(Z_DB_CORRUPTED_MESSAGE) - 1);
+        break;
+    case Z_READ_REPORT_PARTLY_CORRUPTED:
+        tty_puts("ncsh z: database file is corrupted, only the entries before the corruption were read.");
+        break;
+    }
+    db->read_report = Z_READ_REPORT_NONE;
+}
 
-        if (file) {
-            fclose(file);
+/* z_read
+ * Read the database file, nothing is printed, see z_read_report.
+ * Returns: Z_SUCCESS, or Z_FILE_ERROR if the database file can't be read
+ */
+enum z_Result z_read(z_Database* restrict db, Arena* restrict arena)
+{
+    int fd = open(db->database_file, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        db->open_errno = errno;
+        fd = open(db->database_file, O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+        if (fd == -1) {
+            db->create_errno = errno;
+            db->read_report = Z_READ_REPORT_NOT_CREATED;
+        }
+        else {
+            db->read_report = Z_READ_REPORT_CREATED;
+            close(fd);
         }
         return Z_SUCCESS;
     }
 
-    uint32_t number_of_entries = 0;
-    size_t bytes_read = fread(&number_of_entries, sizeof(uint32_t), 1, file);
-    if (!number_of_entries) {
-        tty_writeln(Z_NO_COUNT_HEADER, sizeof(Z_NO_COUNT_HEADER) - 1);
-        fclose(file);
-        return Z_SUCCESS;
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return Z_FILE_ERROR;
     }
-    else if (!bytes_read || ferror(file) || feof(file)) {
-        tty_writeln(Z_NO_COUNT_HEADER, sizeof(Z_NO_COUNT_HEADER) - 1);
-        fclose(file);
+    size_t len = (size_t)st.st_size;
+    if (!len) {
+        close(fd);
         return Z_SUCCESS;
     }
-
-    enum z_Result result;
-    for (uint32_t i = 0; i < number_of_entries && number_of_entries < Z_DATABASE_IN_MEMORY_LIMIT && !feof(file); ++i) {
-        if ((result = z_read_entry((db->dirs + i), file, arena)) != Z_SUCCESS) {
-            if (result == Z_ZERO_BYTES_READ) {
-                tty_puts("ncsh z: database file is corrupted, will try to read rest of file.");
-                --i;
-                continue;
-            }
-            tty_puts("ncsh z: database file is corrupted, file cannot be read.");
-            fclose(file);
-            return result;
-        }
-#ifdef Z_DEBUG
-        tty_println("Rank: %f", (db->dirs + i)->rank);
-        tty_println("Last accessed: %ld", (db->dirs + i)->last_accessed);
-        tty_println("Path: %s", (db->dirs + i)->path.value);
-#endif /* ifdef Z_DEBUG */
+    if (len < sizeof(z_Database_Header)) {
+        close(fd);
+        return z_read_legacy(db, arena);
     }
 
-    fclose(file);
+    // the paths are used from the mapping, which is never written to, and stays mapped while the shell runs
+    char* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return Z_FILE_ERROR;
+    }
+    if (memcmp(map, Z_DATABASE_MAGIC, sizeof(Z_DATABASE_MAGIC))) {
+        munmap(map, len);
+        return z_read_legacy(db, arena);
+    }
+    if (!z_read_map(db, map, len, arena)) {
+        munmap(map, len);
+        db->count = 0;
+        z_index_clear(db);
+        db->read_report = Z_READ_REPORT_CORRUPTED;
+    }
 
-    db->count = number_of_entries;
     return Z_SUCCESS;
 }
 
@@ -302,14 +1065,8 @@ enum z_Result z_write_entry_new(Str* restrict path, z_Database* restrict db, Are
 {
     assert(path); assert(path->value); assert(db); assert(path->length > 1); assert(path->value[path->length - 1] == '\0');
 
-    if (db->count == Z_DATABASE_IN_MEMORY_LIMIT) {
-        return Z_FAILURE;
-    }
-
-    db->dirs[db->count].path = *estrdup(path, arena);
-    ++db->dirs[db->count].rank;
-    db->dirs[db->count].last_accessed = time(NULL);
-    ++db->count;
+    z_directory_add(db, (z_Directory){.rank = 1, .last_accessed = time(NULL), .path = *estrdup(path, arena)}, arena);
+    db->dirty = true;
 
     return Z_SUCCESS;
 }
@@ -322,23 +1079,18 @@ enum z_Result z_database_add(Str* restrict path, char* restrict cwd, size_t cwd_
         return Z_NULL_REFERENCE;
     }
 
-    if (db->count + 1 >= Z_DATABASE_IN_MEMORY_LIMIT) {
-        return Z_HIT_MEMORY_LIMIT;
-    }
-
     assert(path && path->value[path->length - 1] == '\0');
     assert(strlen(path->value) + 1 == path->length);
     assert(cwd && cwd[cwd_length - 1] == '\0');
     assert(strlen(cwd) + 1 == cwd_length);
     assert(path->length + cwd_length > 0);
 
-    db->dirs[db->count].path = *estrjoin(&Str(cwd, cwd_length), path, '/', arena);
-    ++db->dirs[db->count].rank;
-    db->dirs[db->count].last_accessed = time(NULL);
-    ++db->count;
+    Str* full_path = estrjoin(&Str(cwd, cwd_length), path, '/', arena);
+    z_directory_add(db, (z_Directory){.rank = 1, .last_accessed = time(NULL), .path = *full_path}, arena);
+    db->dirty = true;
 
 #ifdef Z_DEBUG
-    tty_println("adding new value to db after memcpys %s", db->dirs[db->count].path.value);
+    tty_println("adding new value to db after memcpys %s", db->dirs[db->count - 1].path.value);
 #endif /* ifdef Z_DEBUG */
 
     return Z_SUCCESS;
@@ -477,6 +1229,10 @@ void z(Str* restrict target, char* restrict cwd, z_Database* restrict db, Arena*
         return;
     }
 
+    if (!db->pool && db->parallel_min && db->count >= db->parallel_min) {
+        z_parallel_start(db, z_parallel_threads(), arena);
+    }
+
     if (estrcmp_s(*target, home, strlen(home) + 1)) {
         if (chdir(home) == EOF) {
             tty_perror("z: couldn't change directory to home");
@@ -537,6 +1293,7 @@ void z(Str* restrict target, char* restrict cwd, z_Database* restrict db, Arena*
 
         match->last_accessed = time(NULL);
         ++match->rank;
+        db->dirty = true;
         return;
     }
 
@@ -607,7 +1364,9 @@ enum z_Result z_remove(Str* restrict path, z_Database* restrict db)
             (db->dirs + i)->rank = 0;
 
             z_remove_dirs_shift(i, db);
+            z_index_remove(db, i);
             --db->count;
+            db->dirty = true;
             tty_writeln(Z_ENTRY_REMOVED_MESSAGE, sizeof(Z_ENTRY_REMOVED_MESSAGE) - 1);
             return Z_SUCCESS;
         }
@@ -624,6 +1383,11 @@ enum z_Result z_exit(z_Database* restrict db)
         return Z_NULL_REFERENCE;
     }
 
+    z_parallel_stop(db);
+    if (db->fzf) {
+        fzf_free_context(db->fzf);
+    }
+
     enum z_Result result;
     if ((result = z_write(db)) != Z_SUCCESS) {
         tty_writeln(Z_ERROR_WRITING_TO_DB_MESSAGE, sizeof(Z_ERROR_WRITING_TO_DB_MESSAGE) - 1);
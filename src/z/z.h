@@ -6,13 +6,14 @@
 #ifndef Z_H_
 #define Z_H_
 
+#include <stdint.h>
 #include <time.h>
 
 #include "../arena.h"
 #include "../eskilib/str.h"
+#include "fzf.h"
 
 #define Z_DATABASE_FILE "_z_database.bin"
-#define Z_DATABASE_IN_MEMORY_LIMIT 200
 
 #define Z_SECOND 1
 #define Z_MINUTE 60 * Z_SECOND
@@ -25,6 +26,8 @@ typedef struct {
     double rank;
     time_t last_accessed;
     Str path;
+    uint64_t mask; // the characters in path, see z_mask
+    char* lower; // path lowercased for fzf, path's own value when it has no uppercase characters
 } z_Directory;
 
 typedef struct {
@@ -32,11 +35,55 @@ typedef struct {
     z_Directory* dir;
 } z_Match;
 
+/* z_Trigram
+ * The ids (indexes into dirs) of the directories with the trigram key in one of their path's components,
+ * in ascending order.
+ */
 typedef struct {
-    // bool dirty;
+    uint32_t key;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t* ids;
+} z_Trigram;
+
+typedef struct z_Pool z_Pool;
+
+/* z_Read_Report
+ * What reading the database has to tell the user, kept until z_read_report prints it on the main thread.
+ */
+enum z_Read_Report : uint8_t {
+    Z_READ_REPORT_NONE,
+    Z_READ_REPORT_CREATED, // the database file couldn't be opened, so an empty one was created
+    Z_READ_REPORT_NOT_CREATED, // the database file couldn't be opened or created
+    Z_READ_REPORT_CORRUPTED, // the database file is corrupted, so the database starts empty
+    Z_READ_REPORT_PARTLY_CORRUPTED, // only the entries before the corruption were read
+};
+
+typedef struct {
+    bool dirty; // changed since it was read, so it's written on exit
     size_t count;
+    size_t cap;
     char* database_file;
-    z_Directory dirs[Z_DATABASE_IN_MEMORY_LIMIT];
+    z_Directory* dirs;
+
+    // open addressing table of the trigrams in dirs, case folded, so z_match_find only scores directories which
+    // contain every trigram of an exact, prefix, suffix, or equal term
+    z_Trigram* trigrams;
+    size_t trigrams_cap;
+    size_t trigrams_count;
+
+    // the slab and scratch every z reuses to score the directories, made with the first directory
+    fzf_context_t* fzf;
+
+    // the threads scoring the directories with the shell's when there are at least parallel_min of them,
+    // NULL until z is first called with that many, parallel_min of 0 scores them all on the shell's thread,
+    // and is what it's set to if the threads can't be started
+    size_t parallel_min;
+    z_Pool* pool;
+
+    enum z_Read_Report read_report;
+    int open_errno; // why the database file couldn't be opened, and created
+    int create_errno;
 } z_Database;
 
 enum z_Result {
@@ -54,8 +101,17 @@ enum z_Result {
     Z_SUCCESS = 1
 };
 
+/* z_init
+ * Read the database file in the config location. Nothing is printed, so it can be called off the main thread,
+ * what the user should be told is printed by z_read_report.
+ */
 enum z_Result z_init(Str* restrict config_location, z_Database* restrict database, Arena* restrict arena);
 
+/* z_read_report
+ * Print what reading the database has to tell the user, like that it was corrupted.
+ */
+void z_read_report(z_Database* restrict db);
+
 void z(Str* restrict str, char* restrict cwd, z_Database* restrict db, Arena* restrict arena,
        Arena scratch_arena);
 
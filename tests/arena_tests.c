@@ -1,3 +1,5 @@
+#include <setjmp.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -85,6 +87,184 @@ void arena_realloc_non_char_test()
     ARENA_TEST_TEARDOWN;
 }
 
+#define ARENA_CHAIN_TEST_SETUP(cap)                                                                                    \
+    constexpr int chain_arena_capacity = 256;                                                                          \
+    char* chain_memory = malloc(chain_arena_capacity);                                                                 \
+    Arena arena = {.start = chain_memory, .end = chain_memory + (chain_arena_capacity)};                               \
+    arena_chain(&arena, cap);                                                                                          \
+    [[maybe_unused]] char* base_end = arena.end
+
+#define ARENA_CHAIN_TEST_TEARDOWN                                                                                      \
+    arena_chain_free(&arena);                                                                                          \
+    free(chain_memory)
+
+static bool arena_test_in(void* ptr, char* start, char* end)
+{
+    return (uintptr_t)ptr >= (uintptr_t)start && (uintptr_t)ptr < (uintptr_t)end;
+}
+
+void arena_chain_block_boundary_test()
+{
+    ARENA_CHAIN_TEST_SETUP(0);
+
+    char* values[8];
+    for (size_t i = 0; i < 8; ++i) {
+        values[i] = arena_malloc(&arena, 100, char);
+        memset(values[i], 'a' + (int)i, 100);
+    }
+
+    // the first allocations fit in the first block, the rest are in a chained block
+    eassert(arena_test_in(values[0], chain_memory, base_end));
+    eassert(!arena_test_in(values[7], chain_memory, base_end));
+    eassert(arena.end != base_end);
+    for (size_t i = 0; i < 8; ++i) {
+        for (size_t j = 0; j < 100; ++j) {
+            eassert(values[i][j] == 'a' + (int)i);
+        }
+    }
+
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+void arena_chain_alignment_test()
+{
+    ARENA_CHAIN_TEST_SETUP(0);
+
+    (void)arena_malloc(&arena, 250, char);
+    struct Test* value = arena_malloc(&arena, 4, struct Test);
+    eassert(!arena_test_in(value, chain_memory, base_end));
+    eassert(!((uintptr_t)value & (_Alignof(struct Test) - 1)));
+    eassert(!value[3].test);
+
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+void arena_chain_large_test()
+{
+    ARENA_CHAIN_TEST_SETUP(0);
+
+    constexpr size_t large = 1 << 20;
+    char* value = arena_malloc(&arena, large, char);
+    value[0] = 'a';
+    value[large - 1] = 'z';
+    eassert((size_t)(arena.end - value) >= large);
+
+    char* next = arena_malloc(&arena, 16, char);
+    eassert(next == value + large);
+
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+void arena_chain_realloc_test()
+{
+    ARENA_CHAIN_TEST_SETUP(0);
+
+    constexpr size_t initial_size = 20;
+    struct Test* test_values = arena_malloc(&arena, initial_size, struct Test);
+    eassert(arena_test_in(test_values, chain_memory, base_end));
+    for (size_t i = 0; i < initial_size; ++i) {
+        test_values[i].test = i * 100;
+    }
+
+    constexpr size_t new_size = 200;
+    struct Test* realloced_values = arena_realloc(&arena, new_size, struct Test, test_values, initial_size);
+    eassert(!arena_test_in(realloced_values, chain_memory, base_end));
+    for (size_t i = 0; i < initial_size; ++i) {
+        eassert(realloced_values[i].test == i * 100);
+    }
+    for (size_t i = initial_size; i < new_size; ++i) {
+        eassert(!realloced_values[i].test);
+    }
+
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+// copies of the arena, like scratch arenas passed by value, reuse the blocks chained by earlier copies
+void arena_chain_copy_reuse_test()
+{
+    ARENA_CHAIN_TEST_SETUP(0);
+
+    char* first = NULL;
+    for (size_t i = 0; i < 16; ++i) {
+        Arena scratch = arena;
+        (void)arena_malloc(&scratch, 200, char);
+        char* value = arena_malloc(&scratch, 1000, char);
+        eassert(!arena_test_in(value, chain_memory, base_end));
+        if (!first) {
+            first = value;
+        }
+        eassert(value == first);
+    }
+    eassert(arena.end == base_end);
+
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+static jmp_buf arena_test_jmp_buf;
+
+static void arena_test_abort()
+{
+    longjmp(arena_test_jmp_buf, 1);
+}
+
+void arena_chain_cap_test()
+{
+    ARENA_CHAIN_TEST_SETUP(1 << 17);
+    arena_abort_fn_set(arena_test_abort);
+
+    char* value = arena_malloc(&arena, 1 << 16, char);
+    eassert(value);
+
+    bool aborted = false;
+    if (!setjmp(arena_test_jmp_buf)) {
+        (void)arena_malloc(&arena, 1 << 17, char);
+    }
+    else {
+        aborted = true;
+    }
+    eassert(aborted);
+
+    arena_abort_fn_set(NULL);
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
+static size_t arena_test_aborts;
+
+static void arena_test_abort_returns()
+{
+    ++arena_test_aborts;
+}
+
+// an abort function which returns leaves the allocation NULL, chained or not
+void arena_abort_returns_test()
+{
+    char memory[64];
+    Arena arena = {.start = memory, .end = memory + sizeof(memory)};
+    arena_abort_fn_set(arena_test_abort_returns);
+    arena_test_aborts = 0;
+
+    eassert(!arena_malloc(&arena, 128, char));
+    char* value = arena_malloc(&arena, 16, char);
+    eassert(value);
+    char* grown = arena_realloc(&arena, 128, char, value, 16);
+    eassert(!grown);
+    eassert(arena_test_aborts == 2);
+    arena_abort_fn_set(NULL);
+}
+
+void arena_chain_abort_returns_test()
+{
+    ARENA_CHAIN_TEST_SETUP(1 << 17);
+    arena_abort_fn_set(arena_test_abort_returns);
+    arena_test_aborts = 0;
+
+    eassert(!arena_malloc(&arena, 1 << 18, char));
+    eassert(arena_test_aborts == 1);
+
+    arena_abort_fn_set(NULL);
+    ARENA_CHAIN_TEST_TEARDOWN;
+}
+
 void arena_tests()
 {
     etest_start();
@@ -93,6 +273,14 @@ void arena_tests()
     etest_run(arena_malloc_multiple_test);
     etest_run(arena_realloc_test);
     etest_run(arena_realloc_non_char_test);
+    etest_run(arena_chain_block_boundary_test);
+    etest_run(arena_chain_alignment_test);
+    etest_run(arena_chain_large_test);
+    etest_run(arena_chain_realloc_test);
+    etest_run(arena_chain_copy_reuse_test);
+    etest_run(arena_chain_cap_test);
+    etest_run(arena_abort_returns_test);
+    etest_run(arena_chain_abort_returns_test);
 
     etest_finish();
 }
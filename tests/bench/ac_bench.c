@@ -1,203 +1,376 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
 #include "../../src/defines.h" // used for macro NCSH_MAX_AUTOCOMPLETION_MATCHES
 #include "../etest.h"
 #include "../../src/io/ac.h"
 #include "../lib/arena_test_helper.h"
 
+static char* entries[] = {
+    "ls",
+    "ls | wc -c",
+    "ls | sort",
+    "ls | sort | wc -c",
+    "ls > t.txt",
+    "cat t.txt",
+    "rm t.txt",
+    "ss",
+    "nvim",
+    "nvim .",
+    "ls",
+    "ls",
+    "z ncsh",
+    "make ud",
+    "ls -a",
+    "echo hello",
+    "version",
+    "history",
+    "./bin/ncsh",
+    "z ncsh2",
+    "nvim src/io/io.c",
+    "nvim .",
+    "git diff",
+    "git restore",
+    "git restore src/io.c",
+    "git restore src/io/io.c",
+    "nvim src/arena.c",
+    "z print",
+    "z rm /home/alex/io",
+    "z rm /home/alex/io/usr/local",
+    "z rm /home/alex/ncsh/development/cash",
+    "z rm /home/alex/ncsh/development/curses",
+    "z rm /home/alex/../",
+    "z io",
+    "pwd",
+    "z",
+    "nvim makefile",
+    "git diff makefile",
+    "git restore makefile",
+    "git pull origin main",
+    "z eskilib",
+    "git config pull.rebase true",
+    "nvim src/z/z.c",
+    "nvim src/io/input.c",
+    "nvim src/ncsh.c",
+    "echo 'hello'",
+    "nvim src/vm",
+    "ls | sort",
+    "nvim src/defines.h",
+    "ls -a --color",
+    "m l",
+    "m check",
+    "nvim src/z/fzf.c",
+    "nvim src/vm/vm.c",
+    "make",
+    "sudo make install",
+    "cd ncsh2",
+    "make -B",
+    "git branch",
+    "git add .",
+    "nvim .gitignore",
+    "git rm Z_CORPUS",
+    "git rm -r Z_CORPUS",
+    "git rm -r Z_ADD_CORPUS",
+    "git push -u origin fuzz-testing-and-longjmp",
+    "cd ..",
+    "git clone https://github.com/a-eski/ncsh.git ./ncsh3",
+    "cd ncsh3",
+    "z ncsh3",
+    "z '.config'",
+    "cd nvim",
+    "git stash",
+    "z ..",
+    "cd ncsh",
+    "z rm /home/alex/ncsh2/ncsh3",
+    "m fz",
+    "z rm /home/alex/ncsh2/ncsh2",
+    "make clean",
+    "z src",
+    "vv",
+    "cd src",
+    "z ncsh2/src",
+    "z rm /home/alex/ncsh3/ncsh2",
+    "z rm /home/alex/ncsh2/eskilib",
+    "nvim ncsh",
+    "nvim src/io",
+    "nvim src/io/terminal.c",
+    ":w",
+    "git restore src/io/terminal.c",
+    "clear",
+    "make l",
+    "nvim src",
+    "git switch -c sigwinch",
+    "make fuzz_parser",
+    "nvim io.c",
+    "history rm vim",
+    "history rm 'vim .'",
+    "nvim README.md",
+    "make fuzz_history",
+    "/bin/bash",
+    "git push -u origin sigwinch",
+    "nvim src/io/autocompletions.c",
+    "m ba",
+    "make tac",
+    "make ba",
+    "git commit -m 'trie optimizations: switch back impl'",
+    "git push",
+    "git rm Z_CORPUS/.gitignore",
+    "git rm Z_ADD_CORPUS",
+    "git rm Z_ADD_CORPUS/.gitignore",
+    "git rm NCSH_AUTOCOMPLETIONS_CORPUS/.gitignore",
+    "git rm NCSH_AUTOCOMPLETIONS_CORPUS",
+    "git rm NCSH_HISTORY_CORPUS/.gitignore",
+    "git rm NCSH_PARSER_CORPUS/.gitignore",
+    "nvim",
+    "nvim src/noninteractive.c",
+    "make bpv",
+    "make thta",
+    "git restore *",
+    "git restore tests/autocompletions_tests.c",
+    "git restore src/io/history.h",
+    "nvim src/vm/vm.c",
+    "nvim src/io/ncreadlin.c",
+    "nvim src/io/ncio.c",
+    "nvim tests",
+    "make at",
+    "nvim acceptance_tests/tests",
+    "nvim acceptance_tests/tests/common.rb",
+    "ls",
+    "ls",
+    "ls -a",
+    "nvim .",
+    "nvim .",
+    "nvim .",
+    "git diff",
+    "nvim src/io/io.c",
+    "nvim .",
+    "z ncsh2",
+    "nvim src/io/io.c",
+    "nvim src",
+    "git stash pop",
+    "nvim .",
+    "make ud",
+    "./bin/ncsh",
+    "git diff",
+    "nvim src/io",
+    "git stash pop",
+    "nvim .",
+    "make l",
+    "ls -a --color",
+    "version",
+};
+
+static char* searches[] = {
+    "l", "ls", "n", "nv", "nvi", "nvim", "v", "ve", "m", "ma",
+    "mak", "make", "g", "gi", "git", "git ", "git d", "git di", "git dif", "git diff",
+};
+
+constexpr size_t entries_count = sizeof(entries) / sizeof(*entries);
+constexpr size_t searches_count = sizeof(searches) / sizeof(*searches);
+
+static Autocompletion_Node* ac_bench_tree(Arena* restrict arena)
+{
+    Autocompletion_Node* tree = ac_alloc(arena);
+    assert(tree);
+
+    for (size_t i = 0; i < entries_count; ++i) {
+        ac_add(entries[i], strlen(entries[i]) + 1, tree, arena);
+    }
+
+    return tree;
+}
+
 void ac_bench()
 {
     ARENA_TEST_SETUP;
     SCRATCH_ARENA_TEST_SETUP;
 
-    Autocompletion_Node* tree = ac_alloc(&arena);
-    eassert(tree != NULL);
-
-    ac_add("ls", sizeof("ls"), tree, &arena);
-    ac_add("ls | wc -c", sizeof("ls | wc -c"), tree, &arena);
-    ac_add("ls | sort", sizeof("ls | sort"), tree, &arena);
-    ac_add("ls | sort | wc -c", sizeof("ls | sort | wc -c"), tree, &arena);
-    ac_add("ls > t.txt", sizeof("ls > t.txt"), tree, &arena);
-    ac_add("cat t.txt", sizeof("cat t.txt"), tree, &arena);
-    ac_add("rm t.txt", sizeof("rm t.txt"), tree, &arena);
-    ac_add("ss", sizeof("ss"), tree, &arena);
-    ac_add("nvim", sizeof("nvim"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("ls", sizeof("ls"), tree, &arena);
-    ac_add("ls", sizeof("ls"), tree, &arena);
-    ac_add("z ncsh", sizeof("z ncsh"), tree, &arena);
-    ac_add("make ud", sizeof("make ud"), tree, &arena);
-    ac_add("ls -a", sizeof("ls -a"), tree, &arena);
-    ac_add("echo hello", sizeof("echo hello"), tree, &arena);
-    ac_add("version", sizeof("version"), tree, &arena);
-    ac_add("history", sizeof("history"), tree, &arena);
-    ac_add("./bin/ncsh", sizeof("./bin/ncsh"), tree, &arena);
-    ac_add("z ncsh2", sizeof("z ncsh2"), tree, &arena);
-    ac_add("nvim src/io/io.c", sizeof("nvim src/io/io.c"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("git diff", sizeof("git diff"), tree, &arena);
-    ac_add("git restore", sizeof("git restore"), tree, &arena);
-    ac_add("git restore src/io.c", sizeof("git restore src/io.c"), tree, &arena);
-    ac_add("git restore src/io/io.c", sizeof("git restore src/io/io.c"), tree,
-           &arena);
-    ac_add("nvim src/arena.c", sizeof("nvim src/arena.c"), tree, &arena);
-    ac_add("z print", sizeof("z print"), tree, &arena);
-    ac_add("z rm /home/alex/io", sizeof("z rm /home/alex/io"), tree, &arena);
-    ac_add("z rm /home/alex/io/usr/local", sizeof("z rm /home/alex/io/usr/local"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh/development/cash", sizeof("z rm /home/alex/ncsh/development/cash"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh/development/curses", sizeof("z rm /home/alex/ncsh/development/curses"), tree, &arena);
-    ac_add("z rm /home/alex/../", sizeof("z rm /home/alex/../"), tree, &arena);
-    ac_add("z io", sizeof("z io"), tree, &arena);
-    ac_add("pwd", sizeof("pwd"), tree, &arena);
-    ac_add("z", sizeof("z"), tree, &arena);
-    ac_add("nvim makefile", sizeof("nvim makefile"), tree, &arena);
-    ac_add("git diff makefile", sizeof("git diff makefile"), tree, &arena);
-    ac_add("git restore makefile", sizeof("git restore makefile"), tree, &arena);
-    ac_add("git pull origin main", sizeof("git pull origin main"), tree, &arena);
-    ac_add("z eskilib", sizeof("z eskilib"), tree, &arena);
-    ac_add("git config pull.rebase true", sizeof("git config pull.rebase true"), tree, &arena);
-    ac_add("nvim src/z/z.c", sizeof("nvim src/z/z.c"), tree, &arena);
-    ac_add("nvim src/io/input.c", sizeof("nvim src/io/input.c"), tree, &arena);
-    ac_add("nvim src/ncsh.c", sizeof("nvim src/ncsh.c"), tree, &arena);
-    ac_add("echo 'hello'", sizeof("echo 'hello'"), tree, &arena);
-    ac_add("nvim src/vm", sizeof("nvim src/vm"), tree, &arena);
-    ac_add("ls | sort", sizeof("ls | sort"), tree, &arena);
-    ac_add("nvim src/defines.h", sizeof("nvim src/defines.h"), tree, &arena);
-    ac_add("ls -a --color", sizeof("ls -a --color"), tree, &arena);
-    ac_add("m l", sizeof("m l"), tree, &arena);
-    ac_add("m check", sizeof("m check"), tree, &arena);
-    ac_add("nvim src/z/fzf.c", sizeof("nvim src/z/fzf.c"), tree, &arena);
-    ac_add("nvim src/vm/vm.c", sizeof("nvim src/vm/vm.c"), tree, &arena);
-    ac_add("make", sizeof("make"), tree, &arena);
-    ac_add("sudo make install", sizeof("sudo make install"), tree, &arena);
-    ac_add("cd ncsh2", sizeof("cd ncsh2"), tree, &arena);
-    ac_add("make -B", sizeof("make -B"), tree, &arena);
-    ac_add("git branch", sizeof("git branch"), tree, &arena);
-    ac_add("git add .", sizeof("git add ."), tree, &arena);
-    ac_add("nvim .gitignore", sizeof("nvim .gitignore"), tree, &arena);
-    ac_add("git rm Z_CORPUS", sizeof("git rm Z_CORPUS"), tree, &arena);
-    ac_add("git rm -r Z_CORPUS", sizeof("git rm -r Z_CORPUS"), tree, &arena);
-    ac_add("git rm -r Z_ADD_CORPUS", sizeof("git rm -r Z_ADD_CORPUS"), tree, &arena);
-    ac_add("git push -u origin fuzz-testing-and-longjmp", sizeof("git push -u origin fuzz-testing-and-longjmp"), tree,
-           &arena);
-    ac_add("cd ..", sizeof("cd .."), tree, &arena);
-    ac_add("git clone https://github.com/a-eski/ncsh.git ./ncsh3",
-           sizeof("git clone https://github.com/a-eski/ncsh.git ./ncsh3"), tree, &arena);
-    ac_add("cd ncsh3", sizeof("cd ncsh3"), tree, &arena);
-    ac_add("z ncsh3", sizeof("z ncsh3"), tree, &arena);
-    ac_add("z '.config'", sizeof("z '.config'"), tree, &arena);
-    ac_add("cd nvim", sizeof("cd nvim"), tree, &arena);
-    ac_add("git stash", sizeof("git stash"), tree, &arena);
-    ac_add("z ..", sizeof("z .."), tree, &arena);
-    ac_add("cd ncsh", sizeof("cd ncsh"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh2/ncsh3", sizeof("z rm /home/alex/ncsh2/ncsh3"), tree, &arena);
-    ac_add("m fz", sizeof("m fz"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh2/ncsh2", sizeof("z rm /home/alex/ncsh2/ncsh2"), tree, &arena);
-    ac_add("make clean", sizeof("make clean"), tree, &arena);
-    ac_add("z src", sizeof("z src"), tree, &arena);
-    ac_add("vv", sizeof("vv"), tree, &arena);
-    ac_add("cd src", sizeof("cd src"), tree, &arena);
-    ac_add("z ncsh2/src", sizeof("z ncsh2/src"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh3/ncsh2", sizeof("z rm /home/alex/ncsh3/ncsh2"), tree, &arena);
-    ac_add("z rm /home/alex/ncsh2/eskilib", sizeof("z rm /home/alex/ncsh2/eskilib"), tree, &arena);
-    ac_add("nvim ncsh", sizeof("nvim ncsh"), tree, &arena);
-    ac_add("nvim src/io", sizeof("nvim src/io"), tree, &arena);
-    ac_add("nvim src/io/terminal.c", sizeof("nvim src/io/terminal.c"), tree, &arena);
-    ac_add(":w", sizeof(":w"), tree, &arena);
-    ac_add("git restore src/io/terminal.c", sizeof("git restore src/io/terminal.c"), tree,
-           &arena);
-    ac_add("clear", sizeof("clear"), tree, &arena);
-    ac_add("make l", sizeof("make l"), tree, &arena);
-    ac_add("nvim src", sizeof("nvim src"), tree, &arena);
-    ac_add("git switch -c sigwinch", sizeof("git switch -c sigwinch"), tree, &arena);
-    ac_add("make fuzz_parser", sizeof("make fuzz_parser"), tree, &arena);
-    ac_add("nvim io.c", sizeof("nvim io.c"), tree, &arena);
-    ac_add("history rm vim", sizeof("history rm vim"), tree, &arena);
-    ac_add("history rm 'vim .'", sizeof("history rm 'vim .'"), tree, &arena);
-    ac_add("nvim README.md", sizeof("nvim README.md"), tree, &arena);
-    ac_add("make fuzz_history", sizeof("make fuzz_history"), tree, &arena);
-    ac_add("/bin/bash", sizeof("/bin/bash"), tree, &arena);
-    ac_add("git push -u origin sigwinch", sizeof("git push -u origin sigwinch"), tree, &arena);
-    ac_add("nvim src/io/autocompletions.c", sizeof("nvim src/io/autocompletions.c"), tree,
-           &arena);
-    ac_add("m ba", sizeof("m ba"), tree, &arena);
-    ac_add("make tac", sizeof("make tac"), tree, &arena);
-    ac_add("make ba", sizeof("make ba"), tree, &arena);
-    ac_add("git commit -m 'trie optimizations: switch back impl'",
-           sizeof("git commit -m 'trie optimizations: switch back impl'"), tree, &arena);
-    ac_add("git push", sizeof("git push"), tree, &arena);
-    ac_add("git rm Z_CORPUS/.gitignore", sizeof("git rm Z_CORPUS/.gitignore"), tree, &arena);
-    ac_add("git rm Z_ADD_CORPUS", sizeof("git rm Z_ADD_CORPUS"), tree, &arena);
-    ac_add("git rm Z_ADD_CORPUS/.gitignore", sizeof("git rm Z_ADD_CORPUS/.gitignore"), tree, &arena);
-    ac_add("git rm NCSH_AUTOCOMPLETIONS_CORPUS/.gitignore", sizeof("git rm NCSH_ac_CORPUS/.gitignore"), tree, &arena);
-    ac_add("git rm NCSH_AUTOCOMPLETIONS_CORPUS", sizeof("git rm NCSH_AUTOCOMPLETIONS_CORPUS"), tree, &arena);
-    ac_add("git rm NCSH_HISTORY_CORPUS/.gitignore", sizeof("git rm NCSH_HISTORY_CORPUS/.gitignore"), tree, &arena);
-    ac_add("git rm NCSH_PARSER_CORPUS/.gitignore", sizeof("git rm NCSH_PARSER_CORPUS/.gitignore"), tree, &arena);
-    ac_add("nvim", sizeof("nvim"), tree, &arena);
-    ac_add("nvim src/noninteractive.c", sizeof("nvim src/noninteractive.c"), tree, &arena);
-    ac_add("make bpv", sizeof("make bpv"), tree, &arena);
-    ac_add("make thta", sizeof("make thta"), tree, &arena);
-    ac_add("git restore *", sizeof("git restore *"), tree, &arena);
-    ac_add("git restore tests/autocompletions_tests.c", sizeof("git restore tests/ac_tests.c"), tree, &arena);
-    ac_add("git restore src/io/history.h", sizeof("git restore src/io/history.h"), tree, &arena);
-    ac_add("nvim src/vm/vm.c", sizeof("nvim src/vm/vm.c"), tree, &arena);
-    ac_add("nvim src/io/ncreadlin.c", sizeof("nvim src/io/ncreadlin.c"), tree, &arena);
-    ac_add("nvim src/io/ncio.c", sizeof("nvim src/io/ncio.c"), tree, &arena);
-    ac_add("nvim tests", sizeof("nvim tests"), tree, &arena);
-    ac_add("make at", sizeof("make at"), tree, &arena);
-    ac_add("nvim acceptance_tests/tests", sizeof("nvim acceptance_tests/tests"), tree, &arena);
-    ac_add("nvim acceptance_tests/tests/common.rb", sizeof("nvim acceptance_tests/tests/common.rb"), tree, &arena);
-    ac_add("ls", sizeof("ls"), tree, &arena);
-    ac_add("ls", sizeof("ls"), tree, &arena);
-    ac_add("ls -a", sizeof("ls -a"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("git diff", sizeof("git diff"), tree, &arena);
-    ac_add("nvim src/io/io.c", sizeof("nvim src/io/io.c"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("z ncsh2", sizeof("z ncsh2"), tree, &arena);
-    ac_add("nvim src/io/io.c", sizeof("nvim src/io/io.c"), tree, &arena);
-    ac_add("nvim src", sizeof("nvim src"), tree, &arena);
-    ac_add("git stash pop", sizeof("git stash pop"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("make ud", sizeof("make ud"), tree, &arena);
-    ac_add("./bin/ncsh", sizeof("./bin/ncsh"), tree, &arena);
-    ac_add("git diff", sizeof("git diff"), tree, &arena);
-    ac_add("nvim src/io", sizeof("nvim src/io"), tree, &arena);
-    ac_add("git stash pop", sizeof("git stash pop"), tree, &arena);
-    ac_add("nvim .", sizeof("nvim ."), tree, &arena);
-    ac_add("make l", sizeof("make l"), tree, &arena);
-    ac_add("ls -a --color", sizeof("ls -a --color"), tree, &arena);
-    ac_add("version", sizeof("version"), tree, &arena);
+    Autocompletion_Node* tree = ac_bench_tree(&arena);
 
     Autocompletion autocomplete[NCSH_MAX_AUTOCOMPLETION_MATCHES] = {0};
-
-    uint8_t match_count = ac_get("l", autocomplete, tree, scratch_arena);
-    match_count = ac_get("ls", autocomplete, tree, scratch_arena);
-    match_count = ac_get("n", autocomplete, tree, scratch_arena);
-    match_count = ac_get("nv", autocomplete, tree, scratch_arena);
-    match_count = ac_get("nvi", autocomplete, tree, scratch_arena);
-    match_count = ac_get("nvim", autocomplete, tree, scratch_arena);
-    match_count = ac_get("v", autocomplete, tree, scratch_arena);
-    match_count = ac_get("ve", autocomplete, tree, scratch_arena);
-    match_count = ac_get("m", autocomplete, tree, scratch_arena);
-    match_count = ac_get("ma", autocomplete, tree, scratch_arena);
-    match_count = ac_get("mak", autocomplete, tree, scratch_arena);
-    match_count = ac_get("make", autocomplete, tree, scratch_arena);
-    match_count = ac_get("g", autocomplete, tree, scratch_arena);
-    match_count = ac_get("gi", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git ", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git d", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git di", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git dif", autocomplete, tree, scratch_arena);
-    match_count = ac_get("git diff", autocomplete, tree, scratch_arena);
+    uint8_t match_count = 0;
+    for (size_t i = 0; i < searches_count; ++i) {
+        match_count = ac_get(searches[i], autocomplete, tree, scratch_arena);
+    }
     eassert(match_count);
 
     ARENA_TEST_TEARDOWN;
     SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
-int main()
+static double ac_bench_ns(struct timespec start, struct timespec end)
+{
+    return (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+}
+
+// a history like the one bestline loads on startup, the entries with arguments that make each line unique
+static void ac_bench_history(size_t count, Autocompletion_Node* restrict tree, Arena* restrict arena)
+{
+    char line[NCSH_MAX_INPUT];
+    for (size_t i = 0; i < count; ++i) {
+        int len = snprintf(line, sizeof(line), "%s %zu", entries[i % entries_count], i / entries_count);
+        ac_add(line, (size_t)len + 1, tree, arena);
+    }
+}
+
+/* ac_bench_keystrokes
+ * Replays typing lines of a 10k line history one keystroke at a time, with a typo deleted by backspace every few
+ * characters, and prints the latency of getting the hint after each keystroke from the root and from a cursor.
+ */
+static void ac_bench_keystrokes(Arena* restrict arena)
+{
+    constexpr size_t history_count = 10000;
+    constexpr size_t lines_count = 500;
+    Autocompletion_Node* tree = ac_alloc(arena);
+    ac_bench_history(history_count, tree, arena);
+
+    // each line as the buffer looks after every keystroke
+    char* keystrokes = arena_malloc(arena, lines_count * NCSH_MAX_INPUT * 4, char);
+    size_t keystrokes_count = 0;
+    char* keystroke = keystrokes;
+    char line[NCSH_MAX_INPUT];
+    for (size_t i = 0; i < lines_count; ++i) {
+        int len = snprintf(line, sizeof(line), "%s %zu", entries[(i * 7) % entries_count], i % 80);
+        for (int j = 1; j <= len; ++j) {
+            memcpy(keystroke, line, (size_t)j);
+            keystroke[j] = '\0';
+            keystroke += j + 1;
+            ++keystrokes_count;
+            if (j % 6 == 0) {
+                memcpy(keystroke, line, (size_t)j);
+                memcpy(keystroke + j, "x", 2);
+                keystroke += j + 2;
+                ++keystrokes_count;
+                memcpy(keystroke, line, (size_t)j);
+                keystroke[j] = '\0';
+                keystroke += j + 1;
+                ++keystrokes_count;
+            }
+        }
+    }
+
+    char match[NCSH_MAX_INPUT];
+    size_t matches = 0;
+    struct timespec begin, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    keystroke = keystrokes;
+    for (size_t i = 0; i < keystrokes_count; ++i) {
+        matches += ac_first(keystroke, match, tree);
+        keystroke += strlen(keystroke) + 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("keystrokes: %zu, history entries: %zu\n", keystrokes_count, history_count);
+    printf("ac_first: %.0f ns per keystroke\n", ac_bench_ns(begin, end) / (double)keystrokes_count);
+
+    Autocompletion_Cursor cursor;
+    ac_cursor_init(&cursor, tree, match, arena);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    keystroke = keystrokes;
+    for (size_t i = 0; i < keystrokes_count; ++i) {
+        matches += ac_cursor_first(&cursor, keystroke);
+        keystroke += strlen(keystroke) + 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ac_cursor_first: %.0f ns per keystroke\n", ac_bench_ns(begin, end) / (double)keystrokes_count);
+    eassert(matches);
+}
+
+/* ac_bench_snapshot
+ * Prints how long it takes to get the trie for a 10k line history by adding every line and by loading a snapshot.
+ */
+static void ac_bench_snapshot(Arena* restrict arena, Arena scratch)
+{
+    constexpr size_t history_count = 10000;
+    char history_path[] = "/tmp/ncsh_ac_bench_history";
+    char ac_path[] = "/tmp/ncsh_ac_bench_history_ac";
+    FILE* history_file = fopen(history_path, "w");
+    eassert(history_file);
+    for (size_t i = 0; i < history_count; ++i) {
+        fprintf(history_file, "%s %zu\n", entries[i % entries_count], i / entries_count);
+    }
+    fclose(history_file);
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    Autocompletion_Node* tree = ac_alloc(arena);
+    ac_bench_history(history_count, tree, arena);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("rebuild from %zu history entries: %.0f us\n", history_count, ac_bench_ns(begin, end) / 1e3);
+
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch) == EXIT_SUCCESS);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    Autocompletion_Node* loaded = ac_snapshot_load(ac_path, history_path, arena);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    eassert(loaded);
+    printf("load snapshot of %zu history entries: %.0f us\n", history_count, ac_bench_ns(begin, end) / 1e3);
+
+    remove(ac_path);
+    remove(history_path);
+}
+
+/* ac_bench_stats
+ * Ran by 'make bench_ac_stats'. Prints the arena memory used per history entry, the latency of ac_get and ac_first,
+ * and the latency of hints while typing.
+ */
+void ac_bench_stats()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    char* start = arena.start;
+    Autocompletion_Node* tree = ac_bench_tree(&arena);
+    printf("entries: %zu, memory: %zu bytes, %zu bytes per entry\n", entries_count, (size_t)(arena.start - start),
+           (size_t)(arena.start - start) / entries_count);
+
+    constexpr size_t history_count = 2000;
+    Arena history_arena = arena;
+    Autocompletion_Node* history_tree = ac_alloc(&history_arena);
+    ac_bench_history(history_count, history_tree, &history_arena);
+    printf("history entries: %zu, memory: %zu bytes, %zu bytes per entry\n", history_count,
+           (size_t)(history_arena.start - arena.start), (size_t)(history_arena.start - arena.start) / history_count);
+
+    constexpr size_t rounds = 2000;
+    Autocompletion autocomplete[NCSH_MAX_AUTOCOMPLETION_MATCHES];
+    char match[NCSH_MAX_INPUT];
+    size_t matches = 0;
+    struct timespec begin, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < searches_count; ++i) {
+            memset(autocomplete, 0, sizeof(autocomplete));
+            matches += ac_get(searches[i], autocomplete, history_tree, scratch_arena);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ac_get: %.0f ns per lookup\n", ac_bench_ns(begin, end) / (double)(rounds * searches_count));
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < searches_count; ++i) {
+            matches += ac_first(searches[i], match, history_tree);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("ac_first: %.0f ns per lookup\n", ac_bench_ns(begin, end) / (double)(rounds * searches_count));
+    eassert(matches);
+
+    ac_bench_keystrokes(&arena);
+    ac_bench_snapshot(&arena, scratch_arena);
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+int main(int argc, char** argv)
 {
+    if (argc > 1 && !strcmp(argv[1], "stats")) {
+        ac_bench_stats();
+        return EXIT_SUCCESS;
+    }
+
     ac_bench();
 }
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../lib/arena_test_helper.h"
+#include "../../src/eskilib/emap.h"
+#include "../../src/eskilib/str.h"
+
+// Inserts and looks up count keys, the same total amount of operations is done for every count.
+// Ran with 50, 500, and 5000 keys by 'make bench_emap'.
+constexpr size_t emap_bench_ops = 1 << 20;
+
+void emap_bench(size_t count)
+{
+    ARENA_TEST_SETUP;
+
+    Str* keys = arena_malloc(&a, count, Str);
+    for (size_t i = 0; i < count; ++i) {
+        char* key = arena_malloc(&a, 24, char);
+        int len = snprintf(key, 24, "NCSH_VAR_%zu", i);
+        keys[i] = Str(key, (size_t)len + 1);
+    }
+
+    // insert: build a new map from scratch until emap_bench_ops keys have been added
+    size_t sum = 0;
+    for (size_t round = 0; round < emap_bench_ops / count; ++round) {
+        Arena map_arena = a;
+        Emap map;
+        emap_new(&map, 0, size_t, &map_arena);
+        for (size_t i = 0; i < count; ++i) {
+            *(size_t*)emap_add_or_get(&map, keys[i]) = i;
+        }
+        sum += map.count;
+    }
+
+    // lookup
+    Emap map;
+    emap_new(&map, 0, size_t, &a);
+    for (size_t i = 0; i < count; ++i) {
+        *(size_t*)emap_add_or_get(&map, keys[i]) = i;
+    }
+    for (size_t i = 0; i < emap_bench_ops; ++i) {
+        sum += *(size_t*)emap_get(&map, keys[i % count]);
+    }
+
+    if (!sum) {
+        puts("emap_bench: no keys");
+    }
+
+    ARENA_TEST_TEARDOWN;
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 50;
+    if (!count) {
+        return EXIT_FAILURE;
+    }
+
+    emap_bench(count);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/z/fzf.h"
+#include "../lib/arena_test_helper.h"
+
+// Ran by 'make bench_fzf'.
+constexpr size_t fzf_bench_paths = 100000;
+
+static char* roots[] = {"/home/alex/source/repos", "/home/alex/Documents", "/var/lib/docker/volumes", "/usr/local/src",
+                        "/mnt/c/Users/Alex/source/repos/PersonalRepos", "/opt/build/workspace"};
+static char* projects[] = {"ncsh", "linux", "llvm-project", "postgres", "redis", "nvim", "ttytest2", "curl",
+                           "sqlite", "fzf-native", "kubernetes", "ffmpeg"};
+static char* subdirs[] = {"src", "tests", "build", "docs", "include", "bin", "scripts", "lib", "out", "vendor"};
+
+static char* patterns[] = {"ncsh", "srcfzf", "kubtest", "'vendor", "qqq"};
+
+static char* level_names[] = {"scalar", "sse2", "avx2"};
+
+static double fzf_bench_ns(struct timespec begin, struct timespec end)
+{
+    return (double)(end.tv_sec - begin.tv_sec) * 1e9 + (double)(end.tv_nsec - begin.tv_nsec);
+}
+
+int main()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    char** paths = arena_malloc(&arena, fzf_bench_paths, char*);
+    size_t* lengths = arena_malloc(&arena, fzf_bench_paths, size_t);
+    for (size_t i = 0; i < fzf_bench_paths; ++i) {
+        char path[256];
+        int len = snprintf(path, sizeof(path), "%s/%s%zu/%s/%s%zu", roots[i % (sizeof(roots) / sizeof(*roots))],
+                           projects[i / 7 % (sizeof(projects) / sizeof(*projects))], i / 84 % 40,
+                           subdirs[i / 3 % (sizeof(subdirs) / sizeof(*subdirs))],
+                           subdirs[i % (sizeof(subdirs) / sizeof(*subdirs))], i / 1000);
+        paths[i] = arena_malloc(&arena, (size_t)len + 1, char);
+        memcpy(paths[i], path, (size_t)len + 1);
+        lengths[i] = (size_t)len;
+    }
+
+    printf("paths: %zu, best instruction set: %s\n", fzf_bench_paths, level_names[fzf_simd_best()]);
+    printf("| pattern | matches |");
+    for (enum fzf_simd level = FZF_SIMD_SCALAR; level <= fzf_simd_best(); ++level) {
+        printf(" %s ns per path |", level_names[level]);
+    }
+    printf("\n");
+
+    for (size_t p = 0; p < sizeof(patterns) / sizeof(*patterns); ++p) {
+        int64_t scalar_total = 0;
+        size_t matches = 0;
+        double ns[FZF_SIMD_AVX2 + 1];
+        for (enum fzf_simd level = FZF_SIMD_SCALAR; level <= fzf_simd_best(); ++level) {
+            fzf_simd_set(level);
+            Arena scratch = scratch_arena;
+            size_t len = strlen(patterns[p]);
+            char* pattern_copy = arena_malloc(&scratch, len + 1, char);
+            memcpy(pattern_copy, patterns[p], len);
+            fzf_pattern_t* pattern = fzf_parse_pattern(pattern_copy, len, &scratch);
+            fzf_slab_t* slab = fzf_make_default_slab(&scratch);
+
+            int64_t total = 0;
+            size_t level_matches = 0;
+            struct timespec begin, end;
+            clock_gettime(CLOCK_MONOTONIC, &begin);
+            for (size_t i = 0; i < fzf_bench_paths; ++i) {
+                Arena path_scratch = scratch;
+                int32_t score = fzf_get_score(paths[i], lengths[i], pattern, slab, &path_scratch);
+                total += score;
+                level_matches += score > 0;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ns[level] = fzf_bench_ns(begin, end) / (double)fzf_bench_paths;
+
+            if (level == FZF_SIMD_SCALAR) {
+                scalar_total = total;
+                matches = level_matches;
+            }
+            else if (total != scalar_total) {
+                printf("fzf_bench: %s scored %s differently than scalar\n", level_names[level], patterns[p]);
+            }
+        }
+
+        printf("| %s | %zu |", patterns[p], matches);
+        for (enum fzf_simd level = FZF_SIMD_SCALAR; level <= fzf_simd_best(); ++level) {
+            printf(" %.1f |", ns[level]);
+        }
+        printf("\n");
+    }
+    fzf_simd_set(FZF_SIMD_UNSET);
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+    return EXIT_SUCCESS;
+}
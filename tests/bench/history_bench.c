@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/io/bestline.h"
+
+// Adds history_bench_adds lines to a history holding {max} lines, so all but the first max adds evict a line.
+// Ran with histories of 1000 and 100000 lines by 'make bench_history'.
+constexpr unsigned history_bench_adds = 1000000;
+
+void history_bench(unsigned max)
+{
+    char line[64];
+    bestlineHistorySetMaxLen(max);
+    for (unsigned i = 0; i < history_bench_adds; ++i) {
+        snprintf(line, sizeof(line), "git commit -m 'history bench %u'", i);
+        bestlineHistoryAdd(line);
+    }
+
+    if (bestlineHistoryCount() != max) {
+        puts("history_bench: wrong count");
+    }
+    bestlineHistoryFree();
+}
+
+constexpr unsigned history_bench_search_lines = 200000;
+constexpr unsigned history_bench_search_presses = 5; // CTRL-R pressed again after the whole query is typed
+
+static char* search_commands[] = {
+    "git commit -m 'fix %u'",
+    "git checkout -b feature-%u",
+    "make check && ./bin/ncsh %u",
+    "nvim src/io/file_%u.c",
+    "ls -la /home/alex/projects/%u",
+    "cd ../ncsh-%u",
+    "docker run --rm -it image:%u",
+    "ssh deploy@host-%u",
+    "grep -rn 'needle%u' src",
+    "echo $PATH | tr : '\\n' | head -%u",
+};
+
+static char* search_queries[] = {
+    "git commit",
+    "ssh deploy@host-1999",
+    "needle4242",
+    "docker run --rm",
+    "kubectl", // not in the history
+};
+
+/* history_bench_scan
+ * The linear search CTRL-R did before the trigram index: every line from the newest back, searched from its end.
+ */
+static int history_bench_scan(const char* query, unsigned i)
+{
+    size_t m = strlen(query);
+    while (i--) {
+        const char* p = bestlineHistoryGet(i);
+        size_t n = strlen(p);
+        if (m > n) {
+            continue;
+        }
+        for (size_t k = n - m + 1; k--;) {
+            if (!memcmp(p + k, query, m)) {
+                return (int)i;
+            }
+        }
+    }
+    return -1;
+}
+
+static double history_bench_ns(struct timespec begin, struct timespec end)
+{
+    return (double)(end.tv_sec - begin.tv_sec) * 1e9 + (double)(end.tv_nsec - begin.tv_nsec);
+}
+
+/* history_bench_search_run
+ * Types each query one character at a time, searching after each one from the third, then presses CTRL-R a few
+ * more times. Queries shorter than a trigram are left out, they scan every line either way.
+ * Returns: the average ns per search
+ */
+static double history_bench_search_run(int (*find)(const char*, unsigned), size_t* found)
+{
+    char query[64];
+    size_t searches = 0;
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t q = 0; q < sizeof(search_queries) / sizeof(*search_queries); ++q) {
+        size_t len = strlen(search_queries[q]);
+        for (size_t n = 3; n <= len; ++n) {
+            memcpy(query, search_queries[q], n);
+            query[n] = '\0';
+            int i = find(query, bestlineHistoryCount());
+            ++searches;
+            for (unsigned r = 0; n == len && i > 0 && r < history_bench_search_presses; ++r) {
+                i = find(query, (unsigned)i);
+                ++searches;
+            }
+            *found += (size_t)(i + 1);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return history_bench_ns(begin, end) / (double)searches;
+}
+
+/* history_bench_search
+ * Ran by 'make bench_history_search'. Prints the latency of each CTRL-R search of a 200,000 line history,
+ * through the trigram index and by scanning every line.
+ */
+void history_bench_search()
+{
+    char line[128];
+    bestlineHistorySetMaxLen(history_bench_search_lines);
+    for (unsigned i = 0; i < history_bench_search_lines; ++i) {
+        snprintf(line, sizeof(line), search_commands[i % (sizeof(search_commands) / sizeof(*search_commands))],
+                 i / 7 % 5000);
+        bestlineHistoryAdd(line);
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int first = bestlineHistoryFind("git", bestlineHistoryCount());
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("lines: %u, first search (builds the index): %.1f ms\n", bestlineHistoryCount(),
+           history_bench_ns(begin, end) / 1e6);
+
+    size_t found_index = 0;
+    size_t found_scan = 0;
+    double index = history_bench_search_run(bestlineHistoryFind, &found_index);
+    double scan = history_bench_search_run(history_bench_scan, &found_scan);
+    printf("index: %.0f ns per search\n", index);
+    printf("scan: %.0f ns per search\n", scan);
+    if (found_index != found_scan || first < 0) {
+        puts("history_bench_search: the index and the scan found different lines");
+    }
+    bestlineHistoryFree();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && !strcmp(argv[1], "search")) {
+        history_bench_search();
+        return EXIT_SUCCESS;
+    }
+
+    history_bench(argc > 1 ? (unsigned)atoi(argv[1]) : 1000);
+
+    return EXIT_SUCCESS;
+}
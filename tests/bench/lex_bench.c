@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lib/arena_test_helper.h"
+#include "../../src/defines.h" // used for macro NCSH_MAX_INPUT
+#include "../../src/interpreter/lex.h"
+
+// Lexes each line of the corpus until lex_bench_bytes bytes have been lexed, the same total for every corpus.
+// Ran with the one_liners and scripts corpora by 'make bench_lex'.
+constexpr size_t lex_bench_bytes = 1 << 26;
+
+static char* one_liners[] = {
+    "ls",
+    "ls -a",
+    "ls | wc -c",
+    "ls | sort | wc -c",
+    "ls > t.txt",
+    "cat t.txt",
+    "rm t.txt",
+    "nvim src/io/io.c",
+    "git diff",
+    "git restore src/io/io.c",
+    "git pull origin main",
+    "git config pull.rebase true",
+    "git commit -m 'fix the lexer'",
+    "git log --oneline | head -n 20",
+    "z ncsh",
+    "z rm /home/alex/ncsh/development/cash",
+    "make ud",
+    "make check && make install",
+    "echo hello",
+    "echo \"hello there\"",
+    "echo $HOME",
+    "echo ~/.config/ncsh",
+    "ls *.c | wc -l",
+    "ls src/?.c",
+    "grep -rn TODO src > todos.txt",
+    "find . -name '*.o' | xargs rm",
+    "ls /nonexist && echo found || echo missing",
+    "cat /proc/cpuinfo | grep 'model name' | sort | uniq -c",
+    "STR=hello",
+    "echo $STR | cat",
+    "ps aux | grep ncsh | grep -v grep",
+    "sleep 10 &",
+    "ls 2> errors.txt",
+    "ls &> all.txt",
+    "if [ 1 -eq 1 ]; then echo hi; else echo hello; fi",
+    "if [ $i -lt 5 ]; then echo small; elif [ $i -lt 10 ]; then echo medium; else echo large; fi",
+    "while [ $count -lt 10 ]; do echo $count; count=$(count + 1); done",
+    "for ((i = 0; i < 10; i++)); do echo $i; done",
+    "for fruit in apple banana orange; do echo $fruit; done",
+    "echo $(1 + 2 * 3 - 4 / 2)",
+    "ls # list the files",
+};
+
+static char* script_lines[] = {
+    "if [ $count -lt 10 ] && [ $total -gt 0 ]; then echo $count $total | sort -n >> out.txt; fi",
+    "for f in *.c *.h; do echo $f; wc -l $f | sort -n >> lines.txt; done",
+    "while [ $i -le 100 ]; do echo \"i is $i\" | cat; i=$(i + 1); done",
+    "git add src/interpreter/lex.c && git commit -m 'lex views' || echo 'nothing to commit'",
+    "ls -la ~/.config | grep ncsh > ~/ncsh_config.txt 2> ~/ncsh_errors.txt",
+};
+
+// Builds lines as long as the shell accepts out of script_lines, like a script with its statements on one line.
+static Str* lex_bench_scripts(size_t* restrict count, Arena* restrict arena)
+{
+    constexpr size_t scripts_count = 8;
+    constexpr size_t lines_count = sizeof(script_lines) / sizeof(*script_lines);
+    Str* scripts = arena_malloc(arena, scripts_count, Str);
+    for (size_t i = 0; i < scripts_count; ++i) {
+        char* buffer = arena_malloc(arena, NCSH_MAX_INPUT, char);
+        size_t len = 0;
+        for (size_t j = i;; ++j) {
+            char* line = script_lines[j % lines_count];
+            size_t line_len = strlen(line);
+            if (len + line_len + 3 >= NCSH_MAX_INPUT) {
+                break;
+            }
+            memcpy(buffer + len, line, line_len);
+            len += line_len;
+            memcpy(buffer + len, "; ", 2);
+            len += 2;
+        }
+        buffer[len] = '\0';
+        scripts[i] = Str(buffer, len + 1);
+    }
+
+    *count = scripts_count;
+    return scripts;
+}
+
+static Str* lex_bench_one_liners(size_t* restrict count, Arena* restrict arena)
+{
+    constexpr size_t one_liners_count = sizeof(one_liners) / sizeof(*one_liners);
+    Str* lines = arena_malloc(arena, one_liners_count, Str);
+    for (size_t i = 0; i < one_liners_count; ++i) {
+        lines[i] = Str(one_liners[i], strlen(one_liners[i]) + 1);
+    }
+
+    *count = one_liners_count;
+    return lines;
+}
+
+void lex_bench(char* corpus)
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    size_t count;
+    Str* lines = !strcmp(corpus, "scripts") ? lex_bench_scripts(&count, &a) : lex_bench_one_liners(&count, &a);
+
+    size_t bytes = 0;
+    size_t lexemes_count = 0;
+    for (size_t i = 0; bytes < lex_bench_bytes; i = (i + 1) % count) {
+        Arena scratch = scratch_arena;
+        Lexemes lexemes = {0};
+        lex(lines[i], &lexemes, &scratch);
+        lexemes_count += lexemes.count;
+        bytes += lines[i].length;
+    }
+
+    if (!lexemes_count) {
+        puts("lex_bench: no lexemes");
+    }
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+    ARENA_TEST_TEARDOWN;
+}
+
+int main(int argc, char** argv)
+{
+    lex_bench(argc > 1 ? argv[1] : "one_liners");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/interpreter/lex.h"
+#include "../../src/interpreter/parse.h"
+#include "../../src/interpreter/parse_cache.h"
+#include "../lib/arena_test_helper.h"
+
+// Compares lexing and parsing each line of the corpus with getting it from the parse cache, and with a miss that
+// lexes, parses, and adds the line to the cache. Ran by 'make bench_parse_cache'.
+constexpr size_t parse_cache_bench_rounds = 1 << 16;
+
+static char* one_liners[] = {
+    "ls",
+    "ls -a",
+    "ls | sort | wc -c",
+    "git commit -m 'fix the lexer'",
+    "git log --oneline | head -n 20",
+    "make check && make install",
+    "echo \"hello there\"",
+    "find . -name '*.o' | xargs rm",
+    "cat /proc/cpuinfo | grep 'model name' | sort | uniq -c",
+    "if [ $i -lt 5 ]; then echo small; elif [ $i -lt 10 ]; then echo medium; else echo large; fi",
+    "while [ $count -lt 10 ]; do echo $count; count=$(count + 1); done",
+    "for fruit in apple banana orange; do echo $fruit; done",
+};
+
+static double parse_cache_bench_ns(struct timespec begin, struct timespec end)
+{
+    return (double)(end.tv_sec - begin.tv_sec) * 1e9 + (double)(end.tv_nsec - begin.tv_nsec);
+}
+
+static Statements* parse_cache_bench_parse(Str line, Arena* restrict scratch)
+{
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, scratch);
+    Parser_Output rv = parse(&lexemes, scratch);
+    assert(!rv.parser_errno);
+    return rv.output.stmts;
+}
+
+int main()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Shell shell = {.arena = a};
+    parse_cache_new(&shell);
+    Parse_Cache* cache = shell.parse_cache;
+
+    printf("| line | lex + parse ns | hit ns | miss ns |\n");
+    constexpr size_t count = sizeof(one_liners) / sizeof(*one_liners);
+    for (size_t i = 0; i < count; ++i) {
+        Str line = Str(one_liners[i], strlen(one_liners[i]) + 1);
+        size_t heads = 0;
+        struct timespec begin, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (size_t r = 0; r < parse_cache_bench_rounds; ++r) {
+            Arena scratch = scratch_arena;
+            heads += parse_cache_bench_parse(line, &scratch)->head != NULL;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double parse_ns = parse_cache_bench_ns(begin, end) / (double)parse_cache_bench_rounds;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (size_t r = 0; r < parse_cache_bench_rounds; ++r) {
+            Arena scratch = scratch_arena;
+            parse_cache_clear(cache);
+            Statements* stmts = parse_cache_bench_parse(line, &scratch);
+            parse_cache_add(cache, line, stmts, scratch);
+            heads += stmts->head != NULL;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double miss_ns = parse_cache_bench_ns(begin, end) / (double)parse_cache_bench_rounds;
+
+        clock_gettime(CLOCK_MONOTONIC, &begin);
+        for (size_t r = 0; r < parse_cache_bench_rounds; ++r) {
+            Arena scratch = scratch_arena;
+            Statements* stmts = parse_cache_get(cache, line, &scratch);
+            heads += stmts && stmts->head;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double hit_ns = parse_cache_bench_ns(begin, end) / (double)parse_cache_bench_rounds;
+
+        if (heads != 3 * parse_cache_bench_rounds) {
+            printf("parse_cache_bench: '%s' wasn't parsed or cached\n", one_liners[i]);
+        }
+        printf("| %s | %.0f | %.0f | %.0f |\n", one_liners[i], parse_ns, hit_ns, miss_ns);
+    }
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+    ARENA_TEST_TEARDOWN;
+    return EXIT_SUCCESS;
+}
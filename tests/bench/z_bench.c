@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/z/fzf.h"
+#include "../../src/z/z.h"
+#include "../lib/arena_test_helper.h"
+
+z_Directory* z_match_find(Str* restrict target, char* restrict cwd, size_t cwd_length, z_Database* restrict db,
+                          Arena* restrict scratch_arena);
+
+enum z_Result z_database_add(Str* restrict path, char* restrict cwd, size_t cwd_length, z_Database* restrict db,
+                             Arena* restrict arena);
+
+double z_score(z_Directory* restrict directory, int fzf_score, time_t now);
+
+void z_parallel_start(z_Database* restrict db, size_t threads, Arena* restrict arena);
+
+void z_parallel_stop(z_Database* restrict db);
+
+// Ran by 'make bench_z'.
+constexpr size_t z_bench_entries = 50000;
+constexpr size_t z_bench_runs = 20;
+constexpr size_t z_bench_threads = 4;
+
+static char* roots[] = {"/home/alex/source/repos", "/home/alex/Documents", "/var/lib/docker/volumes", "/usr/local/src",
+                        "/mnt/c/Users/Alex/source/repos/PersonalRepos", "/opt/build/workspace"};
+static char* projects[] = {"ncsh", "linux", "llvm-project", "postgres", "redis", "nvim", "ttytest2", "curl",
+                           "sqlite", "fzf-native", "kubernetes", "ffmpeg"};
+static char* subdirs[] = {"src", "tests", "build", "docs", "include", "bin", "scripts", "lib", "out", "vendor"};
+
+static char* queries[] = {
+    "ncsh",          // fuzzy, the usual z
+    "kubtest",       // fuzzy, spread over the path
+    "'postgres1",    // exact
+    "^/opt/build",   // prefix
+    "vendor$",       // suffix
+    "'ncsh 'tests",  // two exact terms
+    "qqq",           // fuzzy, not in any path
+    "'zzzz",         // exact, not in any path
+};
+
+/* z_bench_scan
+ * What z_match_find did before the index: score every directory with fzf.
+ */
+static z_Directory* z_bench_scan(Str* restrict target, z_Database* restrict db, Arena* restrict scratch)
+{
+    fzf_slab_t* slab = fzf_make_slab((fzf_slab_config_t){(size_t)1 << 6, 1 << 6}, scratch);
+    fzf_pattern_t* pattern = fzf_parse_pattern(target->value, target->length - 1, scratch);
+    time_t now = time(NULL);
+    z_Match match = {0};
+    for (size_t i = 0; i < db->count; ++i) {
+        int fzf_score = fzf_get_score(db->dirs[i].path.value, db->dirs[i].path.length - 1, pattern, slab, scratch);
+        if (!fzf_score) {
+            continue;
+        }
+        double score = z_score(db->dirs + i, fzf_score, now);
+        if (!match.dir || match.z_score < score) {
+            match = (z_Match){.z_score = score, .dir = db->dirs + i};
+        }
+    }
+    return match.dir;
+}
+
+static double z_bench_ns(struct timespec begin, struct timespec end)
+{
+    return (double)(end.tv_sec - begin.tv_sec) * 1e9 + (double)(end.tv_nsec - begin.tv_nsec);
+}
+
+/* z_bench_run
+ * Returns: the average ns to find the match for query, and the match in result
+ */
+static double z_bench_run(bool scan, char* query, z_Database* restrict db, Arena scratch, z_Directory** result)
+{
+    size_t len = strlen(query);
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t r = 0; r < z_bench_runs; ++r) {
+        Arena run_scratch = scratch;
+        char* copy = arena_malloc(&run_scratch, len + 1, char);
+        memcpy(copy, query, len);
+        *result = scan ? z_bench_scan(&Str(copy, len + 1), db, &run_scratch)
+                       : z_match_find(&Str(copy, len + 1), "/", 2, db, &run_scratch);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return z_bench_ns(begin, end) / (double)z_bench_runs;
+}
+
+int main()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+    arena_chain(&arena, 0);
+
+    z_Database db = {0};
+    char name[128];
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t i = 0; i < z_bench_entries; ++i) {
+        char* root = roots[i % (sizeof(roots) / sizeof(*roots))];
+        int len = snprintf(name, sizeof(name), "%s%zu/%s/%s%zu", projects[i / 7 % (sizeof(projects) / sizeof(*projects))],
+                           i / 84 % 40, subdirs[i / 3 % (sizeof(subdirs) / sizeof(*subdirs))],
+                           subdirs[i % (sizeof(subdirs) / sizeof(*subdirs))], i / 1000);
+        (void)z_database_add(&Str(name, (size_t)len + 1), root, strlen(root) + 1, &db, &arena);
+        db.dirs[db.count - 1].rank = (double)(i % 17);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("entries: %zu, added and indexed in %.1f ms\n", db.count, z_bench_ns(begin, end) / 1e6);
+
+    z_parallel_start(&db, z_bench_threads, &arena);
+    printf("| query | scan ns | index ns | index on %zu threads ns |\n", (size_t)z_bench_threads);
+    for (size_t q = 0; q < sizeof(queries) / sizeof(*queries); ++q) {
+        z_Directory* scanned;
+        z_Directory* indexed;
+        z_Directory* parallel;
+        double scan = z_bench_run(true, queries[q], &db, scratch_arena, &scanned);
+        db.parallel_min = 0;
+        double index = z_bench_run(false, queries[q], &db, scratch_arena, &indexed);
+        db.parallel_min = 1;
+        double index_parallel = z_bench_run(false, queries[q], &db, scratch_arena, &parallel);
+        printf("| %s | %.0f | %.0f | %.0f |\n", queries[q], scan, index, index_parallel);
+        if (scanned != indexed) {
+            printf("z_bench: the index and the scan found different directories for %s\n", queries[q]);
+        }
+        if (indexed != parallel) {
+            printf("z_bench: one thread and %zu threads found different directories for %s\n",
+                   (size_t)z_bench_threads, queries[q]);
+        }
+    }
+    z_parallel_stop(&db);
+
+    arena_chain_free(&arena);
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+    return EXIT_SUCCESS;
+}
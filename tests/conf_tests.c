@@ -22,11 +22,83 @@ void conf_init_test()
     ARENA_TEST_TEARDOWN;
 }
 
+void conf_ac_frecency_set_test()
+{
+    Autocompletion_Frecency frecency = {.half_life = 1, .age_every = 2, .prune_below = 3};
+
+    conf_ac_frecency_set("AC_HALF_LIFE_HOURS=72", &frecency);
+    eassert(frecency.half_life == 72 * 60 * 60);
+    conf_ac_frecency_set("AC_AGE_EVERY=500", &frecency);
+    eassert(frecency.age_every == 500);
+    conf_ac_frecency_set("AC_PRUNE_BELOW=0.5", &frecency);
+    eassert(frecency.prune_below == 0.5);
+
+    // values which aren't numbers or are out of range are ignored
+    conf_ac_frecency_set("AC_HALF_LIFE_HOURS=0", &frecency);
+    conf_ac_frecency_set("AC_HALF_LIFE_HOURS=", &frecency);
+    conf_ac_frecency_set("AC_AGE_EVERY=100000", &frecency);
+    conf_ac_frecency_set("AC_AGE_EVERY=-1", &frecency);
+    conf_ac_frecency_set("AC_PRUNE_BELOW=low", &frecency);
+    conf_ac_frecency_set("AC_UNKNOWN=1", &frecency);
+    eassert(frecency.half_life == 72 * 60 * 60);
+    eassert(frecency.age_every == 500);
+    eassert(frecency.prune_below == 0.5);
+}
+
+void conf_history_max_set_test()
+{
+    unsigned history_max = 1;
+
+    conf_history_max_set("HISTORY_MAX=100000", &history_max);
+    eassert(history_max == 100000);
+    conf_history_max_set("HISTORY_MAX=0", &history_max);
+    eassert(history_max == 0);
+
+    // values which aren't whole numbers or are out of range are ignored
+    conf_history_max_set("HISTORY_MAX=2.5", &history_max);
+    conf_history_max_set("HISTORY_MAX=-1", &history_max);
+    conf_history_max_set("HISTORY_MAX=9999999999", &history_max);
+    conf_history_max_set("HISTORY_MAX=", &history_max);
+    eassert(history_max == 0);
+}
+
+void conf_history_erase_dups_set_test()
+{
+    bool erase_dups = false;
+
+    conf_history_erase_dups_set("HISTORY_ERASE_DUPS=1", &erase_dups);
+    eassert(erase_dups);
+    conf_history_erase_dups_set("HISTORY_ERASE_DUPS=2", &erase_dups);
+    conf_history_erase_dups_set("HISTORY_ERASE_DUPS=", &erase_dups);
+    eassert(erase_dups);
+    conf_history_erase_dups_set("HISTORY_ERASE_DUPS=0", &erase_dups);
+    eassert(!erase_dups);
+}
+
+void conf_z_parallel_min_set_test()
+{
+    unsigned z_parallel_min = 1;
+
+    conf_z_parallel_min_set("Z_PARALLEL_MIN=50000", &z_parallel_min);
+    eassert(z_parallel_min == 50000);
+    conf_z_parallel_min_set("Z_PARALLEL_MIN=0", &z_parallel_min);
+    eassert(z_parallel_min == 0);
+
+    conf_z_parallel_min_set("Z_PARALLEL_MIN=1.5", &z_parallel_min);
+    conf_z_parallel_min_set("Z_PARALLEL_MIN=-1", &z_parallel_min);
+    conf_z_parallel_min_set("Z_PARALLEL_MIN=", &z_parallel_min);
+    eassert(z_parallel_min == 0);
+}
+
 void conf_tests()
 {
     etest_start();
 
     etest_run(conf_init_test);
+    etest_run(conf_ac_frecency_set_test);
+    etest_run(conf_history_max_set_test);
+    etest_run(conf_history_erase_dups_set_test);
+    etest_run(conf_z_parallel_min_set_test);
 
     etest_finish();
 }
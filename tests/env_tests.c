@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "etest.h"
@@ -62,6 +63,44 @@ void env_add_or_get_user_test()
     ARENA_TEST_TEARDOWN;
 }
 
+// the env used to be a static 128 slot table, more variables than that made env_add_or_get loop forever
+void env_new_many_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr int count = 500;
+    char** envp = arena_malloc(&arena, count + 1, char*);
+    for (int i = 0; i < count; ++i) {
+        envp[i] = arena_malloc(&arena, 32, char);
+        snprintf(envp[i], 32, "NCSH_VAR_%d=%d", i, i);
+    }
+
+    Shell s = {0};
+    env_new(&s, envp, &arena);
+
+    eassert(s.env->count == count);
+    Str* val = env_get(s.env, Str_Lit("NCSH_VAR_321"));
+    eassert(val);
+    eassert(estrcmp(*val, Str_Lit("321")));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void env_remove_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {0};
+    env_new(&s, envp_ptr, &arena);
+    eassert(env_get(s.env, Str_Lit(NCSH_PATH_VAL)));
+
+    eassert(env_remove(s.env, Str_Lit(NCSH_PATH_VAL)));
+    eassert(!env_get(s.env, Str_Lit(NCSH_PATH_VAL)));
+    eassert(env_get(s.env, Str_Lit(NCSH_HOME_VAL)));
+
+    ARENA_TEST_TEARDOWN;
+}
+
 void env_tests()
 {
     etest_start();
@@ -69,6 +108,8 @@ void env_tests()
     etest_run(env_add_or_get_home_test);
     etest_run(env_add_or_get_path_test);
     etest_run(env_add_or_get_user_test);
+    etest_run(env_new_many_test);
+    etest_run(env_remove_test);
 
     etest_finish();
 }
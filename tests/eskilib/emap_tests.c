@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etest.h"
+#include "../../src/eskilib/emap.h"
+#include "../lib/arena_test_helper.h"
+
+void emap_new_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, int, &a);
+
+    eassert(map.capacity == EMAP_DEFAULT_CAPACITY);
+    eassert(!map.count);
+    eassert(map.val_size == sizeof(int));
+
+    emap_new(&map, 100, int, &a);
+    eassert(map.capacity == 128);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void emap_add_or_get_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, int, &a);
+    int* val = emap_add_or_get(&map, Str_Lit("hello"));
+
+    eassert(val);
+    eassert(!*val);
+    *val = 5;
+    eassert(map.count == 1);
+
+    int* val_again = emap_add_or_get(&map, Str_Lit("hello"));
+    eassert(val_again == val);
+    eassert(*val_again == 5);
+    eassert(map.count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void emap_get_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, Str, &a);
+    *(Str*)emap_add_or_get(&map, Str_Lit("PATH")) = Str_Lit("/usr/bin");
+    *(Str*)emap_add_or_get(&map, Str_Lit("HOME")) = Str_Lit("/home/alex");
+
+    Str* path = emap_get(&map, Str_Lit("PATH"));
+    eassert(path);
+    eassert(estrcmp(*path, Str_Lit("/usr/bin")));
+    Str* home = emap_get(&map, Str_Lit("HOME"));
+    eassert(home);
+    eassert(estrcmp(*home, Str_Lit("/home/alex")));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void emap_get_missing_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, int, &a);
+    *(int*)emap_add_or_get(&map, Str_Lit("hello")) = 1;
+
+    eassert(!emap_get(&map, Str_Lit("hell")));
+    eassert(!emap_get(&map, Str_Lit("hello there")));
+    eassert(!emap_get(&map, Str_Empty));
+    eassert(map.count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void emap_remove_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, int, &a);
+    *(int*)emap_add_or_get(&map, Str_Lit("hello")) = 1;
+    *(int*)emap_add_or_get(&map, Str_Lit("there")) = 2;
+
+    eassert(emap_remove(&map, Str_Lit("hello")));
+    eassert(map.count == 1);
+    eassert(!emap_get(&map, Str_Lit("hello")));
+    eassert(*(int*)emap_get(&map, Str_Lit("there")) == 2);
+
+    eassert(!emap_remove(&map, Str_Lit("hello")));
+    eassert(map.count == 1);
+
+    int* val = emap_add_or_get(&map, Str_Lit("hello"));
+    eassert(!*val);
+    eassert(map.count == 2);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// more keys than the old static 128 slot env/vars tables could hold
+void emap_grow_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr int count = 1000;
+    Emap map;
+    emap_new(&map, 0, int, &a);
+    for (int i = 0; i < count; ++i) {
+        char* key = arena_malloc(&a, 16, char);
+        int len = snprintf(key, 16, "KEY_%d", i);
+        *(int*)emap_add_or_get(&map, Str(key, (size_t)len + 1)) = i;
+    }
+
+    eassert(map.count == count);
+    eassert(map.capacity >= count);
+    for (int i = 0; i < count; ++i) {
+        char key[16];
+        int len = snprintf(key, sizeof(key), "KEY_%d", i);
+        int* val = emap_get(&map, Str(key, (size_t)len + 1));
+        eassert(val);
+        eassert(*val == i);
+    }
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// adding and removing keys leaves tombstones, they should be cleared out rather than filling the map
+void emap_remove_many_test()
+{
+    ARENA_TEST_SETUP;
+
+    Emap map;
+    emap_new(&map, 0, int, &a);
+    size_t capacity = map.capacity;
+    for (int i = 0; i < 1000; ++i) {
+        char* key = arena_malloc(&a, 16, char);
+        int len = snprintf(key, 16, "KEY_%d", i);
+        Str k = Str(key, (size_t)len + 1);
+        *(int*)emap_add_or_get(&map, k) = i;
+        eassert(emap_remove(&map, k));
+    }
+
+    eassert(!map.count);
+    eassert(map.capacity == capacity);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void emap_tests()
+{
+    etest_start();
+
+    etest_run(emap_new_test);
+    etest_run(emap_add_or_get_test);
+    etest_run(emap_get_test);
+    etest_run(emap_get_missing_test);
+    etest_run(emap_remove_test);
+    etest_run(emap_grow_test);
+    etest_run(emap_remove_many_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    emap_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
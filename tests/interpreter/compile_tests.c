@@ -0,0 +1,242 @@
+/* compile_tests.c: tests for compile.c, the instructions and jump targets emitted for the VM. */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etest.h"
+#include "../../src/interpreter/compile.h"
+#include "../../src/interpreter/lex.h"
+#include "../../src/interpreter/parse.h"
+#include "../lib/arena_test_helper.h"
+
+static Program* compile_line(Str line, Arena* restrict scratch)
+{
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, scratch);
+    auto rv = parse(&lexemes, scratch);
+    assert(!rv.parser_errno);
+    return compile(rv.output.stmts, scratch);
+}
+
+static bool inst_is(Instruction* inst, enum Ops op, enum Vm_State state, char* str)
+{
+    if (inst->op != op || inst->state != state) {
+        return false;
+    }
+    return !str || (inst->cmds && !memcmp(inst->cmds->strs[0].value, str, strlen(str) + 1));
+}
+
+void compile_simple_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("ls"), &scratch_arena);
+
+    eassert(prog->count == 1);
+    eassert(inst_is(prog->insts, OP_CONST, VS_NORMAL, "ls"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_pipe_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("ls | sort | wc -c"), &scratch_arena);
+
+    // stages of a pipeline are never jumped between
+    eassert(prog->count == 3);
+    eassert(inst_is(prog->insts, OP_CONST, VS_NORMAL, "ls"));
+    eassert(inst_is(prog->insts + 1, OP_CONST, VS_NORMAL, "sort"));
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_NORMAL, "wc"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_and_or_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("ls && pwd || echo"), &scratch_arena);
+
+    eassert(prog->count == 5);
+    eassert(inst_is(prog->insts, OP_CONST, VS_NORMAL, "ls"));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_NORMAL, "pwd"));
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_NORMAL, "pwd"));
+    eassert(inst_is(prog->insts + 3, OP_JUMP_IF_TRUE, VS_NORMAL, "echo"));
+    eassert(inst_is(prog->insts + 4, OP_CONST, VS_NORMAL, "echo"));
+
+    // ls failing skips pwd but still runs echo
+    eassert(prog->insts[1].target == 4);
+    eassert(prog->insts[3].target == 5);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_if_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("if [ 1 -eq 1 ]; then echo hi; fi"), &scratch_arena);
+
+    eassert(prog->count == 3);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_CONDITIONS, "1"));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, "echo"));
+    eassert(prog->insts[1].target == 3);
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_IN_IF_STATEMENTS, "echo"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_if_else_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("if [ 1 -eq 1 ]; then echo hi; else echo hello; fi"), &scratch_arena);
+
+    eassert(prog->count == 5);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_CONDITIONS, "1"));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, NULL));
+    eassert(prog->insts[1].target == 4);
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_IN_IF_STATEMENTS, "echo"));
+    eassert(!memcmp(prog->insts[2].cmds->strs[1].value, "hi", 3));
+    eassert(inst_is(prog->insts + 3, OP_JUMP, VS_IN_IF_STATEMENTS, NULL));
+    eassert(prog->insts[3].target == 5);
+    eassert(inst_is(prog->insts + 4, OP_CONST, VS_IN_ELSE_STATEMENTS, "echo"));
+    eassert(!memcmp(prog->insts[4].cmds->strs[1].value, "hello", 6));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_if_elif_else_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(
+        Str_Lit("if [ 2 -eq 1 ]; then echo hi; elif [ 1 -eq 1 ]; then echo hey; else echo hello; fi"), &scratch_arena);
+
+    eassert(prog->count == 9);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_CONDITIONS, "2"));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, NULL));
+    eassert(prog->insts[1].target == 4);
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_IN_IF_STATEMENTS, "echo"));
+    eassert(inst_is(prog->insts + 3, OP_JUMP, VS_IN_IF_STATEMENTS, NULL));
+    eassert(prog->insts[3].target == 9);
+
+    eassert(inst_is(prog->insts + 4, OP_CONST, VS_IN_CONDITIONS, "1"));
+    eassert(inst_is(prog->insts + 5, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, NULL));
+    eassert(prog->insts[5].target == 8);
+    eassert(inst_is(prog->insts + 6, OP_CONST, VS_IN_ELIF_STATEMENTS, "echo"));
+    eassert(inst_is(prog->insts + 7, OP_JUMP, VS_IN_ELIF_STATEMENTS, NULL));
+    eassert(prog->insts[7].target == 9);
+
+    eassert(inst_is(prog->insts + 8, OP_CONST, VS_IN_ELSE_STATEMENTS, "echo"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_if_conditions_and_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("if [ false && true ]; then echo hi; else echo hello; fi"), &scratch_arena);
+
+    eassert(prog->count == 7);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_CONDITIONS, "false"));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, "true"));
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_IN_CONDITIONS, "true"));
+    eassert(inst_is(prog->insts + 3, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, NULL));
+    eassert(prog->insts[3].target == 6);
+
+    // the short circuit jumps straight to else instead of through the jump after the conditions
+    eassert(prog->insts[1].target == 6);
+    eassert(inst_is(prog->insts + 6, OP_CONST, VS_IN_ELSE_STATEMENTS, "echo"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_while_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("while [ $count -lt 3 ]; do echo $count; count=$(count + 1); done"),
+                                 &scratch_arena);
+
+    eassert(prog->count == 5);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_CONDITIONS, NULL));
+    eassert(inst_is(prog->insts + 1, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, "echo"));
+    eassert(prog->insts[1].target == 5);
+    eassert(inst_is(prog->insts + 2, OP_CONST, VS_IN_LOOP_STATEMENTS, "echo"));
+    // the math expression is evaluated by the assignment, not as its own instruction
+    eassert(inst_is(prog->insts + 3, OP_CONST, VS_IN_LOOP_STATEMENTS, "count"));
+    eassert(prog->insts[3].cmds->op == OP_ASSIGNMENT);
+    eassert(inst_is(prog->insts + 4, OP_JUMP, VS_IN_LOOP_STATEMENTS, NULL));
+    eassert(!prog->insts[4].target);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_for_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("for ((i = 0; i < 3; i++)); do echo $i; done"), &scratch_arena);
+
+    eassert(prog->count == 6);
+    eassert(inst_is(prog->insts, OP_CONST, VS_IN_LOOP_INIT, "i"));
+    eassert(inst_is(prog->insts + 1, OP_CONST, VS_IN_CONDITIONS, "i"));
+    eassert(inst_is(prog->insts + 2, OP_JUMP_IF_FALSE, VS_IN_CONDITIONS, "echo"));
+    eassert(prog->insts[2].target == 6);
+    eassert(inst_is(prog->insts + 3, OP_CONST, VS_IN_LOOP_STATEMENTS, "echo"));
+    eassert(inst_is(prog->insts + 4, OP_CONST, VS_IN_LOOP_INCREMENT, "i"));
+    // jumps back to the conditions, skipping init
+    eassert(inst_is(prog->insts + 5, OP_JUMP, VS_IN_LOOP_INCREMENT, NULL));
+    eassert(prog->insts[5].target == 1);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_for_each_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Program* prog = compile_line(Str_Lit("for fruit in apple banana orange; do echo $fruit; done"), &scratch_arena);
+
+    eassert(prog->count == 3);
+    eassert(inst_is(prog->insts, OP_FOR, VS_IN_LOOP_EACH_INIT, "fruit"));
+    eassert(prog->insts[0].cmds->count == 4);
+    eassert(prog->insts[0].target == 3);
+    eassert(inst_is(prog->insts + 1, OP_CONST, VS_IN_LOOP_STATEMENTS, "echo"));
+    eassert(inst_is(prog->insts + 2, OP_JUMP, VS_IN_LOOP_STATEMENTS, NULL));
+    eassert(!prog->insts[2].target);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void compile_tests()
+{
+    etest_start();
+
+    etest_run(compile_simple_test);
+    etest_run(compile_pipe_test);
+    etest_run(compile_and_or_test);
+    etest_run(compile_if_test);
+    etest_run(compile_if_else_test);
+    etest_run(compile_if_elif_else_test);
+    etest_run(compile_if_conditions_and_test);
+    etest_run(compile_while_test);
+    etest_run(compile_for_test);
+    etest_run(compile_for_each_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    compile_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
@@ -1051,6 +1051,23 @@ void lex_comment_test()
     SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
+// symbols in comments are skipped too, not just words
+void lex_comment_symbols_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    auto line = Str_Lit("ls # sort | wc -c > t.txt");
+
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == 1);
+    eassert(!memcmp(lexemes.strs[0].value, "ls", sizeof("ls")));
+    eassert(!lexemes.strs[1].value);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
 void lex_math_operators_test()
 {
     SCRATCH_ARENA_TEST_SETUP;
@@ -1605,6 +1622,128 @@ void lex_for_each_expansion_test()
 // forward declaration: implementation put at the end because it messes with clangd lsp
 void lex_bad_input_shouldnt_crash();
 
+// lexemes are views into a copy of the line, symbols right after a word can't be overwritten in the copy
+void lex_symbols_no_whitespace_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    auto line = Str_Lit("ls|sort>t.txt");
+
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == 5);
+    eassert(!memcmp(lexemes.strs[0].value, "ls", sizeof("ls")));
+    eassert(lexemes.strs[0].length == sizeof("ls"));
+    eassert(!memcmp(lexemes.strs[1].value, "|", 2));
+    eassert(lexemes.ops[1] == T_PIPE);
+    eassert(!memcmp(lexemes.strs[2].value, "sort", sizeof("sort")));
+    eassert(!memcmp(lexemes.strs[3].value, ">", 2));
+    eassert(lexemes.ops[3] == T_GT);
+    eassert(!memcmp(lexemes.strs[4].value, "t.txt", sizeof("t.txt")));
+
+    // the line itself is left untouched
+    eassert(!memcmp(line.value, "ls|sort>t.txt", sizeof("ls|sort>t.txt")));
+
+    // symbols are the lexer's own copies, writing to one doesn't change the next line's
+    lexemes.strs[1].value[0] = 'x';
+    Lexemes next = {0};
+    lex(Str_Lit("ls | sort"), &next, &scratch_arena);
+    eassert(next.count == 3);
+    eassert(!memcmp(next.strs[1].value, "|", 2));
+    eassert(next.ops[1] == T_PIPE);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// more lexemes than the default capacity of the lexeme arrays
+void lex_many_lexemes_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    constexpr size_t count = 500;
+    char buffer[count * 2 + 1];
+    for (size_t i = 0; i < count; ++i) {
+        buffer[i * 2] = 'a' + (char)(i % 26);
+        buffer[i * 2 + 1] = ' ';
+    }
+    buffer[count * 2 - 1] = '\0';
+
+    Lexemes lexemes = {0};
+    lex(Str(buffer, count * 2), &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == count);
+    eassert(lexemes.cap > count);
+    for (size_t i = 0; i < count; ++i) {
+        eassert(lexemes.strs[i].length == 2);
+        eassert(lexemes.strs[i].value[0] == 'a' + (char)(i % 26));
+        eassert(lexemes.ops[i] == T_CONST);
+    }
+    eassert(!lexemes.strs[count].value);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+void lex_keywords_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    auto line = Str_Lit("if fi do in then else elif done true false while for -eq -lt -le -gt -ge");
+    enum Token toks[] = {T_IF,   T_FI,    T_DO,    T_IN,  T_THEN, T_ELSE, T_ELIF, T_DONE, T_TRUE,
+                         T_FALSE, T_WHILE, T_FOR, T_EQ_A, T_LT_A, T_LE_A, T_GT_A, T_GE_A};
+
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == sizeof(toks) / sizeof(*toks));
+    for (size_t i = 0; i < lexemes.count; ++i) {
+        eassert(lexemes.ops[i] == toks[i]);
+    }
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// words which hash like keywords or start like them
+void lex_keywords_near_miss_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    auto line = Str_Lit("iff f don dine tru flase whale fo -eqq -l elf 12345 -12");
+
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == 13);
+    for (size_t i = 0; i < 11; ++i) {
+        eassert(lexemes.ops[i] == T_CONST);
+    }
+    eassert(lexemes.ops[11] == T_NUM);
+    eassert(lexemes.ops[12] == T_NUM);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// words longer than the vector width and with characters the vector scan stops on
+void lex_long_words_test()
+{
+    SCRATCH_ARENA_TEST_SETUP;
+
+    auto line = Str_Lit("/usr/local/share/ncsh/completions/git_completions.txt user@host:~/a,b.c_d|wc");
+
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, &scratch_arena);
+
+    eassert(lexemes.count == 4);
+    eassert(estrcmp(lexemes.strs[0], Str_Lit("/usr/local/share/ncsh/completions/git_completions.txt")));
+    eassert(lexemes.ops[0] == T_CONST);
+    eassert(estrcmp(lexemes.strs[1], Str_Lit("user@host:~/a,b.c_d")));
+    eassert(lexemes.ops[1] == T_CONST);
+    eassert(lexemes.ops[2] == T_PIPE);
+    eassert(estrcmp(lexemes.strs[3], Str_Lit("wc")));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
 void lexer_tests()
 {
     // etest_init(true);
@@ -1650,6 +1789,7 @@ void lexer_tests()
     etest_run(lex_if_else_test);
     etest_run(lex_if_elif_elif_else_test);
     etest_run(lex_comment_test);
+    etest_run(lex_comment_symbols_test);
 
     etest_run(lex_math_operators_test);
     etest_run(lex_var_increment_test);
@@ -1661,6 +1801,12 @@ void lexer_tests()
     etest_run(lex_for_each_test);
     etest_run(lex_for_each_expansion_test);
 
+    etest_run(lex_symbols_no_whitespace_test);
+    etest_run(lex_many_lexemes_test);
+    etest_run(lex_keywords_test);
+    etest_run(lex_keywords_near_miss_test);
+    etest_run(lex_long_words_test);
+
     etest_finish();
 }
 
@@ -1679,7 +1825,10 @@ void lex_bad_input_shouldnt_crash()
     SCRATCH_ARENA_TEST_SETUP;
 
     auto line = Str_Lit("~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~C~~~~~~~~~~~~~k~"
-                 "~~~~>ÿÿ> >ÿ>\w\>ÿ> >ÿ> \> >");
+                 "~~~~>ÿÿ> >ÿ>\
+w\
+>ÿ> >ÿ> \
+> >");
 
     Lexemes lexemes = {0};
     lex(line, &lexemes, &scratch_arena);
@@ -0,0 +1,188 @@
+/* parse_cache_tests.c: tests for parse_cache.c, caching parser output by input line. */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../etest.h"
+#include "../../src/interpreter/lex.h"
+#include "../../src/interpreter/parse.h"
+#include "../../src/interpreter/parse_cache.h"
+#include "../lib/arena_test_helper.h"
+
+#define PARSE_CACHE_TEST_SETUP                                                                                         \
+    ARENA_TEST_SETUP;                                                                                                  \
+    SCRATCH_ARENA_TEST_SETUP;                                                                                          \
+    Shell shell = {.arena = a};                                                                                        \
+    parse_cache_new(&shell);                                                                                           \
+    Parse_Cache* cache = shell.parse_cache
+
+#define PARSE_CACHE_TEST_TEARDOWN                                                                                      \
+    SCRATCH_ARENA_TEST_TEARDOWN;                                                                                       \
+    ARENA_TEST_TEARDOWN
+
+static Statements* parse_line(Str line, Arena* restrict scratch)
+{
+    Lexemes lexemes = {0};
+    lex(line, &lexemes, scratch);
+    auto rv = parse(&lexemes, scratch);
+    assert(!rv.parser_errno);
+    return rv.output.stmts;
+}
+
+void parse_cache_miss_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    eassert(!parse_cache_get(cache, Str_Lit("ls"), &s));
+
+    parse_cache_add(cache, Str_Lit("ls"), parse_line(Str_Lit("ls"), &s), s);
+    eassert(!parse_cache_get(cache, Str_Lit("ls -a"), &s));
+    eassert(!parse_cache_get(cache, Str_Lit("l"), &s));
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+void parse_cache_hit_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    Str line = Str_Lit("ls -a | sort > out.txt");
+    Statements* stmts = parse_line(line, &s);
+    parse_cache_add(cache, line, stmts, s);
+
+    Statements* cached = parse_cache_get(cache, line, &s);
+    eassert(cached);
+    eassert(cached != stmts);
+    eassert(cached->type == stmts->type);
+    eassert(cached->pipes_count == 2);
+    eassert(cached->redirect_type == stmts->redirect_type);
+    eassert(!strcmp(cached->redirect_filename, "out.txt"));
+
+    Commands* cmds = cached->head->commands;
+    eassert(cmds != stmts->head->commands);
+    eassert(cmds->count == 2);
+    eassert(cmds->cap == 3);
+    eassert(estrcmp(cmds->strs[0], Str_Lit("ls")));
+    eassert(estrcmp(cmds->strs[1], Str_Lit("-a")));
+    eassert(!cmds->strs[2].value);
+    eassert(cmds->next);
+    eassert(estrcmp(cmds->next->strs[0], Str_Lit("sort")));
+    eassert(cmds->next->prev_op == OP_PIPE);
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+// expansion changes commands in place, which must not reach the cached statements, the strings are borrowed
+void parse_cache_copy_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    Str line = Str_Lit("echo ~");
+    parse_cache_add(cache, line, parse_line(line, &s), s);
+
+    Statements* first = parse_cache_get(cache, line, &s);
+    eassert(first);
+    first->head->commands->strs[1] = Str_Lit("/home/alex");
+    first->head->commands->ops[1] = OP_CONST;
+
+    Statements* second = parse_cache_get(cache, line, &s);
+    eassert(second);
+    eassert(estrcmp(second->head->commands->strs[0], Str_Lit("echo")));
+    eassert(estrcmp(second->head->commands->strs[1], Str_Lit("~")));
+    eassert(second->head->commands->ops[1] == OP_HOME_EXPANSION);
+    eassert(second->head->commands->strs[0].value == first->head->commands->strs[0].value);
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+// loops link back to their start, the copy should link back to its own start
+void parse_cache_loop_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    Str line = Str_Lit("while [ $count -lt 3 ]; do echo $count; count=$(count + 1); done");
+    Statements* stmts = parse_line(line, &s);
+    parse_cache_add(cache, line, stmts, s);
+
+    Statements* cached = parse_cache_get(cache, line, &s);
+    eassert(cached);
+
+    Statement* orig = stmts->head;
+    Statement* copy = cached->head;
+    for (size_t i = 0; i < 8 && orig; ++i) {
+        eassert(copy);
+        eassert(copy != orig);
+        eassert(copy->type == orig->type);
+        eassert(!orig->right == !copy->right);
+        eassert((orig->right == stmts->head) == (copy->right == cached->head));
+        orig = orig->right;
+        copy = copy->right;
+    }
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+void parse_cache_lru_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    char lines[parse_cache_size + 1][16];
+    for (size_t i = 0; i < parse_cache_size; ++i) {
+        int len = snprintf(lines[i], sizeof(lines[i]), "echo %zu", i);
+        Str line = Str(lines[i], (size_t)len + 1);
+        parse_cache_add(cache, line, parse_line(line, &s), s);
+    }
+
+    // the first line was used most recently, so the second is replaced instead
+    eassert(parse_cache_get(cache, Str(lines[0], strlen(lines[0]) + 1), &s));
+    int len = snprintf(lines[parse_cache_size], sizeof(lines[0]), "echo %zu", parse_cache_size);
+    Str line = Str(lines[parse_cache_size], (size_t)len + 1);
+    parse_cache_add(cache, line, parse_line(line, &s), s);
+
+    eassert(parse_cache_get(cache, line, &s));
+    eassert(parse_cache_get(cache, Str(lines[0], strlen(lines[0]) + 1), &s));
+    eassert(!parse_cache_get(cache, Str(lines[1], strlen(lines[1]) + 1), &s));
+    eassert(parse_cache_get(cache, Str(lines[2], strlen(lines[2]) + 1), &s));
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+void parse_cache_clear_test()
+{
+    PARSE_CACHE_TEST_SETUP;
+
+    Str line = Str_Lit("ls | wc -l");
+    parse_cache_add(cache, line, parse_line(line, &s), s);
+    eassert(cache->arena.start != cache->memory);
+
+    parse_cache_clear(cache);
+    eassert(cache->arena.start == cache->memory);
+    eassert(!parse_cache_get(cache, line, &s));
+
+    PARSE_CACHE_TEST_TEARDOWN;
+}
+
+void parse_cache_tests()
+{
+    etest_start();
+
+    etest_run(parse_cache_miss_test);
+    etest_run(parse_cache_hit_test);
+    etest_run(parse_cache_copy_test);
+    etest_run(parse_cache_loop_test);
+    etest_run(parse_cache_lru_test);
+    etest_run(parse_cache_clear_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    parse_cache_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
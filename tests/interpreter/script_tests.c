@@ -0,0 +1,227 @@
+/* script_tests.c: tests for script.c, reading scripts one complete command at a time. */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../etest.h"
+#include "../../src/defines.h" // used for macro NCSH_MAX_INPUT
+#include "../../src/interpreter/script.h"
+#include "../lib/arena_test_helper.h"
+
+// regular files are mmap'd
+static int script_file(char* restrict contents)
+{
+    FILE* file = tmpfile();
+    assert(file);
+    size_t len = strlen(contents);
+    [[maybe_unused]] size_t written = fwrite(contents, 1, len, file);
+    assert(written == len);
+    fflush(file);
+    int fd = dup(fileno(file));
+    fclose(file);
+    return fd;
+}
+
+// pipes are streamed
+static int script_pipe(char* restrict contents)
+{
+    int fds[2];
+    [[maybe_unused]] int rv = pipe(fds);
+    assert(!rv);
+    size_t len = strlen(contents);
+    [[maybe_unused]] ssize_t written = write(fds[1], contents, len);
+    assert(written == (ssize_t)len);
+    close(fds[1]);
+    return fds[0];
+}
+
+static void script_commands_check(int fd, char** expected, size_t expected_count, Arena* restrict arena)
+{
+    Script script;
+    eassert(script_open(&script, fd, arena) == EXIT_SUCCESS);
+
+    char buffer[NCSH_MAX_INPUT];
+    Str command;
+    for (size_t i = 0; i < expected_count; ++i) {
+        eassert(script_command_next(&script, buffer, &command) == EXIT_SUCCESS);
+        eassert(estrcmp(command, Str_Get(expected[i])));
+    }
+    eassert(script_command_next(&script, buffer, &command) == EXIT_SUCCESS_END);
+
+    script_close(&script);
+    close(fd);
+}
+
+#define SCRIPT_CHECK(contents, ...)                                                                                    \
+    do {                                                                                                               \
+        char* expected[] = {__VA_ARGS__};                                                                              \
+        size_t count = sizeof(expected) / sizeof(*expected);                                                           \
+        script_commands_check(script_file(contents), expected, count, &a);                                             \
+        script_commands_check(script_pipe(contents), expected, count, &a);                                             \
+    } while (0)
+
+void script_lines_test()
+{
+    ARENA_TEST_SETUP;
+
+    SCRIPT_CHECK("ls\nls -a | sort\necho hello", "ls", "ls -a | sort", "echo hello");
+    SCRIPT_CHECK("ls\r\necho hi  \r\n", "ls", "echo hi");
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_empty_test()
+{
+    ARENA_TEST_SETUP;
+
+    script_commands_check(script_file(""), NULL, 0, &a);
+    script_commands_check(script_pipe(""), NULL, 0, &a);
+    script_commands_check(script_pipe("\n\n  \n# only a comment\n"), NULL, 0, &a);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_comments_test()
+{
+    ARENA_TEST_SETUP;
+
+    SCRIPT_CHECK("#!/bin/ncsh\n# list the files\n\n    ls\n\t# done\necho hi # not done\n", "ls", "echo hi # not done");
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_continuation_test()
+{
+    ARENA_TEST_SETUP;
+
+    SCRIPT_CHECK("ls -a \\\n    | sort\\\n| wc -l\nls", "ls -a     | sort| wc -l", "ls");
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_control_structures_test()
+{
+    ARENA_TEST_SETUP;
+
+    SCRIPT_CHECK("if [ 1 -eq 1 ]; then\n    echo hi\nelse\n    echo hello\nfi\nls",
+                 "if [ 1 -eq 1 ]; then; echo hi; else; echo hello; fi", "ls");
+    SCRIPT_CHECK("for f in a b\ndo\n    echo $f\ndone\n", "for f in a b; do; echo $f; done");
+    SCRIPT_CHECK("while [ $i -lt 3 ]; do\n    if [ $i -eq 1 ]; then\n        echo one\n    fi\ndone\necho end",
+                 "while [ $i -lt 3 ]; do; if [ $i -eq 1 ]; then; echo one; fi; done", "echo end");
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// keywords that aren't commands don't open or close control structures
+void script_keywords_not_commands_test()
+{
+    ARENA_TEST_SETUP;
+
+    SCRIPT_CHECK("echo if\necho 'while'\nls # for", "echo if", "echo 'while'", "ls # for");
+    SCRIPT_CHECK("while [ 1 ]; do\n    echo done\n    echo \"fi\"\ndone",
+                 "while [ 1 ]; do; echo done; echo \"fi\"; done");
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_unclosed_test()
+{
+    ARENA_TEST_SETUP;
+
+    Script script;
+    eassert(script_open(&script, script_pipe("if [ 1 ]; then\n    echo hi\n"), &a) == EXIT_SUCCESS);
+    char buffer[NCSH_MAX_INPUT];
+    Str command;
+    eassert(script_command_next(&script, buffer, &command) == EXIT_FAILURE);
+    close(script.fd);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_too_long_test()
+{
+    ARENA_TEST_SETUP;
+
+    char* contents = arena_malloc(&a, NCSH_MAX_INPUT * 2, char);
+    memset(contents, 'a', NCSH_MAX_INPUT + 16);
+    memcpy(contents + NCSH_MAX_INPUT + 16, "\nls\n", 4);
+
+    Script script;
+    eassert(script_open(&script, script_file(contents), &a) == EXIT_SUCCESS);
+    char buffer[NCSH_MAX_INPUT];
+    Str command;
+    eassert(script_command_next(&script, buffer, &command) == EXIT_FAILURE);
+    script_close(&script);
+    close(script.fd);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// lines which cross the boundary of a read from the stream are joined back together
+void script_stream_long_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr size_t lines_count = 20000;
+    int fds[2];
+    eassert(!pipe(fds));
+    pid_t pid = fork();
+    eassert(pid != -1);
+    if (!pid) {
+        close(fds[0]);
+        FILE* out = fdopen(fds[1], "w");
+        for (size_t i = 0; i < lines_count; ++i) {
+            fprintf(out, "echo %zu\n", i);
+        }
+        fclose(out);
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+
+    Script script;
+    eassert(script_open(&script, fds[0], &a) == EXIT_SUCCESS);
+    char buffer[NCSH_MAX_INPUT];
+    char expected[32];
+    Str command;
+    for (size_t i = 0; i < lines_count; ++i) {
+        eassert(script_command_next(&script, buffer, &command) == EXIT_SUCCESS);
+        int len = snprintf(expected, sizeof(expected), "echo %zu", i);
+        eassert(estrcmp(command, Str(expected, (size_t)len + 1)));
+    }
+    eassert(script_command_next(&script, buffer, &command) == EXIT_SUCCESS_END);
+    eassert(script.line_number == lines_count);
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void script_tests()
+{
+    etest_start();
+
+    etest_run(script_lines_test);
+    etest_run(script_empty_test);
+    etest_run(script_comments_test);
+    etest_run(script_continuation_test);
+    etest_run(script_control_structures_test);
+    etest_run(script_keywords_not_commands_test);
+    etest_run(script_unclosed_test);
+    etest_run(script_too_long_test);
+    etest_run(script_stream_long_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    script_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
@@ -219,19 +219,8 @@ void vm_next_if_multiple_conditions_true_or_test()
     eassert(!memcmp(vm.cmds->strs[0].value, "true", 4));
     eassert(!vm.cmds->strs[1].value);
 
-    // assume first condition succeeds
-    vm.state = EXIT_SUCCESS;
-
-    // second condition
-    vm.next_cmds = vm_next(&vm);
-
-    eassert(vm.next_cmds);
-    eassert(vm.state == VS_IN_CONDITIONS);
-
-    eassert(vm.op_current == OP_OR);
-    eassert(!memcmp(vm.cmds->strs[0].value, "true", 4));
-
-    eassert(!vm.cmds->strs[1].value);
+    // first condition succeeds, short circuits the or
+    vm.status = EXIT_SUCCESS;
 
     // if statements
     vm.next_cmds = vm_next(&vm);
@@ -373,6 +362,8 @@ void vm_next_if_elif_else_if_true_test()
 
     eassert(vm.end);
     eassert(!vm.next_cmds);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
 void vm_next_if_elif_else_elif_true_test()
@@ -430,6 +421,8 @@ void vm_next_if_elif_else_elif_true_test()
 
     eassert(vm.end);
     eassert(!vm.next_cmds);
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
 void vm_next_tests()
@@ -439,12 +432,12 @@ void vm_next_tests()
     etest_run(vm_next_simple_test);
     etest_run(vm_next_if_test);
     etest_run(vm_next_if_multiple_conditions_true_and_test);
-    // etest_run(vm_next_if_multiple_conditions_false_and_test);
+    etest_run(vm_next_if_multiple_conditions_false_and_test);
     etest_run(vm_next_if_multiple_conditions_true_or_test);
     etest_run(vm_next_if_else_true_test);
     etest_run(vm_next_if_else_false_test);
     etest_run(vm_next_if_elif_else_if_true_test);
-    // etest_run(vm_next_if_elif_else_elif_true_test);
+    etest_run(vm_next_if_elif_else_elif_true_test);
 
     etest_finish();
 }
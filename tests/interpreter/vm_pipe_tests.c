@@ -0,0 +1,148 @@
+/* vm_pipe_tests.c: pipelines run through the VM with real processes, vm_tests.c mocks process creation.
+ * Built with posix_spawn and with NCSH_FORK so both ways of launching commands are covered. */
+
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../src/defines.h"
+#include "../etest.h"
+#include "../../src/interpreter/lex.h"
+#include "../../src/interpreter/parse.h"
+#include "../../src/interpreter/vm.h"
+#include "../../src/io/bestline.h"
+#include "../../src/path_cache.h"
+#include "../../src/ttyio/ttyio.h"
+#include "../lib/arena_test_helper.h"
+
+sig_atomic_t vm_child_pid;
+jmp_buf env_jmp_buf;
+volatile int sigwinch_caught;
+
+// use a macro so line numbers are preserved, shell sets the options the input runs with
+#define vm_pipe_status_tester(input, shell, expected)                                                                  \
+    SCRATCH_ARENA_TEST_SETUP;                                                                                          \
+                                                                                                                       \
+    Lexemes lexemes = {0};                                                                                             \
+    lex(Str_Get(input), &lexemes, &scratch_arena);                                                                     \
+    auto parse_rv = parse(&lexemes, &scratch_arena);                                                                   \
+    eassert(!parse_rv.parser_errno);                                                                                   \
+    int res = vm_execute(parse_rv.output.stmts, shell, &scratch_arena);                                                \
+    eassert(res == expected);                                                                                          \
+    SCRATCH_ARENA_TEST_TEARDOWN;
+
+/* vm_pipe_count_tester
+ * Runs input, which writes the number of bytes that went through its pipeline to t.txt, and checks that number.
+ */
+void vm_pipe_count_tester(char* input, long expected)
+{
+    vm_pipe_status_tester(input, &(Shell){}, EXIT_SUCCESS);
+
+    FILE* file = fopen("t.txt", "r");
+    eassert(file);
+    long count = 0;
+    int scanned = fscanf(file, "%ld", &count);
+    fclose(file);
+    eassert(scanned == 1);
+    eassert(count == expected);
+}
+
+// more than a pipe buffer (64 KiB on Linux), a stage that isn't drained while it writes never finishes
+constexpr long vm_pipe_large_output = 200000;
+
+void vm_pipe_large_output_test()
+{
+    vm_pipe_count_tester("head -c 200000 /dev/zero | wc -c > t.txt", vm_pipe_large_output);
+}
+
+void vm_pipe_builtin_large_output_test()
+{
+    // bestline keeps 1024 lines of history, so the lines are long enough to go past the pipe buffer
+    char line[256];
+    memset(line, 'x', sizeof(line) - 1);
+    line[sizeof(line) - 1] = '\0';
+    long written = 0;
+    for (size_t i = 0; written <= vm_pipe_large_output; ++i) {
+        int len = snprintf(line, sizeof(line), "echo %zu", i);
+        line[len] = ' ';
+        bestlineHistoryAdd(line);
+        written += (long)sizeof(line); // printed with a newline instead of the '\0'
+    }
+
+    vm_pipe_count_tester("history | wc -c > t.txt", written);
+    vm_pipe_count_tester("history | sort | wc -c > t.txt", written);
+    bestlineHistoryFree();
+}
+
+void vm_pipe_stale_path_test()
+{
+    ARENA_TEST_SETUP;
+
+    char* original_path = getenv("PATH");
+    eassert(original_path);
+    char* saved_path = strdup(original_path);
+    char path[4096];
+    snprintf(path, sizeof(path), "vm_pipe_first:vm_pipe_second:%s", saved_path);
+    setenv("PATH", path, 1);
+    mkdir("vm_pipe_first", 0755);
+    mkdir("vm_pipe_second", 0755);
+    FILE* file = fopen("vm_pipe_first/vm_pipe_command", "w");
+    eassert(file);
+    fputs("#!/bin/sh\necho hello\n", file);
+    fclose(file);
+    chmod("vm_pipe_first/vm_pipe_command", 0755);
+
+    Shell shell = {.arena = arena, .opts.pipefail = true};
+    path_cache_new(&shell);
+    {
+        vm_pipe_status_tester("vm_pipe_command | wc -c > t.txt", &shell, EXIT_SUCCESS);
+    }
+    // the cached path is gone, the command is found again further down PATH
+    rename("vm_pipe_first/vm_pipe_command", "vm_pipe_second/vm_pipe_command");
+    {
+        vm_pipe_status_tester("vm_pipe_command | wc -c > t.txt", &shell, EXIT_SUCCESS);
+    }
+
+    remove("vm_pipe_second/vm_pipe_command");
+    rmdir("vm_pipe_first");
+    rmdir("vm_pipe_second");
+    setenv("PATH", saved_path, 1);
+    free(saved_path);
+    ARENA_TEST_TEARDOWN;
+}
+
+void vm_pipe_tests()
+{
+    tty_init_caps();
+
+    etest_start();
+
+    etest_run_tester("pipe_status_last_stage_test",
+                     vm_pipe_status_tester("sh -c \"exit 3\" | sort", &(Shell){}, EXIT_SUCCESS));
+    etest_run_tester("pipe_status_last_stage_failure_test",
+                     vm_pipe_status_tester("sort < /dev/null | sh -c \"exit 3\"", &(Shell){}, 3));
+    etest_run_tester("pipe_status_pipefail_test",
+                     vm_pipe_status_tester("sh -c \"exit 3\" | sort", &(Shell){.opts.pipefail = true}, 3));
+    etest_run_tester(
+        "pipe_status_pipefail_rightmost_test",
+        vm_pipe_status_tester("sh -c \"exit 3\" | sh -c \"exit 4\" | sort", &(Shell){.opts.pipefail = true}, 4));
+    etest_run(vm_pipe_large_output_test);
+    etest_run(vm_pipe_builtin_large_output_test);
+    etest_run(vm_pipe_stale_path_test);
+
+    etest_finish();
+
+    remove("t.txt");
+    tty_deinit_caps();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    vm_pipe_tests();
+}
+#endif /* ifndef TEST_ALL */
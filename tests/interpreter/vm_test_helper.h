@@ -2,6 +2,7 @@
 
 #include <setjmp.h>
 
+#include "../../src/interpreter/compile.h"
 #include "../../src/interpreter/parse.h"
 #include "../../src/interpreter/vm_types.h"
 #include "../etest.h"
@@ -15,13 +16,7 @@ Commands* vm_next(Vm_Data* restrict vm);
 
 static inline void vm_setup(Vm_Data* vm, Parser_Output rv, Arena* s)
 {
-    *vm = (Vm_Data){.stmts = rv.output.stmts, .cur_stmt = rv.output.stmts->head, .sh = NULL, .s = s};
-    vm->next_cmds = vm->cur_stmt->commands;
-    vm->next_cmds->pos = 0;
     // simulate setup the VM does
-    // vm->stmts = rv.output.stmts;
-    // vm->cur_stmt = rv.output.stmts->head;
-    // vm->s = s;
-    // vm->next_cmds = vm->cur_stmt->commands;
-    // vm->next_cmds->pos = 0;
+    *vm = (Vm_Data){.stmts = rv.output.stmts, .prog = compile(rv.output.stmts, s), .sh = NULL, .s = s};
+    vm->next_cmds = vm->prog->count ? vm->prog->insts[0].cmds : NULL;
 }
@@ -35,6 +35,9 @@ void vm_tests()
     etest_run_tester("simple_test", vm_tester("ls"));
     etest_run_tester("pipe_test", vm_tester("ls | sort"));
     etest_run_tester("pipe_multiple_test", vm_tester("ls | sort | wc -c"));
+    etest_run_tester("pipe_many_stages_test", vm_tester("ls | sort | sort | sort | wc -c"));
+    etest_run_tester("pipe_builtin_stage_test", vm_tester("echo hello | sort"));
+    etest_run_tester("set_pipefail_test", vm_tester("set -o pipefail"));
     etest_run_tester("out_redirect_test", vm_tester("ls > t.txt"));
     etest_run_tester("out_redirect_pipe_test", vm_tester("ls | sort > t.txt"));
     etest_run_tester("out_append_redirect_test", vm_tester("ls >> t.txt"));
@@ -1,5 +1,11 @@
+#define _POSIX_C_SOURCE 200809L // for utimensat and truncate
+
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../../src/defines.h" // used for macro NCSH_MAX_AUTOCOMPLETION_MATCHES
 #include "../etest.h"
@@ -21,6 +27,10 @@ void ac_add_length_mismatch_test()
     ARENA_TEST_TEARDOWN;
 }
 
+// edges aren't null terminated
+#define eassert_edge(node, expected)                                                                                   \
+    eassert((node)->edge_len == sizeof(expected) - 1 && !memcmp((node)->edge, expected, sizeof(expected) - 1))
+
 void ac_add_test()
 {
     ARENA_TEST_SETUP;
@@ -32,23 +42,17 @@ void ac_add_test()
     ac_add(string.value, string.length, tree, &arena);
 
     // sanity check: unrelated letters are null
-    eassert(tree->nodes[char_to_index('b')] == NULL);
-    eassert(tree->nodes[char_to_index('c')] == NULL);
-    eassert(tree->nodes[char_to_index('d')] == NULL);
-    eassert(tree->nodes[char_to_index('e')] == NULL);
-
-    Autocompletion_Node* first_node = tree->nodes[char_to_index('a')];
-    eassert(first_node != NULL);
-    eassert(first_node->is_end_of_a_word == false);
-    eassert(first_node->nodes[char_to_index('b')] == NULL); // sanity check
-    Autocompletion_Node* second_node = first_node->nodes[char_to_index('n')];
-    eassert(second_node != NULL);
-    eassert(second_node->is_end_of_a_word == false);
-    eassert(second_node->nodes[char_to_index('b')] == NULL); // sanity check
-    Autocompletion_Node* third_node = second_node->nodes[char_to_index('d')];
-    eassert(third_node != NULL);
-    eassert(third_node->is_end_of_a_word == true);
-    eassert(third_node->nodes[char_to_index('b')] == NULL); // sanity check
+    eassert(ac_child(tree, 'b') == NULL);
+    eassert(ac_child(tree, 'n') == NULL);
+    eassert(ac_child(tree, 'd') == NULL);
+    eassert(tree->children_count == 1);
+
+    // one node for the whole string, since there is only one way forward
+    Autocompletion_Node* node = ac_child(tree, 'a');
+    eassert(node != NULL);
+    eassert_edge(node, "and");
+    eassert(node->is_end_of_a_word == true);
+    eassert(node->children_count == 0);
 
     ARENA_TEST_TEARDOWN;
 }
@@ -63,36 +67,10 @@ void ac_add_spaces_test()
     Str string = {.value = "ls | wc -c", .length = 11};
     ac_add(string.value, string.length, tree, &arena);
 
-    Autocompletion_Node* first_node = tree->nodes[char_to_index('l')];
-    eassert(first_node != NULL);
-    eassert(first_node->is_end_of_a_word == false);
-    Autocompletion_Node* second_node = first_node->nodes[char_to_index('s')];
-    eassert(second_node != NULL);
-    eassert(second_node->is_end_of_a_word == false);
-    Autocompletion_Node* third_node = second_node->nodes[char_to_index(' ')];
-    eassert(third_node != NULL);
-    eassert(third_node->is_end_of_a_word == false);
-    Autocompletion_Node* fourth_node = third_node->nodes[char_to_index('|')];
-    eassert(fourth_node != NULL);
-    eassert(fourth_node->is_end_of_a_word == false);
-    Autocompletion_Node* fifth_node = fourth_node->nodes[char_to_index(' ')];
-    eassert(fifth_node != NULL);
-    eassert(fifth_node->is_end_of_a_word == false);
-    Autocompletion_Node* sixth_node = fifth_node->nodes[char_to_index('w')];
-    eassert(sixth_node != NULL);
-    eassert(sixth_node->is_end_of_a_word == false);
-    Autocompletion_Node* seventh_node = sixth_node->nodes[char_to_index('c')];
-    eassert(seventh_node != NULL);
-    eassert(seventh_node->is_end_of_a_word == false);
-    Autocompletion_Node* eighth_node = seventh_node->nodes[char_to_index(' ')];
-    eassert(eighth_node != NULL);
-    eassert(eighth_node->is_end_of_a_word == false);
-    Autocompletion_Node* ninth_node = eighth_node->nodes[char_to_index('-')];
-    eassert(ninth_node != NULL);
-    eassert(ninth_node->is_end_of_a_word == false);
-    Autocompletion_Node* tenth_node = ninth_node->nodes[char_to_index('c')];
-    eassert(tenth_node != NULL);
-    eassert(tenth_node->is_end_of_a_word == true);
+    Autocompletion_Node* node = ac_child(tree, 'l');
+    eassert(node != NULL);
+    eassert_edge(node, "ls | wc -c");
+    eassert(node->is_end_of_a_word == true);
 
     ARENA_TEST_TEARDOWN;
 }
@@ -108,19 +86,14 @@ void ac_add_duplicate_test()
     ac_add(string.value, string.length, tree, &arena);
     ac_add(string.value, string.length, tree, &arena);
 
-    Autocompletion_Node* first_node = tree->nodes[char_to_index('a')];
-    eassert(first_node != NULL);
-    eassert(first_node->is_end_of_a_word == false);
-
-    Autocompletion_Node* second_node = first_node->nodes[char_to_index('n')];
-    eassert(second_node != NULL);
-    eassert(second_node->is_end_of_a_word == false);
-
-    Autocompletion_Node* third_node = second_node->nodes[char_to_index('d')];
-    eassert(third_node != NULL);
-    eassert(third_node->is_end_of_a_word == true);
+    eassert(tree->children_count == 1);
+    Autocompletion_Node* node = ac_child(tree, 'a');
+    eassert(node != NULL);
+    eassert_edge(node, "and");
+    eassert(node->is_end_of_a_word == true);
+    eassert(node->children_count == 0);
 #ifndef NCSH_AC_CHARACTER_WEIGHTING
-    eassert(third_node->weight == 3); // starts at 1, each add adds 1
+    eassert(node->weight == 3); // starts at 1, each add adds 1
 #endif
 
     ARENA_TEST_TEARDOWN;
@@ -138,28 +111,20 @@ void ac_add_multiple_unrelated_test()
     Str string_two = {.value = "echo", .length = 5};
     ac_add(string_two.value, string_two.length, tree, &arena);
 
-    Autocompletion_Node* ls_first_node = tree->nodes[char_to_index('l')];
-    eassert(ls_first_node != NULL);
-    eassert(ls_first_node->is_end_of_a_word == false);
-    Autocompletion_Node* ls_second_node = ls_first_node->nodes[char_to_index('s')];
-    eassert(ls_second_node != NULL);
-    eassert(ls_second_node->is_end_of_a_word == true);
+    // children are sorted by the first character of their edge
+    eassert(tree->children_count == 2);
+    eassert(tree->keys[0] == 'e');
+    eassert(tree->keys[1] == 'l');
 
-    Autocompletion_Node* first_node = tree->nodes[char_to_index('e')];
-    eassert(first_node != NULL);
-    eassert(first_node->is_end_of_a_word == false);
+    Autocompletion_Node* ls_node = ac_child(tree, 'l');
+    eassert(ls_node != NULL);
+    eassert_edge(ls_node, "ls");
+    eassert(ls_node->is_end_of_a_word == true);
 
-    Autocompletion_Node* second_node = first_node->nodes[char_to_index('c')];
-    eassert(second_node != NULL);
-    eassert(second_node->is_end_of_a_word == false);
-
-    Autocompletion_Node* third_node = second_node->nodes[char_to_index('h')];
-    eassert(third_node != NULL);
-    eassert(third_node->is_end_of_a_word == false);
-
-    Autocompletion_Node* fourth_node = third_node->nodes[char_to_index('o')];
-    eassert(fourth_node != NULL);
-    eassert(fourth_node->is_end_of_a_word == true);
+    Autocompletion_Node* echo_node = ac_child(tree, 'e');
+    eassert(echo_node != NULL);
+    eassert_edge(echo_node, "echo");
+    eassert(echo_node->is_end_of_a_word == true);
 
     ARENA_TEST_TEARDOWN;
 }
@@ -178,48 +143,86 @@ void ac_add_multiple_related_test()
     Str string_three = {.value = "genius", .length = 7};
     ac_add(string_three.value, string_three.length, tree, &arena);
 
+    // "gene" is split into "gen" and "e" when "genius" is added
+    Autocompletion_Node* gen_node = ac_child(tree, 'g');
+    eassert(gen_node != NULL);
+    eassert_edge(gen_node, "gen");
+    eassert(gen_node->is_end_of_a_word == false);
+    eassert(gen_node->children_count == 2);
+
     // gene
-    Autocompletion_Node* first_node = tree->nodes[char_to_index('g')];
-    eassert(first_node != NULL);
-    eassert(first_node->is_end_of_a_word == false);
+    Autocompletion_Node* gene_node = ac_child(gen_node, 'e');
+    eassert(gene_node != NULL);
+    eassert_edge(gene_node, "e");
+    eassert(gene_node->is_end_of_a_word == true);
+
+    // genetic
+    Autocompletion_Node* genetic_node = ac_child(gene_node, 't');
+    eassert(genetic_node != NULL);
+    eassert_edge(genetic_node, "tic");
+    eassert(genetic_node->is_end_of_a_word == true);
 
-    Autocompletion_Node* second_node = first_node->nodes[char_to_index('e')];
-    eassert(second_node != NULL);
-    eassert(second_node->is_end_of_a_word == false);
+    // genius
+    Autocompletion_Node* genius_node = ac_child(gen_node, 'i');
+    eassert(genius_node != NULL);
+    eassert_edge(genius_node, "ius");
+    eassert(genius_node->is_end_of_a_word == true);
 
-    Autocompletion_Node* third_node = second_node->nodes[char_to_index('n')];
-    eassert(third_node != NULL);
-    eassert(third_node->is_end_of_a_word == false);
+    ARENA_TEST_TEARDOWN;
+}
 
-    Autocompletion_Node* fourth_node = third_node->nodes[char_to_index('e')];
-    eassert(fourth_node != NULL);
-    eassert(fourth_node->is_end_of_a_word == true);
+// adding a prefix of an existing edge splits the edge
+void ac_add_split_test()
+{
+    ARENA_TEST_SETUP;
 
-    // genetic
-    Autocompletion_Node* genetic_fifth_node = fourth_node->nodes[char_to_index('t')];
-    eassert(genetic_fifth_node != NULL);
-    eassert(genetic_fifth_node->is_end_of_a_word == false);
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
 
-    Autocompletion_Node* genetic_sixth_node = genetic_fifth_node->nodes[char_to_index('i')];
-    eassert(genetic_sixth_node != NULL);
-    eassert(genetic_sixth_node->is_end_of_a_word == false);
+    ac_add("ls | sort", 10, tree, &arena);
+    ac_add("ls", 3, tree, &arena);
 
-    Autocompletion_Node* genetic_seventh_node = genetic_sixth_node->nodes[char_to_index('c')];
-    eassert(genetic_seventh_node != NULL);
-    eassert(genetic_seventh_node->is_end_of_a_word == true);
+    Autocompletion_Node* ls_node = ac_child(tree, 'l');
+    eassert(ls_node != NULL);
+    eassert_edge(ls_node, "ls");
+    eassert(ls_node->is_end_of_a_word == true);
+    eassert(ls_node->children_count == 1);
 
-    // genius
-    Autocompletion_Node* genius_fourth_node = third_node->nodes[char_to_index('i')];
-    eassert(genius_fourth_node != NULL);
-    eassert(genius_fourth_node->is_end_of_a_word == false);
+    Autocompletion_Node* sort_node = ac_child(ls_node, ' ');
+    eassert(sort_node != NULL);
+    eassert_edge(sort_node, " | sort");
+    eassert(sort_node->is_end_of_a_word == true);
+#ifndef NCSH_AC_CHARACTER_WEIGHTING
+    eassert(ls_node->weight == 2);
+    eassert(sort_node->weight == 2);
+#endif
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// nodes only have room for the children they have, not one pointer per character
+void ac_add_many_children_test()
+{
+    ARENA_TEST_SETUP;
 
-    Autocompletion_Node* genius_fifth_node = genius_fourth_node->nodes[char_to_index('u')];
-    eassert(genius_fifth_node != NULL);
-    eassert(genius_fifth_node->is_end_of_a_word == false);
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
 
-    Autocompletion_Node* genius_sixth_node = genius_fifth_node->nodes[char_to_index('s')];
-    eassert(genius_sixth_node != NULL);
-    eassert(genius_sixth_node->is_end_of_a_word == true);
+    char string[3] = {'a', 0, 0};
+    for (char c = '~'; c >= ' '; --c) {
+        string[1] = c;
+        ac_add(string, sizeof(string), tree, &arena);
+    }
+
+    Autocompletion_Node* a_node = ac_child(tree, 'a');
+    eassert(a_node != NULL);
+    eassert(a_node->children_count == '~' - ' ' + 1);
+    eassert(a_node->children_cap >= a_node->children_count);
+    for (uint8_t i = 0; i < a_node->children_count; ++i) {
+        eassert(a_node->keys[i] == ' ' + i);
+        eassert(a_node->children[i]->edge_len == 1);
+        eassert(a_node->children[i]->is_end_of_a_word == true);
+    }
 
     ARENA_TEST_TEARDOWN;
 }
@@ -241,10 +244,17 @@ void ac_find_test()
     Autocompletion_Node* result = ac_find("gen", tree);
 
     eassert(result != NULL);
-    Autocompletion_Node* result_e = result->nodes[char_to_index('e')];
+    Autocompletion_Node* result_e = ac_child(result, 'e');
     eassert(result_e != NULL);
     eassert(result_e->is_end_of_a_word == true);
 
+    // prefixes ending inside of an edge find the node the edge leads to
+    result = ac_find("genet", tree);
+    eassert(result != NULL);
+    eassert_edge(result, "tic");
+
+    eassert(ac_find("genez", tree) == NULL);
+
     ARENA_TEST_TEARDOWN;
 }
 
@@ -263,36 +273,24 @@ void ac_find_commands_test()
     ac_add("rm t.txt", 9, tree, &arena);
     ac_add("ss", 3, tree, &arena);
 
-    Autocompletion_Node* result = tree->nodes[char_to_index('l')];
-    eassert(result != NULL);
-    eassert(result->is_end_of_a_word == false);
-
-    result = result->nodes[char_to_index('s')];
+    Autocompletion_Node* result = ac_child(tree, 'l');
     eassert(result != NULL);
+    eassert_edge(result, "ls");
     eassert(result->is_end_of_a_word == true);
 
-    result = result->nodes[char_to_index(' ')];
+    result = ac_child(result, ' ');
     eassert(result != NULL);
+    eassert_edge(result, " ");
     eassert(result->is_end_of_a_word == false);
 
     Autocompletion_Node* search_res = ac_find("ls | ", tree);
     eassert(search_res != NULL);
-    eassert(search_res->is_end_of_a_word == false);
-
-    search_res = search_res->nodes[char_to_index('s')];
-    eassert(search_res != NULL);
-    eassert(search_res->is_end_of_a_word == false);
-
-    search_res = search_res->nodes[char_to_index('o')];
-    eassert(search_res != NULL);
-    eassert(search_res->is_end_of_a_word == false);
-
-    search_res = search_res->nodes[char_to_index('r')];
-    eassert(search_res != NULL);
-    eassert(search_res->is_end_of_a_word == false);
+    eassert_edge(search_res, "| sort");
+    eassert(search_res->is_end_of_a_word == true);
 
-    search_res = search_res->nodes[char_to_index('t')];
+    search_res = ac_child(search_res, ' ');
     eassert(search_res != NULL);
+    eassert_edge(search_res, " | wc -c");
     eassert(search_res->is_end_of_a_word == true);
 
     ARENA_TEST_TEARDOWN;
@@ -383,6 +381,31 @@ void ac_get_spaces_test()
     SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
+// an empty search ends at the root, which has no edge, every word is a match
+void ac_get_root_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    ac_add("ls", 3, tree, &arena);
+    ac_add("ls | sort", 10, tree, &arena);
+    ac_add("nvim .", 7, tree, &arena);
+
+    Autocompletion autocomplete[NCSH_MAX_AUTOCOMPLETION_MATCHES] = {0};
+    uint8_t match_count = ac_get("", autocomplete, tree, scratch_arena);
+
+    eassert(match_count == 3);
+    eassert(!strcmp(autocomplete[0].value, "ls"));
+    eassert(!strcmp(autocomplete[1].value, "ls | sort"));
+    eassert(!strcmp(autocomplete[2].value, "nvim ."));
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
 void ac_get_no_results_test()
 {
     ARENA_TEST_SETUP;
@@ -494,7 +517,6 @@ void ac_get_multiple_simulation_test()
 void ac_first_test()
 {
     ARENA_TEST_SETUP;
-    SCRATCH_ARENA_TEST_SETUP;
 
     Autocompletion_Node* tree = ac_alloc(&arena);
     eassert(tree != NULL);
@@ -511,19 +533,17 @@ void ac_first_test()
     eassert(search_res != NULL);
 
     char match[NCSH_MAX_INPUT] = {0};
-    uint8_t match_count = ac_first("ls | ", match, tree, scratch_arena);
+    uint8_t match_count = ac_first("ls | ", match, tree);
 
     eassert(match_count == 1);
     eassert(!memcmp(match, "sort | wc -c", 13));
 
     ARENA_TEST_TEARDOWN;
-    SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
 void ac_first_no_matches_test()
 {
     ARENA_TEST_SETUP;
-    SCRATCH_ARENA_TEST_SETUP;
 
     Autocompletion_Node* tree = ac_alloc(&arena);
     eassert(tree != NULL);
@@ -535,10 +555,513 @@ void ac_first_no_matches_test()
     ac_add("nvim .", 7, tree, &arena);
 
     char match[NCSH_MAX_INPUT] = {0};
-    uint8_t match_count = ac_first("ls", match, tree, scratch_arena);
+    uint8_t match_count = ac_first("ls", match, tree);
+
+    eassert(!match_count);
+
+    // the search itself isn't a match
+    match_count = ac_first("nvim .", match, tree);
 
     eassert(!match_count);
 
+    ARENA_TEST_TEARDOWN;
+}
+
+// the search can end in the middle of an edge, and the word it ends in can be the best match
+void ac_first_inside_edge_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    ac_add("git status", 11, tree, &arena);
+    ac_add("git status", 11, tree, &arena);
+    ac_add("git status --short", 19, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("git st", match, tree) == 1);
+    eassert(!strcmp(match, "atus"));
+
+    eassert(ac_first("git status", match, tree) == 1);
+    eassert(!strcmp(match, " --short"));
+
+    ac_add("git status --short", 19, tree, &arena);
+    ac_add("git status --short", 19, tree, &arena);
+
+    eassert(ac_first("git st", match, tree) == 1);
+    eassert(!strcmp(match, "atus --short"));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// ties go to the word which reached the score first
+void ac_first_ties_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    constexpr time_t now = 1700000000;
+    ac_add_at("make test", 10, now, tree, &arena);
+    ac_add_at("make check", 11, now, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("make ", match, tree) == 1);
+    eassert(!strcmp(match, "test"));
+
+    ac_add_at("make check", 11, now, tree, &arena);
+
+    eassert(ac_first("make ", match, tree) == 1);
+    eassert(!strcmp(match, "check"));
+
+    ac_add_at("make test", 10, now, tree, &arena);
+
+    eassert(ac_first("make ", match, tree) == 1);
+    eassert(!strcmp(match, "check"));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// the best match is found out of every word starting with the search, not just the first matches in lexical order
+void ac_first_many_matches_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    char string[] = "cd dir_00";
+    for (int i = 0; i < NCSH_MAX_AUTOCOMPLETION_MATCHES * 2; ++i) {
+        string[sizeof(string) - 3] = (char)('0' + i / 10);
+        string[sizeof(string) - 2] = (char)('0' + i % 10);
+        ac_add(string, sizeof(string), tree, &arena);
+    }
+    ac_add("cd dir_63", sizeof("cd dir_63"), tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("cd ", match, tree) == 1);
+    eassert(!strcmp(match, "dir_63"));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+static void ac_frecency_reset()
+{
+    ac_frecency_set((Autocompletion_Frecency){
+        .half_life = NCSH_AC_HALF_LIFE_HOURS * 60.0 * 60.0,
+        .age_every = NCSH_AC_AGE_EVERY,
+        .prune_below = NCSH_AC_PRUNE_BELOW,
+    });
+}
+
+// a word used less often but more recently can outrank one used more often, depending on the half life
+void ac_first_frecency_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr time_t now = 1700000000;
+    constexpr time_t hour = 60 * 60;
+    ac_frecency_set((Autocompletion_Frecency){.half_life = hour});
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    for (int i = 0; i < 4; ++i) {
+        ac_add_at("make test", 10, now, tree, &arena);
+    }
+    // 5 decayed for half a half life is still more than 3
+    ac_add_at("make check", 11, now + hour / 2, tree, &arena);
+    ac_add_at("make check", 11, now + hour / 2, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("make ", match, tree) == 1);
+    eassert(!strcmp(match, "test"));
+
+    // 5 decayed for two half lives is less than 4
+    ac_add_at("make check", 11, now + hour * 2, tree, &arena);
+
+    eassert(ac_first("make ", match, tree) == 1);
+    eassert(!strcmp(match, "check"));
+
+    // the same uses with a long half life are ranked by count
+    ac_frecency_set((Autocompletion_Frecency){.half_life = hour * 1000});
+    Autocompletion_Node* long_tree = ac_alloc(&arena);
+    for (int i = 0; i < 4; ++i) {
+        ac_add_at("make test", 10, now, long_tree, &arena);
+    }
+    for (int i = 0; i < 3; ++i) {
+        ac_add_at("make check", 11, now + hour * 2, long_tree, &arena);
+    }
+    eassert(ac_first("make ", match, long_tree) == 1);
+    eassert(!strcmp(match, "test"));
+
+    ac_frecency_reset();
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// aging halves counts, prunes words scoring below the threshold, and merges the edges left with one way forward
+void ac_age_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr time_t now = 1700000000;
+    constexpr time_t hour = 60 * 60;
+    ac_frecency_set((Autocompletion_Frecency){.half_life = hour, .prune_below = 1});
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    for (int i = 0; i < 7; ++i) {
+        ac_add_at("git status", 11, now, tree, &arena);
+    }
+    ac_add_at("git stash", 10, now, tree, &arena);
+    ac_add_at("git stash pop", 14, now - hour * 10, tree, &arena);
+    ac_add_at("ls -a", 6, now - hour * 10, tree, &arena);
+    ac_add_at("ls -l", 6, now, tree, &arena);
+    ac_add_at("ls -l", 6, now, tree, &arena);
+
+    ac_age(tree, now, &arena);
+
+    Autocompletion_Node* status = ac_find("git status", tree);
+    eassert(status != NULL);
+    eassert(status->weight == 4);
+    Autocompletion_Node* stash = ac_find("git stash", tree);
+    eassert(stash != NULL);
+    eassert(stash->is_end_of_a_word);
+    eassert(stash->weight == 1);
+    eassert(stash->children_count == 0);
+    eassert(ac_find("git stash p", tree) == NULL);
+
+    // 'ls -' only led to 'ls -l' once 'ls -a' was pruned
+    eassert(ac_find("ls -a", tree) == NULL);
+    Autocompletion_Node* ls = ac_child(tree, 'l');
+    eassert(ls != NULL);
+    eassert_edge(ls, "ls -l");
+    eassert(ls->is_end_of_a_word);
+    eassert(ls->weight == 2);
+    eassert(ls->parent == tree);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("git sta", match, tree) == 1);
+    eassert(!strcmp(match, "tus"));
+    eassert(ac_first("git stash", match, tree) == 0);
+    eassert(ac_first("l", match, tree) == 1);
+    eassert(!strcmp(match, "s -l"));
+
+    // words can still be added after aging
+    ac_add_at("ls -la", 7, now, tree, &arena);
+    eassert(ac_first("ls -", match, tree) == 1);
+    eassert(!strcmp(match, "l"));
+
+    ac_frecency_reset();
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// counts are halved every age_every words, so they stay bounded and can't overflow
+void ac_age_every_test()
+{
+    ARENA_TEST_SETUP;
+
+    constexpr time_t now = 1700000000;
+    ac_frecency_set((Autocompletion_Frecency){.half_life = 60 * 60, .age_every = 4, .prune_below = 0.5});
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    for (int i = 0; i < 100; ++i) {
+        ac_add_at("ls", 3, now + i, tree, &arena);
+        Autocompletion_Node* ls = ac_find("ls", tree);
+        eassert(ls != NULL);
+        eassert(ls->weight <= 2 * 4);
+        eassert(tree->added < 4);
+    }
+
+    // without aging, counts stop at the max instead of wrapping around
+    ac_frecency_set((Autocompletion_Frecency){.half_life = 60 * 60});
+    Autocompletion_Node* unaged = ac_alloc(&arena);
+    for (int i = 0; i < UINT16_MAX + 10; ++i) {
+        ac_add_at("ls", 3, now, unaged, &arena);
+    }
+    eassert(ac_find("ls", unaged)->weight == UINT16_MAX);
+
+    ac_frecency_reset();
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// typing and deleting characters gives the same matches as searching from the root
+void ac_cursor_first_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    ac_add("ls", 3, tree, &arena);
+    ac_add("ls | wc -c", 11, tree, &arena);
+    ac_add("ls | sort", 10, tree, &arena);
+    ac_add("ls | sort | wc -c", 18, tree, &arena);
+    ac_add("ls | sort | wc -c", 18, tree, &arena);
+    ac_add("ls > t.txt", 11, tree, &arena);
+    ac_add("nvim .", 7, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    char expected[NCSH_MAX_INPUT] = {0};
+    Autocompletion_Cursor cursor;
+    ac_cursor_init(&cursor, tree, match, &arena);
+
+    char* keystrokes[] = {"l", "ls", "ls ", "ls |", "ls | ", "ls | s", "ls | ", "ls |", "ls >", "ls > t.txt",
+                          "ls > t.txtx", "ls > t.txt", "n", "nv", "x", "", "ls | w"};
+    for (size_t i = 0; i < sizeof(keystrokes) / sizeof(*keystrokes); ++i) {
+        uint8_t expected_count = ac_first(keystrokes[i], expected, tree);
+        eassert(ac_cursor_first(&cursor, keystrokes[i]) == expected_count);
+        eassert(!expected_count || !strcmp(match, expected));
+        eassert(expected_count || !match[0]);
+        // calling again with the same search uses the cached result
+        eassert(ac_cursor_first(&cursor, keystrokes[i]) == expected_count);
+    }
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// a cursor which hasn't moved is at the root, which has no edge, its best match is the whole word
+void ac_cursor_root_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    ac_add("ls", 3, tree, &arena);
+    ac_add("ls", 3, tree, &arena);
+    ac_add("nvim .", 7, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    Autocompletion_Cursor cursor;
+    ac_cursor_init(&cursor, tree, match, &arena);
+
+    eassert(ac_cursor_first(&cursor, "") == 1);
+    eassert(!strcmp(match, "ls"));
+    eassert(ac_cursor_first(&cursor, "n") == 1);
+    eassert(!strcmp(match, "vim ."));
+    eassert(ac_cursor_first(&cursor, "") == 1);
+    eassert(!strcmp(match, "ls"));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void ac_cursor_reset_test()
+{
+    ARENA_TEST_SETUP;
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    eassert(tree != NULL);
+
+    ac_add("git status", 11, tree, &arena);
+
+    char match[NCSH_MAX_INPUT] = {0};
+    Autocompletion_Cursor cursor;
+    ac_cursor_init(&cursor, tree, match, &arena);
+
+    eassert(ac_cursor_first(&cursor, "git s") == 1);
+    eassert(!strcmp(match, "tatus"));
+
+    // splits the edge the cursor is in
+    ac_add("git stash", 10, tree, &arena);
+    ac_add("git stash", 10, tree, &arena);
+    ac_cursor_reset(&cursor);
+
+    eassert(ac_cursor_first(&cursor, "git s") == 1);
+    eassert(!strcmp(match, "tash"));
+    eassert(ac_cursor_first(&cursor, "git stat") == 1);
+    eassert(!strcmp(match, "us"));
+
+    ARENA_TEST_TEARDOWN;
+}
+
+static void ac_snapshot_history_write(char* restrict history_path, char* restrict contents)
+{
+    FILE* file = fopen(history_path, "w");
+    eassert(file);
+    fputs(contents, file);
+    fclose(file);
+}
+
+// the trie mapped from a snapshot gives the same matches as the trie it was saved from
+void ac_snapshot_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    char history_path[] = "/tmp/ncsh_ac_tests_history";
+    char ac_path[] = "/tmp/ncsh_ac_tests_history_ac";
+    ac_snapshot_history_write(history_path, "ls\nls | sort\n");
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    ac_add("ls", 3, tree, &arena);
+    ac_add("ls | wc -c", 11, tree, &arena);
+    ac_add("ls | sort", 10, tree, &arena);
+    ac_add("ls | sort | wc -c", 18, tree, &arena);
+    ac_add("ls | sort | wc -c", 18, tree, &arena);
+    ac_add("ls > t.txt", 11, tree, &arena);
+    ac_add("nvim .", 7, tree, &arena);
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch_arena) == EXIT_SUCCESS);
+
+    Autocompletion_Node* loaded = ac_snapshot_load(ac_path, history_path, &arena);
+    eassert(loaded != NULL);
+    eassert(loaded->added == tree->added);
+
+    char* searches[] = {"", "l", "ls", "ls | ", "ls | s", "ls >", "n", "nvim", "x"};
+    for (size_t i = 0; i < sizeof(searches) / sizeof(*searches); ++i) {
+        Autocompletion expected[NCSH_MAX_AUTOCOMPLETION_MATCHES] = {0};
+        Autocompletion matches[NCSH_MAX_AUTOCOMPLETION_MATCHES] = {0};
+        uint8_t count = ac_get(searches[i], expected, tree, scratch_arena);
+        eassert(ac_get(searches[i], matches, loaded, scratch_arena) == count);
+        for (uint8_t j = 0; j < count; ++j) {
+            eassert(!strcmp(matches[j].value, expected[j].value));
+            eassert(matches[j].weight == expected[j].weight);
+        }
+
+        char expected_first[NCSH_MAX_INPUT] = {0};
+        char first[NCSH_MAX_INPUT] = {0};
+        count = ac_first(searches[i], expected_first, tree);
+        eassert(ac_first(searches[i], first, loaded) == count);
+        eassert(!strcmp(first, expected_first));
+    }
+
+    // the mapping is read only, adding words copies what they change into the arena
+    ac_add("ls | sort -r", 13, loaded, &arena);
+    ac_add("nvim src", 9, loaded, &arena);
+    ac_add("cat t.txt", 10, loaded, &arena);
+    char first[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("ls | sort ", first, loaded) == 1);
+    eassert(!strcmp(first, "| wc -c"));
+    eassert(ac_first("nvim s", first, loaded) == 1);
+    eassert(!strcmp(first, "rc"));
+    eassert(ac_first("c", first, loaded) == 1);
+    eassert(!strcmp(first, "at t.txt"));
+
+    // and so does aging it
+    ac_age(ac_snapshot_load(ac_path, history_path, &arena), time(NULL), &arena);
+
+    remove(ac_path);
+    remove(history_path);
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// snapshots aren't loaded once the history changes, or when they aren't valid
+void ac_snapshot_stale_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    char history_path[] = "/tmp/ncsh_ac_tests_stale_history";
+    char ac_path[] = "/tmp/ncsh_ac_tests_stale_history_ac";
+    ac_snapshot_history_write(history_path, "ls\n");
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    ac_add("ls", 3, tree, &arena);
+    ac_add("ls -a", 6, tree, &arena);
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch_arena) == EXIT_SUCCESS);
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) != NULL);
+
+    // saved again with the same contents, the modification time changes but the hash doesn't
+    struct timespec times[2] = {{.tv_nsec = UTIME_OMIT}, {.tv_sec = 1}};
+    eassert(!utimensat(AT_FDCWD, history_path, times, 0));
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) != NULL);
+
+    // same size, different contents
+    ac_snapshot_history_write(history_path, "rm\n");
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    ac_snapshot_history_write(history_path, "ls\nrm\n");
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    remove(history_path);
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    // truncated
+    ac_snapshot_history_write(history_path, "ls\n");
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch_arena) == EXIT_SUCCESS);
+    eassert(!truncate(ac_path, 60));
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    // corrupted, the checksum doesn't match
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch_arena) == EXIT_SUCCESS);
+    FILE* file = fopen(ac_path, "r+");
+    eassert(file);
+    eassert(!fseek(file, -1, SEEK_END));
+    fputc('x', file);
+    fclose(file);
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    eassert(ac_snapshot_load("/tmp/ncsh_ac_tests_does_not_exist", history_path, &arena) == NULL);
+
+    remove(ac_path);
+    remove(history_path);
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// rebuilt from a history the snapshot no longer matches, words keep the counts and times saved in the snapshot
+void ac_rebuild_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    constexpr time_t now = 1700000000;
+    constexpr time_t hour = 60 * 60;
+    ac_frecency_set((Autocompletion_Frecency){.half_life = hour, .age_every = 4, .prune_below = 0.5});
+
+    char history_path[] = "/tmp/ncsh_ac_tests_rebuild_history";
+    char ac_path[] = "/tmp/ncsh_ac_tests_rebuild_history_ac";
+    ac_snapshot_history_write(history_path, "ls\n");
+
+    Autocompletion_Node* tree = ac_alloc(&arena);
+    ac_add_at("ls", 3, now - hour * 5, tree, &arena);
+    ac_add_at("ls", 3, now - hour * 5, tree, &arena);
+    ac_add_at("git status", 11, now - hour * 5, tree, &arena);
+    eassert(ac_snapshot_save(tree, ac_path, history_path, scratch_arena) == EXIT_SUCCESS);
+    uint16_t ls_weight = ac_find("ls", tree)->weight;
+
+    ac_snapshot_history_write(history_path, "ls\nmake\nrm t.txt\n");
+    eassert(ac_snapshot_load(ac_path, history_path, &arena) == NULL);
+
+    // more lines than age_every, none of them are aged away
+    Str lines[] = {Str_Lit("ls"),      Str_Lit("make"),    Str_Lit("make -j"), Str_Lit("ls -a"),
+                   Str_Lit("ls -l"),   Str_Lit("cat"),     Str_Lit("rm"),      Str_Lit("rm t.txt")};
+    size_t count = sizeof(lines) / sizeof(*lines);
+    Autocompletion_Node* rebuilt = ac_rebuild(lines, count, ac_path, now, &arena);
+    eassert(rebuilt->added == tree->added);
+
+    Autocompletion_Node* ls = ac_find("ls", rebuilt);
+    eassert(ls && ls->is_end_of_a_word);
+    eassert(ls->weight == ls_weight);
+    eassert(ls->last_used == now - hour * 5);
+    for (size_t i = 1; i < count; ++i) {
+        Autocompletion_Node* word = ac_find(lines[i].value, rebuilt);
+        eassert(word && word->is_end_of_a_word);
+        eassert(word->last_used == now - (time_t)(count - 1 - i));
+    }
+    eassert(!ac_find("git", rebuilt));
+
+    // newer lines rank higher, and so does the word used the most
+    char first[NCSH_MAX_INPUT] = {0};
+    eassert(ac_first("r", first, rebuilt) == 1);
+    eassert(!strcmp(first, "m t.txt"));
+    eassert(ac_first("l", first, rebuilt) == 1);
+    eassert(!strcmp(first, "s -l"));
+
+    // without a snapshot every line is new
+    Autocompletion_Node* fresh = ac_rebuild(lines, count, NULL, now, &arena);
+    eassert(ac_find("ls", fresh)->last_used == now - (time_t)(count - 1));
+    eassert(!fresh->added);
+
+    remove(ac_path);
+    remove(history_path);
+    ac_frecency_reset();
+
     ARENA_TEST_TEARDOWN;
     SCRATCH_ARENA_TEST_TEARDOWN;
 }
@@ -554,6 +1077,8 @@ void ac_tests()
 
     etest_run(ac_add_multiple_unrelated_test);
     etest_run(ac_add_multiple_related_test);
+    etest_run(ac_add_split_test);
+    etest_run(ac_add_many_children_test);
 
     etest_run(ac_find_test);
     etest_run(ac_find_no_results_test);
@@ -561,12 +1086,28 @@ void ac_tests()
 
     etest_run(ac_get_test);
     etest_run(ac_get_spaces_test);
+    etest_run(ac_get_root_test);
     etest_run(ac_get_no_results_test);
     etest_run(ac_get_multiple_test);
     etest_run(ac_get_multiple_simulation_test);
 
     etest_run(ac_first_test);
     etest_run(ac_first_no_matches_test);
+    etest_run(ac_first_inside_edge_test);
+    etest_run(ac_first_ties_test);
+    etest_run(ac_first_many_matches_test);
+    etest_run(ac_first_frecency_test);
+
+    etest_run(ac_age_test);
+    etest_run(ac_age_every_test);
+
+    etest_run(ac_cursor_first_test);
+    etest_run(ac_cursor_root_test);
+    etest_run(ac_cursor_reset_test);
+
+    etest_run(ac_snapshot_test);
+    etest_run(ac_snapshot_stale_test);
+    etest_run(ac_rebuild_test);
 
     etest_finish();
 }
@@ -0,0 +1,527 @@
+/* history_tests.c: tests for the history ring in bestline.c and the history log in history.c */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "../etest.h"
+#include "../../src/io/bestline.h"
+#include "../../src/io/history.h"
+#include "../lib/arena_test_helper.h"
+
+#define HISTORY_TEST_FILE "ncsh_history_ring_test"
+#define HISTORY_LOG_TEST_FILE "ncsh_history_log_test"
+
+static void history_add_n(unsigned from, unsigned to)
+{
+    char line[32];
+    for (unsigned i = from; i < to; ++i) {
+        snprintf(line, sizeof(line), "echo %u", i);
+        eassert(bestlineHistoryAdd(line) == 1);
+    }
+}
+
+static bool history_is(unsigned i, unsigned expected)
+{
+    char line[32];
+    snprintf(line, sizeof(line), "echo %u", expected);
+    const char* entry = bestlineHistoryGet(i);
+    return entry && !strcmp(entry, line);
+}
+
+void history_add_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(8) == 0);
+
+    history_add_n(0, 5);
+    eassert(bestlineHistoryCount() == 5);
+    for (unsigned i = 0; i < 5; ++i) {
+        eassert(history_is(i, i));
+    }
+    eassert(!bestlineHistoryGet(5));
+
+    // the same line twice in a row is only added once
+    eassert(bestlineHistoryAdd("echo 4") == 0);
+    eassert(bestlineHistoryCount() == 5);
+
+    bestlineHistoryFree();
+}
+
+// adding to a full history evicts the oldest entry
+void history_evict_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(8) == 0);
+
+    history_add_n(0, 21);
+    eassert(bestlineHistoryCount() == 8);
+    for (unsigned i = 0; i < 8; ++i) {
+        eassert(history_is(i, 13 + i));
+    }
+
+    bestlineHistoryFree();
+}
+
+void history_delete_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(8) == 0);
+
+    // wrapped around the ring
+    history_add_n(0, 12);
+    eassert(bestlineHistoryDelete(1) == 0); // older half
+    eassert(bestlineHistoryDelete(5) == 0); // newer half
+    eassert(bestlineHistoryDelete(6) == -1);
+    unsigned expected[] = {4, 6, 7, 8, 9, 11};
+    eassert(bestlineHistoryCount() == 6);
+    for (unsigned i = 0; i < 6; ++i) {
+        eassert(history_is(i, expected[i]));
+    }
+
+    history_add_n(12, 15);
+    eassert(bestlineHistoryCount() == 8);
+    eassert(history_is(0, 6));
+    eassert(history_is(7, 14));
+
+    bestlineHistoryFree();
+}
+
+void history_set_max_len_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(8) == 0);
+    history_add_n(0, 12);
+
+    // shrinking keeps the newest entries
+    eassert(bestlineHistorySetMaxLen(3) == 0);
+    eassert(bestlineHistoryCount() == 3);
+    eassert(history_is(0, 9));
+    eassert(history_is(2, 11));
+
+    eassert(bestlineHistorySetMaxLen(16) == 0);
+    history_add_n(12, 20);
+    eassert(bestlineHistoryCount() == 11);
+    eassert(history_is(0, 9));
+    eassert(history_is(10, 19));
+
+    // no history
+    eassert(bestlineHistorySetMaxLen(0) == 0);
+    eassert(bestlineHistoryCount() == 0);
+    eassert(bestlineHistoryAdd("ls") == 0);
+    eassert(!bestlineHistoryGet(0));
+
+    bestlineHistoryFree();
+}
+
+// lines longer than the largest slab block are allocated on their own
+void history_long_lines_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(4) == 0);
+
+    size_t lens[] = {0, 13, 14, 15, 4093, 4094, 4095, 10000};
+    char* line = malloc(10001);
+    eassert(line);
+    for (size_t i = 0; i < sizeof(lens) / sizeof(*lens); ++i) {
+        memset(line, 'a' + (int)i, lens[i]);
+        line[lens[i]] = '\0';
+        eassert(bestlineHistoryAdd(line) == 1);
+        const char* entry = bestlineHistoryGet(bestlineHistoryCount() - 1);
+        eassert(entry && strlen(entry) == lens[i] && !memcmp(entry, line, lens[i]));
+    }
+    eassert(bestlineHistoryCount() == 4);
+    eassert(strlen(bestlineHistoryGet(0)) == 4093);
+
+    free(line);
+    bestlineHistoryFree();
+}
+
+// only the newest entries of the history file fit in memory
+void history_load_save_test()
+{
+    FILE* file = fopen(HISTORY_TEST_FILE, "w");
+    eassert(file);
+    for (unsigned i = 0; i < 100000; ++i) {
+        fprintf(file, "echo %u\n", i);
+    }
+    fclose(file);
+
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(50000) == 0);
+    eassert(bestlineHistoryLoad(HISTORY_TEST_FILE) == 0);
+    eassert(bestlineHistoryCount() == 50000);
+    eassert(history_is(0, 50000));
+    eassert(history_is(49999, 99999));
+
+    history_add_n(100000, 100010);
+    eassert(bestlineHistoryCount() == 50000);
+    eassert(history_is(0, 50010));
+    eassert(bestlineHistorySave(HISTORY_TEST_FILE) == 0);
+
+    bestlineHistoryFree();
+    eassert(bestlineHistoryLoad(HISTORY_TEST_FILE) == 0);
+    eassert(bestlineHistoryCount() == 50000);
+    eassert(history_is(0, 50010));
+    eassert(history_is(49999, 100009));
+
+    bestlineHistoryFree();
+    unlink(HISTORY_TEST_FILE);
+}
+
+static int history_find_naive(const char* query, unsigned i)
+{
+    while (i--) {
+        if (strstr(bestlineHistoryGet(i), query)) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// every line found through the trigram index is the one a scan of each line would find
+static void history_find_check(const char* query)
+{
+    unsigned count = bestlineHistoryCount();
+    eassert(bestlineHistoryFind(query, count) == history_find_naive(query, count));
+    int i = bestlineHistoryFind(query, count);
+    while (i > 0) {
+        int next = bestlineHistoryFind(query, (unsigned)i);
+        eassert(next == history_find_naive(query, (unsigned)i));
+        i = next;
+    }
+}
+
+void history_find_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(500) == 0);
+
+    char line[64];
+    for (unsigned i = 0; i < 400; ++i) {
+        snprintf(line, sizeof(line), "%s %u", i % 3 ? "git status" : "make check", i * 7919 % 1000);
+        eassert(bestlineHistoryAdd(line) == 1);
+    }
+    eassert(bestlineHistoryFind("make", bestlineHistoryCount()) == 399);
+    eassert(bestlineHistoryFind("status 9", bestlineHistoryCount()) == 383);
+    eassert(bestlineHistoryFind("nope", bestlineHistoryCount()) == -1);
+    eassert(bestlineHistoryFind("make", 0) == -1);
+
+    // the index is built by the first search, then kept up to date as lines are added and evicted
+    for (unsigned i = 400; i < 1300; ++i) {
+        snprintf(line, sizeof(line), "%s %u", i % 5 ? "ls -la" : "make check", i * 7919 % 1000);
+        eassert(bestlineHistoryAdd(line) == 1);
+    }
+    eassert(bestlineHistoryCount() == 500);
+    eassert(bestlineHistoryDelete(0) == 0);
+    eassert(bestlineHistoryDelete(100) == 0);
+    eassert(bestlineHistoryDelete(400) == 0);
+    eassert(bestlineHistorySetMaxLen(300) == 0);
+
+    const char* queries[] = {"", "m", "ma", "mak", "make check 1", "ls -la 99", "check 7", "9", "status", "ls"};
+    for (size_t i = 0; i < sizeof(queries) / sizeof(*queries); ++i) {
+        history_find_check(queries[i]);
+    }
+
+    bestlineHistoryFree();
+    eassert(bestlineHistoryFind("make", bestlineHistoryCount()) == -1);
+}
+
+static bool history_lines_are(const char** lines, unsigned count)
+{
+    if (bestlineHistoryCount() != count) {
+        return false;
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        if (strcmp(bestlineHistoryGet(i), lines[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// commands ran again move to the newest instead of being added again
+void history_erase_dups_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(4) == 0);
+    eassert(bestlineHistorySetEraseDups(1) == 0);
+
+    eassert(bestlineHistoryAdd("ls") == 1);
+    eassert(bestlineHistoryAdd("pwd") == 1);
+    eassert(bestlineHistoryAdd("make") == 1);
+    eassert(bestlineHistoryAdd("make") == 0);
+    eassert(bestlineHistoryAdd("ls") == 1);
+    eassert(history_lines_are((const char*[]){"pwd", "make", "ls"}, 3));
+
+    // evicted and deleted lines aren't found again
+    eassert(bestlineHistoryAdd("git status") == 1);
+    eassert(bestlineHistoryAdd("nvim") == 1);
+    eassert(history_lines_are((const char*[]){"make", "ls", "git status", "nvim"}, 4));
+    eassert(bestlineHistoryAdd("pwd") == 1);
+    eassert(bestlineHistoryDelete(1) == 0);
+    eassert(bestlineHistoryAdd("git status") == 1);
+    eassert(history_lines_are((const char*[]){"ls", "nvim", "pwd", "git status"}, 4));
+
+    // loading keeps the newest of each line
+    FILE* file = fopen(HISTORY_TEST_FILE, "w");
+    eassert(file);
+    fputs("ls\nmake\nls\npwd\nmake\nls\n", file);
+    fclose(file);
+    eassert(bestlineHistoryLoad(HISTORY_TEST_FILE) == 0);
+    eassert(history_lines_are((const char*[]){"pwd", "make", "ls"}, 3));
+    unlink(HISTORY_TEST_FILE);
+
+    // turning it on erases the duplicates already in the history
+    eassert(bestlineHistorySetEraseDups(0) == 0);
+    eassert(bestlineHistoryAdd("pwd") == 1);
+    eassert(bestlineHistoryAdd("make") == 1);
+    eassert(history_lines_are((const char*[]){"make", "ls", "pwd", "make"}, 4));
+    eassert(bestlineHistorySetEraseDups(1) == 0);
+    eassert(history_lines_are((const char*[]){"ls", "pwd", "make"}, 3));
+
+    eassert(bestlineHistorySetEraseDups(0) == 0);
+    bestlineHistoryFree();
+}
+
+// the table from each line to where it is grows and keeps up with the ring as it wraps around
+void history_erase_dups_many_test()
+{
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(3000) == 0);
+    eassert(bestlineHistorySetEraseDups(1) == 0);
+
+    history_add_n(0, 5000);
+    eassert(bestlineHistoryCount() == 3000);
+    history_add_n(2000, 2100);
+    history_add_n(4900, 5000);
+    eassert(bestlineHistoryCount() == 3000);
+    for (unsigned i = 0; i < 2800; ++i) {
+        eassert(history_is(i, 2100 + i));
+    }
+    eassert(history_is(2800, 2000));
+    eassert(history_is(2999, 4999));
+
+    eassert(bestlineHistorySetEraseDups(0) == 0);
+    bestlineHistoryFree();
+}
+
+static size_t history_file_lines()
+{
+    FILE* file = fopen(HISTORY_LOG_TEST_FILE, "r");
+    if (!file) {
+        return 0;
+    }
+    size_t lines = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        lines += c == '\n';
+    }
+    fclose(file);
+    return lines;
+}
+
+static void history_log_write(char* contents)
+{
+    FILE* file = fopen(HISTORY_LOG_TEST_FILE, "w");
+    eassert(file);
+    fputs(contents, file);
+    fclose(file);
+}
+
+static size_t history_log_merged_count;
+static void history_log_on_merged(const char* line, int length)
+{
+    eassert(line && (size_t)length == strlen(line) + 1);
+    ++history_log_merged_count;
+}
+
+void history_log_add_test()
+{
+    ARENA_TEST_SETUP;
+    history_log_write("ls\npwd\n");
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(100) == 0);
+
+    History_Log log;
+    eassert(history_log_open(&log, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_load(&log) == EXIT_SUCCESS);
+    eassert(bestlineHistoryCount() == 2);
+
+    history_log_add(&log, Str_Lit("echo hi"));
+    eassert(!log.pending_len);
+    eassert(history_file_lines() == 3);
+    // this shell's own lines aren't merged back in
+    eassert(history_log_merge(&log) == 0);
+
+    history_log_close(&log);
+    bestlineHistoryFree();
+    unlink(HISTORY_LOG_TEST_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+// two logs on the same file are like two shells running at the same time
+void history_log_merge_test()
+{
+    ARENA_TEST_SETUP;
+    history_log_write("ls\n");
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(100) == 0);
+
+    History_Log log;
+    History_Log other;
+    eassert(history_log_open(&log, HISTORY_LOG_TEST_FILE, history_log_on_merged, &arena) == EXIT_SUCCESS);
+    eassert(history_log_open(&other, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_load(&log) == EXIT_SUCCESS);
+    history_log_seek(&other, 3);
+
+    history_log_merged_count = 0;
+    history_log_add(&other, Str_Lit("echo one"));
+    history_log_add(&other, Str_Lit("echo two"));
+    eassert(history_log_merge(&log) == 2);
+    eassert(history_log_merged_count == 2);
+    eassert(bestlineHistoryCount() == 3);
+    eassert(!strcmp(bestlineHistoryGet(2), "echo two"));
+
+    // what the other shell appended is merged before this shell's own lines are appended
+    eassert(bestlineHistoryAdd("echo three") == 1);
+    history_log_add(&other, Str_Lit("echo four"));
+    history_log_add(&log, Str_Lit("echo three"));
+    eassert(bestlineHistoryCount() == 5);
+    eassert(!strcmp(bestlineHistoryGet(4), "echo four"));
+    eassert(history_log_merge(&log) == 0);
+    eassert(history_file_lines() == 5);
+
+    history_log_close(&other);
+    history_log_close(&log);
+    bestlineHistoryFree();
+    unlink(HISTORY_LOG_TEST_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+void history_log_compact_test()
+{
+    ARENA_TEST_SETUP;
+    FILE* file = fopen(HISTORY_LOG_TEST_FILE, "w");
+    eassert(file);
+    for (unsigned i = 0; i < 30; ++i) {
+        fprintf(file, "echo %u\n", i);
+    }
+    fclose(file);
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(100) == 0);
+
+    History_Log log;
+    History_Log other;
+    History_Log third;
+    eassert(history_log_open(&log, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_open(&other, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_open(&third, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_load(&log) == EXIT_SUCCESS);
+    history_log_seek(&other, log.offset);
+    history_log_seek(&third, log.offset);
+
+    // not more than twice the lines to keep
+    eassert(history_log_compact(&log, 15) == EXIT_SUCCESS);
+    eassert(history_file_lines() == 30);
+
+    eassert(history_log_compact(&log, 10) == EXIT_SUCCESS);
+    eassert(history_file_lines() == 10);
+    bestlineHistoryFree();
+    eassert(bestlineHistoryLoad(HISTORY_LOG_TEST_FILE) == 0);
+    eassert(history_is(0, 20));
+    eassert(history_is(9, 29));
+
+    // the other shells switch to the compacted file, and only merge what's appended after
+    history_log_add(&third, Str_Lit("echo 30"));
+    eassert(history_log_merge(&other) == 1);
+    eassert(!strcmp(bestlineHistoryGet(bestlineHistoryCount() - 1), "echo 30"));
+    eassert(history_log_merge(&other) == 0);
+    history_log_add(&log, Str_Lit("echo 31"));
+    eassert(history_log_merge(&other) == 1);
+    (void)history_log_merge(&third);
+    eassert(third.offset == other.offset && other.offset == log.offset);
+    eassert(history_file_lines() == 12);
+    eassert(access(HISTORY_LOG_TEST_FILE ".tmp", F_OK));
+
+    history_log_close(&third);
+    history_log_close(&other);
+    history_log_close(&log);
+    bestlineHistoryFree();
+    unlink(HISTORY_LOG_TEST_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+// like history clean: a shell rewrites the history file while another appends to it
+void history_log_replace_test()
+{
+    ARENA_TEST_SETUP;
+    history_log_write("ls\nls\npwd\n");
+    bestlineHistoryFree();
+    eassert(bestlineHistorySetMaxLen(100) == 0);
+
+    History_Log log;
+    History_Log other;
+    eassert(history_log_open(&log, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_open(&other, HISTORY_LOG_TEST_FILE, NULL, &arena) == EXIT_SUCCESS);
+    eassert(history_log_load(&log) == EXIT_SUCCESS);
+    history_log_seek(&other, log.offset);
+
+    // appended after this shell's last merge, it's merged before the history file is rewritten
+    history_log_add(&other, Str_Lit("echo other"));
+    eassert(history_log_lock(&log, LOCK_EX) == EXIT_SUCCESS);
+    eassert(history_log_merge_locked(&log) == 1);
+    FILE* file = fopen(log.tmp_path, "w");
+    eassert(file);
+    fputs("ls\npwd\necho other\n", file);
+    fclose(file);
+    eassert(history_log_replace(&log) == EXIT_SUCCESS);
+    eassert(history_log_reload(&log) == EXIT_SUCCESS);
+    history_log_unlock(&log);
+    eassert(history_file_lines() == 3);
+    eassert(history_lines_are((const char*[]){"ls", "pwd", "echo other"}, 3));
+
+    // the other shell appends to the new history file
+    history_log_add(&other, Str_Lit("echo after"));
+    eassert(history_file_lines() == 4);
+    eassert(history_log_merge(&log) == 1);
+    eassert(history_log_merge(&other) == 0);
+
+    history_log_close(&other);
+    history_log_close(&log);
+    bestlineHistoryFree();
+    unlink(HISTORY_LOG_TEST_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+void history_tests()
+{
+    etest_start();
+
+    etest_run(history_add_test);
+    etest_run(history_evict_test);
+    etest_run(history_delete_test);
+    etest_run(history_set_max_len_test);
+    etest_run(history_long_lines_test);
+    etest_run(history_load_save_test);
+    etest_run(history_find_test);
+    etest_run(history_erase_dups_test);
+    etest_run(history_erase_dups_many_test);
+    etest_run(history_log_add_test);
+    etest_run(history_log_merge_test);
+    etest_run(history_log_compact_test);
+    etest_run(history_log_replace_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    history_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+
+#include "etest.h"
+#include "../src/path_cache.h"
+#include "lib/arena_test_helper.h"
+
+void path_cache_get_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    Str path = path_cache_get(s.path_cache, Str_Lit("sh"));
+
+    eassert(path.value);
+    eassert(path.length == strlen(path.value) + 1);
+    eassert(path.value[0] == '/');
+    eassert(!memcmp(path.value + path.length - sizeof("/sh"), "/sh", sizeof("/sh")));
+    eassert(s.path_cache->count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_get_hit_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    Str path = path_cache_get(s.path_cache, Str_Lit("sh"));
+    Str path_again = path_cache_get(s.path_cache, Str_Lit("sh"));
+
+    eassert(path.value);
+    eassert(path.value == path_again.value);
+    eassert(s.path_cache->count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_get_not_found_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    Str path = path_cache_get(s.path_cache, Str_Lit("ncsh_not_a_command"));
+
+    eassert(!path.value);
+    eassert(!s.path_cache->count);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_get_slash_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    Str name = Str_Lit("./bin/ncsh");
+    Str path = path_cache_get(s.path_cache, name);
+
+    eassert(path.value == name.value);
+    eassert(!s.path_cache->count);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_invalidate_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    Str path = path_cache_get(s.path_cache, Str_Lit("sh"));
+    eassert(path.value);
+
+    path_cache_invalidate(s.path_cache, Str_Lit("sh"));
+    eassert(s.path_cache->count == 1);
+    Str path_again = path_cache_get(s.path_cache, Str_Lit("sh"));
+
+    eassert(path_again.value);
+    eassert(path_again.value != path.value);
+    eassert(estrcmp(path, path_again));
+    eassert(s.path_cache->count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_clear_test()
+{
+    ARENA_TEST_SETUP;
+
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    eassert(path_cache_get(s.path_cache, Str_Lit("sh")).value);
+    eassert(path_cache_get(s.path_cache, Str_Lit("ls")).value);
+    eassert(s.path_cache->count == 2);
+
+    path_cache_clear(s.path_cache);
+
+    eassert(!s.path_cache->count);
+    eassert(!s.path_cache->pool_len);
+    eassert(path_cache_get(s.path_cache, Str_Lit("sh")).value);
+    eassert(s.path_cache->count == 1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_path_changed_test()
+{
+    ARENA_TEST_SETUP;
+
+    char* old_path = strdup(getenv("PATH"));
+    Shell s = {.arena = arena};
+    path_cache_new(&s);
+    eassert(path_cache_get(s.path_cache, Str_Lit("sh")).value);
+
+    setenv("PATH", "/ncsh_not_a_directory", true);
+    path_cache_clear(s.path_cache);
+    eassert(!path_cache_get(s.path_cache, Str_Lit("sh")).value);
+
+    setenv("PATH", old_path, true);
+    free(old_path);
+    ARENA_TEST_TEARDOWN;
+}
+
+void path_cache_tests()
+{
+    etest_start();
+
+    etest_run(path_cache_get_test);
+    etest_run(path_cache_get_hit_test);
+    etest_run(path_cache_get_not_found_test);
+    etest_run(path_cache_get_slash_test);
+    etest_run(path_cache_invalidate_test);
+    etest_run(path_cache_clear_test);
+    etest_run(path_cache_path_changed_test);
+
+    etest_finish();
+}
+
+#ifndef TEST_ALL
+int main()
+{
+    path_cache_tests();
+
+    return EXIT_SUCCESS;
+}
+#endif /* ifndef TEST_ALL */
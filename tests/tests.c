@@ -2,7 +2,12 @@ extern void alias_tests();
 extern void arena_tests();
 extern void config_tests();
 extern void env_tests();
+extern void path_cache_tests();
 extern void str_tests();
+extern void emap_tests();
+extern void compile_tests();
+extern void parse_cache_tests();
+extern void script_tests();
 extern void vm_next_tests();
 extern void vm_tests();
 extern void expansions_tests();
@@ -23,7 +28,12 @@ int main(int argc, char** argv)
     config_tests();
     config_tests();
     env_tests();
+    path_cache_tests();
     str_tests();
+    emap_tests();
+    compile_tests();
+    parse_cache_tests();
+    script_tests();
     vm_next_tests();
     vm_tests();
     ac_tests();
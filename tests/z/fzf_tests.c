@@ -10,6 +10,8 @@
 #include "../lib/examiner.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -829,6 +831,172 @@ TEST(PosIntegration, complexTerm)
     pos_wrapper(".lua$ 'previewer !'term", input, expected);
 }
 
+int32_t fzf_index_byte(const char* data, size_t size, char b, char upper, enum fzf_simd level);
+void fzf_bonus(const char* data, size_t size, bool case_sensitive, int16_t* bonus, int32_t* runes,
+               enum fzf_simd level);
+int16_t fzf_row_max(const int16_t* row, size_t size, size_t* at, enum fzf_simd level);
+
+// bytes the kernels tell apart: both cases and the edges of each range, digits, separators, and non ascii
+static char simd_random_byte(void)
+{
+    static const char bytes[] = "aAzZbmXY09/-_. @[`{\x80\xff";
+    return bytes[rand() % (int)(sizeof(bytes) - 1)];
+}
+
+static void simd_random_text(char* text, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        text[i] = simd_random_byte();
+    }
+    text[len] = '\0';
+}
+
+// the SSE2 and AVX2 kernels give the same results as the scalar ones, for every length around their block sizes
+TEST(Simd, indexByte)
+{
+    srand(1);
+    char text[128];
+    for (size_t len = 0; len < 100; len++) {
+        simd_random_text(text, len);
+        for (int i = 0; i < 8; i++) {
+            char b = simd_random_byte();
+            char upper = rand() % 2 ? b : simd_random_byte();
+            int32_t expected = fzf_index_byte(text, len, b, upper, FZF_SIMD_SCALAR);
+            for (enum fzf_simd level = FZF_SIMD_SSE2; level <= fzf_simd_best(); level++) {
+                ASSERT_EQ(expected, fzf_index_byte(text, len, b, upper, level));
+            }
+        }
+    }
+}
+
+TEST(Simd, bonus)
+{
+    srand(2);
+    char text[128];
+    int16_t expected_bonus[128];
+    int32_t expected_runes[128];
+    int16_t bonus[128];
+    int32_t runes[128];
+    for (size_t len = 0; len < 100; len++) {
+        simd_random_text(text, len);
+        for (int case_sensitive = 0; case_sensitive < 2; case_sensitive++) {
+            fzf_bonus(text, len, case_sensitive, expected_bonus, expected_runes, FZF_SIMD_SCALAR);
+            for (enum fzf_simd level = FZF_SIMD_SSE2; level <= fzf_simd_best(); level++) {
+                fzf_bonus(text, len, case_sensitive, bonus, runes, level);
+                ASSERT_EQ_MEM(expected_bonus, bonus, len * sizeof(int16_t));
+                ASSERT_EQ_MEM(expected_runes, runes, len * sizeof(int32_t));
+            }
+        }
+    }
+}
+
+TEST(Simd, rowMax)
+{
+    srand(3);
+    int16_t row[256];
+    for (size_t len = 1; len < 200; len++) {
+        for (int i = 0; i < 4; i++) {
+            for (size_t j = 0; j < len; j++) {
+                row[j] = (int16_t)(rand() % (i ? 300 : 4)); // ties for the max are common with few values
+            }
+            size_t expected_at = 0;
+            int16_t expected = fzf_row_max(row, len, &expected_at, FZF_SIMD_SCALAR);
+            for (enum fzf_simd level = FZF_SIMD_SSE2; level <= fzf_simd_best(); level++) {
+                size_t at = 0;
+                ASSERT_EQ((int32_t)expected, (int32_t)fzf_row_max(row, len, &at, level));
+                ASSERT_EQ(expected_at, at);
+            }
+        }
+    }
+}
+
+// whole matches, with positions, are the same with every instruction set
+TEST(Simd, fuzzyMatchV2)
+{
+    srand(4);
+    SCRATCH_ARENA_TEST_SETUP;
+    fzf_slab_t* slab = fzf_make_default_slab(&scratch_arena);
+    char text[128];
+    char pattern[8];
+    for (int i = 0; i < 2000; i++) {
+        size_t len = (size_t)(rand() % 100);
+        simd_random_text(text, len);
+        size_t pattern_len = (size_t)(1 + rand() % 6);
+        for (size_t j = 0; j < pattern_len; j++) {
+            // mostly bytes of the text, so most patterns match
+            pattern[j] = len && rand() % 4 ? text[rand() % (int)len] : simd_random_byte();
+        }
+        pattern[pattern_len] = '\0';
+        bool case_sensitive = rand() % 2;
+
+        Arena scratch = scratch_arena;
+        fzf_simd_set(FZF_SIMD_SCALAR);
+        fzf_position_t* expected_pos = fzf_pos_array(0, &scratch);
+        fzf_result_t expected = fuzzy_match_v2(case_sensitive, text, pattern, expected_pos, slab, &scratch);
+        for (enum fzf_simd level = FZF_SIMD_SSE2; level <= fzf_simd_best(); level++) {
+            fzf_simd_set(level);
+            fzf_position_t* pos = fzf_pos_array(0, &scratch);
+            fzf_result_t res = fuzzy_match_v2(case_sensitive, text, pattern, pos, slab, &scratch);
+            ASSERT_EQ(expected.start, res.start);
+            ASSERT_EQ(expected.end, res.end);
+            ASSERT_EQ(expected.score, res.score);
+            ASSERT_EQ(expected_pos->size, pos->size);
+            ASSERT_EQ_MEM(expected_pos->data, pos->data, pos->size * sizeof(uint32_t));
+        }
+    }
+    fzf_simd_set(FZF_SIMD_UNSET);
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+TEST(Context, score)
+{
+    srand(5);
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+    static const fzf_slab_config_t configs[] = {{16, 16}, {64, 64}, {10 * 1024, 2048}};
+    static const char* prefixes[] = {"", "", "'", "^", "!"};
+    char text[128];
+    char lower[128];
+    char pattern[64];
+    for (size_t c = 0; c < sizeof(configs) / sizeof(*configs); c++) {
+        fzf_context_t* ctx = fzf_make_context(configs[c], &arena);
+        fzf_slab_t* slab = fzf_make_slab(configs[c], &arena);
+        for (int i = 0; i < 1000; i++) {
+            size_t len = (size_t)(rand() % 120);
+            simd_random_text(text, len);
+            for (size_t j = 0; j <= len; j++) {
+                lower[j] = (char)tolower((uint8_t)text[j]);
+            }
+
+            size_t pattern_len = 0;
+            for (int term = 0; term <= rand() % 3; term++) {
+                if (term) {
+                    pattern_len += (size_t)sprintf(pattern + pattern_len, rand() % 4 ? " " : " | ");
+                }
+                pattern_len += (size_t)sprintf(pattern + pattern_len, "%s", prefixes[rand() % 5]);
+                for (int j = 0; j <= rand() % 4; j++) {
+                    pattern[pattern_len++] = len && rand() % 4 ? text[rand() % (int)len] : simd_random_byte();
+                }
+                if (!(rand() % 5)) {
+                    pattern[pattern_len++] = '$';
+                }
+            }
+            if (pattern[pattern_len - 1] == ' ') {
+                pattern[pattern_len++] = 'a';
+            }
+            pattern[pattern_len] = '\0';
+
+            Arena scratch = scratch_arena;
+            fzf_context_pattern(ctx, pattern, pattern_len, &scratch);
+            int32_t expected = fzf_get_score(text, len, ctx->pattern, slab, &scratch);
+            ASSERT_EQ(expected, fzf_context_score(ctx, text, lower, len));
+            ASSERT_EQ(expected, fzf_context_score(ctx, text, NULL, len));
+        }
+    }
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
 int fzf_tests(int argc, char** argv)
 {
     exam_init(argc, argv);
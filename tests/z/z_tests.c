@@ -6,6 +6,7 @@
 #include <unistd.h>
 
 #include "../etest.h"
+#include "../../src/z/fzf.h"
 #include "../../src/z/z.h"
 #include "../../src/ttyio/ttyio.h"
 #include "../lib/arena_test_helper.h"
@@ -24,6 +25,10 @@ z_Directory* z_match_find(Str* restrict target, char* restrict cwd, size_t cwd_l
 enum z_Result z_database_add(Str* restrict path, char* restrict cwd, size_t cwd_length,
                              z_Database* restrict db, Arena* restrict arena);
 
+void z_parallel_start(z_Database* restrict db, size_t threads, Arena* restrict arena);
+
+void z_parallel_stop(z_Database* restrict db);
+
 // read from empty database file
 void z_read_empty_database_file_test()
 {
@@ -33,6 +38,10 @@ void z_read_empty_database_file_test()
     z_Database db = {0};
     eassert(z_init(&config_location, &db, &arena) == Z_SUCCESS);
     eassert(db.count == 0);
+    // reported once it's read, rather than printed while reading it
+    eassert(db.read_report == Z_READ_REPORT_CREATED);
+    z_read_report(&db);
+    eassert(db.read_report == Z_READ_REPORT_NONE);
 
     ARENA_TEST_TEARDOWN;
 }
@@ -730,6 +739,338 @@ void z_crashing_input_test()
     SCRATCH_ARENA_TEST_TEARDOWN;
 }
 
+static void z_database_entries_add(z_Database* restrict db, Arena* restrict arena)
+{
+    Str first = Str_Lit("/mnt/c/Users/Alex/source/repos/PersonalRepos/shells");
+    Str second = Str_Lit("/mnt/c/Users/Alex/source/repos/PersonalRepos/shells/ncsh");
+    eassert(z_add(&first, db, arena) == Z_SUCCESS);
+    eassert(z_add(&second, db, arena) == Z_SUCCESS);
+    eassert(z_add(&second, db, arena) == Z_SUCCESS);
+}
+
+// the database is written with a header, entries, and paths, and read back with the paths in place
+void z_database_format_test()
+{
+    remove(Z_DATABASE_FILE);
+    ARENA_TEST_SETUP;
+
+    z_Database db = {0};
+    eassert(z_init(&config_location, &db, &arena) == Z_SUCCESS);
+    z_database_entries_add(&db, &arena);
+    eassert(db.dirty);
+    eassert(z_exit(&db) == Z_SUCCESS);
+    eassert(!db.dirty);
+
+    FILE* file = fopen(Z_DATABASE_FILE, "rb");
+    eassert(file);
+    char magic[8] = {0};
+    eassert(fread(magic, 1, sizeof(magic), file) == sizeof(magic));
+    fclose(file);
+    eassert(!memcmp(magic, "NCSHZDB", 8));
+
+    z_Database read = {0};
+    eassert(z_init(&config_location, &read, &arena) == Z_SUCCESS);
+    eassert(read.count == 2);
+    eassert(!read.dirty);
+    for (size_t i = 0; i < 2; ++i) {
+        eassert(estrcmp(read.dirs[i].path, db.dirs[i].path));
+        eassert(read.dirs[i].rank == db.dirs[i].rank);
+        eassert(read.dirs[i].last_accessed == db.dirs[i].last_accessed);
+    }
+
+    // nothing changed, so it isn't written again
+    remove(Z_DATABASE_FILE);
+    eassert(z_exit(&read) == Z_SUCCESS);
+    eassert(access(Z_DATABASE_FILE, F_OK) == -1);
+
+    ARENA_TEST_TEARDOWN;
+}
+
+// a corrupted database is caught by its checksum, and the shell starts with an empty one
+void z_database_corrupted_test()
+{
+    remove(Z_DATABASE_FILE);
+    ARENA_TEST_SETUP;
+
+    z_Database db = {0};
+    eassert(z_init(&config_location, &db, &arena) == Z_SUCCESS);
+    z_database_entries_add(&db, &arena);
+    eassert(z_exit(&db) == Z_SUCCESS);
+
+    FILE* file = fopen(Z_DATABASE_FILE, "r+b");
+    eassert(file);
+    eassert(!fseek(file, -10, SEEK_END));
+    eassert(fputc('x', file) != EOF);
+    fclose(file);
+
+    z_Database read = {0};
+    eassert(z_init(&config_location, &read, &arena) == Z_SUCCESS);
+    eassert(read.count == 0);
+    eassert(read.read_report == Z_READ_REPORT_CORRUPTED);
+
+    // cut short
+    eassert(!truncate(Z_DATABASE_FILE, 40));
+    eassert(z_init(&config_location, &read, &arena) == Z_SUCCESS);
+    eassert(read.count == 0);
+
+    remove(Z_DATABASE_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+// databases in the old format, an entry at a time, are read and written back in the new one
+void z_database_legacy_test()
+{
+    remove(Z_DATABASE_FILE);
+    ARENA_TEST_SETUP;
+
+    char* paths[] = {"/mnt/c/Users/Alex/source/repos/PersonalRepos/shells", "/mnt/c/Users/Alex/source/repos"};
+    FILE* file = fopen(Z_DATABASE_FILE, "wb");
+    eassert(file);
+    uint32_t count = 2;
+    fwrite(&count, sizeof(count), 1, file);
+    for (size_t i = 0; i < 2; ++i) {
+        double rank = (double)i + 1;
+        time_t last_accessed = 1000 + (time_t)i;
+        uint32_t length = (uint32_t)strlen(paths[i]) + 1;
+        fwrite(&rank, sizeof(rank), 1, file);
+        fwrite(&last_accessed, sizeof(last_accessed), 1, file);
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(paths[i], 1, length, file);
+    }
+    fclose(file);
+
+    z_Database db = {0};
+    eassert(z_init(&config_location, &db, &arena) == Z_SUCCESS);
+    eassert(db.count == 2);
+    eassert(db.dirty);
+    eassert(!strcmp(db.dirs[1].path.value, paths[1]));
+    eassert(db.dirs[1].rank == 2 && db.dirs[1].last_accessed == 1001);
+    eassert(z_exit(&db) == Z_SUCCESS);
+
+    z_Database read = {0};
+    eassert(z_init(&config_location, &read, &arena) == Z_SUCCESS);
+    eassert(read.count == 2);
+    eassert(!read.dirty);
+    eassert(!strcmp(read.dirs[0].path.value, paths[0]));
+
+    remove(Z_DATABASE_FILE);
+    ARENA_TEST_TEARDOWN;
+}
+
+// the database grows past the 200 entries it used to be limited to
+void z_database_unbounded_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    z_Database db = {0};
+    Str cwd = Str_Lit("/home/alex/projects");
+    char name[32];
+    for (size_t i = 0; i < 1000; ++i) {
+        int len = snprintf(name, sizeof(name), "project_%zu", i);
+        eassert(z_database_add(&Str(name, (size_t)len + 1), cwd.value, cwd.length, &db, &arena) == Z_SUCCESS);
+    }
+    eassert(db.count == 1000);
+
+    Str target = Str_Lit("'project_999");
+    z_Directory* result = z_match_find(&target, "/", 2, &db, &scratch_arena);
+    eassert(result);
+    eassert(!strcmp(result->path.value, "/home/alex/projects/project_999"));
+
+    Str path = Str_Lit("/home/alex/projects/project_999");
+    eassert(z_remove(&path, &db) == Z_SUCCESS);
+    eassert(db.count == 999);
+    target = Str_Lit("'project_999");
+    eassert(!z_match_find(&target, "/", 2, &db, &scratch_arena));
+    target = Str_Lit("'project_998");
+    result = z_match_find(&target, "/", 2, &db, &scratch_arena);
+    eassert(result);
+    eassert(!strcmp(result->path.value, "/home/alex/projects/project_998"));
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// a trigram whose only directory was removed keeps its key with no ids, adding a directory with it again still works
+void z_database_add_after_remove_test()
+{
+    ARENA_TEST_SETUP;
+
+    z_Database db = {0};
+    Str cwd = Str_Lit("/home/alex");
+    eassert(z_database_add(&Str_Lit("uniq_abc"), cwd.value, cwd.length, &db, &arena) == Z_SUCCESS);
+    eassert(z_remove(&Str_Lit("/home/alex/uniq_abc"), &db) == Z_SUCCESS);
+    eassert(!db.count);
+
+    eassert(z_database_add(&Str_Lit("uniq_abd"), cwd.value, cwd.length, &db, &arena) == Z_SUCCESS);
+    eassert(z_database_add(&Str_Lit("uniq_abc"), cwd.value, cwd.length, &db, &arena) == Z_SUCCESS);
+    eassert(db.count == 2);
+
+    SCRATCH_ARENA_TEST_SETUP;
+    Str target = Str_Lit("'uniq_abc");
+    z_Directory* result = z_match_find(&target, "/", 2, &db, &scratch_arena);
+    eassert(result);
+    eassert(!strcmp(result->path.value, "/home/alex/uniq_abc"));
+    target = Str_Lit("'uniq_abd");
+    result = z_match_find(&target, "/", 2, &db, &scratch_arena);
+    eassert(result);
+    eassert(!strcmp(result->path.value, "/home/alex/uniq_abd"));
+
+    SCRATCH_ARENA_TEST_TEARDOWN;
+    ARENA_TEST_TEARDOWN;
+}
+
+/* z_match_find_scan
+ * z_match_find without the index, scoring every directory.
+ */
+static z_Directory* z_match_find_scan(char* query, z_Database* restrict db, Arena scratch)
+{
+    size_t len = strlen(query);
+    char* copy = arena_malloc(&scratch, len + 1, char);
+    memcpy(copy, query, len);
+    fzf_slab_t* slab = fzf_make_slab((fzf_slab_config_t){(size_t)1 << 6, 1 << 6}, &scratch);
+    fzf_pattern_t* pattern = fzf_parse_pattern(copy, len, &scratch);
+    time_t now = time(NULL);
+    z_Directory* match = NULL;
+    double match_score = 0;
+    for (size_t i = 0; i < db->count; ++i) {
+        int fzf_score = fzf_get_score(db->dirs[i].path.value, db->dirs[i].path.length - 1, pattern, slab, &scratch);
+        if (fzf_score && (!match || match_score < z_score(db->dirs + i, fzf_score, now))) {
+            match = db->dirs + i;
+            match_score = z_score(match, fzf_score, now);
+        }
+    }
+    return match;
+}
+
+// the index finds the same directory as scoring every one, whatever the kind of terms, before and after removing
+void z_match_find_index_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    static char* parents[] = {"/home/alex/src", "/home/alex/Documents", "/var/lib/docker", "/usr/local/share",
+                              "/mnt/c/Users/Alex/source/repos"};
+    static char* names[] = {"ncsh", "ttytest2", "build", "NcshDocs", "volumes", "man", "z_db", "fzf-native"};
+    z_Database db = {0};
+    char name[64];
+    for (size_t i = 0; i < 400; ++i) {
+        int len = snprintf(name, sizeof(name), "%s%zu/%s", names[i % 8], i / 40, names[i / 8 % 8]);
+        char* parent = parents[i % 5];
+        eassert(z_database_add(&Str(name, (size_t)len + 1), parent, strlen(parent) + 1, &db, &arena) == Z_SUCCESS);
+        db.dirs[db.count - 1].rank = (double)(i * 7 % 13);
+    }
+
+    static char* queries[] = {"ncsh", "'ncsh", "^/home", "build$", "^/home/alex/documents/ncsh0/build$", "NcshDocs",
+                              "'ncshdocs", "'sh0/bui", "docs !alex", "'man | 'z_db", "'src/ncsh 'build", "!ncsh",
+                              "'fzf-native9", "'zzz", "ttytest2 'ocs", "ab", "'/v", "'ocker/volumes"};
+    for (size_t pass = 0; pass < 2; ++pass) {
+        for (size_t q = 0; q < sizeof(queries) / sizeof(*queries); ++q) {
+            Arena query_scratch = scratch_arena;
+            size_t len = strlen(queries[q]);
+            char* copy = arena_malloc(&query_scratch, len + 1, char);
+            memcpy(copy, queries[q], len);
+            z_Directory* indexed = z_match_find(&Str(copy, len + 1), "/", 2, &db, &query_scratch);
+            eassert(indexed == z_match_find_scan(queries[q], &db, scratch_arena));
+        }
+
+        for (size_t i = 0; i < 50; ++i) {
+            Str path = {.value = db.dirs[i * 3].path.value, .length = db.dirs[i * 3].path.length};
+            eassert(z_remove(&path, &db) == Z_SUCCESS);
+        }
+    }
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
+// scoring allocates nothing, so what a z takes from the scratch arena doesn't grow with the database
+void z_match_find_arena_usage_test()
+{
+    static char* queries[] = {"ncsh", "nsh/build", "NcshDocs", "'ncsh9 build$", "qqq"};
+    size_t usage[2][sizeof(queries) / sizeof(*queries)];
+    static const size_t counts[] = {100, 5000};
+
+    for (size_t c = 0; c < 2; ++c) {
+        ARENA_TEST_SETUP;
+        SCRATCH_ARENA_TEST_SETUP;
+        z_Database db = {0};
+        char name[64];
+        for (size_t i = 0; i < counts[c]; ++i) {
+            int len = snprintf(name, sizeof(name), "%s%zu/%s", i % 3 ? "ncsh" : "NcshDocs", i, i % 2 ? "build" : "src");
+            eassert(z_database_add(&Str(name, (size_t)len + 1), "/home/alex", 11, &db, &arena) == Z_SUCCESS);
+        }
+
+        for (size_t q = 0; q < sizeof(queries) / sizeof(*queries); ++q) {
+            Arena query_scratch = scratch_arena;
+            size_t len = strlen(queries[q]);
+            char* copy = arena_malloc(&query_scratch, len + 1, char);
+            memcpy(copy, queries[q], len);
+            char* before = query_scratch.start;
+            (void)z_match_find(&Str(copy, len + 1), "/", 2, &db, &query_scratch);
+            usage[c][q] = (size_t)(query_scratch.start - before);
+            printf("z %s with %zu directories: %zu bytes of scratch\n", queries[q], db.count, usage[c][q]);
+        }
+
+        ARENA_TEST_TEARDOWN;
+        SCRATCH_ARENA_TEST_TEARDOWN;
+    }
+
+    // exact terms allocate the list of the directories with their trigrams, fuzzy terms score every directory
+    eassert(usage[0][0] == usage[1][0]);
+    eassert(usage[0][1] == usage[1][1]);
+    eassert(usage[0][2] == usage[1][2]);
+    eassert(usage[0][4] == usage[1][4]);
+}
+
+// scoring on the pool's threads finds the same directory as one thread, the first of those tying for the best score
+void z_match_find_parallel_test()
+{
+    ARENA_TEST_SETUP;
+    SCRATCH_ARENA_TEST_SETUP;
+
+    static char* names[] = {"ncsh", "build", "src", "Docs", "tests"};
+    z_Database db = {0};
+    char name[64];
+    for (size_t i = 0; i < 3000; ++i) {
+        int len = snprintf(name, sizeof(name), "%s%zu/%s", names[i % 5], i % 7, names[i / 5 % 5]);
+        Str path = Str(name, (size_t)len + 1);
+        if (z_database_add(&path, "/home/alex", 11, &db, &arena) == Z_SUCCESS) {
+            // only a few ranks, so many directories tie
+            db.dirs[db.count - 1].rank = (double)(i % 3);
+            db.dirs[db.count - 1].last_accessed = 0;
+        }
+    }
+
+    z_parallel_start(&db, 4, &arena);
+    eassert(db.pool);
+    static char* queries[] = {"ncsh", "build", "'src", "docs", "ncsh3/tests", "^/home/alex/build", "tests$", "qqq",
+                              "s", "'ncsh 'build"};
+    for (size_t q = 0; q < sizeof(queries) / sizeof(*queries); ++q) {
+        z_Directory* results[2];
+        for (size_t parallel_min = 0; parallel_min < 2; ++parallel_min) {
+            db.parallel_min = parallel_min;
+            Arena query_scratch = scratch_arena;
+            size_t len = strlen(queries[q]);
+            char* copy = arena_malloc(&query_scratch, len + 1, char);
+            memcpy(copy, queries[q], len);
+            results[parallel_min] = z_match_find(&Str(copy, len + 1), "/", 2, &db, &query_scratch);
+        }
+        eassert(results[0] == results[1]);
+    }
+    z_parallel_stop(&db);
+    eassert(!db.pool);
+
+    // with one thread there's no pool to start, and z doesn't try again
+    db.parallel_min = 1;
+    z_parallel_start(&db, 1, &arena);
+    eassert(!db.pool);
+    eassert(!db.parallel_min);
+
+    ARENA_TEST_TEARDOWN;
+    SCRATCH_ARENA_TEST_TEARDOWN;
+}
+
 void z_tests()
 {
     tty_init_caps();
@@ -764,6 +1105,14 @@ void z_tests()
     etest_run(z_add_new_entry_contained_in_another_entry_but_different_test);
     etest_run(z_contains_correct_match_test);
     etest_run(z_crashing_input_test);
+    etest_run(z_database_format_test);
+    etest_run(z_database_corrupted_test);
+    etest_run(z_database_legacy_test);
+    etest_run(z_database_unbounded_test);
+    etest_run(z_match_find_index_test);
+    etest_run(z_database_add_after_remove_test);
+    etest_run(z_match_find_arena_usage_test);
+    etest_run(z_match_find_parallel_test);
 
     etest_finish();
     tty_deinit_caps();